@@ -0,0 +1,107 @@
+#!/usr/bin/env bash
+# Benchmarks do Sapphire.
+#
+# Uso: bench/run.sh [binario] [repeticoes] [filtro]
+#   binario     padrão: configura e compila build-bench/sapphire em Release
+#               com -DSAPPHIRE_DEBUG_PRINT=OFF. Um binário próprio também
+#               deve ser Release e sem as listagens de depuração.
+#   repeticoes  quantas vezes cada medida roda; vale a menor (padrão: 5)
+#   filtro      só os scripts cujo nome contém o texto (ex: "array")
+#
+# Para cada bench/*.sp, mostra o tempo de CPU (usuário + sistema) em
+# segundos na VM de pilha, na VM de registradores (--vm=register) e com o
+# JIT (--jit). "-" quer dizer que a build não tem aquele modo. Depois:
+#   - memória por instância: o "live" de --gc-stats em instances.sp,
+#     dividido pelo número de nós que ele cria;
+#   - compilação: um script gerado de vários MB passa só pelo compilador
+#     (--compile), em MB/s; mede o lexer e o parser juntos;
+#   - lexer: o mesmo script só passa pelo lexer (--lex-only), em MB/s.
+#
+# Todo script roda com --no-cache, para não medir o .spc de uma rodada
+# anterior, e a saída é descartada.
+
+set -u
+
+BIN=${1:-}
+RUNS=${2:-5}
+FILTER=${3:-}
+DIR=$(cd "$(dirname "$0")" && pwd)
+
+if [ -z "$BIN" ]; then
+    ROOT=$(dirname "$DIR")
+    cmake -S "$ROOT" -B "$ROOT/build-bench" -DCMAKE_BUILD_TYPE=Release -DSAPPHIRE_DEBUG_PRINT=OFF >/dev/null || exit 1
+    cmake --build "$ROOT/build-bench" -j"$(nproc 2>/dev/null || echo 2)" >/dev/null || exit 1
+    BIN=$ROOT/build-bench/sapphire
+fi
+
+if [ ! -x "$BIN" ]; then
+    echo "Binario nao encontrado: $BIN" >&2
+    exit 1
+fi
+
+TIMEFORMAT='%3U %3S'
+
+# Menor tempo de CPU de $RUNS execuções; "-" se o modo falhar.
+best_time() {
+    local best="" t
+    for _ in $(seq "$RUNS"); do
+        t=$( { time "$BIN" --no-cache "$@" >/dev/null 2>&1 || echo FAIL >&2; } 2>&1 )
+        case "$t" in *FAIL*) echo "-"; return ;; esac
+        t=$(echo "$t" | awk '{ printf "%.3f", $1 + $2 }')
+        if [ -z "$best" ] || awk -v a="$t" -v b="$best" 'BEGIN { exit !(a < b) }'; then best=$t; fi
+    done
+    echo "$best"
+}
+
+printf '%-16s %10s %10s %10s\n' "script" "pilha" "registr." "jit"
+for script in "$DIR"/*.sp; do
+    name=$(basename "$script" .sp)
+    case "$name" in *"$FILTER"*) ;; *) continue ;; esac
+    printf '%-16s %10s %10s %10s\n' "$name" \
+        "$(best_time "$script")" \
+        "$(best_time --vm=register "$script")" \
+        "$(best_time --jit "$script")"
+done
+
+# --- Memória por instância ---
+INSTANCES=1000000
+case "instances" in *"$FILTER"*)
+    live=$("$BIN" --no-cache --gc-stats "$DIR/instances.sp" 2>&1 | sed -n 's/.*live: \([0-9]*\) bytes.*/\1/p')
+    if [ -n "$live" ]; then
+        echo
+        awk -v live="$live" -v n="$INSTANCES" 'BEGIN { printf "memoria por instancia: %.1f bytes (live %d bytes / %d nos)\n", live / n, live, n }'
+    fi
+;; esac
+
+# --- Compilação e lexer ---
+case "compile lexer" in *"$FILTER"*)
+    TMP=$(mktemp -d)
+    trap 'rm -rf "$TMP"' EXIT
+    # 200 funções de 2000 comandos: aritmética, if/else e while. Os comandos
+    # só usam variáveis, porque cada literal ocupa uma das 256 constantes
+    # da função.
+    awk 'BEGIN {
+        for (f = 0; f < 200; f++) {
+            printf "function double f%d(double a, double b) {\n    double t = a;\n    double u = b;\n", f
+            for (s = 0; s < 2000; s++) {
+                if (s % 4 == 0) printf "    t = t * a + b - u / t;\n"
+                else if (s % 4 == 1) printf "    if (t > u) { t = t - a; } else { u = u + b; }\n"
+                else if (s % 4 == 2) printf "    while (t > u) { t = t / a; }\n"
+                else printf "    u = u * b - t;\n"
+            }
+            printf "    return t;\n}\n"
+        }
+    }' > "$TMP/compile.sp"
+    bytes=$(wc -c < "$TMP/compile.sp")
+    echo
+    # Uma linha por medida: nome, tempo (ou "-").
+    report() {
+        if [ "$2" = "-" ]; then
+            echo "$1: falhou"
+        else
+            awk -v n="$1" -v b="$bytes" -v t="$2" 'BEGIN { printf "%s: %.1f MB em %.3f s (%.1f MB/s)\n", n, b / 1e6, t, (t > 0 ? b / 1e6 / t : 0) }'
+        fi
+    }
+    case "compile" in *"$FILTER"*) report compilacao "$(best_time --compile "$TMP/compile.spc" "$TMP/compile.sp")" ;; esac
+    case "lexer" in *"$FILTER"*) report lexer "$(best_time --lex-only "$TMP/compile.sp")" ;; esac
+;; esac
@@ -6,9 +6,141 @@
 #include <vector>
 #include <cstdint>
 
+struct Shape;
+struct ObjClosure;
+struct JitCode;
+void free_jit_code(JitCode* code);
+
+// Tamanho em bytes de uma instrução (opcode + operandos), ou 0 para um
+// opcode desconhecido. Usado por quem precisa percorrer o bytecode.
+static inline int instruction_length(uint8_t instruction) {
+    switch (instruction) {
+        case OP_NIL: case OP_TRUE: case OP_FALSE: case OP_POP:
+        case OP_CLASS: case OP_EQUAL: case OP_GREATER: case OP_LESS: case OP_NOT:
+        case OP_ADD: case OP_SUBTRACT: case OP_MULTIPLY: case OP_DIVIDE: case OP_NEGATE:
+        case OP_PRINT: case OP_GET_SUBSCRIPT: case OP_SET_SUBSCRIPT: case OP_RETURN:
+        case OP_NOT_EQUAL: case OP_GREATER_EQUAL: case OP_LESS_EQUAL:
+        case OP_ADD_NUM: case OP_SUBTRACT_NUM: case OP_MULTIPLY_NUM: case OP_DIVIDE_NUM:
+        case OP_GREATER_NUM: case OP_LESS_NUM: case OP_CHECK_NUMBER: case OP_DIVIDE_INT:
+            return 1;
+        case OP_CONSTANT: case OP_GET_LOCAL: case OP_SET_LOCAL:
+        case OP_CLOSURE: case OP_CALL:
+        case OP_SET_LOCAL_POP: case OP_ARRAY_APPEND:
+            return 2;
+        case OP_GET_GLOBAL: case OP_SET_GLOBAL: case OP_DEFINE_GLOBAL:
+        case OP_JUMP: case OP_JUMP_IF_FALSE: case OP_LOOP:
+        case OP_EQUAL_JUMP: case OP_NOT_EQUAL_JUMP: case OP_GREATER_JUMP:
+        case OP_GREATER_EQUAL_JUMP: case OP_LESS_JUMP: case OP_LESS_EQUAL_JUMP:
+        case OP_ADD_LOCAL_LOCAL: case OP_INC_LOCAL_CONST:
+        case OP_GET_GLOBAL_QUICK: case OP_SET_GLOBAL_POP:
+        case OP_GET_NATIVE: case OP_BUILD_ARRAY: case OP_ARRAY_LITERAL:
+            return 3;
+        case OP_GET_PROPERTY: case OP_SET_PROPERTY:
+        case OP_INC_GLOBAL_CONST: case OP_CALL_NATIVE:
+            return 4;
+        case OP_INVOKE:
+        case OP_LESS_LOCAL_CONST_JUMP: case OP_LESS_LOCAL_LOCAL_JUMP:
+            return 5;
+        case OP_LESS_GLOBAL_CONST_JUMP:
+            return 6;
+    }
+    return 0;
+}
+
+// --- Inline caches ---
+// Cada OP_GET_PROPERTY / OP_SET_PROPERTY / OP_INVOKE tem o seu próprio cache, indexado
+// pelo operando da instrução. A chave é a forma (Shape) do receptor, que
+// também identifica a classe, e o valor é o resultado da busca:
+//   - leitura e OP_INVOKE: o índice do campo, ou a closure do método;
+//   - escrita: o índice do campo, mais a forma de destino se a escrita
+//     acrescentar um campo novo.
+// O cache começa monomórfico, guarda até CACHE_ENTRIES_MAX formas e, se
+// aparecer mais uma, vira megamórfico e deixa de ser consultado.
+#define CACHE_ENTRIES_MAX 4
+
+enum CacheState : uint8_t {
+    CACHE_EMPTY,
+    CACHE_MONOMORPHIC,
+    CACHE_POLYMORPHIC,
+    CACHE_MEGAMORPHIC,
+};
+
+struct CacheEntry {
+    Shape* shape = nullptr;
+    Shape* new_shape = nullptr;   // Escrita: transição causada pela atribuição
+    ObjClosure* method = nullptr; // Leitura: método da classe em vez de campo
+    uint16_t index = 0;           // Posição do campo em ObjInstance::fields
+};
+
+struct InlineCache {
+    CacheState state = CACHE_EMPTY;
+    uint8_t count = 0;
+    CacheEntry entries[CACHE_ENTRIES_MAX];
+    int offset = 0;               // Posição da instrução no bytecode (para as estatísticas)
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+};
+
+// Os bytes de um chunk. Durante a compilação o chunk é dono de um vetor que
+// cresce; um chunk carregado de uma imagem (image.h) aponta direto para a
+// memória mapeada do arquivo, somente leitura. patch e push_back só valem
+// para bytecode próprio; resize seguido de uma reescrita completa (o tier-up,
+// optimizer.h) troca o bytecode externo por um próprio.
+class Bytecode {
+public:
+    Bytecode() = default;
+    Bytecode(const Bytecode&) = delete;
+    Bytecode& operator=(const Bytecode&) = delete;
+
+    size_t size() const { return length; }
+    const uint8_t* data() const { return bytes; }
+    uint8_t operator[](size_t index) const { return bytes[index]; }
+
+    void patch(size_t index, uint8_t byte) { owned[index] = byte; }
+    uint8_t* writable_data() { return owned.data(); }
+    void push_back(uint8_t byte) { owned.push_back(byte); sync(); }
+    void resize(size_t size) { owned.resize(size); sync(); }
+
+    // Passa a usar 'size' bytes de memória externa, que deve viver mais que o chunk.
+    void assign_external(const uint8_t* data, size_t size) {
+        std::vector<uint8_t>().swap(owned);
+        bytes = data;
+        length = size;
+        external = true;
+    }
+    bool is_external() const { return external; }
+
+private:
+    void sync() {
+        bytes = owned.data();
+        length = owned.size();
+        external = false;
+    }
+
+    std::vector<uint8_t> owned;
+    const uint8_t* bytes = nullptr;
+    size_t length = 0;
+    bool external = false;
+};
+
 struct Chunk {
-    std::vector<uint8_t> code;          // O bytecode em si. Uma lista de instruções.
+    Bytecode code;                      // O bytecode em si. Uma lista de instruções.
     std::vector<SapphireValue> constants; // A "piscina" de constantes.
+    std::vector<InlineCache> caches;    // Um por instrução de propriedade.
+    // Tradução para o backend de registradores (register.h), feita na
+    // primeira chamada com --vm=register. Vazia no backend de pilha.
+    std::vector<uint8_t> register_code;
+    uint16_t register_count = 0;        // Registradores usados pelo frame
+    // Chamadas + voltas de laço, até o último nível: em TIER_UP_THRESHOLD o
+    // bytecode é acelerado (quicken_chunk, optimizer.h) e em
+    // JIT_HOT_THRESHOLD vira código nativo (jit.h, só com --jit).
+    uint32_t hotness = 0;
+    JitCode* jit = nullptr;
+
+    ~Chunk() {
+        if (jit != nullptr) free_jit_code(jit);
+    }
+
 
     // Função auxiliar para escrever um byte no chunk.
     void write(uint8_t byte) {
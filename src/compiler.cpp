@@ -1,7 +1,12 @@
 #include "compiler.h"
 #include "parser.h" // O parser.cpp conterá a implementação do parser.
+#include "optimizer.h"
 #include <iostream>
 
+// O parser ativo, se houver uma compilação em andamento. As funções que ele
+// está preenchendo ainda não são alcançáveis a partir da VM.
+static Parser* active_parser = nullptr;
+
 // Construtor e inicializador do Compiler
 Compiler::Compiler(ObjFunction* func) {
     init(func);
@@ -22,13 +27,14 @@ void Compiler::init(ObjFunction* func) {
 
 // A função de compilação agora está em seu próprio arquivo.
 // Ela será chamada pelo parser.h
-ObjFunction* compile(const std::string& source) {
+ObjFunction* compile(const std::string& source, GlobalTable& globals) {
     Lexer lexer(source);
     Compiler compiler(new_function());
 
     // Inicializa o parser (que será definido em parser.cpp)
     // e passa a ele o lexer e o compilador.
-    Parser parser(lexer, &compiler);
+    Parser parser(lexer, &compiler, &globals);
+    active_parser = &parser;
 
     while (!parser.match(TokenType::END_OF_FILE)) {
         parser.declaration();
@@ -36,7 +42,13 @@ ObjFunction* compile(const std::string& source) {
     
     ObjFunction* main_function = compiler.function;
     parser.emit_return(); // Garante que o script principal sempre retorne.
+    if (!parser.had_error) optimize_chunk(main_function->chunk);
+    active_parser = nullptr;
 
     // Retorna nullptr se houve um erro de compilação.
     return parser.had_error ? nullptr : main_function;
-}
\ No newline at end of file
+}
+
+void mark_compiler_roots() {
+    if (active_parser != nullptr) active_parser->mark_roots();
+}
@@ -4,9 +4,9 @@
 #include "object.h"
 #include "vm.h"
 #include "tokens.h" // Incluído para a struct Token
-#include <functional>
 #include <string>
 #include <map>
+#include <vector>
 
 // Precedência dos operadores para o Pratt Parser
 typedef enum {
@@ -23,16 +23,19 @@ typedef enum {
     PREC_PRIMARY
 } Precedence;
 
-// Assinatura para as funções de parsing do Pratt Parser
-using PrefixParseFn = std::function<TokenType(bool can_assign)>;
+class Parser;
 
-using InfixParseFn = std::function<TokenType(TokenType left_type, bool can_assign)>;
+// Assinatura para as funções de parsing do Pratt Parser. São ponteiros para
+// métodos do Parser, chamados com (this->*regra)(...), sem std::function.
+using PrefixParseFn = TokenType (Parser::*)(bool can_assign);
+
+using InfixParseFn = TokenType (Parser::*)(TokenType left_type, bool can_assign);
 
 // Estrutura para uma regra de parsing
 struct ParseRule {
-    PrefixParseFn prefix;
-    InfixParseFn infix;
-    Precedence precedence;
+    PrefixParseFn prefix = nullptr;
+    InfixParseFn infix = nullptr;
+    Precedence precedence = PREC_NONE;
 };
 
 // Estrutura para rastrear uma variável local no momento da compilação.
@@ -40,6 +43,9 @@ struct Local {
     Token name;
     int depth;
     TokenType type; 
+    // Local numérica cujo valor é sempre um número: inicializada com um
+    // número garantido, e toda atribuição posterior é checada.
+    bool number;
 };
 
 // A classe Compiler agora é uma classe de estado, gerenciada pelo Parser.
@@ -52,7 +58,10 @@ public:
     int local_count = 0;
     int scope_depth = 0;
 
-    std::map<std::string, TokenType> global_types;
+    // std::less<> permite buscar direto pela string_view do token.
+    std::map<std::string, TokenType, std::less<>> global_types;
+    // Tipos dos parâmetros das funções globais declaradas até aqui.
+    std::map<std::string, std::vector<TokenType>, std::less<>> function_params;
 
     Compiler(ObjFunction* func);
     TokenType function_return_type;
@@ -60,6 +69,10 @@ public:
 };
 
 // A função principal que inicia todo o processo de compilação.
-ObjFunction* compile(const std::string& source);
+// Os nomes globais são resolvidos para slots da tabela da VM.
+ObjFunction* compile(const std::string& source, GlobalTable& globals);
+
+// Marca as funções em compilação (e suas constantes) para o coletor de lixo.
+void mark_compiler_roots();
 
 #endif //SAPPHIRE_COMPILER_H
\ No newline at end of file
@@ -1,8 +1,11 @@
+#include <algorithm>
 #include <iomanip>
 #include <iostream>
+#include <vector>
 
 #include "debug.h"
 #include "object.h"
+#include "register.h"
 #include "value.h"
 #include "vm.h"
 
@@ -27,6 +30,114 @@ static int constant_instruction(const char* name, const Chunk& chunk, int offset
     return offset + 2;
 }
 
+static int global_instruction(const char* name, const Chunk& chunk, int offset) {
+    uint16_t slot = (uint16_t)(chunk.code[offset + 1] << 8);
+    slot |= chunk.code[offset + 2];
+    printf("%-16s %4d\n", name, slot);
+    return offset + 3;
+}
+
+static int property_instruction(const char* name, const Chunk& chunk, int offset) {
+    uint8_t constant_index = chunk.code[offset + 1];
+    uint16_t cache = (uint16_t)(chunk.code[offset + 2] << 8);
+    cache |= chunk.code[offset + 3];
+    printf("%-16s %4d '", name, constant_index);
+    print_value(chunk.constants[constant_index]);
+    printf("' ic %d\n", cache);
+    return offset + 4;
+}
+
+static int invoke_instruction(const char* name, const Chunk& chunk, int offset) {
+    uint8_t constant_index = chunk.code[offset + 1];
+    uint16_t cache = (uint16_t)(chunk.code[offset + 2] << 8);
+    cache |= chunk.code[offset + 3];
+    uint8_t arg_count = chunk.code[offset + 4];
+    printf("%-16s (%d args) %4d '", name, arg_count, constant_index);
+    print_value(chunk.constants[constant_index]);
+    printf("' ic %d\n", cache);
+    return offset + 5;
+}
+
+// Slot da nativa e número de argumentos.
+static int native_call_instruction(const char* name, const Chunk& chunk, int offset) {
+    uint16_t slot = (uint16_t)((chunk.code[offset + 1] << 8) | chunk.code[offset + 2]);
+    uint8_t arg_count = chunk.code[offset + 3];
+    printf("%-16s (%d args) %4d\n", name, arg_count, slot);
+    return offset + 4;
+}
+
+static const char* array_kind_name(uint8_t kind) {
+    switch (kind) {
+        case ARRAY_DOUBLE: return "double";
+        case ARRAY_INT:    return "int";
+        case ARRAY_BOOL:   return "bool";
+        case ARRAY_VALUE:  return "value";
+        case ARRAY_VIEW:   return "view";
+    }
+    return "infer";
+}
+
+// Quantidade de elementos e o tipo declarado deles.
+static int array_instruction(const char* name, const Chunk& chunk, int offset) {
+    printf("%-16s %4d %s\n", name, chunk.code[offset + 1], array_kind_name(chunk.code[offset + 2]));
+    return offset + 3;
+}
+
+// Os elementos empacotados não são texto: mostra só quantos são.
+static int packed_array_instruction(const char* name, const Chunk& chunk, int offset) {
+    uint8_t constant_index = chunk.code[offset + 1];
+    uint8_t kind = chunk.code[offset + 2];
+    size_t bytes = static_cast<ObjString*>(chunk.constants[constant_index].as_obj())->chars.size();
+    printf("%-16s %4d (%zu elementos) %s\n", name, constant_index,
+           bytes / array_element_size(static_cast<ArrayKind>(kind)), array_kind_name(kind));
+    return offset + 3;
+}
+
+static int two_byte_instruction(const char* name, const Chunk& chunk, int offset) {
+    printf("%-16s %4d %4d\n", name, chunk.code[offset + 1], chunk.code[offset + 2]);
+    return offset + 3;
+}
+
+static int local_constant_instruction(const char* name, const Chunk& chunk, int offset) {
+    uint8_t constant_index = chunk.code[offset + 2];
+    printf("%-16s %4d %4d '", name, chunk.code[offset + 1], constant_index);
+    print_value(chunk.constants[constant_index]);
+    printf("'\n");
+    return offset + 3;
+}
+
+// Superinstrução com dois operandos de 1 byte seguidos de um salto.
+static int compare_jump_instruction(const char* name, bool constant, const Chunk& chunk, int offset) {
+    uint16_t jump = (uint16_t)(chunk.code[offset + 3] << 8);
+    jump |= chunk.code[offset + 4];
+    printf("%-16s %4d %4d", name, chunk.code[offset + 1], chunk.code[offset + 2]);
+    if (constant) {
+        printf(" '");
+        print_value(chunk.constants[chunk.code[offset + 2]]);
+        printf("'");
+    }
+    printf(" -> %d\n", offset + 5 + jump);
+    return offset + 5;
+}
+
+// Global de 16 bits + constante (+ salto, nas comparações).
+static int global_constant_instruction(const char* name, bool jump, const Chunk& chunk, int offset) {
+    uint16_t slot = (uint16_t)(chunk.code[offset + 1] << 8);
+    slot |= chunk.code[offset + 2];
+    uint8_t constant_index = chunk.code[offset + 3];
+    printf("%-16s %4d %4d '", name, slot, constant_index);
+    print_value(chunk.constants[constant_index]);
+    printf("'");
+    if (!jump) {
+        printf("\n");
+        return offset + 4;
+    }
+    uint16_t distance = (uint16_t)(chunk.code[offset + 4] << 8);
+    distance |= chunk.code[offset + 5];
+    printf(" -> %d\n", offset + 6 + distance);
+    return offset + 6;
+}
+
 static int jump_instruction(const char* name, int sign, const Chunk& chunk, int offset) {
     uint16_t jump = (uint16_t)(chunk.code[offset + 1] << 8);
     jump |= chunk.code[offset + 2];
@@ -49,11 +160,11 @@ int disassemble_instruction(const Chunk& chunk, int offset) {
         case OP_POP:           return simple_instruction("OP_POP", offset);
         case OP_GET_LOCAL:     return byte_instruction("OP_GET_LOCAL", chunk, offset);
         case OP_SET_LOCAL:     return byte_instruction("OP_SET_LOCAL", chunk, offset);
-        case OP_GET_GLOBAL:    return constant_instruction("OP_GET_GLOBAL", chunk, offset);
-        case OP_DEFINE_GLOBAL: return constant_instruction("OP_DEFINE_GLOBAL", chunk, offset);
-        case OP_SET_GLOBAL:    return constant_instruction("OP_SET_GLOBAL", chunk, offset);
-        case OP_GET_PROPERTY:  return constant_instruction("OP_GET_PROPERTY", chunk, offset);
-        case OP_SET_PROPERTY:  return constant_instruction("OP_SET_PROPERTY", chunk, offset);
+        case OP_GET_GLOBAL:    return global_instruction("OP_GET_GLOBAL", chunk, offset);
+        case OP_DEFINE_GLOBAL: return global_instruction("OP_DEFINE_GLOBAL", chunk, offset);
+        case OP_SET_GLOBAL:    return global_instruction("OP_SET_GLOBAL", chunk, offset);
+        case OP_GET_PROPERTY:  return property_instruction("OP_GET_PROPERTY", chunk, offset);
+        case OP_SET_PROPERTY:  return property_instruction("OP_SET_PROPERTY", chunk, offset);
         case OP_GET_SUBSCRIPT: return simple_instruction("OP_GET_SUBSCRIPT", offset);
         case OP_SET_SUBSCRIPT: return simple_instruction("OP_SET_SUBSCRIPT", offset);
         case OP_EQUAL:         return simple_instruction("OP_EQUAL", offset);
@@ -70,15 +181,245 @@ int disassemble_instruction(const Chunk& chunk, int offset) {
         case OP_JUMP_IF_FALSE: return jump_instruction("OP_JUMP_IF_FALSE", 1, chunk, offset);
         case OP_LOOP:          return jump_instruction("OP_LOOP", -1, chunk, offset);
         case OP_CALL:          return byte_instruction("OP_CALL", chunk, offset);
+        case OP_INVOKE:        return invoke_instruction("OP_INVOKE", chunk, offset);
         case OP_CLOSURE:       return constant_instruction("OP_CLOSURE", chunk, offset);
-        case OP_BUILD_ARRAY:   return byte_instruction("OP_BUILD_ARRAY", chunk, offset);
+        case OP_BUILD_ARRAY:   return array_instruction("OP_BUILD_ARRAY", chunk, offset);
         case OP_RETURN:        return simple_instruction("OP_RETURN", offset);
+        case OP_NOT_EQUAL:     return simple_instruction("OP_NOT_EQUAL", offset);
+        case OP_GREATER_EQUAL: return simple_instruction("OP_GREATER_EQUAL", offset);
+        case OP_LESS_EQUAL:    return simple_instruction("OP_LESS_EQUAL", offset);
+        case OP_SET_LOCAL_POP: return byte_instruction("OP_SET_LOCAL_POP", chunk, offset);
+        case OP_EQUAL_JUMP:         return jump_instruction("OP_EQUAL_JUMP", 1, chunk, offset);
+        case OP_NOT_EQUAL_JUMP:     return jump_instruction("OP_NOT_EQUAL_JUMP", 1, chunk, offset);
+        case OP_GREATER_JUMP:       return jump_instruction("OP_GREATER_JUMP", 1, chunk, offset);
+        case OP_GREATER_EQUAL_JUMP: return jump_instruction("OP_GREATER_EQUAL_JUMP", 1, chunk, offset);
+        case OP_LESS_JUMP:          return jump_instruction("OP_LESS_JUMP", 1, chunk, offset);
+        case OP_LESS_EQUAL_JUMP:    return jump_instruction("OP_LESS_EQUAL_JUMP", 1, chunk, offset);
+        case OP_ADD_LOCAL_LOCAL:    return two_byte_instruction("OP_ADD_LOCAL_LOCAL", chunk, offset);
+        case OP_INC_LOCAL_CONST:    return local_constant_instruction("OP_INC_LOCAL_CONST", chunk, offset);
+        case OP_LESS_LOCAL_CONST_JUMP: return compare_jump_instruction("OP_LESS_LOCAL_CONST_JUMP", true, chunk, offset);
+        case OP_LESS_LOCAL_LOCAL_JUMP: return compare_jump_instruction("OP_LESS_LOCAL_LOCAL_JUMP", false, chunk, offset);
+        case OP_ADD_NUM:            return simple_instruction("OP_ADD_NUM", offset);
+        case OP_SUBTRACT_NUM:       return simple_instruction("OP_SUBTRACT_NUM", offset);
+        case OP_MULTIPLY_NUM:       return simple_instruction("OP_MULTIPLY_NUM", offset);
+        case OP_DIVIDE_NUM:         return simple_instruction("OP_DIVIDE_NUM", offset);
+        case OP_GREATER_NUM:        return simple_instruction("OP_GREATER_NUM", offset);
+        case OP_LESS_NUM:           return simple_instruction("OP_LESS_NUM", offset);
+        case OP_CHECK_NUMBER:       return simple_instruction("OP_CHECK_NUMBER", offset);
+        case OP_DIVIDE_INT:         return simple_instruction("OP_DIVIDE_INT", offset);
+        case OP_GET_GLOBAL_QUICK:   return global_instruction("OP_GET_GLOBAL_QUICK", chunk, offset);
+        case OP_SET_GLOBAL_POP:     return global_instruction("OP_SET_GLOBAL_POP", chunk, offset);
+        case OP_INC_GLOBAL_CONST:   return global_constant_instruction("OP_INC_GLOBAL_CONST", false, chunk, offset);
+        case OP_LESS_GLOBAL_CONST_JUMP: return global_constant_instruction("OP_LESS_GLOBAL_CONST_JUMP", true, chunk, offset);
+        case OP_GET_NATIVE:         return global_instruction("OP_GET_NATIVE", chunk, offset);
+        case OP_CALL_NATIVE:        return native_call_instruction("OP_CALL_NATIVE", chunk, offset);
+        case OP_ARRAY_LITERAL:      return packed_array_instruction("OP_ARRAY_LITERAL", chunk, offset);
+        case OP_ARRAY_APPEND:       return byte_instruction("OP_ARRAY_APPEND", chunk, offset);
         default:
             std::cout << "Instrucao desconhecida: " << (int)instruction << std::endl;
             return offset + 1;
     }
 }
 
+const char* opcode_name(uint8_t instruction) {
+    switch (instruction) {
+        case OP_CONSTANT:      return "OP_CONSTANT";
+        case OP_NIL:           return "OP_NIL";
+        case OP_TRUE:          return "OP_TRUE";
+        case OP_FALSE:         return "OP_FALSE";
+        case OP_POP:           return "OP_POP";
+        case OP_GET_LOCAL:     return "OP_GET_LOCAL";
+        case OP_SET_LOCAL:     return "OP_SET_LOCAL";
+        case OP_GET_GLOBAL:    return "OP_GET_GLOBAL";
+        case OP_DEFINE_GLOBAL: return "OP_DEFINE_GLOBAL";
+        case OP_SET_GLOBAL:    return "OP_SET_GLOBAL";
+        case OP_GET_PROPERTY:  return "OP_GET_PROPERTY";
+        case OP_SET_PROPERTY:  return "OP_SET_PROPERTY";
+        case OP_GET_SUBSCRIPT: return "OP_GET_SUBSCRIPT";
+        case OP_SET_SUBSCRIPT: return "OP_SET_SUBSCRIPT";
+        case OP_EQUAL:         return "OP_EQUAL";
+        case OP_GREATER:       return "OP_GREATER";
+        case OP_LESS:          return "OP_LESS";
+        case OP_ADD:           return "OP_ADD";
+        case OP_SUBTRACT:      return "OP_SUBTRACT";
+        case OP_MULTIPLY:      return "OP_MULTIPLY";
+        case OP_DIVIDE:        return "OP_DIVIDE";
+        case OP_NOT:           return "OP_NOT";
+        case OP_NEGATE:        return "OP_NEGATE";
+        case OP_PRINT:         return "OP_PRINT";
+        case OP_JUMP:          return "OP_JUMP";
+        case OP_JUMP_IF_FALSE: return "OP_JUMP_IF_FALSE";
+        case OP_LOOP:          return "OP_LOOP";
+        case OP_CALL:          return "OP_CALL";
+        case OP_INVOKE:        return "OP_INVOKE";
+        case OP_CLOSURE:       return "OP_CLOSURE";
+        case OP_BUILD_ARRAY:   return "OP_BUILD_ARRAY";
+        case OP_RETURN:        return "OP_RETURN";
+        case OP_NOT_EQUAL:     return "OP_NOT_EQUAL";
+        case OP_GREATER_EQUAL: return "OP_GREATER_EQUAL";
+        case OP_LESS_EQUAL:    return "OP_LESS_EQUAL";
+        case OP_SET_LOCAL_POP: return "OP_SET_LOCAL_POP";
+        case OP_EQUAL_JUMP:         return "OP_EQUAL_JUMP";
+        case OP_NOT_EQUAL_JUMP:     return "OP_NOT_EQUAL_JUMP";
+        case OP_GREATER_JUMP:       return "OP_GREATER_JUMP";
+        case OP_GREATER_EQUAL_JUMP: return "OP_GREATER_EQUAL_JUMP";
+        case OP_LESS_JUMP:          return "OP_LESS_JUMP";
+        case OP_LESS_EQUAL_JUMP:    return "OP_LESS_EQUAL_JUMP";
+        case OP_ADD_LOCAL_LOCAL:    return "OP_ADD_LOCAL_LOCAL";
+        case OP_INC_LOCAL_CONST:    return "OP_INC_LOCAL_CONST";
+        case OP_LESS_LOCAL_CONST_JUMP: return "OP_LESS_LOCAL_CONST_JUMP";
+        case OP_LESS_LOCAL_LOCAL_JUMP: return "OP_LESS_LOCAL_LOCAL_JUMP";
+        case OP_ADD_NUM:            return "OP_ADD_NUM";
+        case OP_SUBTRACT_NUM:       return "OP_SUBTRACT_NUM";
+        case OP_MULTIPLY_NUM:       return "OP_MULTIPLY_NUM";
+        case OP_DIVIDE_NUM:         return "OP_DIVIDE_NUM";
+        case OP_GREATER_NUM:        return "OP_GREATER_NUM";
+        case OP_LESS_NUM:           return "OP_LESS_NUM";
+        case OP_CHECK_NUMBER:       return "OP_CHECK_NUMBER";
+        case OP_DIVIDE_INT:         return "OP_DIVIDE_INT";
+        case OP_GET_GLOBAL_QUICK:   return "OP_GET_GLOBAL_QUICK";
+        case OP_SET_GLOBAL_POP:     return "OP_SET_GLOBAL_POP";
+        case OP_INC_GLOBAL_CONST:   return "OP_INC_GLOBAL_CONST";
+        case OP_LESS_GLOBAL_CONST_JUMP: return "OP_LESS_GLOBAL_CONST_JUMP";
+        case OP_GET_NATIVE:         return "OP_GET_NATIVE";
+        case OP_CALL_NATIVE:        return "OP_CALL_NATIVE";
+        case OP_ARRAY_LITERAL:      return "OP_ARRAY_LITERAL";
+        case OP_ARRAY_APPEND:       return "OP_ARRAY_APPEND";
+    }
+    return "?";
+}
+
+// --- Disassembly do Backend de Registradores (register.h) ---
+
+static const char* register_opcode_name(uint8_t instruction) {
+    static const char* const names[R_COUNT] = {
+        "R_MOVE", "R_LOADK", "R_NIL", "R_TRUE", "R_FALSE",
+        "R_GET_GLOBAL", "R_SET_GLOBAL", "R_DEFINE_GLOBAL",
+        "R_GET_PROPERTY", "R_SET_PROPERTY", "R_GET_SUBSCRIPT", "R_SET_SUBSCRIPT",
+        "R_EQUAL", "R_NOT_EQUAL", "R_GREATER", "R_GREATER_EQUAL", "R_LESS", "R_LESS_EQUAL",
+        "R_ADD", "R_SUBTRACT", "R_MULTIPLY", "R_DIVIDE", "R_NOT", "R_NEGATE", "R_PRINT",
+        "R_JUMP", "R_LOOP", "R_JUMP_IF_FALSE",
+        "R_EQUAL_JUMP", "R_NOT_EQUAL_JUMP", "R_GREATER_JUMP", "R_GREATER_EQUAL_JUMP",
+        "R_LESS_JUMP", "R_LESS_EQUAL_JUMP",
+        "R_CLOSURE", "R_CALL", "R_INVOKE", "R_BUILD_ARRAY", "R_RETURN",
+        "R_ADD_NUM", "R_SUBTRACT_NUM", "R_MULTIPLY_NUM", "R_DIVIDE_NUM",
+        "R_GREATER_NUM", "R_LESS_NUM", "R_CHECK_NUMBER", "R_GET_NATIVE", "R_CALL_NATIVE",
+        "R_ARRAY_LITERAL", "R_ARRAY_APPEND", "R_DIVIDE_INT",
+    };
+    return instruction < R_COUNT ? names[instruction] : "?";
+}
+
+// Operando que é sempre uma constante (0 a 255): "k5'valor'".
+static void print_constant(const Chunk& chunk, uint8_t index) {
+    printf(" k%d'", index);
+    print_value(chunk.constants[index]);
+    printf("'");
+}
+
+// Operando RK: "r3" ou "k5'valor'".
+static void print_rk(const Chunk& chunk, uint8_t operand) {
+    if (operand & RK_CONSTANT) {
+        print_constant(chunk, operand & ~RK_CONSTANT);
+    } else {
+        printf(" r%d", operand);
+    }
+}
+
+int disassemble_register_instruction(const Chunk& chunk, int offset) {
+    const uint8_t* code = chunk.register_code.data() + offset;
+    uint8_t instruction = code[0];
+    int length = register_instruction_length(instruction);
+    printf("%04d %-20s", offset, register_opcode_name(instruction));
+    if (length == 0) {
+        printf("\n");
+        return offset + 1;
+    }
+
+    uint16_t last_short = (uint16_t)((code[length - 2] << 8) | code[length - 1]);
+    switch (instruction) {
+        case R_LOADK: case R_CLOSURE:
+            printf(" r%d", code[1]);
+            print_constant(chunk, code[2]);
+            break;
+        case R_MOVE:
+            printf(" r%d r%d", code[1], code[2]);
+            break;
+        case R_CALL:
+            printf(" r%d (%d)", code[1], code[2]);
+            break;
+        case R_BUILD_ARRAY:
+            printf(" r%d (%d) %s", code[1], code[2], array_kind_name(code[3]));
+            break;
+        case R_ARRAY_LITERAL:
+            printf(" r%d k%d %s", code[1], code[2], array_kind_name(code[3]));
+            break;
+        case R_ARRAY_APPEND:
+            printf(" r%d (%d)", code[1], code[2]);
+            break;
+        case R_NIL: case R_TRUE: case R_FALSE:
+            printf(" r%d", code[1]);
+            break;
+        case R_GET_GLOBAL:
+            printf(" r%d g%d", code[1], last_short);
+            break;
+        case R_GET_NATIVE:
+            printf(" r%d n%d", code[1], last_short);
+            break;
+        case R_CALL_NATIVE:
+            printf(" r%d n%d (%d args)", code[1], (code[2] << 8) | code[3], code[4]);
+            break;
+        case R_SET_GLOBAL: case R_DEFINE_GLOBAL:
+            print_rk(chunk, code[1]);
+            printf(" g%d", last_short);
+            break;
+        case R_GET_PROPERTY: case R_SET_PROPERTY:
+            printf(" r%d", code[1]);
+            if (instruction == R_GET_PROPERTY) printf(" r%d", code[2]); else print_rk(chunk, code[2]);
+            print_constant(chunk, code[3]);
+            printf(" ic %d", last_short);
+            break;
+        case R_INVOKE:
+            printf(" r%d (%d args)", code[1], code[5]);
+            print_constant(chunk, code[2]);
+            printf(" ic %d", (code[3] << 8) | code[4]);
+            break;
+        case R_JUMP: case R_LOOP:
+            printf(" -> %d", offset + length + (instruction == R_LOOP ? -last_short : last_short));
+            break;
+        case R_JUMP_IF_FALSE:
+        case R_EQUAL_JUMP: case R_NOT_EQUAL_JUMP: case R_GREATER_JUMP:
+        case R_GREATER_EQUAL_JUMP: case R_LESS_JUMP: case R_LESS_EQUAL_JUMP:
+            for (int i = 1; i < length - 2; i++) print_rk(chunk, code[i]);
+            printf(" -> %d", offset + length + last_short);
+            break;
+        case R_GET_SUBSCRIPT:
+            printf(" r%d r%d", code[1], code[2]);
+            print_rk(chunk, code[3]);
+            break;
+        case R_SET_SUBSCRIPT:
+            printf(" r%d", code[1]);
+            print_rk(chunk, code[2]);
+            print_rk(chunk, code[3]);
+            break;
+        case R_PRINT: case R_RETURN: case R_CHECK_NUMBER:
+            print_rk(chunk, code[1]);
+            break;
+        default: // A RK [RK]
+            printf(" r%d", code[1]);
+            for (int i = 2; i < length; i++) print_rk(chunk, code[i]);
+            break;
+    }
+    printf("\n");
+    return offset + length;
+}
+
+void disassemble_register_code(const Chunk& chunk, const std::string& name) {
+    std::cout << "== " << name << " (registradores: " << chunk.register_count << ") ==" << std::endl;
+    for (size_t offset = 0; offset < chunk.register_code.size();) {
+        offset = disassemble_register_instruction(chunk, offset);
+    }
+}
+
 void disassemble_chunk(const Chunk& chunk, const std::string& name) {
     std::cout << "== " << name << " ==" << std::endl;
     for (size_t offset = 0; offset < chunk.code.size();) {
@@ -86,6 +427,50 @@ void disassemble_chunk(const Chunk& chunk, const std::string& name) {
     }
 }
 
+// --- Estatísticas dos Inline Caches ---
+
+static const char* cache_state_name(CacheState state) {
+    switch (state) {
+        case CACHE_EMPTY:       return "empty";
+        case CACHE_MONOMORPHIC: return "monomorphic";
+        case CACHE_POLYMORPHIC: return "polymorphic";
+        case CACHE_MEGAMORPHIC: return "megamorphic";
+    }
+    return "?";
+}
+
+
+static void print_function_cache_stats(ObjFunction* function) {
+    const Chunk& chunk = function->chunk;
+    const char* name = function->name != nullptr ? function->name->chars.c_str() : "<script>";
+    for (const InlineCache& cache : chunk.caches) {
+        uint8_t instruction = chunk.code[cache.offset];
+        uint8_t constant_index = chunk.code[cache.offset + 1];
+        uint64_t total = cache.hits + cache.misses;
+        fprintf(stderr, "[ic] %-12s %04d %-16s %-12s %-12s hits: %llu, misses: %llu (%.1f%% hit)\n",
+                name, cache.offset,
+                opcode_name(instruction),
+                static_cast<ObjString*>(chunk.constants[constant_index].as_obj())->chars.c_str(),
+                cache_state_name(cache.state),
+                (unsigned long long)cache.hits, (unsigned long long)cache.misses,
+                total == 0 ? 0.0 : 100.0 * cache.hits / total);
+    }
+    // Funções e métodos declarados dentro desta função.
+    for (const SapphireValue& constant : chunk.constants) {
+        if (is_obj_type(constant, OBJ_FUNCTION)) {
+            print_function_cache_stats(static_cast<ObjFunction*>(constant.as_obj()));
+        } else if (is_obj_type(constant, OBJ_CLASS)) {
+            for (auto& entry : static_cast<ObjClass*>(constant.as_obj())->methods) {
+                print_function_cache_stats(entry.second->function);
+            }
+        }
+    }
+}
+
+void print_cache_stats(ObjFunction* script) {
+    print_function_cache_stats(script);
+}
+
 // --- Nova Função de Debug da Pilha ---
 
 void debug_print_stack(VM* vm) {
@@ -96,4 +481,33 @@ void debug_print_stack(VM* vm) {
         std::cout << " ]";
     }
     std::cout << std::endl;
-}
\ No newline at end of file
+}
+
+// --- Perfil de Pares de Opcodes ---
+
+#ifdef PROFILE_OPCODES
+uint64_t opcode_pair_counts[256][256];
+
+void print_opcode_pairs(size_t limit) {
+    struct Pair { uint64_t count; uint8_t first, second; };
+    std::vector<Pair> pairs;
+    uint64_t total = 0;
+    for (int first = 0; first < 256; first++) {
+        for (int second = 0; second < 256; second++) {
+            uint64_t count = opcode_pair_counts[first][second];
+            if (count == 0) continue;
+            pairs.push_back({count, (uint8_t)first, (uint8_t)second});
+            total += count;
+        }
+    }
+    std::sort(pairs.begin(), pairs.end(), [](const Pair& a, const Pair& b) { return a.count > b.count; });
+    if (pairs.size() > limit) pairs.resize(limit);
+
+    fprintf(stderr, "[op-pairs] %llu instrucoes executadas\n", (unsigned long long)total);
+    for (const Pair& pair : pairs) {
+        fprintf(stderr, "[op-pairs] %12llu %5.1f%%  %-22s -> %s\n",
+                (unsigned long long)pair.count, 100.0 * pair.count / total,
+                opcode_name(pair.first), opcode_name(pair.second));
+    }
+}
+#endif
\ No newline at end of file
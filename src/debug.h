@@ -5,9 +5,25 @@
 #include <string>
 
 class VM;
+struct ObjFunction;
 
 void disassemble_chunk(const Chunk& chunk, const std::string& name);
 int disassemble_instruction(const Chunk& chunk, int offset);
 void debug_print_stack(VM* vm);
+// Taxa de acerto e estado de cada inline cache do script e das funções nele.
+void print_cache_stats(ObjFunction* script);
+// Nome do opcode ("OP_ADD"), ou "?" se o byte não for uma instrução.
+const char* opcode_name(uint8_t instruction);
+// O mesmo para o código traduzido pelo backend de registradores.
+void disassemble_register_code(const Chunk& chunk, const std::string& name);
+int disassemble_register_instruction(const Chunk& chunk, int offset);
+
+#ifdef PROFILE_OPCODES
+// Quantas vezes cada par (anterior, atual) de instruções foi executado.
+// Preenchida pelo laço de despacho da VM (cmake -DSAPPHIRE_OPCODE_PROFILE=ON).
+extern uint64_t opcode_pair_counts[256][256];
+// Imprime os 'limit' pares mais frequentes em stderr (sapphire --op-pairs).
+void print_opcode_pairs(size_t limit);
+#endif
 
 #endif //SAPPHIRE_DEBUG_H
\ No newline at end of file
@@ -0,0 +1,574 @@
+#include "image.h"
+#include "memory.h"
+#include "serializer.h"
+#include "vm.h"
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <unordered_map>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define SAPPHIRE_HAS_MMAP
+#endif
+
+// Tags das constantes na imagem.
+enum SpiTag : uint32_t {
+    SPI_NIL,
+    SPI_FALSE,
+    SPI_TRUE,
+    SPI_NUMBER,
+    SPI_STRING,
+    SPI_FUNCTION,
+    SPI_CLASS,
+    SPI_INT,
+};
+
+static const uint32_t NO_NAME = 0xFFFFFFFF;
+
+static const size_t HEADER_SIZE = 12 + 9 * 4;
+static const size_t STRING_RECORD = 2 * 4;
+static const size_t GLOBAL_RECORD = 4;
+static const size_t NATIVE_RECORD = 4;
+static const size_t FUNCTION_RECORD = 6 * 4;
+static const size_t CONSTANT_RECORD = 2 * 4 + 8;
+static const size_t CLASS_RECORD = 4 * 4;
+static const size_t ITEM_RECORD = 4;
+
+struct BytecodeImage {
+    const uint8_t* data = nullptr;
+    size_t size = 0;
+#ifdef SAPPHIRE_HAS_MMAP
+    bool mapped = false;
+#endif
+    std::vector<uint8_t> buffer; // Sem mmap, o arquivo inteiro é lido aqui
+
+    uint32_t string_count = 0, global_count = 0, native_count = 0, function_count = 0;
+    uint32_t constant_count = 0, class_count = 0, item_count = 0;
+    const uint8_t* strings = nullptr;
+    const uint8_t* globals = nullptr;
+    const uint8_t* natives = nullptr;
+    const uint8_t* functions = nullptr;
+    const uint8_t* constants = nullptr;
+    const uint8_t* classes = nullptr;
+    const uint8_t* items = nullptr;
+    const uint8_t* string_blob = nullptr;
+    const uint8_t* code_blob = nullptr;
+    uint32_t string_blob_size = 0, code_blob_size = 0;
+
+    // Slot na imagem -> slot na VM, para globais e nativas. Se os dois forem
+    // a identidade (o caso comum: a VM que carrega registra as nativas na
+    // mesma ordem que a que compilou), o bytecode é usado direto do
+    // mapeamento, sem cópia.
+    std::vector<uint16_t> global_remap;
+    std::vector<uint16_t> native_remap;
+    bool identity_slots = true;
+};
+
+static uint32_t read_u32(const uint8_t* at) {
+    return (uint32_t)at[0] | ((uint32_t)at[1] << 8) | ((uint32_t)at[2] << 16) | ((uint32_t)at[3] << 24);
+}
+
+static uint64_t read_u64(const uint8_t* at) {
+    return (uint64_t)read_u32(at) | ((uint64_t)read_u32(at + 4) << 32);
+}
+
+// --- Escrita ---
+
+static void write_u32(std::ostream& out, uint32_t value) {
+    for (int i = 0; i < 4; i++) out.put((char)((value >> (8 * i)) & 0xff));
+}
+
+static void write_u64(std::ostream& out, uint64_t value) {
+    for (int i = 0; i < 8; i++) out.put((char)((value >> (8 * i)) & 0xff));
+}
+
+// Monta as tabelas em memória. As funções são numeradas na ordem em que são
+// encontradas (o script principal é a 0) e as constantes de cada uma ficam
+// contíguas na tabela de constantes.
+struct ImageWriter {
+    std::vector<const ObjString*> strings;
+    std::unordered_map<const ObjString*, uint32_t> string_index;
+    std::vector<uint32_t> functions;  // 6 valores por função
+    std::vector<uint32_t> constants;  // tag, índice, e os 64 bits em duas metades
+    std::vector<uint32_t> classes;    // 4 valores por classe
+    std::vector<uint32_t> items;
+    std::string code;
+    size_t string_blob_size = 0;
+    bool failed = false;
+
+    // Strings internadas são únicas, então o ponteiro basta como chave.
+    uint32_t string(const ObjString* string) {
+        if (string == nullptr) return NO_NAME;
+        auto found = string_index.find(string);
+        if (found != string_index.end()) return found->second;
+        uint32_t index = (uint32_t)strings.size();
+        strings.push_back(string);
+        string_index[string] = index;
+        string_blob_size += string->chars.size();
+        return index;
+    }
+
+    uint32_t function(ObjFunction* function) {
+        uint32_t index = (uint32_t)(functions.size() / 6);
+        functions.resize(functions.size() + 6);
+        const Chunk& chunk = function->chunk;
+
+        // As constantes desta função são reservadas antes das aninhadas,
+        // que vão sendo acrescentadas depois delas.
+        uint32_t first_constant = (uint32_t)(constants.size() / 4);
+        constants.resize(constants.size() + 4 * chunk.constants.size());
+        for (size_t i = 0; i < chunk.constants.size() && !failed; i++) {
+            constant(first_constant + (uint32_t)i, chunk.constants[i]);
+        }
+
+        uint32_t* record = &functions[6 * index];
+        record[0] = (uint32_t)function->arity;
+        record[1] = string(function->name);
+        record[2] = (uint32_t)code.size();
+        record[3] = (uint32_t)chunk.code.size();
+        record[4] = first_constant;
+        record[5] = (uint32_t)chunk.constants.size();
+        code.append(reinterpret_cast<const char*>(chunk.code.data()), chunk.code.size());
+        return index;
+    }
+
+    uint32_t klass(ObjClass* klass) {
+        uint32_t index = (uint32_t)(classes.size() / 4);
+        classes.resize(classes.size() + 4);
+
+        // Os campos declarados são o caminho da forma inicial até a raiz.
+        std::vector<ObjString*> fields(klass->initial_shape->slots.size());
+        for (auto& entry : klass->initial_shape->slots) fields[entry.second] = entry.first;
+
+        uint32_t first_item = (uint32_t)items.size();
+        for (ObjString* field : fields) items.push_back(string(field));
+        size_t methods_at = items.size();
+        items.resize(items.size() + 2 * klass->methods.size());
+        for (auto& entry : klass->methods) {
+            // Um método pode declarar classes, que crescem 'items'.
+            uint32_t method_name = string(entry.first);
+            uint32_t method = function(entry.second->function);
+            items[methods_at++] = method_name;
+            items[methods_at++] = method;
+        }
+
+        uint32_t* record = &classes[4 * index];
+        record[0] = string(klass->name);
+        record[1] = first_item;
+        record[2] = (uint32_t)fields.size();
+        record[3] = (uint32_t)klass->methods.size();
+        return index;
+    }
+
+    void constant(uint32_t index, const SapphireValue& value) {
+        uint32_t tag = SPI_NIL, operand = 0;
+        uint64_t bits = 0;
+        if (value.is_nil()) {
+            tag = SPI_NIL;
+        } else if (value.is_bool()) {
+            tag = value.as_bool() ? SPI_TRUE : SPI_FALSE;
+        } else if (value.is_int()) {
+            bits = (uint64_t)value.as_int();
+            tag = SPI_INT;
+        } else if (value.is_number()) {
+            double number = value.as_number();
+            std::memcpy(&bits, &number, sizeof(double));
+            tag = SPI_NUMBER;
+        } else if (is_obj_type(value, OBJ_STRING)) {
+            tag = SPI_STRING;
+            operand = string(static_cast<ObjString*>(value.as_obj()));
+        } else if (is_obj_type(value, OBJ_FUNCTION)) {
+            tag = SPI_FUNCTION;
+            operand = function(static_cast<ObjFunction*>(value.as_obj()));
+        } else if (is_obj_type(value, OBJ_CLASS)) {
+            tag = SPI_CLASS;
+            operand = klass(static_cast<ObjClass*>(value.as_obj()));
+        } else {
+            std::cerr << "Erro: Constante do tipo " << get_value_type_name(value)
+                      << " nao pode ser serializada." << std::endl;
+            failed = true;
+            return;
+        }
+        // 'constants' pode ter crescido nas chamadas acima.
+        uint32_t* record = &constants[4 * index];
+        record[0] = tag;
+        record[1] = operand;
+        record[2] = (uint32_t)bits;
+        record[3] = (uint32_t)(bits >> 32);
+    }
+};
+
+bool write_image(std::ostream& out, ObjFunction* function, const GlobalTable& globals) {
+    ImageWriter writer;
+    std::vector<uint32_t> global_names;
+    for (ObjString* name : globals.names) global_names.push_back(writer.string(name));
+    std::vector<uint32_t> native_names;
+    for (ObjString* name : globals.natives.names) native_names.push_back(writer.string(name));
+    writer.function(function);
+    if (writer.failed) return false;
+
+    out.write("SPHI", 4);
+    write_u32(out, SPI_VERSION);
+    write_u32(out, OP_COUNT);
+    write_u32(out, (uint32_t)writer.strings.size());
+    write_u32(out, (uint32_t)global_names.size());
+    write_u32(out, (uint32_t)native_names.size());
+    write_u32(out, (uint32_t)(writer.functions.size() / 6));
+    write_u32(out, (uint32_t)(writer.constants.size() / 4));
+    write_u32(out, (uint32_t)(writer.classes.size() / 4));
+    write_u32(out, (uint32_t)writer.items.size());
+    write_u32(out, (uint32_t)writer.string_blob_size);
+    write_u32(out, (uint32_t)writer.code.size());
+
+    uint32_t blob_offset = 0;
+    for (const ObjString* string : writer.strings) {
+        write_u32(out, blob_offset);
+        write_u32(out, (uint32_t)string->chars.size());
+        blob_offset += (uint32_t)string->chars.size();
+    }
+    for (uint32_t name : global_names) write_u32(out, name);
+    for (uint32_t name : native_names) write_u32(out, name);
+    for (uint32_t value : writer.functions) write_u32(out, value);
+    for (size_t i = 0; i < writer.constants.size(); i += 4) {
+        write_u32(out, writer.constants[i]);
+        write_u32(out, writer.constants[i + 1]);
+        write_u64(out, (uint64_t)writer.constants[i + 2] | ((uint64_t)writer.constants[i + 3] << 32));
+    }
+    for (uint32_t value : writer.classes) write_u32(out, value);
+    for (uint32_t value : writer.items) write_u32(out, value);
+    for (const ObjString* string : writer.strings) out.write(string->chars.data(), string->chars.size());
+    out.write(writer.code.data(), writer.code.size());
+    return (bool)out;
+}
+
+// --- Carga ---
+
+static const uint8_t* string_record(const BytecodeImage* image, uint32_t index) {
+    return image->strings + STRING_RECORD * index;
+}
+
+static const uint8_t* function_record(const BytecodeImage* image, uint32_t index) {
+    return image->functions + FUNCTION_RECORD * index;
+}
+
+static const uint8_t* constant_record(const BytecodeImage* image, uint32_t index) {
+    return image->constants + CONSTANT_RECORD * index;
+}
+
+static const uint8_t* class_record(const BytecodeImage* image, uint32_t index) {
+    return image->classes + CLASS_RECORD * index;
+}
+
+static uint32_t item(const BytecodeImage* image, uint32_t index) {
+    return read_u32(image->items + ITEM_RECORD * index);
+}
+
+static bool valid_string(const BytecodeImage* image, uint32_t index, bool optional) {
+    return index < image->string_count || (optional && index == NO_NAME);
+}
+
+// Percorre as instruções de uma função: os slots de globais e de nativas
+// precisam existir na imagem, e o resto (constantes, locais, saltos) passa
+// por verify_code, com o tipo de cada constante tirado da tag do registro.
+static bool validate_code(const BytecodeImage* image, const uint8_t* record) {
+    const uint8_t* code = image->code_blob + read_u32(record + 8);
+    uint32_t length = read_u32(record + 12);
+    uint32_t first_constant = read_u32(record + 16), constant_count = read_u32(record + 20);
+
+    std::vector<ConstantKind> kinds(constant_count, CONSTANT_OTHER);
+    for (uint32_t i = 0; i < constant_count; i++) {
+        uint32_t tag = read_u32(constant_record(image, first_constant + i));
+        if (tag == SPI_STRING) kinds[i] = CONSTANT_STRING;
+        if (tag == SPI_FUNCTION) kinds[i] = CONSTANT_FUNCTION;
+    }
+    if (!verify_code(code, length, (int)read_u32(record), kinds)) return false;
+
+    size_t offset = 0;
+    while (offset < length) {
+        uint8_t instruction = code[offset];
+        int instruction_size = instruction_length(instruction);
+        if (instruction_size == 0 || offset + instruction_size > length) return false;
+        if (instruction == OP_GET_GLOBAL || instruction == OP_SET_GLOBAL || instruction == OP_DEFINE_GLOBAL) {
+            uint16_t slot = (uint16_t)((code[offset + 1] << 8) | code[offset + 2]);
+            if (slot >= image->global_count) return false;
+        }
+        if (instruction == OP_GET_NATIVE || instruction == OP_CALL_NATIVE) {
+            uint16_t slot = (uint16_t)((code[offset + 1] << 8) | code[offset + 2]);
+            if (slot >= image->native_count) return false;
+        }
+        offset += instruction_size;
+    }
+    return true;
+}
+
+// Toda a validação acontece aqui, uma vez: a materialização preguiçosa
+// confia nos índices e não tem como reportar erros no meio da execução.
+static bool validate_image(BytecodeImage* image) {
+    if (image->size < HEADER_SIZE) return false;
+    const uint8_t* header = image->data;
+    image->string_count = read_u32(header + 12);
+    image->global_count = read_u32(header + 16);
+    image->native_count = read_u32(header + 20);
+    image->function_count = read_u32(header + 24);
+    image->constant_count = read_u32(header + 28);
+    image->class_count = read_u32(header + 32);
+    image->item_count = read_u32(header + 36);
+    image->string_blob_size = read_u32(header + 40);
+    image->code_blob_size = read_u32(header + 44);
+    if (image->function_count == 0) return false;
+
+    // Em 64 bits, nenhuma destas somas de u32 multiplicados transborda.
+    uint64_t offset = HEADER_SIZE;
+    auto section = [&](uint64_t bytes) {
+        const uint8_t* start = image->data + (offset <= image->size ? offset : image->size);
+        offset += bytes;
+        return start;
+    };
+    image->strings = section((uint64_t)STRING_RECORD * image->string_count);
+    image->globals = section((uint64_t)GLOBAL_RECORD * image->global_count);
+    image->natives = section((uint64_t)NATIVE_RECORD * image->native_count);
+    image->functions = section((uint64_t)FUNCTION_RECORD * image->function_count);
+    image->constants = section((uint64_t)CONSTANT_RECORD * image->constant_count);
+    image->classes = section((uint64_t)CLASS_RECORD * image->class_count);
+    image->items = section((uint64_t)ITEM_RECORD * image->item_count);
+    image->string_blob = section(image->string_blob_size);
+    image->code_blob = section(image->code_blob_size);
+    if (offset != image->size) return false;
+
+    for (uint32_t i = 0; i < image->string_count; i++) {
+        const uint8_t* record = string_record(image, i);
+        if ((uint64_t)read_u32(record) + read_u32(record + 4) > image->string_blob_size) return false;
+    }
+    for (uint32_t i = 0; i < image->global_count; i++) {
+        if (!valid_string(image, read_u32(image->globals + GLOBAL_RECORD * i), false)) return false;
+    }
+    for (uint32_t i = 0; i < image->native_count; i++) {
+        if (!valid_string(image, read_u32(image->natives + NATIVE_RECORD * i), false)) return false;
+    }
+    for (uint32_t i = 0; i < image->function_count; i++) {
+        const uint8_t* record = function_record(image, i);
+        uint32_t code_offset = read_u32(record + 8), code_length = read_u32(record + 12);
+        uint32_t first_constant = read_u32(record + 16), constant_count = read_u32(record + 20);
+        if (!valid_string(image, read_u32(record + 4), true)) return false;
+        if ((uint64_t)code_offset + code_length > image->code_blob_size) return false;
+        if ((uint64_t)first_constant + constant_count > image->constant_count) return false;
+        if (!validate_code(image, record)) return false;
+    }
+    for (uint32_t i = 0; i < image->constant_count; i++) {
+        const uint8_t* record = constant_record(image, i);
+        uint32_t operand = read_u32(record + 4);
+        switch (read_u32(record)) {
+            case SPI_NIL: case SPI_FALSE: case SPI_TRUE: case SPI_NUMBER: case SPI_INT: break;
+            case SPI_STRING:   if (operand >= image->string_count) return false; break;
+            case SPI_FUNCTION: if (operand >= image->function_count) return false; break;
+            case SPI_CLASS:    if (operand >= image->class_count) return false; break;
+            default: return false;
+        }
+    }
+    for (uint32_t i = 0; i < image->class_count; i++) {
+        const uint8_t* record = class_record(image, i);
+        uint32_t first_item = read_u32(record + 4);
+        uint32_t field_count = read_u32(record + 8), method_count = read_u32(record + 12);
+        if (!valid_string(image, read_u32(record), false)) return false;
+        if ((uint64_t)first_item + field_count + 2ull * method_count > image->item_count) return false;
+        for (uint32_t j = 0; j < field_count; j++) {
+            if (!valid_string(image, item(image, first_item + j), false)) return false;
+        }
+        for (uint32_t j = 0; j < method_count; j++) {
+            uint32_t at = first_item + field_count + 2 * j;
+            if (!valid_string(image, item(image, at), false)) return false;
+            if (item(image, at + 1) >= image->function_count) return false;
+        }
+    }
+    return true;
+}
+
+BytecodeImage* open_image(const std::string& path) {
+    auto* image = new BytecodeImage();
+#ifdef SAPPHIRE_HAS_MMAP
+    int fd = ::open(path.c_str(), O_RDONLY);
+    struct stat info;
+    if (fd != -1 && fstat(fd, &info) == 0 && info.st_size > 0) {
+        void* mapping = mmap(nullptr, (size_t)info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        if (mapping != MAP_FAILED) {
+            image->data = static_cast<const uint8_t*>(mapping);
+            image->size = (size_t)info.st_size;
+            image->mapped = true;
+        }
+    }
+    if (fd != -1) ::close(fd);
+#endif
+    if (image->data == nullptr) {
+        std::ifstream file(path, std::ios::binary);
+        if (!file.is_open()) {
+            std::cerr << "Erro: Nao foi possivel abrir o arquivo '" << path << "'." << std::endl;
+            delete image;
+            return nullptr;
+        }
+        std::stringstream contents;
+        contents << file.rdbuf();
+        std::string bytes = contents.str();
+        image->buffer.assign(bytes.begin(), bytes.end());
+        image->data = image->buffer.data();
+        image->size = image->buffer.size();
+    }
+
+    if (image->size < 12 || std::memcmp(image->data, "SPHI", 4) != 0) {
+        std::cerr << "Erro: Arquivo de imagem invalido." << std::endl;
+        close_image(image);
+        return nullptr;
+    }
+    if (read_u32(image->data + 4) != SPI_VERSION || read_u32(image->data + 8) != OP_COUNT) {
+        std::cerr << "Erro: Imagem gerada por outra versao da Sapphire." << std::endl;
+        close_image(image);
+        return nullptr;
+    }
+    if (!validate_image(image)) {
+        std::cerr << "Erro: Arquivo de imagem corrompido." << std::endl;
+        close_image(image);
+        return nullptr;
+    }
+    return image;
+}
+
+void close_image(BytecodeImage* image) {
+#ifdef SAPPHIRE_HAS_MMAP
+    if (image->mapped) munmap(const_cast<uint8_t*>(image->data), image->size);
+#endif
+    delete image;
+}
+
+// As strings são copiadas para a tabela de internação: ObjString guarda os
+// caracteres num std::string, então não dá para apontar para o arquivo.
+static ObjString* image_string(const BytecodeImage* image, uint32_t index) {
+    if (index == NO_NAME) return nullptr;
+    const uint8_t* record = string_record(image, index);
+    const char* chars = reinterpret_cast<const char*>(image->string_blob + read_u32(record));
+    return new_string(std::string(chars, read_u32(record + 4)));
+}
+
+static ObjFunction* function_stub(BytecodeImage* image, uint32_t index) {
+    const uint8_t* record = function_record(image, index);
+    ObjString* name = image_string(image, read_u32(record + 4));
+    if (name != nullptr) push_temp_root(name);
+    ObjFunction* function = new_function();
+    if (name != nullptr) pop_temp_root();
+    function->arity = (int)read_u32(record);
+    function->name = name;
+    function->image = image;
+    function->image_index = index;
+    return function;
+}
+
+ObjFunction* load_image(BytecodeImage* image, GlobalTable& globals) {
+    for (uint32_t i = 0; i < image->global_count; i++) {
+        int slot = globals.resolve(image_string(image, read_u32(image->globals + GLOBAL_RECORD * i)));
+        if (slot == -1) {
+            std::cerr << "Erro: Globais demais na imagem." << std::endl;
+            return nullptr;
+        }
+        image->global_remap.push_back((uint16_t)slot);
+        if ((uint32_t)slot != i) image->identity_slots = false;
+    }
+    for (uint32_t i = 0; i < image->native_count; i++) {
+        ObjString* name = image_string(image, read_u32(image->natives + NATIVE_RECORD * i));
+        int slot = globals.natives.find(name);
+        if (slot == -1) {
+            std::cerr << "Erro: Funcao nativa '" << name->chars << "' nao registrada nesta VM." << std::endl;
+            return nullptr;
+        }
+        image->native_remap.push_back((uint16_t)slot);
+        if ((uint32_t)slot != i) image->identity_slots = false;
+    }
+    return function_stub(image, 0);
+}
+
+// Cada objeto criado aqui fica alcançável pela classe ou pela piscina de
+// constantes antes da próxima alocação. A própria função está viva: quem a
+// chama a tem na pilha ou na tabela de métodos de uma classe.
+static ObjClass* materialize_class(BytecodeImage* image, uint32_t index, ObjFunction* owner) {
+    const uint8_t* record = class_record(image, index);
+    uint32_t first_item = read_u32(record + 4);
+    uint32_t field_count = read_u32(record + 8), method_count = read_u32(record + 12);
+
+    ObjString* name = image_string(image, read_u32(record));
+    push_temp_root(name);
+    ObjClass* klass = new_class(name);
+    pop_temp_root();
+    owner->chunk.constants.push_back(klass);
+    write_barrier(owner, klass);
+
+    for (uint32_t i = 0; i < field_count; i++) {
+        ObjString* field = image_string(image, item(image, first_item + i));
+        klass->initial_shape = klass->initial_shape->add_field(field);
+    }
+    for (uint32_t i = 0; i < method_count; i++) {
+        uint32_t at = first_item + field_count + 2 * i;
+        ObjString* method_name = image_string(image, item(image, at));
+        push_temp_root(method_name);
+        ObjFunction* method = function_stub(image, item(image, at + 1));
+        push_temp_root(method);
+        klass->methods[method_name] = new_closure(method);
+        pop_temp_root();
+        pop_temp_root();
+    }
+    return klass;
+}
+
+void materialize_function(ObjFunction* function) {
+    BytecodeImage* image = function->image;
+    const uint8_t* record = function_record(image, function->image_index);
+    const uint8_t* code = image->code_blob + read_u32(record + 8);
+    uint32_t code_length = read_u32(record + 12);
+    uint32_t first_constant = read_u32(record + 16), constant_count = read_u32(record + 20);
+
+    Chunk& chunk = function->chunk;
+    if (image->identity_slots) {
+        chunk.code.assign_external(code, code_length);
+        link_chunk(chunk, nullptr, nullptr);
+    } else {
+        chunk.code.resize(code_length);
+        if (code_length > 0) std::memcpy(chunk.code.writable_data(), code, code_length);
+        link_chunk(chunk, &image->global_remap, &image->native_remap);
+    }
+
+    chunk.constants.reserve(constant_count);
+    for (uint32_t i = 0; i < constant_count; i++) {
+        const uint8_t* constant = constant_record(image, first_constant + i);
+        uint32_t operand = read_u32(constant + 4);
+        switch (read_u32(constant)) {
+            case SPI_NIL:   chunk.constants.push_back(SapphireValue()); break;
+            case SPI_FALSE: chunk.constants.push_back(false); break;
+            case SPI_TRUE:  chunk.constants.push_back(true); break;
+            case SPI_NUMBER: {
+                uint64_t bits = read_u64(constant + 8);
+                double number;
+                std::memcpy(&number, &bits, sizeof(double));
+                chunk.constants.push_back(number);
+                break;
+            }
+            case SPI_INT: chunk.constants.push_back(int_value((int64_t)read_u64(constant + 8))); break;
+            case SPI_STRING: {
+                ObjString* string = image_string(image, operand);
+                chunk.constants.push_back(string);
+                write_barrier(function, string);
+                break;
+            }
+            case SPI_FUNCTION: {
+                ObjFunction* nested = function_stub(image, operand);
+                chunk.constants.push_back(nested);
+                write_barrier(function, nested);
+                break;
+            }
+            case SPI_CLASS:
+                materialize_class(image, operand, function);
+                break;
+        }
+    }
+    function->image = nullptr;
+}
\ No newline at end of file
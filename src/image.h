@@ -0,0 +1,54 @@
+#ifndef SAPPHIRE_IMAGE_H
+#define SAPPHIRE_IMAGE_H
+
+#include "object.h"
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+struct GlobalTable;
+
+// --- Imagem de bytecode (.spi) ---
+// Diferente do .spc (serializer.h), que é lido objeto por objeto, a imagem é
+// feita para ser mapeada na memória (mmap) e usada no lugar: o bytecode de
+// cada função fica num bloco contíguo do arquivo e o Chunk aponta direto para
+// ele, então vários processos rodando a mesma imagem compartilham as páginas.
+// As funções são materializadas sob demanda: a carga cria só o script
+// principal, e cada ObjFunction nasce como um "esboço" (nome, aridade e o
+// índice na imagem) que ganha constantes e inline caches na primeira chamada.
+//
+// Layout (inteiros little-endian, tabelas de registros de tamanho fixo):
+//   cabeçalho  "SPHI", u32 versão, u32 número de opcodes, 9 x u32 contagens
+//   strings    (u32 posição no blob, u32 comprimento)
+//   globais    u32 string, na ordem dos slots
+//   nativas    u32 string (nome qualificado), na ordem dos slots
+//   funções    u32 aridade, u32 nome, u32 posição do código, u32 tamanho,
+//              u32 primeira constante, u32 número de constantes
+//   constantes u32 tag, u32 índice (string/função/classe), u64 bits do número
+//              (double, ou o inteiro em complemento de dois)
+//   classes    u32 nome, u32 primeiro item, u32 campos, u32 métodos
+//              (itens: os campos, e depois pares nome/função dos métodos)
+//   itens      u32
+//   blob de strings, blob de código
+#define SPI_VERSION 5
+
+struct BytecodeImage;
+
+// Escreve 'function' (e tudo o que ele alcança) como imagem. Não aloca objetos.
+bool write_image(std::ostream& out, ObjFunction* function, const GlobalTable& globals);
+
+// Mapeia e valida uma imagem. Retorna nullptr (com a mensagem em std::cerr)
+// se o arquivo não puder ser lido ou for inválido.
+BytecodeImage* open_image(const std::string& path);
+void close_image(BytecodeImage* image);
+
+// Resolve as globais e as nativas da imagem nas tabelas da VM (falha se
+// faltar alguma nativa) e retorna o esboço do script principal. A imagem
+// precisa continuar aberta enquanto a VM existir.
+ObjFunction* load_image(BytecodeImage* image, GlobalTable& globals);
+
+// Preenche um esboço (chamado por VM::call antes da primeira execução).
+void materialize_function(ObjFunction* function);
+
+#endif //SAPPHIRE_IMAGE_H
\ No newline at end of file
@@ -0,0 +1,616 @@
+#include "jit.h"
+#include "opcodes.h"
+#include <cstddef>
+#include <cstring>
+#include <map>
+
+#ifdef BASELINE_JIT
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+bool jit_available() {
+#ifdef BASELINE_JIT
+    return true;
+#else
+    return false;
+#endif
+}
+
+#ifdef BASELINE_JIT
+
+namespace {
+
+enum Register { RAX, RCX, RDX, RBX, RSP, RBP, RSI, RDI, R8, R9, R10, R11, R12, R13, R14, R15 };
+
+// Papéis fixos em todo o código nativo (registradores preservados pela ABI
+// System V, então só o prólogo e a saída precisam salvá-los).
+const int SLOTS = RBX;
+const int TOP = R12;        // stack_top: o primeiro slot livre
+const int CONSTANTS = R13;
+const int FRAME = R14;      // JitFrame*
+const int TAG = R15;        // QNAN, para testar e montar valores
+// Para reconhecer inteiros (value.h). R10 e R11 não são preservados pela
+// ABI, mas o código nativo não chama nenhuma função.
+const int INTEGER_MASK = R10;   // INT_MASK
+const int INTEGER_TAG = R11;    // QNAN | INT_TAG
+
+// Códigos de condição do x86 (Jcc / SETcc).
+enum Condition { CC_E = 0x4, CC_NE = 0x5, CC_BE = 0x6, CC_A = 0x7, CC_P = 0xa, CC_NP = 0xb };
+
+// Opcodes SSE2 escalares (prefixo F2, exceto ucomisd).
+const uint8_t MOVSD_LOAD = 0x10, MOVSD_STORE = 0x11;
+const uint8_t ADDSD = 0x58, MULSD = 0x59, SUBSD = 0x5c, DIVSD = 0x5e;
+const uint8_t CVTSI2SD = 0x2a, CVTTSD2SI = 0x2c;
+
+// Só as formas de instrução que os moldes usam.
+class Assembler {
+public:
+    std::vector<uint8_t> code;
+
+    size_t position() const { return code.size(); }
+    void byte(uint8_t value) { code.push_back(value); }
+    void u32(uint32_t value) { for (int i = 0; i < 4; i++) byte((value >> (8 * i)) & 0xff); }
+    void u64(uint64_t value) { for (int i = 0; i < 8; i++) byte((value >> (8 * i)) & 0xff); }
+
+    // Prefixo REX: W = operandos de 64 bits; R e B estendem os campos reg e base.
+    void rex(bool wide, int reg, int base) {
+        uint8_t prefix = 0x40 | (wide ? 8 : 0) | ((reg & 8) ? 4 : 0) | ((base & 8) ? 1 : 0);
+        if (prefix != 0x40) byte(prefix);
+    }
+    // ModRM de [base + disp]. Com base RSP/R12 o x86 exige o byte SIB.
+    void memory(int reg, int base, int32_t disp) {
+        bool small = disp >= -128 && disp <= 127;
+        byte((small ? 0x40 : 0x80) | ((reg & 7) << 3) | (base & 7));
+        if ((base & 7) == RSP) byte(0x24);
+        if (small) byte((uint8_t)(int8_t)disp);
+        else u32((uint32_t)disp);
+    }
+
+    void load(int reg, int base, int32_t disp)  { rex(true, reg, base); byte(0x8b); memory(reg, base, disp); }
+    void store(int base, int32_t disp, int reg) { rex(true, reg, base); byte(0x89); memory(reg, base, disp); }
+    void mov(int destination, int source) { alu(0x89, destination, source); }
+    void mov_imm64(int reg, uint64_t value) { rex(true, 0, reg); byte(0xb8 | (reg & 7)); u64(value); }
+    void mov_eax(uint32_t value) { byte(0xb8); u32(value); }
+    // op r/m64, r64 entre registradores: ADD 01, OR 09, AND 21, SUB 29, CMP 39, MOV 89.
+    void alu(uint8_t op, int destination, int source) {
+        rex(true, source, destination);
+        byte(op);
+        byte(0xc0 | ((source & 7) << 3) | (destination & 7));
+    }
+    // op r/m64, imm8 (83 /ext): ADD 0, OR 1, SUB 5, CMP 7.
+    void alu_imm(int ext, int reg, int8_t value) {
+        rex(true, 0, reg);
+        byte(0x83);
+        byte(0xc0 | (ext << 3) | (reg & 7));
+        byte((uint8_t)value);
+    }
+    // movzx eax, byte [base + disp]
+    void load_byte(int base, int32_t disp) { rex(false, RAX, base); byte(0x0f); byte(0xb6); memory(RAX, base, disp); }
+    void test_eax() { byte(0x85); byte(0xc0); }
+    // btc rax, 63: troca o sinal do double em rax.
+    void flip_sign() { byte(0x48); byte(0x0f); byte(0xba); byte(0xf8); byte(0x3f); }
+    // op r64, imm8 (C1 /ext): SHL 4, SAR 7.
+    void shift(int ext, int reg, uint8_t count) {
+        rex(true, 0, reg);
+        byte(0xc1);
+        byte(0xc0 | (ext << 3) | (reg & 7));
+        byte(count);
+    }
+
+    // SSE2 com operando na memória (movsd, addsd...).
+    void sse(uint8_t op, int xmm, int base, int32_t disp) {
+        byte(0xf2);
+        rex(false, xmm, base);
+        byte(0x0f);
+        byte(op);
+        memory(xmm, base, disp);
+    }
+    // SSE2 entre registradores xmm (addsd xmm0, xmm1...).
+    void sse_registers(uint8_t op, int xmm_destination, int xmm_source) {
+        byte(0xf2); byte(0x0f); byte(op); byte(0xc0 | (xmm_destination << 3) | xmm_source);
+    }
+    // cvtsi2sd xmm, r64 / cvttsd2si r64, xmm
+    void convert(uint8_t op, int destination, int source) {
+        byte(0xf2);
+        rex(true, destination, source);
+        byte(0x0f);
+        byte(op);
+        byte(0xc0 | ((destination & 7) << 3) | (source & 7));
+    }
+    // movq xmm, r64 (66 REX.W 0F 6E) e movq r64, xmm (66 REX.W 0F 7E).
+    void movq_to_xmm(int xmm, int reg)   { byte(0x66); rex(true, xmm, reg); byte(0x0f); byte(0x6e); byte(0xc0 | (xmm << 3) | (reg & 7)); }
+    void movq_from_xmm(int reg, int xmm) { byte(0x66); rex(true, xmm, reg); byte(0x0f); byte(0x7e); byte(0xc0 | (xmm << 3) | (reg & 7)); }
+    // xorpd xmm, xmm: zera o registrador.
+    void zero_xmm(int xmm) { byte(0x66); byte(0x0f); byte(0x57); byte(0xc0 | (xmm << 3) | xmm); }
+    // ucomisd xmm_a, xmm_b
+    void ucomisd(int xmm_a, int xmm_b) { byte(0x66); byte(0x0f); byte(0x2e); byte(0xc0 | (xmm_a << 3) | xmm_b); }
+    // setcc al / cl
+    void setcc(int condition, int reg) { byte(0x0f); byte(0x90 | condition); byte(0xc0 | reg); }
+    void movzx_eax_al() { byte(0x0f); byte(0xb6); byte(0xc0); }
+
+    // Saltos de 32 bits. Retornam a posição do deslocamento, para patch().
+    size_t jcc(int condition) { byte(0x0f); byte(0x80 | condition); u32(0); return position() - 4; }
+    size_t jmp() { byte(0xe9); u32(0); return position() - 4; }
+    void patch(size_t at, size_t target) {
+        int32_t relative = (int32_t)((long)target - (long)(at + 4));
+        std::memcpy(&code[at], &relative, 4);
+    }
+
+    void push(int reg) { rex(false, 0, reg); byte(0x50 | (reg & 7)); }
+    void pop(int reg) { rex(false, 0, reg); byte(0x58 | (reg & 7)); }
+    void jmp_rsi() { byte(0xff); byte(0xe6); }
+    void ret() { byte(0xc3); }
+};
+
+class Translator {
+public:
+    explicit Translator(const Chunk& chunk) : chunk(chunk), size(chunk.code.size()) {}
+
+    JitCode* run();
+
+private:
+    struct Jump {
+        size_t at;          // Deslocamento a corrigir no código nativo
+        size_t target;      // Destino no bytecode
+    };
+
+    const Chunk& chunk;
+    const size_t size;
+    Assembler a;
+    std::vector<uint32_t> native_at;
+    std::vector<Jump> jumps;
+    std::multimap<uint32_t, size_t> exits;  // Instrução -> saltos para a saída dela
+    uint32_t current = 0;                    // Instrução sendo traduzida
+    size_t common_exit = 0;
+
+    int32_t slot(int index) const { return index * 8; }
+    bool constant_is_number(int index) const {
+        return (size_t)index < chunk.constants.size() && chunk.constants[index].is_number();
+    }
+
+    // Volta ao interpretador na instrução atual, com a pilha como estava antes dela.
+    void deopt(size_t at) { exits.insert({current, at}); }
+    void exit_here() {
+        a.mov_eax(current);
+        a.patch(a.jmp(), common_exit);
+    }
+    void jump_to(size_t at, size_t target) { jumps.push_back({at, target}); }
+
+    // Números podem ser doubles ou inteiros (value.h). O código nativo faz
+    // todas as contas em double: um inteiro é convertido na leitura e o
+    // resultado sai como double, com o mesmo valor que a conta inteira daria
+    // (inteiros têm 48 bits, e um double é exato até 2^53; ver value.h).
+
+    // Volta ao interpretador se [base + disp] não for número. Usa rax e rdx.
+    void guard_number(int base, int32_t disp) {
+        a.load(RAX, base, disp);
+        a.mov(RDX, RAX);
+        a.alu(0x21, RDX, TAG);  // and rdx, QNAN
+        a.alu(0x39, RDX, TAG);  // cmp rdx, QNAN
+        size_t is_double = a.jcc(CC_NE);
+        a.alu(0x21, RAX, INTEGER_MASK);
+        a.alu(0x39, RAX, INTEGER_TAG);
+        deopt(a.jcc(CC_NE));
+        a.patch(is_double, a.position());
+    }
+    // xmm = [base + disp] como double, ou volta ao interpretador se não for
+    // número. Usa rax e rdx.
+    void load_number(int xmm, int base, int32_t disp) {
+        a.load(RAX, base, disp);
+        a.mov(RDX, RAX);
+        a.alu(0x21, RDX, TAG);
+        a.alu(0x39, RDX, TAG);
+        size_t is_double = a.jcc(CC_NE);
+        a.mov(RDX, RAX);
+        a.alu(0x21, RDX, INTEGER_MASK);
+        a.alu(0x39, RDX, INTEGER_TAG);
+        deopt(a.jcc(CC_NE));
+        a.shift(4, RAX, 16);    // shl rax, 16
+        a.shift(7, RAX, 16);    // sar rax, 16: o sinal do inteiro de 48 bits
+        a.convert(CVTSI2SD, xmm, RAX);
+        size_t done = a.jmp();
+        a.patch(is_double, a.position());
+        a.movq_to_xmm(xmm, RAX);
+        a.patch(done, a.position());
+    }
+    // A constante já é conhecida: um inteiro vira um double imediato.
+    void load_constant(int xmm, int index) {
+        const SapphireValue& constant = chunk.constants[index];
+        if (constant.is_int()) {
+            double number = constant.as_number();
+            uint64_t bits;
+            std::memcpy(&bits, &number, sizeof(double));
+            a.mov_imm64(RAX, bits);
+            a.movq_to_xmm(xmm, RAX);
+        } else {
+            a.sse(MOVSD_LOAD, xmm, CONSTANTS, slot(index));
+        }
+    }
+    // xmm0 e xmm1 = os dois operandos do topo da pilha.
+    void load_operands() {
+        load_number(0, TOP, -16);
+        load_number(1, TOP, -8);
+    }
+    void push_rax() {
+        a.store(TOP, 0, RAX);
+        a.alu_imm(0, TOP, 8);
+    }
+    // al (0 ou 1) -> true/false em [TOP + disp].
+    void store_bool(int32_t disp) {
+        a.movzx_eax_al();
+        a.alu_imm(0, RAX, (int8_t)TAG_FALSE);  // false = QNAN|2, true = QNAN|3
+        a.alu(0x09, RAX, TAG);
+        a.store(TOP, disp, RAX);
+    }
+    // rax = valor - QNAN - 1: nil e false viram 0 e 1 (falsey se <= 1 sem sinal).
+    void falsey_test(int32_t disp) {
+        a.load(RAX, TOP, disp);
+        a.alu(0x29, RAX, TAG);
+        a.alu_imm(5, RAX, 1);
+        a.alu_imm(7, RAX, 1);
+    }
+
+    void arithmetic(uint8_t op) {
+        load_operands();
+        a.sse_registers(op, 0, 1);
+        a.sse(MOVSD_STORE, 0, TOP, -16);
+        a.alu_imm(5, TOP, 8);
+    }
+    // '/' entre int: trunca o quociente. Divisor zero (ou NaN) e quociente
+    // fora de 64 bits ficam com o interpretador.
+    void divide_integers() {
+        load_operands();
+        a.zero_xmm(2);
+        a.ucomisd(1, 2);
+        deopt(a.jcc(CC_E));
+        a.sse_registers(DIVSD, 0, 1);
+        a.convert(CVTTSD2SI, RAX, 0);
+        a.mov_imm64(RDX, SIGN_BIT);     // "inteiro indefinido" do cvttsd2si
+        a.alu(0x39, RAX, RDX);
+        deopt(a.jcc(CC_E));
+        a.convert(CVTSI2SD, 0, RAX);
+        a.sse(MOVSD_STORE, 0, TOP, -16);
+        a.alu_imm(5, TOP, 8);
+    }
+    // 'swap' compara b com a. Com 'a < b' = (b above a), NaN dá falso, como no C++.
+    void compare(bool swap, int condition) {
+        load_operands();
+        a.ucomisd(swap ? 1 : 0, swap ? 0 : 1);
+        a.setcc(condition, RAX);
+        store_bool(-16);
+        a.alu_imm(5, TOP, 8);
+    }
+    // Desempilha os dois operandos e salta quando 'jump_condition' vale.
+    void compare_jump(bool swap, int jump_condition, size_t target) {
+        load_operands();
+        a.alu_imm(5, TOP, 16);
+        a.ucomisd(swap ? 1 : 0, swap ? 0 : 1);
+        jump_to(a.jcc(jump_condition), target);
+    }
+    // Igualdade só entre números (o resto volta ao interpretador).
+    void equal(bool negate) {
+        load_operands();
+        a.ucomisd(0, 1);
+        a.setcc(CC_E, RAX);
+        a.setcc(CC_NP, RCX);
+        a.byte(0x20); a.byte(0xc8);                     // and al, cl
+        if (negate) { a.byte(0x34); a.byte(0x01); }     // xor al, 1
+        store_bool(-16);
+        a.alu_imm(5, TOP, 8);
+    }
+    void equal_jump(bool negate, size_t target) {
+        load_operands();
+        a.alu_imm(5, TOP, 16);
+        a.ucomisd(0, 1);
+        if (!negate) {
+            // Salta se diferentes (ou NaN).
+            jump_to(a.jcc(CC_NE), target);
+            jump_to(a.jcc(CC_P), target);
+        } else {
+            // Salta se iguais: NaN nunca é igual.
+            size_t unordered = a.jcc(CC_P);
+            jump_to(a.jcc(CC_E), target);
+            a.patch(unordered, a.position());
+        }
+    }
+    static uint16_t global_operand(const uint8_t* operands) {
+        return (uint16_t)((operands[0] << 8) | operands[1]);
+    }
+    // O valor em rax não pode ser objeto: guardar um objeto numa global passa
+    // pela barreira do coletor, então fica com o interpretador.
+    void guard_not_object() {
+        a.mov_imm64(RCX, SIGN_BIT | QNAN);
+        a.mov(RDX, RAX);
+        a.alu(0x21, RDX, RCX);
+        a.alu(0x39, RDX, RCX);
+        deopt(a.jcc(CC_E));
+    }
+    void global_defined(uint16_t index) {
+        a.load(RCX, FRAME, offsetof(JitFrame, defined));
+        a.load_byte(RCX, index);
+        a.test_eax();
+        deopt(a.jcc(CC_E));
+    }
+
+    bool translate(uint8_t op, const uint8_t* operands, size_t target);
+};
+
+bool Translator::translate(uint8_t op, const uint8_t* operands, size_t target) {
+    switch (op) {
+        case OP_CONSTANT:
+            a.load(RAX, CONSTANTS, slot(operands[0]));
+            push_rax();
+            break;
+        case OP_NIL: case OP_TRUE: case OP_FALSE:
+            a.mov(RAX, TAG);
+            a.alu_imm(1, RAX, (int8_t)(op == OP_NIL ? TAG_NIL : op == OP_TRUE ? TAG_TRUE : TAG_FALSE));
+            push_rax();
+            break;
+        case OP_POP:
+            a.alu_imm(5, TOP, 8);
+            break;
+
+        case OP_GET_LOCAL:
+            a.load(RAX, SLOTS, slot(operands[0]));
+            push_rax();
+            break;
+        case OP_SET_LOCAL:
+            a.load(RAX, TOP, -8);
+            a.store(SLOTS, slot(operands[0]), RAX);
+            break;
+        case OP_SET_LOCAL_POP:
+            a.alu_imm(5, TOP, 8);
+            a.load(RAX, TOP, 0);
+            a.store(SLOTS, slot(operands[0]), RAX);
+            break;
+
+        case OP_GET_GLOBAL: {
+            uint16_t index = global_operand(operands);
+            global_defined(index);
+            a.load(RCX, FRAME, offsetof(JitFrame, globals));
+            a.load(RAX, RCX, slot(index));
+            push_rax();
+            break;
+        }
+        case OP_SET_GLOBAL: {
+            uint16_t index = global_operand(operands);
+            global_defined(index);
+            a.load(RAX, TOP, -8);
+            guard_not_object();
+            a.load(RCX, FRAME, offsetof(JitFrame, globals));
+            a.store(RCX, slot(index), RAX);
+            break;
+        }
+
+        // Instruções aceleradas: a global já está definida, sem guarda.
+        case OP_GET_GLOBAL_QUICK:
+            a.load(RCX, FRAME, offsetof(JitFrame, globals));
+            a.load(RAX, RCX, slot(global_operand(operands)));
+            push_rax();
+            break;
+        case OP_SET_GLOBAL_POP:
+            a.load(RAX, TOP, -8);
+            guard_not_object();
+            a.load(RCX, FRAME, offsetof(JitFrame, globals));
+            a.store(RCX, slot(global_operand(operands)), RAX);
+            a.alu_imm(5, TOP, 8);
+            break;
+        case OP_INC_GLOBAL_CONST: {
+            if (!constant_is_number(operands[2])) return false;
+            int32_t global = slot(global_operand(operands));
+            a.load(RCX, FRAME, offsetof(JitFrame, globals));
+            load_number(0, RCX, global);
+            load_constant(1, operands[2]);
+            a.sse_registers(ADDSD, 0, 1);
+            a.sse(MOVSD_STORE, 0, RCX, global);
+            break;
+        }
+        case OP_LESS_GLOBAL_CONST_JUMP: {
+            if (!constant_is_number(operands[2])) return false;
+            int32_t global = slot(global_operand(operands));
+            a.load(RCX, FRAME, offsetof(JitFrame, globals));
+            load_number(0, RCX, global);
+            load_constant(1, operands[2]);
+            a.ucomisd(1, 0);
+            jump_to(a.jcc(CC_BE), target);
+            break;
+        }
+
+        // As versões OP_*_NUM também passam por load_number, que converte
+        // os inteiros (e nunca falha para um número garantido).
+        case OP_ADD:
+        case OP_ADD_NUM:       arithmetic(ADDSD); break;
+        case OP_SUBTRACT:
+        case OP_SUBTRACT_NUM:  arithmetic(SUBSD); break;
+        case OP_MULTIPLY:
+        case OP_MULTIPLY_NUM:  arithmetic(MULSD); break;
+        case OP_DIVIDE:
+        case OP_DIVIDE_NUM:    arithmetic(DIVSD); break;
+        case OP_DIVIDE_INT:    divide_integers(); break;
+
+        // >= é !(a < b) e <= é !(a > b), como na VM (importa com NaN).
+        case OP_LESS:
+        case OP_LESS_NUM:      compare(true, CC_A); break;
+        case OP_GREATER:
+        case OP_GREATER_NUM:   compare(false, CC_A); break;
+        case OP_GREATER_EQUAL: compare(true, CC_BE); break;
+        case OP_LESS_EQUAL:    compare(false, CC_BE); break;
+        case OP_EQUAL:         equal(false); break;
+        case OP_NOT_EQUAL:     equal(true); break;
+
+        case OP_NOT:
+            falsey_test(-8);
+            a.setcc(CC_BE, RAX);
+            store_bool(-8);
+            break;
+        case OP_NEGATE:
+            load_number(0, TOP, -8);
+            a.movq_from_xmm(RAX, 0);
+            a.flip_sign();
+            a.store(TOP, -8, RAX);
+            break;
+        case OP_CHECK_NUMBER:
+            guard_number(TOP, -8);
+            break;
+
+        case OP_JUMP:
+        case OP_LOOP:
+            jump_to(a.jmp(), target);
+            break;
+        case OP_JUMP_IF_FALSE:
+            falsey_test(-8);
+            jump_to(a.jcc(CC_BE), target);
+            break;
+        case OP_LESS_JUMP:          compare_jump(true, CC_BE, target); break;
+        case OP_GREATER_JUMP:       compare_jump(false, CC_BE, target); break;
+        case OP_GREATER_EQUAL_JUMP: compare_jump(true, CC_A, target); break;
+        case OP_LESS_EQUAL_JUMP:    compare_jump(false, CC_A, target); break;
+        case OP_EQUAL_JUMP:         equal_jump(false, target); break;
+        case OP_NOT_EQUAL_JUMP:     equal_jump(true, target); break;
+
+        case OP_ADD_LOCAL_LOCAL:
+            load_number(0, SLOTS, slot(operands[0]));
+            load_number(1, SLOTS, slot(operands[1]));
+            a.sse_registers(ADDSD, 0, 1);
+            a.sse(MOVSD_STORE, 0, TOP, 0);
+            a.alu_imm(0, TOP, 8);
+            break;
+        case OP_INC_LOCAL_CONST:
+            if (!constant_is_number(operands[1])) return false;
+            load_number(0, SLOTS, slot(operands[0]));
+            load_constant(1, operands[1]);
+            a.sse_registers(ADDSD, 0, 1);
+            a.sse(MOVSD_STORE, 0, SLOTS, slot(operands[0]));
+            break;
+        case OP_LESS_LOCAL_CONST_JUMP:
+        case OP_LESS_LOCAL_LOCAL_JUMP: {
+            bool constant = op == OP_LESS_LOCAL_CONST_JUMP;
+            if (constant && !constant_is_number(operands[1])) return false;
+            load_number(0, SLOTS, slot(operands[0]));
+            if (constant) load_constant(1, operands[1]);
+            else load_number(1, SLOTS, slot(operands[1]));
+            a.ucomisd(1, 0);
+            jump_to(a.jcc(CC_BE), target);
+            break;
+        }
+
+        default:
+            // Chamadas, retorno, propriedades, arrays, print...: interpretador.
+            return false;
+    }
+    return true;
+}
+
+JitCode* Translator::run() {
+    native_at.assign(size + 1, UINT32_MAX);
+
+    // Prólogo: salva os registradores preservados, carrega os papéis fixos e
+    // salta para a instrução pedida (rsi).
+    a.push(RBX);
+    a.push(R12);
+    a.push(R13);
+    a.push(R14);
+    a.push(R15);
+    a.mov(FRAME, RDI);
+    a.load(SLOTS, FRAME, offsetof(JitFrame, slots));
+    a.load(TOP, FRAME, offsetof(JitFrame, stack_top));
+    a.load(CONSTANTS, FRAME, offsetof(JitFrame, constants));
+    a.mov_imm64(TAG, QNAN);
+    a.mov_imm64(INTEGER_MASK, INT_MASK);
+    a.mov_imm64(INTEGER_TAG, QNAN | INT_TAG);
+    a.jmp_rsi();
+
+    // Saída comum: eax já tem a instrução onde o interpretador continua.
+    common_exit = a.position();
+    a.store(FRAME, offsetof(JitFrame, stack_top), TOP);
+    a.pop(R15);
+    a.pop(R14);
+    a.pop(R13);
+    a.pop(R12);
+    a.pop(RBX);
+    a.ret();
+
+    for (size_t offset = 0; offset < size;) {
+        uint8_t op = chunk.code[offset];
+        int length = instruction_length(op);
+        if (length == 0 || offset + length > size) return nullptr;
+        const uint8_t* operands = chunk.code.data() + offset + 1;
+
+        size_t target = 0;
+        if (op == OP_LOOP || op == OP_JUMP || op == OP_JUMP_IF_FALSE ||
+            (op >= OP_EQUAL_JUMP && op <= OP_LESS_EQUAL_JUMP) ||
+            op == OP_LESS_LOCAL_CONST_JUMP || op == OP_LESS_LOCAL_LOCAL_JUMP ||
+            op == OP_LESS_GLOBAL_CONST_JUMP) {
+            // O deslocamento de 16 bits é sempre o fim da instrução.
+            size_t jump = (size_t)((operands[length - 3] << 8) | operands[length - 2]);
+            size_t end = offset + length;
+            if (op == OP_LOOP && jump > end) return nullptr;
+            target = op == OP_LOOP ? end - jump : end + jump;
+            if (target > size) return nullptr;
+        }
+
+        current = (uint32_t)offset;
+        native_at[offset] = (uint32_t)a.position();
+        if (!translate(op, operands, target)) exit_here();
+        offset += length;
+    }
+    current = (uint32_t)size;
+    native_at[size] = (uint32_t)a.position();
+    exit_here();
+
+    for (const Jump& jump : jumps) {
+        if (native_at[jump.target] == UINT32_MAX) return nullptr;
+        a.patch(jump.at, native_at[jump.target]);
+    }
+    // Uma saída por instrução com guardas, compartilhada por todas elas.
+    for (auto it = exits.begin(); it != exits.end();) {
+        current = it->first;
+        size_t stub = a.position();
+        exit_here();
+        for (; it != exits.end() && it->first == current; ++it) a.patch(it->second, stub);
+    }
+
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    size_t length = (a.code.size() + page - 1) / page * page;
+    void* memory = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (memory == MAP_FAILED) return nullptr;
+    std::memcpy(memory, a.code.data(), a.code.size());
+    if (mprotect(memory, length, PROT_READ | PROT_EXEC) != 0) {
+        munmap(memory, length);
+        return nullptr;
+    }
+
+    JitCode* code = new JitCode();
+    code->memory = static_cast<uint8_t*>(memory);
+    code->size = length;
+    code->entry = std::move(native_at);
+    return code;
+}
+
+} // namespace
+
+JitCode* jit_compile(const Chunk& chunk) {
+    if (chunk.code.size() == 0 || chunk.code.size() >= UINT32_MAX) return nullptr;
+    return Translator(chunk).run();
+}
+
+void free_jit_code(JitCode* code) {
+    if (code->memory != nullptr) munmap(code->memory, code->size);
+    delete code;
+}
+
+uint32_t jit_execute(const JitCode* code, JitFrame* frame, uint32_t offset) {
+    if (offset >= code->entry.size() || code->entry[offset] == UINT32_MAX) return offset;
+    using Native = uint32_t (*)(JitFrame* frame, const void* target);
+    Native native = reinterpret_cast<Native>(code->memory);
+    return native(frame, code->memory + code->entry[offset]);
+}
+
+#else
+
+JitCode* jit_compile(const Chunk&) { return nullptr; }
+void free_jit_code(JitCode* code) { delete code; }
+uint32_t jit_execute(const JitCode*, JitFrame*, uint32_t offset) { return offset; }
+
+#endif // BASELINE_JIT
\ No newline at end of file
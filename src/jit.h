@@ -0,0 +1,57 @@
+#ifndef SAPPHIRE_JIT_H
+#define SAPPHIRE_JIT_H
+
+#include "chunk.h"
+#include "value.h"
+#include <cstdint>
+#include <vector>
+
+// --- JIT de base (x86-64, Linux) ---
+// Com "--jit", o bytecode de pilha de uma função quente vira código de máquina:
+// cada instrução é copiada de um molde fixo ("template JIT"), sem alocação
+// de registradores entre instruções. O estado continua todo na memória da VM
+// (slots e pilha de operandos), então dá para entrar no código nativo no
+// começo de qualquer instrução e voltar ao interpretador em qualquer uma:
+//   - as instruções numéricas, de locais, globais, comparação e salto rodam
+//     no código nativo, com guardas de tipo;
+//   - se uma guarda falha (ex: OP_ADD com strings), ou a instrução é das que
+//     o JIT não traduz (chamadas, retorno, propriedades...), o código nativo
+//     devolve a posição dessa instrução e o interpretador continua dali,
+//     sem nada para desfazer ("deopt").
+// O interpretador volta a entrar no código nativo nos saltos para trás, na
+// chamada da função e no retorno para um frame compilado (ver VM::run).
+//
+// Só existe com NaN-boxing (cada valor é uma palavra de 64 bits), e só é
+// compilado quando o CMake define BASELINE_JIT.
+
+// Chamadas + voltas de laço até uma função ser compilada.
+#define JIT_HOT_THRESHOLD 1000
+
+// O que o código nativo lê e escreve. 'stack_top' é atualizado na saída.
+struct JitFrame {
+    SapphireValue* slots;
+    SapphireValue* stack_top;
+    const SapphireValue* constants;
+    SapphireValue* globals;
+    const uint8_t* defined;
+};
+
+struct JitCode {
+    uint8_t* memory = nullptr;      // Página(s) executáveis (mmap)
+    size_t size = 0;
+    std::vector<uint32_t> entry;    // Posição no bytecode -> posição no código nativo
+};
+
+// Compila o chunk. Retorna nullptr se não for possível (sem JIT nesta build,
+// bytecode inesperado, falha do mmap); a função segue no interpretador.
+JitCode* jit_compile(const Chunk& chunk);
+void free_jit_code(JitCode* code);
+
+// Roda a partir da instrução 'offset' e retorna a posição onde o
+// interpretador deve continuar.
+uint32_t jit_execute(const JitCode* code, JitFrame* frame, uint32_t offset);
+
+// Se esta build tem o JIT (sapphire --jit).
+bool jit_available();
+
+#endif //SAPPHIRE_JIT_H
\ No newline at end of file
@@ -1,36 +1,22 @@
 #include "lexer.h"
 #include <iostream>
-#include <map>
-#include <cctype> // Para isdigit, isalpha, isalnum
-
-// Mapa de palavras-chave
-static std::map<std::string, TokenType> keywords = {
-    {"print", TokenType::PRINT},
-    {"if", TokenType::IF},         {"else", TokenType::ELSE},
-    {"true", TokenType::TRUE},     {"false", TokenType::FALSE},
-    {"nil", TokenType::NIL},       {"and", TokenType::AND},
-    {"or", TokenType::OR},         {"while", TokenType::WHILE},
-    {"function", TokenType::FUNCTION}, {"return", TokenType::RETURN},
-    {"import", TokenType::IMPORT},  {"this", TokenType::THIS},
-    {"int", TokenType::INT},         
-    {"bool", TokenType::BOOL},       
-    {"string", TokenType::STRING},   
-    {"double", TokenType::DOUBLE},
-    {"float", TokenType::FLOAT},
-    {"void", TokenType::VOID},
-    {"class", TokenType::CLASS},
-};
-
-Lexer::Lexer(const std::string& source) : source(source) {}
-
-// Funções de ajuda para criar tokens
+
+// Classificação ASCII, sem depender da locale (e sem o comportamento
+// indefinido de isalpha/isdigit com bytes negativos).
+static bool is_digit(char c) { return c >= '0' && c <= '9'; }
+static bool is_alpha(char c) { return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_'; }
+
+Lexer::Lexer(std::string_view source) : source(source) {}
+
+// Funções de ajuda para criar tokens. O texto é uma fatia do código-fonte.
 Token Lexer::make_token(TokenType type) {
     return {type, source.substr(start, current - start), line};
 }
-Token Lexer::make_token(TokenType type, const std::string& literal) {
+Token Lexer::make_token(TokenType type, std::string_view literal) {
     return {type, literal, line};
 }
-Token Lexer::error_token(const std::string& message) {
+// 'message' deve ser um literal (vive durante todo o programa).
+Token Lexer::error_token(std::string_view message) {
     return {TokenType::ILLEGAL, message, line};
 }
 
@@ -45,10 +31,6 @@ bool Lexer::match(char expected) {
     return true;
 }
 
-void skip_whitespace() {
-    // Implementação de pular espaços em branco, se necessário
-}
-
 // Funções de tokenização específicas
 Token Lexer::string_token() {
     while (peek() != '"' && !is_at_end()) {
@@ -59,35 +41,85 @@ Token Lexer::string_token() {
     
     advance(); // Consome o " de fechamento
 
-    // ----- DEBUG PRINTS -----
+#ifdef DEBUG_PRINT_LEXER
     std::cout << "--- DEBUG LEXER (string_token) ---" << std::endl;
     std::cout << "start index: " << start << std::endl;
     std::cout << "current index: " << current << std::endl;
     std::cout << "Calculated length: " << (current - start - 2) << std::endl;
     std::cout << "Substring value: '" << source.substr(start + 1, current - start - 2) << "'" << std::endl;
     std::cout << "------------------------------------" << std::endl;
-    // ----- FIM DO DEBUG -----
+#endif
 
     return make_token(TokenType::STRING_LITERAL, source.substr(start + 1, current - start - 2));
 }
 
 Token Lexer::number_token() {
-    while (isdigit(peek())) advance();
-    if (peek() == '.' && isdigit(peek_next())) {
+    while (is_digit(peek())) advance();
+    if (peek() == '.' && is_digit(peek_next())) {
         advance();
-        while (isdigit(peek())) advance();
+        while (is_digit(peek())) advance();
     }
     return make_token(TokenType::NUMBER);
 }
 
-Token Lexer::identifier_token() {
-    while (isalnum(peek()) || peek() == '_') advance();
-    std::string text = source.substr(start, current - start);
-    auto it = keywords.find(text);
-    if (it != keywords.end()) {
-        return make_token(it->second);
+// Confere se o resto do identificador (a partir de 'offset') é 'rest'.
+TokenType Lexer::check_keyword(size_t offset, std::string_view rest, TokenType type) {
+    if (current - start == offset + rest.size() && source.substr(start + offset, rest.size()) == rest) {
+        return type;
     }
-    return make_token(TokenType::IDENTIFIER);
+    return TokenType::IDENTIFIER;
+}
+
+// Palavras-chave reconhecidas por uma árvore de switch sobre os primeiros
+// caracteres, sem montar uma string nem consultar um mapa.
+TokenType Lexer::identifier_type() {
+    size_t length = current - start;
+    switch (source[start]) {
+        case 'a': return check_keyword(1, "nd", TokenType::AND);
+        case 'b': return check_keyword(1, "ool", TokenType::BOOL);
+        case 'c': return check_keyword(1, "lass", TokenType::CLASS);
+        case 'd': return check_keyword(1, "ouble", TokenType::DOUBLE);
+        case 'e': return check_keyword(1, "lse", TokenType::ELSE);
+        case 'f':
+            if (length > 1) {
+                switch (source[start + 1]) {
+                    case 'a': return check_keyword(2, "lse", TokenType::FALSE);
+                    case 'l': return check_keyword(2, "oat", TokenType::FLOAT);
+                    case 'u': return check_keyword(2, "nction", TokenType::FUNCTION);
+                }
+            }
+            break;
+        case 'i':
+            if (length > 1) {
+                switch (source[start + 1]) {
+                    case 'f': return check_keyword(2, "", TokenType::IF);
+                    case 'm': return check_keyword(2, "port", TokenType::IMPORT);
+                    case 'n': return check_keyword(2, "t", TokenType::INT);
+                }
+            }
+            break;
+        case 'n': return check_keyword(1, "il", TokenType::NIL);
+        case 'o': return check_keyword(1, "r", TokenType::OR);
+        case 'p': return check_keyword(1, "rint", TokenType::PRINT);
+        case 'r': return check_keyword(1, "eturn", TokenType::RETURN);
+        case 's': return check_keyword(1, "tring", TokenType::STRING);
+        case 't':
+            if (length > 1) {
+                switch (source[start + 1]) {
+                    case 'h': return check_keyword(2, "is", TokenType::THIS);
+                    case 'r': return check_keyword(2, "ue", TokenType::TRUE);
+                }
+            }
+            break;
+        case 'v': return check_keyword(1, "oid", TokenType::VOID);
+        case 'w': return check_keyword(1, "hile", TokenType::WHILE);
+    }
+    return TokenType::IDENTIFIER;
+}
+
+Token Lexer::identifier_token() {
+    while (is_alpha(peek()) || is_digit(peek())) advance();
+    return make_token(identifier_type());
 }
 
 
@@ -125,8 +157,8 @@ Token Lexer::scan_token() {
 
     char c = advance();
 
-    if (isdigit(c)) return number_token();
-    if (isalpha(c) || c == '_') return identifier_token();
+    if (is_digit(c)) return number_token();
+    if (is_alpha(c)) return identifier_token();
 
     switch (c) {
         case '(': return make_token(TokenType::LEFT_PAREN);
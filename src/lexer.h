@@ -2,19 +2,20 @@
 #define SAPPHIRE_LEXER_H
 
 #include "tokens.h"
-#include <vector>
-#include <map>
-#include <string>
+#include <string_view>
 
+// O lexer não copia o código-fonte: ele percorre uma string_view do buffer
+// de quem chama, e os tokens apontam para dentro dela. O buffer precisa
+// continuar vivo enquanto os tokens forem usados (ver compile()).
 class Lexer {
 public:
-    Lexer(const std::string& source);
+    Lexer(std::string_view source);
     Token scan_token(); // <<< AGORA É PÚBLICO E RETORNA UM TOKEN
 
 private:
-    std::string source;
-    int start = 0;
-    int current = 0;
+    std::string_view source;
+    size_t start = 0;
+    size_t current = 0;
     int line = 1; // Rastreia a linha atual
 
     bool is_at_end();
@@ -24,11 +25,13 @@ private:
     bool match(char expected);
 
     Token make_token(TokenType type);
-    Token make_token(TokenType type, const std::string& literal);
-    Token error_token(const std::string& message);
+    Token make_token(TokenType type, std::string_view literal);
+    Token error_token(std::string_view message);
     Token string_token();
     Token number_token();
     Token identifier_token();
+    TokenType identifier_type();
+    TokenType check_keyword(size_t offset, std::string_view rest, TokenType type);
 };
 
 #endif // SAPPHIRE_LEXER_H
\ No newline at end of file
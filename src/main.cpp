@@ -3,22 +3,174 @@
 #include <vector>
 #include <fstream>
 #include <sstream>
+#include <cstdlib>
+#include <filesystem>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <unistd.h>
+#define process_id getpid
+#elif defined(_WIN32)
+#include <process.h>
+#define process_id _getpid
+#endif
 
 #include "vm.h"
+#include "serializer.h"
+#include "optimizer.h"
+#include "debug.h"
+#include "jit.h"
+#include "lexer.h"
 
 static VM vm; // Instância única da VM
+// As listagens de depuração saem da compilação, e um acerto no cache não
+// compila: nessas builds o cache começa desligado (--cache liga), para que
+// toda execução imprima o mesmo.
+#if defined(DEBUG_PRINT_CODE) || defined(DEBUG_PRINT_LEXER)
+static bool use_cache = false;
+#else
+static bool use_cache = true;
+#endif
 
-// Função para rodar um arquivo de script
-static void run_file(const std::string& path) {
-    std::ifstream file(path);
+static std::string read_file(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
     if (!file.is_open()) {
         std::cerr << "Erro: Nao foi possivel abrir o arquivo '" << path << "'." << std::endl;
         exit(74);
     }
     std::stringstream buffer;
     buffer << file.rdbuf();
-    
-    vm.interpret(buffer.str());
+    return buffer.str();
+}
+
+static bool ends_with(const std::string& text, const std::string& suffix) {
+    return text.size() >= suffix.size() && text.compare(text.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+// Diretório do cache de compilação: $SAPPHIRE_CACHE_DIR, ou o cache do
+// usuário ($XDG_CACHE_HOME ou ~/.cache). Vazio se não houver nenhum.
+static std::filesystem::path cache_directory() {
+    if (const char* dir = std::getenv("SAPPHIRE_CACHE_DIR")) return dir;
+    if (const char* dir = std::getenv("XDG_CACHE_HOME")) return std::filesystem::path(dir) / "sapphire";
+    if (const char* home = std::getenv("HOME")) return std::filesystem::path(home) / ".cache" / "sapphire";
+    return {};
+}
+
+// Nome temporário ao lado de 'path', único por processo (pid) e por chamada,
+// para que dois processos gravando o mesmo arquivo não dividam o temporário.
+static std::filesystem::path temp_path(const std::filesystem::path& path) {
+    static unsigned counter = 0;
+    std::filesystem::path temp = path;
+    temp += ".tmp" + std::to_string(process_id()) + "-" + std::to_string(counter++);
+    return temp;
+}
+
+// Grava num arquivo temporário e renomeia, para que outro processo nunca
+// leia um .spc pela metade.
+static void write_cache(const std::filesystem::path& path, ObjFunction* function) {
+    std::error_code error;
+    std::filesystem::create_directories(path.parent_path(), error);
+    if (error) return;
+
+    std::filesystem::path temp = temp_path(path);
+    {
+        std::ofstream out(temp, std::ios::binary);
+        if (!out.is_open() || !vm.save_bytecode(out, function)) {
+            out.close();
+            std::filesystem::remove(temp, error);
+            return;
+        }
+    }
+    std::filesystem::rename(temp, path, error);
+    if (error) std::filesystem::remove(temp, error);
+}
+
+// Função para rodar um arquivo de script
+static void run_file(const std::string& path) {
+    // Imagem mapeada direto do arquivo (sapphire --compile saida.spi).
+    if (ends_with(path, ".spi")) {
+        ObjFunction* function = vm.load_image(path);
+        if (function != nullptr) vm.interpret(function);
+        return;
+    }
+
+    std::string source = read_file(path);
+
+    // Bytecode já compilado (sapphire --compile).
+    if (ends_with(path, ".spc")) {
+        std::istringstream in(source);
+        ObjFunction* function = vm.load_bytecode(in);
+        if (function != nullptr) vm.interpret(function);
+        return;
+    }
+
+    // Cache indexado pelo hash do código-fonte: só recompila se o script mudou.
+    std::filesystem::path cached;
+    if (use_cache) {
+        std::filesystem::path dir = cache_directory();
+        if (!dir.empty()) cached = dir / (bytecode_cache_key(source) + ".spc");
+    }
+    if (!cached.empty()) {
+        std::ifstream in(cached, std::ios::binary);
+        if (in.is_open()) {
+            ObjFunction* function = vm.load_bytecode(in);
+            if (function != nullptr) {
+                vm.interpret(function);
+                return;
+            }
+        }
+    }
+
+    ObjFunction* function = vm.compile(source);
+    if (function == nullptr) return;
+    if (!cached.empty()) write_cache(cached, function);
+    vm.interpret(function);
+}
+
+// sapphire --compile saida.spc script.sp (ou saida.spi, para uma imagem).
+// Como em write_cache, grava num temporário e renomeia: um processo que já
+// mapeou a .spi antiga (MAP_SHARED) não pode vê-la mudar por baixo.
+static int compile_file(const std::string& output, const std::string& path) {
+    ObjFunction* function = vm.compile(read_file(path));
+    if (function == nullptr) return 65;
+
+    std::error_code error;
+    std::filesystem::path temp = temp_path(output);
+    bool image = ends_with(output, ".spi");
+    bool written;
+    {
+        std::ofstream out(temp, std::ios::binary);
+        written = out.is_open() && (image ? vm.save_image(out, function) : vm.save_bytecode(out, function));
+        if (written) {
+            out.close();
+            written = !out.fail();
+        }
+    }
+    if (written) std::filesystem::rename(temp, output, error);
+    if (!written || error) {
+        std::filesystem::remove(temp, error);
+        std::cerr << "Erro: Nao foi possivel escrever '" << output << "'." << std::endl;
+        return 74;
+    }
+    return 0;
+}
+
+// sapphire --lex-only script.sp: só passa o lexer e conta os tokens, para
+// medir a vazão do lexer sem o parser (bench/run.sh).
+static int lex_file(const std::string& path) {
+    std::string source = read_file(path);
+    Lexer lexer(source);
+    size_t count = 0;
+    for (;;) {
+        Token token = lexer.scan_token();
+        if (token.type == TokenType::ILLEGAL) {
+            std::cerr << "[linha " << token.line << "] Erro: " << token.literal << std::endl;
+            return 65;
+        }
+        if (token.type == TokenType::END_OF_FILE) break;
+        count++;
+    }
+    std::cout << count << " tokens" << std::endl;
+    return 0;
 }
 
 // Função para o modo interativo (REPL)
@@ -36,14 +188,107 @@ static void repl() {
 
 int main(int argc, char* argv[]) {
     std::cout << ">>>>>> TESTE DE COMPILACAO REALIZADO COM SUCESSO <<<<<<" << std::endl;
-    if (argc == 1) {
+
+    // Opções começam com "--" e vêm antes do caminho do script.
+    bool show_gc_stats = false;
+#ifdef PROFILE_OPCODES
+    size_t op_pairs_limit = 0;
+#endif
+    std::string compile_output;
+    bool lex_only = false;
+    GCConfig gc_config;
+    bool use_jit = false;
+    bool register_backend = false;
+    int arg = 1;
+    for (; arg < argc && std::string(argv[arg]).rfind("--", 0) == 0; arg++) {
+        std::string option = argv[arg];
+        if (option == "--gc-stats") {
+            show_gc_stats = true;
+        } else if (option == "--gc-generational") {
+            gc_config.generational = true;
+        } else if (option == "--gc-incremental") {
+            gc_config.incremental = true;
+        } else if (option.rfind("--gc-slice=", 0) == 0) {
+            gc_config.slice_budget = std::stoul(option.substr(11));
+        } else if (option.rfind("--gc-nursery=", 0) == 0) {
+            gc_config.nursery_size = std::stoul(option.substr(13)) * 1024;
+        } else if (option == "--ic-stats") {
+            vm.set_print_cache_stats(true);
+        } else if (option == "--cache") {
+            use_cache = true;
+        } else if (option == "--no-cache") {
+            use_cache = false;
+        } else if (option == "--no-peephole") {
+            set_peephole_enabled(false);
+        } else if (option == "--no-tiering") {
+            vm.set_tiering(false);
+        } else if (option == "--vm=stack") {
+            vm.set_backend(BACKEND_STACK);
+            register_backend = false;
+        } else if (option == "--vm=register") {
+            vm.set_backend(BACKEND_REGISTER);
+            register_backend = true;
+        } else if (option == "--jit") {
+            if (!jit_available()) {
+                std::cerr << "--jit exige uma build com -DSAPPHIRE_JIT=ON (x86-64, Linux, NaN-boxing)." << std::endl;
+                return 64;
+            }
+            use_jit = true;
+        } else if (option == "--op-pairs" || option.rfind("--op-pairs=", 0) == 0) {
+#ifdef PROFILE_OPCODES
+            op_pairs_limit = option.size() > 11 ? std::stoul(option.substr(11)) : 30;
+#else
+            std::cerr << "--op-pairs exige uma build com -DSAPPHIRE_OPCODE_PROFILE=ON." << std::endl;
+            return 64;
+#endif
+        } else if (option == "--compile" && arg + 1 < argc) {
+            compile_output = argv[++arg];
+        } else if (option == "--lex-only") {
+            lex_only = true;
+        } else {
+            std::cerr << "Opcao desconhecida: " << option << std::endl;
+            return 64;
+        }
+    }
+
+    if (use_jit && register_backend) {
+        std::cerr << "--jit so funciona com o backend de pilha (--vm=stack)." << std::endl;
+        return 64;
+    }
+    vm.set_jit(use_jit);
+    configure_gc(gc_config);
+
+    if (lex_only) {
+        if (arg != argc - 1) {
+            std::cerr << "Uso: sapphire --lex-only caminho_do_script" << std::endl;
+            return 64;
+        }
+        return lex_file(argv[arg]);
+    }
+
+    if (!compile_output.empty()) {
+        if (arg != argc - 1) {
+            std::cerr << "Uso: sapphire --compile saida.spc|saida.spi caminho_do_script" << std::endl;
+            return 64;
+        }
+        return compile_file(compile_output, argv[arg]);
+    }
+
+    if (arg == argc) {
         repl();
-    } else if (argc == 2) {
-        run_file(argv[1]);
+    } else if (arg == argc - 1) {
+        run_file(argv[arg]);
     } else {
-        std::cerr << "Uso: sapphire [caminho_do_script]" << std::endl;
+        std::cerr << "Uso: sapphire [--gc-stats] [--gc-generational] [--gc-incremental] [--gc-slice=N] [--gc-nursery=KB] [--ic-stats] [--cache] [--no-cache] [--no-peephole] [--no-tiering] [--vm=stack|register] [--jit] [--op-pairs[=N]] [--compile saida.spc|saida.spi] [--lex-only] [caminho_do_script | arquivo.spc | arquivo.spi]" << std::endl;
         return 64; // Código de erro para uso incorreto
     }
 
+    if (show_gc_stats) {
+        print_gc_stats();
+    }
+#ifdef PROFILE_OPCODES
+    if (op_pairs_limit > 0) print_opcode_pairs(op_pairs_limit);
+#endif
+
     return 0;
-}
\ No newline at end of file
+}
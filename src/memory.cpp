@@ -0,0 +1,638 @@
+#include "memory.h"
+#include "object.h"
+#include "compiler.h"
+#include "vm.h"
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <new>
+#include <unordered_map>
+#include <vector>
+
+#define GC_HEAP_GROW_FACTOR 2
+#ifndef GC_INITIAL_THRESHOLD
+#define GC_INITIAL_THRESHOLD (1024 * 1024)
+#endif
+
+bool gc_barrier_active = false;
+
+// Chave da tabela de strings internadas: o conteúdo e o hash já calculado,
+// para que a busca não precise calcular o hash de novo.
+struct InternKey {
+    std::string_view chars;
+    uint32_t hash;
+    bool operator==(const InternKey& other) const { return hash == other.hash && chars == other.chars; }
+};
+
+struct InternKeyHash {
+    size_t operator()(const InternKey& key) const { return key.hash; }
+};
+
+enum GCPhase {
+    GC_IDLE,
+    GC_MARKING,  // Marcação incremental em andamento
+    GC_SWEEPING, // Varredura incremental em andamento
+};
+
+// Estado global do coletor. Fica dentro de uma função para não depender da
+// ordem de inicialização de estáticos: a VM global de main.cpp já aloca
+// objetos no seu construtor.
+struct Heap {
+    Obj* objects = nullptr;          // Lista intrusiva da geração antiga
+    std::vector<Obj*> gray_stack;    // Objetos marcados (cinza) cujos filhos ainda não foram visitados
+    std::vector<Obj*> temp_roots;
+    VM* vm = nullptr;
+    GCConfig config;
+    GCStats stats;
+    GCPhase phase = GC_IDLE;
+
+    // Varredura incremental: a lista antiga é separada no início da varredura
+    // e os sobreviventes voltam para 'objects' um a um.
+    Obj* sweep_cursor = nullptr;
+
+    // Berçário: região contígua com alocação por incremento de ponteiro.
+    char* nursery = nullptr;
+    size_t nursery_top = 0;
+    std::vector<Obj*> remembered_set; // Objetos antigos que podem apontar para o berçário
+    std::vector<Obj*> promoted;       // Fila de objetos recém-promovidos a escanear
+    bool globals_dirty = false;       // As globais podem apontar para o berçário
+
+    std::vector<double> pauses;       // Duração de cada pausa, em ms
+
+    // As chaves apontam para o 'chars' da própria string internada.
+    std::unordered_map<InternKey, ObjString*, InternKeyHash> strings;
+
+    Heap() { stats.next_gc = GC_INITIAL_THRESHOLD; }
+};
+
+static Heap& heap() {
+    static Heap instance;
+    return instance;
+}
+
+static void update_barrier_state() {
+    Heap& h = heap();
+    gc_barrier_active = h.config.generational || h.phase == GC_MARKING;
+}
+
+static void record_pause(std::chrono::steady_clock::time_point start) {
+    Heap& h = heap();
+    std::chrono::duration<double, std::milli> pause = std::chrono::steady_clock::now() - start;
+    h.pauses.push_back(pause.count());
+    h.stats.last_pause_ms = pause.count();
+    h.stats.total_pause_ms += pause.count();
+    if (pause.count() > h.stats.max_pause_ms) h.stats.max_pause_ms = pause.count();
+}
+
+// Tamanho que contabilizamos para um objeto. Deve ser o mesmo na alocação
+// e na liberação para que os totais batam.
+static size_t object_size(Obj* object) {
+    switch (object->type) {
+        case OBJ_STRING:       return sizeof(ObjString) + static_cast<ObjString*>(object)->chars.size();
+        case OBJ_ARRAY: {
+            ObjArray* array = static_cast<ObjArray*>(object);
+            return sizeof(ObjArray) + array->capacity * array_element_size(array->kind);
+        }
+        case OBJ_CLASS:        return sizeof(ObjClass);
+        case OBJ_INSTANCE:     return sizeof(ObjInstance) + static_cast<ObjInstance*>(object)->fields.capacity() * sizeof(SapphireValue);
+        case OBJ_CLOSURE:      return sizeof(ObjClosure);
+        case OBJ_FUNCTION:     return sizeof(ObjFunction);
+        case OBJ_BOUND_METHOD: return sizeof(ObjBoundMethod);
+        case OBJ_NATIVE:       return sizeof(ObjNative);
+    }
+    return sizeof(Obj);
+}
+
+// Espaço ocupado por um objeto dentro do berçário (só os tipos que vão para lá).
+static size_t nursery_slot_size(size_t size) {
+    const size_t align = alignof(std::max_align_t);
+    return (size + align - 1) & ~(align - 1);
+}
+
+static size_t nursery_object_size(Obj* object) {
+    switch (object->type) {
+        case OBJ_STRING:       return nursery_slot_size(sizeof(ObjString));
+        case OBJ_BOUND_METHOD: return nursery_slot_size(sizeof(ObjBoundMethod));
+        default:               return nursery_slot_size(sizeof(Obj));
+    }
+}
+
+void configure_gc(const GCConfig& config) {
+    Heap& h = heap();
+    h.config = config;
+    if (h.config.slice_budget == 0) h.config.slice_budget = 1;
+    delete[] h.nursery;
+    h.nursery = nullptr;
+    h.nursery_top = 0;
+    if (h.config.generational) {
+        h.nursery = new char[h.config.nursery_size];
+    }
+    update_barrier_state();
+}
+
+void set_gc_vm(VM* vm) {
+    heap().vm = vm;
+}
+
+void track_allocation(size_t bytes) {
+    Heap& h = heap();
+    h.stats.bytes_allocated += bytes;
+    h.stats.total_allocated += bytes;
+}
+
+// Coloca um objeto na lista da geração antiga. Durante uma marcação
+// incremental ele nasce cinza, para que seus filhos também sejam visitados.
+static void link_object(Obj* object) {
+    Heap& h = heap();
+    object->next = h.objects;
+    h.objects = object;
+    if (h.phase == GC_MARKING) mark_object(object);
+}
+
+void register_object(Obj* object) {
+    link_object(object);
+    track_allocation(object_size(object));
+}
+
+// --- Strings internadas ---
+
+ObjString* find_interned_string(std::string_view chars, uint32_t hash) {
+    Heap& h = heap();
+    auto it = h.strings.find(InternKey{chars, hash});
+    if (it == h.strings.end()) return nullptr;
+    // A string pode estar branca no meio de uma marcação incremental: quem a
+    // recebe agora vai guardá-la, então ela precisa sobreviver a este ciclo.
+    if (h.phase == GC_MARKING) mark_object(it->second);
+    return it->second;
+}
+
+void intern_string(ObjString* string) {
+    heap().strings[InternKey{string->chars, string->hash}] = string;
+}
+
+// Remove da tabela as strings que não foram marcadas, antes que a varredura
+// as libere.
+static void remove_white_strings() {
+    Heap& h = heap();
+    for (auto it = h.strings.begin(); it != h.strings.end();) {
+        if (!it->second->is_marked) it = h.strings.erase(it);
+        else ++it;
+    }
+}
+
+void push_temp_root(Obj* object) {
+    heap().temp_roots.push_back(object);
+}
+
+void pop_temp_root() {
+    heap().temp_roots.pop_back();
+}
+
+// --- Marcação (tri-color) ---
+// Branco: is_marked == false. Cinza: marcado e ainda na gray_stack.
+// Preto: marcado e já removido da gray_stack (filhos visitados).
+// Objetos do berçário nunca entram na gray_stack: eles são tratados pela
+// coleta do berçário, que roda antes do fim de toda marcação.
+
+void mark_object(Obj* object) {
+    if (object == nullptr || object->is_marked || object->is_young) return;
+#ifdef DEBUG_LOG_GC
+    std::cout << (void*)object << " mark ";
+    print_value(object);
+    std::cout << std::endl;
+#endif
+    object->is_marked = true;
+    heap().gray_stack.push_back(object);
+}
+
+void mark_value(const SapphireValue& value) {
+    if (value.is_obj()) mark_object(value.as_obj());
+}
+
+// Os nomes de campo ficam nas formas da classe, não nas instâncias.
+static void mark_shape(const Shape& shape) {
+    for (auto& entry : shape.transitions) {
+        mark_object(entry.first);
+        mark_shape(*entry.second);
+    }
+}
+
+static void blacken_object(Obj* object) {
+    switch (object->type) {
+        case OBJ_CLASS: {
+            ObjClass* klass = static_cast<ObjClass*>(object);
+            mark_object(klass->name);
+            for (auto& entry : klass->methods) {
+                mark_object(entry.first);
+                mark_object(entry.second);
+            }
+            mark_shape(klass->root_shape);
+            break;
+        }
+        case OBJ_INSTANCE: {
+            ObjInstance* instance = static_cast<ObjInstance*>(object);
+            mark_object(instance->klass);
+            for (const SapphireValue& field : instance->fields) mark_value(field);
+            break;
+        }
+        case OBJ_CLOSURE:
+            mark_object(static_cast<ObjClosure*>(object)->function);
+            break;
+        case OBJ_FUNCTION: {
+            ObjFunction* function = static_cast<ObjFunction*>(object);
+            mark_object(function->name);
+            for (const SapphireValue& constant : function->chunk.constants) mark_value(constant);
+            // As formas guardadas nos inline caches pertencem a classes que
+            // precisam continuar vivas enquanto o cache apontar para elas.
+            for (const InlineCache& cache : function->chunk.caches) {
+                for (int i = 0; i < cache.count; i++) mark_object(cache.entries[i].shape->klass);
+            }
+            break;
+        }
+        case OBJ_BOUND_METHOD: {
+            ObjBoundMethod* bound = static_cast<ObjBoundMethod*>(object);
+            mark_value(bound->receiver);
+            mark_object(bound->method);
+            break;
+        }
+        case OBJ_ARRAY: {
+            // Arrays empacotados não guardam referências; uma fatia só a da base.
+            ObjArray* array = static_cast<ObjArray*>(object);
+            if (array->kind == ARRAY_VALUE) {
+                for (uint32_t i = 0; i < array->count; i++) mark_value(array->values()[i]);
+            } else if (array->kind == ARRAY_VIEW) {
+                mark_object(array->base);
+            }
+            break;
+        }
+        case OBJ_NATIVE:
+        case OBJ_STRING:
+            break;
+    }
+}
+
+// Marca as raízes. As globais ficam de fora no "remark" do modo incremental,
+// porque toda escrita nelas passa pela barreira global_write_barrier.
+static void mark_roots(bool include_globals) {
+    Heap& h = heap();
+    if (h.vm != nullptr) h.vm->mark_roots(include_globals);
+    mark_compiler_roots();
+    for (Obj* object : h.temp_roots) mark_object(object);
+}
+
+// Processa até 'budget' objetos cinzas. Retorna true se a pilha esvaziou.
+static bool trace_references(size_t budget) {
+    Heap& h = heap();
+    while (!h.gray_stack.empty() && budget-- > 0) {
+        Obj* object = h.gray_stack.back();
+        h.gray_stack.pop_back();
+        blacken_object(object);
+    }
+    return h.gray_stack.empty();
+}
+
+static void destroy_object(Obj* object) {
+    switch (object->type) {
+        case OBJ_CLASS:        static_cast<ObjClass*>(object)->~ObjClass(); break;
+        case OBJ_INSTANCE:     static_cast<ObjInstance*>(object)->~ObjInstance(); break;
+        case OBJ_CLOSURE:      static_cast<ObjClosure*>(object)->~ObjClosure(); break;
+        case OBJ_FUNCTION:     static_cast<ObjFunction*>(object)->~ObjFunction(); break;
+        case OBJ_BOUND_METHOD: static_cast<ObjBoundMethod*>(object)->~ObjBoundMethod(); break;
+        case OBJ_NATIVE:       static_cast<ObjNative*>(object)->~ObjNative(); break;
+        case OBJ_STRING:       static_cast<ObjString*>(object)->~ObjString(); break;
+        case OBJ_ARRAY:        static_cast<ObjArray*>(object)->~ObjArray(); break;
+    }
+}
+
+static void free_object(Obj* object) {
+    switch (object->type) {
+        case OBJ_CLASS:        delete static_cast<ObjClass*>(object); break;
+        case OBJ_INSTANCE:     delete static_cast<ObjInstance*>(object); break;
+        case OBJ_CLOSURE:      delete static_cast<ObjClosure*>(object); break;
+        case OBJ_FUNCTION:     delete static_cast<ObjFunction*>(object); break;
+        case OBJ_BOUND_METHOD: delete static_cast<ObjBoundMethod*>(object); break;
+        case OBJ_NATIVE:       delete static_cast<ObjNative*>(object); break;
+        case OBJ_STRING:       delete static_cast<ObjString*>(object); break;
+        case OBJ_ARRAY:        delete static_cast<ObjArray*>(object); break;
+    }
+}
+
+// --- Berçário (geração jovem) ---
+
+// Copia um objeto jovem para a geração antiga e deixa um ponteiro de
+// redirecionamento no lugar (is_marked + next, que não são usados no berçário).
+static Obj* promote(Obj* young) {
+    Heap& h = heap();
+    if (young->is_marked) return young->next;
+
+    Obj* copy = nullptr;
+    switch (young->type) {
+        case OBJ_STRING: {
+            auto* string_obj = new ObjString();
+            string_obj->chars = std::move(static_cast<ObjString*>(young)->chars);
+            string_obj->hash = static_cast<ObjString*>(young)->hash;
+            copy = string_obj;
+            break;
+        }
+        case OBJ_BOUND_METHOD: {
+            auto* bound = new ObjBoundMethod();
+            bound->receiver = static_cast<ObjBoundMethod*>(young)->receiver;
+            bound->method = static_cast<ObjBoundMethod*>(young)->method;
+            copy = bound;
+            break;
+        }
+        default:
+            return young; // Só strings e bound methods nascem no berçário.
+    }
+    copy->type = young->type;
+
+    size_t size = object_size(copy);
+    link_object(copy);
+    h.stats.bytes_allocated += size;
+    h.stats.promoted_bytes += size;
+
+    young->is_marked = true;
+    young->next = copy;
+    h.promoted.push_back(copy);
+    return copy;
+}
+
+void forward_value(SapphireValue& value) {
+    if (value.is_obj() && value.as_obj()->is_young) {
+        value = promote(value.as_obj());
+    }
+}
+
+// Atualiza as referências de um objeto antigo que possam apontar para o berçário.
+static void forward_children(Obj* object) {
+    switch (object->type) {
+        case OBJ_INSTANCE:
+            for (SapphireValue& field : static_cast<ObjInstance*>(object)->fields) forward_value(field);
+            break;
+        case OBJ_ARRAY: {
+            ObjArray* array = static_cast<ObjArray*>(object);
+            if (array->kind == ARRAY_VALUE) {
+                for (uint32_t i = 0; i < array->count; i++) forward_value(array->values()[i]);
+            }
+            break;
+        }
+        case OBJ_BOUND_METHOD:
+            forward_value(static_cast<ObjBoundMethod*>(object)->receiver);
+            break;
+        default:
+            break;
+    }
+}
+
+// Coleta do berçário: promove tudo que é alcançável a partir das raízes e do
+// remembered set, e então descarta o berçário inteiro de uma vez.
+static void collect_nursery() {
+    Heap& h = heap();
+    if (h.nursery == nullptr || h.nursery_top == 0) return;
+
+    if (h.vm != nullptr) h.vm->forward_roots(h.globals_dirty);
+    h.globals_dirty = false;
+    for (Obj*& object : h.temp_roots) {
+        if (object->is_young) object = promote(object);
+    }
+
+    for (Obj* object : h.remembered_set) {
+        object->is_remembered = false;
+        forward_children(object);
+    }
+    h.remembered_set.clear();
+
+    // Objetos promovidos podem apontar para outros objetos jovens.
+    while (!h.promoted.empty()) {
+        Obj* object = h.promoted.back();
+        h.promoted.pop_back();
+        forward_children(object);
+    }
+
+    // Todo o resto do berçário é lixo (ou já foi copiado): roda os destrutores
+    // e reinicia o ponteiro de alocação.
+    size_t offset = 0;
+    while (offset < h.nursery_top) {
+        Obj* object = reinterpret_cast<Obj*>(h.nursery + offset);
+        offset += nursery_object_size(object);
+        destroy_object(object);
+    }
+    h.nursery_top = 0;
+    h.stats.minor_collections++;
+}
+
+void* nursery_allocate(size_t size) {
+    Heap& h = heap();
+    if (h.nursery == nullptr) return nullptr;
+
+    size_t slot = nursery_slot_size(size);
+    if (slot > h.config.nursery_size) return nullptr;
+
+#ifdef DEBUG_STRESS_GC
+    bool must_collect = true;
+#else
+    bool must_collect = h.nursery_top + slot > h.config.nursery_size;
+#endif
+    if (must_collect) {
+        auto start = std::chrono::steady_clock::now();
+        collect_nursery();
+        record_pause(start);
+    }
+
+    void* memory = h.nursery + h.nursery_top;
+    h.nursery_top += slot;
+    h.stats.total_allocated += slot;
+    return memory;
+}
+
+// --- Barreiras de escrita ---
+
+void gc_record_write(Obj* owner, Obj* target) {
+    Heap& h = heap();
+    if (target->is_young && !owner->is_young && !owner->is_remembered) {
+        owner->is_remembered = true;
+        h.remembered_set.push_back(owner);
+    }
+    // Barreira de inserção (Dijkstra): durante a marcação incremental, nada
+    // que é guardado em um objeto possivelmente preto pode continuar branco.
+    if (h.phase == GC_MARKING) mark_object(target);
+}
+
+void gc_record_global_write(Obj* target) {
+    Heap& h = heap();
+    if (target->is_young) h.globals_dirty = true;
+    if (h.phase == GC_MARKING) mark_object(target);
+}
+
+// --- Geração antiga ---
+
+// Separa a lista antiga para varredura. Objetos alocados (ou promovidos)
+// durante a varredura entram na nova lista e não são visitados neste ciclo.
+static void begin_sweep() {
+    Heap& h = heap();
+    h.sweep_cursor = h.objects;
+    h.objects = nullptr;
+    h.phase = GC_SWEEPING;
+    update_barrier_state();
+}
+
+// Varre até 'budget' objetos. Retorna true quando a lista acabou.
+static bool sweep(size_t budget) {
+    Heap& h = heap();
+    while (h.sweep_cursor != nullptr && budget-- > 0) {
+        Obj* object = h.sweep_cursor;
+        h.sweep_cursor = object->next;
+
+        if (object->is_marked) {
+            object->is_marked = false;
+            object->next = h.objects;
+            h.objects = object;
+            continue;
+        }
+
+        size_t size = object_size(object);
+        h.stats.bytes_allocated -= size;
+        h.stats.total_freed += size;
+        h.stats.objects_freed++;
+        free_object(object);
+    }
+    return h.sweep_cursor == nullptr;
+}
+
+static void finish_cycle() {
+    Heap& h = heap();
+    h.phase = GC_IDLE;
+    update_barrier_state();
+
+    size_t grown = h.stats.bytes_allocated * GC_HEAP_GROW_FACTOR;
+    h.stats.next_gc = grown > GC_INITIAL_THRESHOLD ? grown : GC_INITIAL_THRESHOLD;
+    h.stats.collections++;
+}
+
+static void begin_marking() {
+    Heap& h = heap();
+    h.phase = GC_MARKING;
+    update_barrier_state();
+    mark_roots(true);
+}
+
+// Fim da marcação: esvazia o berçário (os sobreviventes nascem cinzas na
+// geração antiga), remarca as raízes que não têm barreira e termina de traçar.
+static void remark() {
+    collect_nursery();
+    mark_roots(false);
+    trace_references(SIZE_MAX);
+    remove_white_strings();
+    begin_sweep();
+}
+
+// Uma fatia de trabalho incremental, com orçamento limitado.
+static void gc_step() {
+    Heap& h = heap();
+    auto start = std::chrono::steady_clock::now();
+    if (h.phase == GC_MARKING) {
+        if (trace_references(h.config.slice_budget)) remark();
+    } else if (h.phase == GC_SWEEPING) {
+        if (sweep(h.config.slice_budget)) finish_cycle();
+    }
+    h.stats.incremental_slices++;
+    record_pause(start);
+}
+
+void gc_before_allocation(size_t size) {
+    Heap& h = heap();
+#ifdef DEBUG_STRESS_GC
+    collect_garbage();
+#else
+    if (h.config.incremental) {
+        if (h.phase != GC_IDLE) {
+            gc_step();
+        } else if (h.stats.bytes_allocated + size > h.stats.next_gc) {
+            auto start = std::chrono::steady_clock::now();
+            begin_marking();
+            record_pause(start);
+        }
+    } else if (h.stats.bytes_allocated + size > h.stats.next_gc) {
+        collect_garbage();
+    }
+#endif
+}
+
+// Coleta completa e atômica: termina qualquer ciclo incremental em andamento.
+void collect_garbage() {
+    Heap& h = heap();
+    auto start = std::chrono::steady_clock::now();
+#ifdef DEBUG_LOG_GC
+    std::cout << "-- gc begin" << std::endl;
+    size_t before = h.stats.bytes_allocated;
+#endif
+
+    if (h.phase == GC_IDLE) begin_marking();
+    if (h.phase == GC_MARKING) remark();
+    sweep(SIZE_MAX);
+    finish_cycle();
+
+    record_pause(start);
+
+#ifdef DEBUG_LOG_GC
+    std::cout << "-- gc end" << std::endl;
+    std::cout << "   collected " << before - h.stats.bytes_allocated << " bytes (from " << before
+              << " to " << h.stats.bytes_allocated << ") next at " << h.stats.next_gc << std::endl;
+#endif
+}
+
+void free_objects() {
+    Heap& h = heap();
+    size_t offset = 0;
+    while (offset < h.nursery_top) {
+        Obj* object = reinterpret_cast<Obj*>(h.nursery + offset);
+        offset += nursery_object_size(object);
+        destroy_object(object);
+    }
+    h.nursery_top = 0;
+
+    for (Obj* list : {h.objects, h.sweep_cursor}) {
+        Obj* object = list;
+        while (object != nullptr) {
+            Obj* next = object->next;
+            free_object(object);
+            object = next;
+        }
+    }
+    h.objects = nullptr;
+    h.sweep_cursor = nullptr;
+    h.strings.clear();
+    h.gray_stack.clear();
+    h.remembered_set.clear();
+    h.phase = GC_IDLE;
+    h.stats.bytes_allocated = 0;
+    update_barrier_state();
+}
+
+const GCStats& gc_stats() {
+    return heap().stats;
+}
+
+double gc_pause_percentile(double percentile) {
+    std::vector<double> pauses = heap().pauses;
+    if (pauses.empty()) return 0;
+    size_t index = (size_t)(percentile / 100.0 * (pauses.size() - 1) + 0.5);
+    if (index >= pauses.size()) index = pauses.size() - 1;
+    std::nth_element(pauses.begin(), pauses.begin() + index, pauses.end());
+    return pauses[index];
+}
+
+void print_gc_stats() {
+    const GCStats& stats = heap().stats;
+    std::cerr << "[gc] collections: " << stats.collections
+              << ", minor: " << stats.minor_collections
+              << ", incremental slices: " << stats.incremental_slices << std::endl;
+    std::cerr << "[gc] allocated: " << stats.total_allocated << " bytes"
+              << ", freed: " << stats.total_freed << " bytes (" << stats.objects_freed << " objects)"
+              << ", promoted: " << stats.promoted_bytes << " bytes"
+              << ", live: " << stats.bytes_allocated << " bytes" << std::endl;
+    std::cerr << "[gc] pause total: " << stats.total_pause_ms << " ms"
+              << ", p50: " << gc_pause_percentile(50) << " ms"
+              << ", p99: " << gc_pause_percentile(99) << " ms"
+              << ", max: " << stats.max_pause_ms << " ms" << std::endl;
+}
@@ -0,0 +1,96 @@
+#ifndef SAPPHIRE_MEMORY_H
+#define SAPPHIRE_MEMORY_H
+
+#include "value.h"
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+struct Obj;
+struct ObjString;
+class VM;
+
+// Configuração do coletor. Por padrão ele é um mark-and-sweep "stop-the-world";
+// os modos abaixo podem ser ligados independentemente (ver main.cpp).
+struct GCConfig {
+    // Berçário com alocação por incremento de ponteiro para temporários de
+    // vida curta (strings de OP_ADD, bound methods de OP_GET_PROPERTY).
+    bool generational = false;
+    // Marcação e varredura da geração antiga em fatias limitadas.
+    bool incremental = false;
+    size_t nursery_size = 256 * 1024;
+    // Quantos objetos cada fatia incremental pode marcar ou varrer.
+    size_t slice_budget = 256;
+};
+
+// Estatísticas do coletor de lixo, expostas pela VM para ajuste sob carga.
+struct GCStats {
+    size_t bytes_allocated = 0; // Bytes vivos na geração antiga neste momento
+    size_t next_gc = 0;         // Limiar que dispara a próxima coleta
+    size_t total_allocated = 0; // Total de bytes alocados desde o início (incluindo o berçário)
+    size_t total_freed = 0;     // Total de bytes liberados pelo coletor
+    size_t objects_freed = 0;
+    size_t collections = 0;     // Ciclos completos da geração antiga
+    size_t minor_collections = 0;
+    size_t promoted_bytes = 0;  // Bytes copiados do berçário para a geração antiga
+    size_t incremental_slices = 0;
+    double last_pause_ms = 0;
+    double max_pause_ms = 0;
+    double total_pause_ms = 0;
+};
+
+void configure_gc(const GCConfig& config);
+
+// A VM cujas raízes (pilha, frames, globais) são marcadas em cada coleta.
+void set_gc_vm(VM* vm);
+
+// Chamadas pelas funções "fábrica" de object.cpp.
+void gc_before_allocation(size_t size);
+void register_object(Obj* object);
+// Reserva espaço no berçário. Retorna nullptr se o modo geracional estiver
+// desligado ou se o objeto não couber; nesse caso ele vai para o heap normal.
+void* nursery_allocate(size_t size);
+// Informa crescimento de buffers internos de um objeto já registrado.
+void track_allocation(size_t bytes);
+
+// Tabela de strings internadas. Ela é fraca: não mantém as strings vivas, e
+// as que não forem marcadas saem da tabela antes da varredura.
+ObjString* find_interned_string(std::string_view chars, uint32_t hash);
+void intern_string(ObjString* string);
+
+// Raízes temporárias para objetos recém-criados que ainda não estão
+// alcançáveis (ex: uma string usada como argumento de outra alocação).
+void push_temp_root(Obj* object);
+void pop_temp_root();
+
+void mark_object(Obj* object);
+void mark_value(const SapphireValue& value);
+// Usada pela coleta do berçário: troca uma referência a um objeto jovem
+// pela sua cópia promovida.
+void forward_value(SapphireValue& value);
+
+// --- Barreiras de escrita ---
+// Ligadas enquanto houver berçário ou uma marcação incremental em andamento.
+extern bool gc_barrier_active;
+void gc_record_write(Obj* owner, Obj* target);
+void gc_record_global_write(Obj* target);
+
+// Deve ser chamada sempre que 'value' for guardado dentro de 'owner'
+// (campo de instância, elemento de array).
+static inline void write_barrier(Obj* owner, const SapphireValue& value) {
+    if (gc_barrier_active && value.is_obj()) gc_record_write(owner, value.as_obj());
+}
+
+// Idem, para escritas na tabela de globais da VM.
+static inline void global_write_barrier(const SapphireValue& value) {
+    if (gc_barrier_active && value.is_obj()) gc_record_global_write(value.as_obj());
+}
+
+void collect_garbage();
+void free_objects();
+const GCStats& gc_stats();
+// Percentil (0-100) das pausas registradas, em milissegundos.
+double gc_pause_percentile(double percentile);
+void print_gc_stats();
+
+#endif //SAPPHIRE_MEMORY_H
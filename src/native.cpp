@@ -0,0 +1,435 @@
+#include "native.h"
+#include "memory.h"
+#include "simd.h"
+#include "value.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// --- Time ---
+
+static const auto clock_start_time = std::chrono::high_resolution_clock::now();
+
+bool native_clock(NativeCall& call) {
+    auto now = std::chrono::high_resolution_clock::now();
+    std::chrono::duration<double> diff = now - clock_start_time;
+    call.result = diff.count();
+    return true;
+}
+
+// Segundos desde a época Unix, com fração.
+static bool time_now(NativeCall& call) {
+    std::chrono::duration<double> since_epoch = std::chrono::system_clock::now().time_since_epoch();
+    call.result = since_epoch.count();
+    return true;
+}
+
+// --- Math ---
+// A aridade já foi conferida (pelo compilador, ou pela VM numa chamada
+// dinâmica), então os argumentos podem ser lidos direto.
+
+#define MATH_UNARY(name, expression) \
+    static bool math_##name(NativeCall& call) { \
+        if (!call.args[0].is_number()) return native_error(call, "Argument for " #name "() must be a number."); \
+        double x = call.args[0].as_number(); \
+        call.result = (expression); \
+        return true; \
+    }
+
+#define MATH_BINARY(name, expression) \
+    static bool math_##name(NativeCall& call) { \
+        if (!call.args[0].is_number() || !call.args[1].is_number()) { \
+            return native_error(call, "Arguments for " #name "() must be numbers."); \
+        } \
+        double a = call.args[0].as_number(); \
+        double b = call.args[1].as_number(); \
+        call.result = (expression); \
+        return true; \
+    }
+
+MATH_UNARY(sqrt, std::sqrt(x))
+MATH_UNARY(abs, std::fabs(x))
+MATH_UNARY(floor, std::floor(x))
+MATH_UNARY(ceil, std::ceil(x))
+MATH_UNARY(round, std::round(x))
+MATH_UNARY(sin, std::sin(x))
+MATH_UNARY(cos, std::cos(x))
+MATH_UNARY(log, std::log(x))
+MATH_BINARY(pow, std::pow(a, b))
+MATH_BINARY(min, a < b ? a : b)
+MATH_BINARY(max, a > b ? a : b)
+
+#undef MATH_UNARY
+#undef MATH_BINARY
+
+// --- IO ---
+
+static bool io_read_line(NativeCall& call) {
+    std::string line;
+    std::getline(std::cin, line);
+    call.result = new_string(line);
+    return true;
+}
+
+// Como 'print', mas sem a quebra de linha.
+static bool io_write(NativeCall& call) {
+    print_value(call.args[0]);
+    return true;
+}
+
+// --- String ---
+// Os resultados novos são strings temporárias, como as da concatenação.
+
+static bool string_length(NativeCall& call) {
+    if (!is_obj_type(call.args[0], OBJ_STRING)) return native_error(call, "Argument for String.length() must be a string.");
+    call.result = (double)static_cast<ObjString*>(call.args[0].as_obj())->chars.size();
+    return true;
+}
+
+static bool string_upper(NativeCall& call) {
+    if (!is_obj_type(call.args[0], OBJ_STRING)) return native_error(call, "Argument for String.upper() must be a string.");
+    std::string chars = static_cast<ObjString*>(call.args[0].as_obj())->chars;
+    for (char& c : chars) {
+        if (c >= 'a' && c <= 'z') c = (char)(c - 'a' + 'A');
+    }
+    call.result = new_temp_string(chars);
+    return true;
+}
+
+static bool string_lower(NativeCall& call) {
+    if (!is_obj_type(call.args[0], OBJ_STRING)) return native_error(call, "Argument for String.lower() must be a string.");
+    std::string chars = static_cast<ObjString*>(call.args[0].as_obj())->chars;
+    for (char& c : chars) {
+        if (c >= 'A' && c <= 'Z') c = (char)(c - 'A' + 'a');
+    }
+    call.result = new_temp_string(chars);
+    return true;
+}
+
+// --- Array ---
+
+// O array que guarda os elementos de 'array' e onde eles começam nele: o
+// próprio array, ou a base de uma fatia.
+static ObjArray* array_storage(ObjArray* array, uint32_t& offset, uint32_t& count) {
+    count = array_length(array);
+    if (array->kind != ARRAY_VIEW) {
+        offset = 0;
+        return array;
+    }
+    offset = array->offset;
+    return array->base;
+}
+
+// Um índice inteiro de 0 a 'limit' (inclusive).
+static bool array_position(const SapphireValue& value, uint32_t limit, uint32_t& position) {
+    if (!value.is_number()) return false;
+    double number = value.as_number();
+    if (!(number >= 0 && number <= limit)) return false;
+    position = static_cast<uint32_t>(number);
+    return true;
+}
+
+static bool array_length(NativeCall& call) {
+    if (!is_obj_type(call.args[0], OBJ_ARRAY)) return native_error(call, "Argument for Array.length() must be an array.");
+    call.result = (double)array_length(static_cast<ObjArray*>(call.args[0].as_obj()));
+    return true;
+}
+
+// --- Array: crescimento e fatias ---
+// push/pop/insert custam O(1) amortizado no fim do array: o buffer dobra
+// quando enche (ver array_push). Fatias não mudam de tamanho.
+
+static bool array_push(NativeCall& call) {
+    if (!is_obj_type(call.args[0], OBJ_ARRAY)) return native_error(call, "First argument for Array.push() must be an array.");
+    ObjArray* array = static_cast<ObjArray*>(call.args[0].as_obj());
+    if (array->kind == ARRAY_VIEW) return native_error(call, "Array.push() cannot change the length of a slice.");
+    if (array->count == UINT32_MAX) return native_error(call, "Array.push() on a full array.");
+    array_push(array, call.args[1]);
+    call.result = (double)array->count;
+    return true;
+}
+
+static bool array_pop(NativeCall& call) {
+    if (!is_obj_type(call.args[0], OBJ_ARRAY)) return native_error(call, "Argument for Array.pop() must be an array.");
+    ObjArray* array = static_cast<ObjArray*>(call.args[0].as_obj());
+    if (array->kind == ARRAY_VIEW) return native_error(call, "Array.pop() cannot change the length of a slice.");
+    if (array->count == 0) return native_error(call, "Array.pop() of an empty array.");
+    call.result = array_pop(array);
+    return true;
+}
+
+// Array.insert(a, i, valor): 0 <= i <= length(a); retorna o novo tamanho.
+static bool array_insert(NativeCall& call) {
+    if (!is_obj_type(call.args[0], OBJ_ARRAY)) return native_error(call, "First argument for Array.insert() must be an array.");
+    ObjArray* array = static_cast<ObjArray*>(call.args[0].as_obj());
+    if (array->kind == ARRAY_VIEW) return native_error(call, "Array.insert() cannot change the length of a slice.");
+    if (array->count == UINT32_MAX) return native_error(call, "Array.insert() on a full array.");
+    uint32_t index;
+    if (!array_position(call.args[1], array->count, index)) return native_error(call, "Array.insert() index out of bounds.");
+    array_insert(array, index, call.args[2]);
+    call.result = (double)array->count;
+    return true;
+}
+
+// Maior capacidade que um script pode pedir de uma vez (2 GB em double[]).
+#define ARRAY_MAX_RESERVE (1u << 28)
+
+// Array.reserve(a, n): espaço para n elementos sem realocar; retorna o próprio array.
+// O tamanho vem do script, então falta de memória vira erro de runtime.
+static bool array_reserve(NativeCall& call) {
+    if (!is_obj_type(call.args[0], OBJ_ARRAY)) return native_error(call, "First argument for Array.reserve() must be an array.");
+    ObjArray* array = static_cast<ObjArray*>(call.args[0].as_obj());
+    if (array->kind == ARRAY_VIEW) return native_error(call, "Array.reserve() cannot change the length of a slice.");
+    uint32_t capacity;
+    if (!array_position(call.args[1], UINT32_MAX, capacity)) return native_error(call, "Second argument for Array.reserve() must be a non-negative number.");
+    if (capacity > ARRAY_MAX_RESERVE) return native_error(call, "Array.reserve() capacity is too large.");
+    if (!array_try_reserve(array, capacity)) return native_error(call, "Array.reserve() could not allocate memory for the array.");
+    call.result = call.args[0];
+    return true;
+}
+
+static bool array_capacity(NativeCall& call) {
+    if (!is_obj_type(call.args[0], OBJ_ARRAY)) return native_error(call, "Argument for Array.capacity() must be an array.");
+    ObjArray* array = static_cast<ObjArray*>(call.args[0].as_obj());
+    call.result = (double)(array->kind == ARRAY_VIEW ? array_length(array) : array->capacity);
+    return true;
+}
+
+// Array.slice(a, inicio, fim): os elementos [inicio, fim) sem cópia. A fatia
+// lê e escreve no array original, e acompanha o buffer dele mesmo depois de
+// um push que realoca; se o original encolher, ela perde o que sumiu.
+static bool array_slice(NativeCall& call) {
+    if (!is_obj_type(call.args[0], OBJ_ARRAY)) return native_error(call, "First argument for Array.slice() must be an array.");
+    ObjArray* array = static_cast<ObjArray*>(call.args[0].as_obj());
+    uint32_t length = array_length(array);
+    uint32_t start, end;
+    if (!array_position(call.args[1], length, start) || !array_position(call.args[2], length, end) || end < start) {
+        return native_error(call, "Array.slice() range out of bounds.");
+    }
+    call.result = new_array_view(array, start, end - start);
+    return true;
+}
+
+// --- Array: operações sobre o array inteiro ---
+// Os kernels vetoriais (simd.h) leem direto o buffer de um array
+// ARRAY_DOUBLE, sem a checagem de tipo e de limites que cada
+// OP_GET_SUBSCRIPT faria num laço do script.
+
+// Áreas de cópia para arrays de outros tipos, reaproveitadas entre as
+// chamadas (nativas não se reentram).
+static std::vector<double> first_numbers, second_numbers;
+
+// Os números do array em 'numbers': o próprio buffer se ele for
+// ARRAY_DOUBLE, ou uma cópia em 'scratch'. Retorna false se 'value' não for
+// um array ou se algum elemento não for número.
+static bool array_numbers(const SapphireValue& value, std::vector<double>& scratch, const double*& numbers, uint32_t& count) {
+    if (!is_obj_type(value, OBJ_ARRAY)) return false;
+    uint32_t offset;
+    ObjArray* array = array_storage(static_cast<ObjArray*>(value.as_obj()), offset, count);
+    switch (array->kind) {
+        case ARRAY_DOUBLE:
+            numbers = array->numbers() + offset;
+            return true;
+        case ARRAY_INT:
+            scratch.resize(count);
+            for (uint32_t i = 0; i < count; i++) scratch[i] = static_cast<double>(array->integers()[offset + i]);
+            numbers = scratch.data();
+            return true;
+        case ARRAY_BOOL:
+            numbers = nullptr;
+            return count == 0;
+        case ARRAY_VALUE:
+        case ARRAY_VIEW: // array_storage nunca retorna uma fatia.
+            break;
+    }
+    scratch.resize(count);
+    for (uint32_t i = 0; i < count; i++) {
+        const SapphireValue& element = array->values()[offset + i];
+        if (!element.is_number()) return false;
+        scratch[i] = element.as_number();
+    }
+    numbers = scratch.data();
+    return true;
+}
+
+static bool array_sum(NativeCall& call) {
+    uint32_t count;
+    const double* numbers;
+    if (!array_numbers(call.args[0], first_numbers, numbers, count)) return native_error(call, "Argument for Array.sum() must be an array of numbers.");
+    call.result = simd_sum(numbers, count);
+    return true;
+}
+
+static bool array_dot(NativeCall& call) {
+    uint32_t first_count, second_count;
+    const double* first;
+    const double* second;
+    if (!array_numbers(call.args[0], first_numbers, first, first_count) ||
+        !array_numbers(call.args[1], second_numbers, second, second_count)) {
+        return native_error(call, "Arguments for Array.dot() must be arrays of numbers.");
+    }
+    if (first_count != second_count) return native_error(call, "Arrays for Array.dot() must have the same length.");
+    call.result = simd_dot(first, second, first_count);
+    return true;
+}
+
+// Array.map_add(a, b): novo array com a[i] + b[i], ou a[i] + b se b for número.
+// O resultado é ARRAY_DOUBLE e o kernel escreve direto no buffer dele. Os
+// argumentos continuam na pilha durante a alocação, e arrays nunca mudam de
+// lugar, então os ponteiros lidos antes continuam valendo.
+static bool array_map_add(NativeCall& call) {
+    uint32_t count, other_count;
+    const double* numbers;
+    if (!array_numbers(call.args[0], first_numbers, numbers, count)) return native_error(call, "First argument for Array.map_add() must be an array of numbers.");
+    if (call.args[1].is_number()) {
+        ObjArray* result = new_array(ARRAY_DOUBLE, count);
+        result->count = count;
+        simd_add_scalar(numbers, call.args[1].as_number(), result->numbers(), count);
+        call.result = result;
+        return true;
+    }
+    const double* other;
+    if (!array_numbers(call.args[1], second_numbers, other, other_count)) return native_error(call, "Second argument for Array.map_add() must be a number or an array of numbers.");
+    if (count != other_count) return native_error(call, "Arrays for Array.map_add() must have the same length.");
+    ObjArray* result = new_array(ARRAY_DOUBLE, count);
+    result->count = count;
+    simd_add(numbers, other, result->numbers(), count);
+    call.result = result;
+    return true;
+}
+
+// Array.scale(a, k): novo array com a[i] * k.
+static bool array_scale(NativeCall& call) {
+    uint32_t count;
+    const double* numbers;
+    if (!array_numbers(call.args[0], first_numbers, numbers, count) || !call.args[1].is_number()) {
+        return native_error(call, "Arguments for Array.scale() must be an array of numbers and a number.");
+    }
+    ObjArray* result = new_array(ARRAY_DOUBLE, count);
+    result->count = count;
+    simd_scale(numbers, call.args[1].as_number(), result->numbers(), count);
+    call.result = result;
+    return true;
+}
+
+static bool array_min(NativeCall& call) {
+    uint32_t count;
+    const double* numbers;
+    if (!array_numbers(call.args[0], first_numbers, numbers, count)) return native_error(call, "Argument for Array.min() must be an array of numbers.");
+    if (count == 0) return native_error(call, "Array.min() of an empty array.");
+    call.result = simd_min(numbers, count);
+    return true;
+}
+
+static bool array_max(NativeCall& call) {
+    uint32_t count;
+    const double* numbers;
+    if (!array_numbers(call.args[0], first_numbers, numbers, count)) return native_error(call, "Argument for Array.max() must be an array of numbers.");
+    if (count == 0) return native_error(call, "Array.max() of an empty array.");
+    call.result = simd_max(numbers, count);
+    return true;
+}
+
+// Ordena no lugar (NaN vai para o fim) e retorna o próprio array. Arrays
+// empacotados são ordenados direto no buffer.
+static bool array_sort(NativeCall& call) {
+    uint32_t count;
+    const double* numbers;
+    if (!array_numbers(call.args[0], first_numbers, numbers, count)) return native_error(call, "Argument for Array.sort() must be an array of numbers.");
+    uint32_t offset;
+    ObjArray* array = array_storage(static_cast<ObjArray*>(call.args[0].as_obj()), offset, count);
+    auto before = [](double a, double b) { return a < b || (b != b && a == a); };
+    switch (array->kind) {
+        case ARRAY_DOUBLE:
+            std::sort(array->numbers() + offset, array->numbers() + offset + count, before);
+            break;
+        case ARRAY_INT:
+            std::sort(array->integers() + offset, array->integers() + offset + count);
+            break;
+        case ARRAY_BOOL: // Só chega aqui vazio.
+        case ARRAY_VIEW:
+            break;
+        case ARRAY_VALUE:
+            std::sort(first_numbers.begin(), first_numbers.end(), before);
+            for (uint32_t i = 0; i < count; i++) array->values()[offset + i] = first_numbers[i];
+            break;
+    }
+    call.result = call.args[0];
+    return true;
+}
+
+// Array.fill(a, valor): qualquer valor, no lugar; retorna o próprio array.
+static bool array_fill(NativeCall& call) {
+    if (!is_obj_type(call.args[0], OBJ_ARRAY)) return native_error(call, "First argument for Array.fill() must be an array.");
+    uint32_t offset, count;
+    ObjArray* array = array_storage(static_cast<ObjArray*>(call.args[0].as_obj()), offset, count);
+    if (count > 0) {
+        write_barrier(array, call.args[1]);
+        array_convert(array, array_widen(array->kind, call.args[1]));
+        for (uint32_t i = 0; i < count; i++) array_set(array, offset + i, call.args[1]);
+    }
+    call.result = call.args[0];
+    return true;
+}
+
+// --- Tabelas ---
+
+static const NativeEntry math_entries[] = {
+    {"sqrt", math_sqrt, 1},
+    {"abs", math_abs, 1},
+    {"floor", math_floor, 1},
+    {"ceil", math_ceil, 1},
+    {"round", math_round, 1},
+    {"sin", math_sin, 1},
+    {"cos", math_cos, 1},
+    {"log", math_log, 1},
+    {"pow", math_pow, 2},
+    {"min", math_min, 2},
+    {"max", math_max, 2},
+};
+
+static const NativeEntry io_entries[] = {
+    {"readLine", io_read_line, 0},
+    {"write", io_write, 1},
+};
+
+static const NativeEntry string_entries[] = {
+    {"length", string_length, 1},
+    {"upper", string_upper, 1},
+    {"lower", string_lower, 1},
+};
+
+static const NativeEntry array_entries[] = {
+    {"length", array_length, 1},
+    {"sum", array_sum, 1},
+    {"dot", array_dot, 2},
+    {"map_add", array_map_add, 2},
+    {"scale", array_scale, 2},
+    {"min", array_min, 1},
+    {"max", array_max, 1},
+    {"sort", array_sort, 1},
+    {"fill", array_fill, 2},
+    {"push", array_push, 2},
+    {"pop", array_pop, 1},
+    {"insert", array_insert, 3},
+    {"reserve", array_reserve, 2},
+    {"capacity", array_capacity, 1},
+    {"slice", array_slice, 3},
+};
+
+static const NativeEntry time_entries[] = {
+    {"clock", native_clock, 0},
+    {"now", time_now, 0},
+};
+
+const NativeModule standard_modules[] = {
+    native_module("IO", io_entries),
+    native_module("Math", math_entries),
+    native_module("String", string_entries),
+    native_module("Array", array_entries),
+    native_module("Time", time_entries),
+};
+const size_t standard_module_count = sizeof(standard_modules) / sizeof(standard_modules[0]);
\ No newline at end of file
@@ -0,0 +1,41 @@
+#ifndef SAPPHIRE_NATIVE_H
+#define SAPPHIRE_NATIVE_H
+
+#include "object.h"
+#include <cstddef>
+
+// --- Módulos nativos ---
+// Um módulo é um grupo de nativas registrado de uma vez na VM
+// (VM::register_module), como "Math" ou "IO". Cada membro ganha um slot fixo
+// na NativeTable (vm.h), e o compilador troca "Math.sqrt(x)" por uma
+// OP_CALL_NATIVE com esse slot: a chamada não busca nada por nome em runtime,
+// e a aridade declarada é conferida já na compilação.
+//
+// Um embutidor registra os seus módulos do mesmo jeito que a biblioteca padrão:
+//   static const NativeEntry entries[] = { {"beep", beep_native, 0} };
+//   vm.register_module(native_module("Audio", entries), &audio_state);
+struct NativeEntry {
+    const char* name;   // Nome do membro (precisa viver tanto quanto a VM)
+    NativeFn function;
+    int arity;          // NATIVE_VARIADIC: qualquer quantidade
+};
+
+struct NativeModule {
+    const char* name;
+    const NativeEntry* entries;
+    size_t count;
+};
+
+template <size_t N>
+constexpr NativeModule native_module(const char* name, const NativeEntry (&entries)[N]) {
+    return {name, entries, N};
+}
+
+// Biblioteca padrão, registrada por toda VM: Math, IO, String, Array e Time.
+extern const NativeModule standard_modules[];
+extern const size_t standard_module_count;
+
+// A global 'clock' (o mesmo que Time.clock), anterior aos módulos.
+bool native_clock(NativeCall& call);
+
+#endif //SAPPHIRE_NATIVE_H
\ No newline at end of file
@@ -1,12 +1,38 @@
 #include "object.h"
+#include "memory.h"
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
+#include <new>
 
-// NOTA IMPORTANTE SOBRE MEMÓRIA:
-// Estamos usando 'new' para alocar memória para nossos objetos. Em uma
-// linguagem de produção, precisaríamos de um "Coletor de Lixo" (Garbage Collector)
-// para automaticamente liberar essa memória quando os objetos não forem mais usados.
-// Por enquanto, nosso programa irá vazar memória, mas isso é aceitável para
-// o nosso objetivo atual de fazer o compilador e a VM funcionarem.
+// NOTA SOBRE MEMÓRIA:
+// Todos os objetos são criados por allocate_object, que os registra na lista
+// do coletor de lixo (memory.cpp). Uma alocação pode disparar uma coleta, então
+// quem cria um objeto enquanto segura outro ainda não alcançável deve protegê-lo
+// com push_temp_root/pop_temp_root.
+
+template <typename T>
+static T* allocate_object(ObjType type) {
+    gc_before_allocation(sizeof(T));
+    T* object = new T();
+    object->type = type;
+    return object;
+}
+
+// Objetos de vida curta vão para o berçário quando possível. Eles não entram
+// na lista do coletor: a coleta do berçário os promove ou descarta.
+template <typename T>
+static T* allocate_young_object(ObjType type) {
+    void* memory = nursery_allocate(sizeof(T));
+    if (memory == nullptr) {
+        T* object = allocate_object<T>(type);
+        return object;
+    }
+    T* object = new (memory) T();
+    object->type = type;
+    object->is_young = true;
+    return object;
+}
 
 // Função auxiliar para imprimir um objeto de função
 static void print_function(ObjFunction* function) {
@@ -20,7 +46,7 @@ static void print_function(ObjFunction* function) {
 
 // Função principal que sabe como imprimir cada tipo de objeto
 void print_object(const SapphireValue& value) {
-    Obj* obj = std::get<Obj*>(value._value);
+    Obj* obj = value.as_obj();
     switch (obj->type) {
         case OBJ_STRING:
             std::cout << static_cast<ObjString*>(obj)->chars;
@@ -45,56 +71,365 @@ void print_object(const SapphireValue& value) {
         case OBJ_NATIVE:
             std::cout << "<native fn>";
             break;
+        case OBJ_ARRAY: {
+            ObjArray* array = static_cast<ObjArray*>(obj);
+            uint32_t count = array_length(array);
+            std::cout << "[";
+            for (uint32_t i = 0; i < count; ++i) {
+                print_value(array_get(array, i));
+                if (i < count - 1) {
+                    std::cout << ", ";
+                }
+            }
+            std::cout << "]";
+            break;
+        }
     }
 }
 
 
 // Implementações das funções "fábrica"
 
+// O receiver é sempre uma instância (nunca um objeto do berçário), então a
+// cópia recebida por valor continua válida mesmo que a alocação colete.
 ObjBoundMethod* new_bound_method(SapphireValue receiver, ObjClosure* method) {
-    auto* bound = new ObjBoundMethod();
-    bound->type = OBJ_BOUND_METHOD;
+    auto* bound = allocate_young_object<ObjBoundMethod>(OBJ_BOUND_METHOD);
     bound->receiver = receiver;
     bound->method = method;
+    if (!bound->is_young) register_object(bound);
     return bound;
 }
 ObjClass* new_class(ObjString* name) {
-    auto* klass = new ObjClass();
-    klass->type = OBJ_CLASS;
+    auto* klass = allocate_object<ObjClass>(OBJ_CLASS);
     klass->name = name;
+    klass->root_shape.klass = klass;
+    register_object(klass);
     return klass;
 }
 
 ObjInstance* new_instance(ObjClass* klass) {
-    auto* instance = new ObjInstance();
-    instance->type = OBJ_INSTANCE;
+    auto* instance = allocate_object<ObjInstance>(OBJ_INSTANCE);
     instance->klass = klass;
+    // Os campos declarados na classe já existem, valendo nil.
+    instance->shape = klass->initial_shape;
+    instance->fields.resize(klass->initial_shape->slots.size());
+    register_object(instance);
     return instance;
 }
 
+// --- Formas e campos de instância ---
+
+Shape* Shape::add_field(ObjString* name) {
+    auto it = transitions.find(name);
+    if (it != transitions.end()) return it->second.get();
+
+    auto child = std::make_unique<Shape>();
+    child->klass = klass;
+    child->parent = this;
+    child->slots = slots;
+    child->slots[name] = (uint16_t)slots.size();
+    Shape* result = child.get();
+    transitions[name] = std::move(child);
+    return result;
+}
+
+SapphireValue* instance_field(ObjInstance* instance, ObjString* name) {
+    int index = instance->shape->find(name);
+    return index == -1 ? nullptr : &instance->fields[index];
+}
+
+void instance_set_field(ObjInstance* instance, ObjString* name, const SapphireValue& value) {
+    int index = instance->shape->find(name);
+    if (index != -1) {
+        instance->fields[index] = value;
+        return;
+    }
+
+    instance_add_field(instance, instance->shape->add_field(name), value);
+}
+
+void instance_add_field(ObjInstance* instance, Shape* new_shape, const SapphireValue& value) {
+    instance->shape = new_shape;
+    size_t old_capacity = instance->fields.capacity();
+    instance->fields.push_back(value);
+    // O vetor de campos entra na conta do objeto (ver object_size em memory.cpp).
+    track_allocation((instance->fields.capacity() - old_capacity) * sizeof(SapphireValue));
+}
+
 ObjFunction* new_function() {
-    auto* function = new ObjFunction();
-    function->type = OBJ_FUNCTION;
+    auto* function = allocate_object<ObjFunction>(OBJ_FUNCTION);
+    register_object(function);
     return function;
 }
 
-ObjNative* new_native(NativeFn function) {
-    auto* native = new ObjNative();
-    native->type = OBJ_NATIVE;
+ObjNative* new_native(NativeFn function, int arity, const char* name, void* userdata) {
+    auto* native = allocate_object<ObjNative>(OBJ_NATIVE);
     native->function = function;
+    native->arity = arity;
+    native->name = name;
+    native->userdata = userdata;
+    register_object(native);
     return native;
 }
 
 ObjClosure* new_closure(ObjFunction* function) {
-    auto* closure = new ObjClosure();
-    closure->type = OBJ_CLOSURE;
+    auto* closure = allocate_object<ObjClosure>(OBJ_CLOSURE);
     closure->function = function;
+    register_object(closure);
     return closure;
 }
 
-ObjString* new_string(const std::string& chars) {
-    auto* string_obj = new ObjString();
-    string_obj->type = OBJ_STRING;
+uint32_t hash_string(const char* chars, size_t length) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < length; i++) {
+        hash ^= (uint8_t)chars[i];
+        hash *= 16777619;
+    }
+    return hash;
+}
+
+ObjString* new_string(std::string_view chars) {
+    uint32_t hash = hash_string(chars.data(), chars.size());
+    ObjString* interned = find_interned_string(chars, hash);
+    if (interned != nullptr) return interned;
+
+    auto* string_obj = allocate_object<ObjString>(OBJ_STRING);
+    string_obj->chars = chars;
+    string_obj->hash = hash;
+    string_obj->is_interned = true;
+    register_object(string_obj);
+    intern_string(string_obj);
+    return string_obj;
+}
+
+ObjString* new_temp_string(const std::string& chars) {
+    auto* string_obj = allocate_young_object<ObjString>(OBJ_STRING);
     string_obj->chars = chars;
+    string_obj->hash = hash_string(chars.data(), chars.size());
+    if (!string_obj->is_young) register_object(string_obj);
     return string_obj;
-}
\ No newline at end of file
+}
+
+ObjArray::~ObjArray() {
+    std::free(data);
+}
+
+// Buffer para 'capacity' elementos de 'kind'. Ele entra na conta do objeto
+// (ver object_size em memory.cpp), então quem troca o buffer de um array
+// informa a diferença com track_allocation.
+static void* allocate_elements(ArrayKind kind, uint32_t capacity) {
+    if (capacity == 0) return nullptr;
+    void* data = std::malloc(capacity * array_element_size(kind));
+    if (data == nullptr) throw std::bad_alloc();
+    return data;
+}
+
+ObjArray* new_array(ArrayKind kind, uint32_t capacity) {
+    auto* array = allocate_object<ObjArray>(OBJ_ARRAY);
+    array->kind = kind;
+    array->data = allocate_elements(kind, capacity);
+    array->capacity = capacity;
+    // register_object já conta o buffer (object_size).
+    register_object(array);
+    return array;
+}
+
+// Tipo de um array que só tem 'value': números e booleanos empacotados.
+static ArrayKind natural_kind(const SapphireValue& value) {
+    if (value.is_number()) return ARRAY_DOUBLE;
+    if (value.is_bool()) return ARRAY_BOOL;
+    return ARRAY_VALUE;
+}
+
+ArrayKind array_widen(ArrayKind kind, const SapphireValue& value) {
+    switch (kind) {
+        case ARRAY_DOUBLE:
+            return value.is_number() ? ARRAY_DOUBLE : ARRAY_VALUE;
+        case ARRAY_INT:
+            if (!value.is_number()) return ARRAY_VALUE;
+            return number_fits_int(value.as_number()) ? ARRAY_INT : ARRAY_DOUBLE;
+        case ARRAY_BOOL:
+            return value.is_bool() ? ARRAY_BOOL : ARRAY_VALUE;
+        case ARRAY_VALUE:
+        case ARRAY_VIEW:
+            break;
+    }
+    return ARRAY_VALUE;
+}
+
+ObjArray* build_array(const SapphireValue* elements, uint32_t count, uint8_t hint) {
+    ArrayKind kind;
+    if (hint != ARRAY_INFER) {
+        kind = static_cast<ArrayKind>(hint);
+    } else {
+        kind = count > 0 ? natural_kind(elements[0]) : ARRAY_VALUE;
+    }
+    for (uint32_t i = 0; i < count && kind != ARRAY_VALUE; i++) kind = array_widen(kind, elements[i]);
+
+    ObjArray* array = new_array(kind, count);
+    array->count = count;
+    for (uint32_t i = 0; i < count; i++) {
+        write_barrier(array, elements[i]);
+        array_set(array, i, elements[i]);
+    }
+    return array;
+}
+
+void array_convert(ObjArray* array, ArrayKind kind) {
+    if (array->kind == kind) return;
+    void* data = allocate_elements(kind, array->capacity);
+    for (uint32_t i = 0; i < array->count; i++) {
+        SapphireValue element = array_get(array, i);
+        switch (kind) {
+            case ARRAY_DOUBLE: static_cast<double*>(data)[i] = element.as_number(); break;
+            case ARRAY_INT:    static_cast<int64_t*>(data)[i] = static_cast<int64_t>(element.as_number()); break;
+            case ARRAY_BOOL:   static_cast<uint8_t*>(data)[i] = element.as_bool(); break;
+            case ARRAY_VALUE:  static_cast<SapphireValue*>(data)[i] = element; break;
+            case ARRAY_VIEW:   break;
+        }
+    }
+    // As conversões só alargam (int -> double, empacotado -> valor), então o
+    // buffer novo nunca é menor que o antigo.
+    track_allocation(array->capacity * (array_element_size(kind) - array_element_size(array->kind)));
+    std::free(array->data);
+    array->data = data;
+    array->kind = kind;
+}
+
+void array_set_widening(ObjArray* array, uint32_t index, const SapphireValue& value) {
+    if (array->kind == ARRAY_VIEW) {
+        array_set(array->base, array->offset + index, value);
+        return;
+    }
+    array_convert(array, array_widen(array->kind, value));
+    array_set(array, index, value);
+}
+
+void array_store(ObjArray* array, uint32_t index, const SapphireValue& value) {
+    // Numa fatia, quem guarda o valor (e é varrido pelo coletor) é a base.
+    write_barrier(array->kind == ARRAY_VIEW ? array->base : array, value);
+    array_set(array, index, value);
+}
+
+SapphireValue array_view_get(const ObjArray* view, uint32_t index) {
+    return array_get(view->base, view->offset + index);
+}
+
+ObjArray* new_array_view(ObjArray* array, uint32_t start, uint32_t count) {
+    ObjArray* base = array;
+    if (array->kind == ARRAY_VIEW) {
+        base = array->base;
+        start += array->offset;
+    }
+    ObjArray* view = new_array(ARRAY_VIEW);
+    write_barrier(view, SapphireValue(static_cast<Obj*>(base)));
+    view->base = base;
+    view->offset = start;
+    view->count = count;
+    return view;
+}
+
+bool array_try_reserve(ObjArray* array, uint32_t capacity) {
+    if (capacity <= array->capacity) return true;
+    size_t element_size = array_element_size(array->kind);
+    void* data = std::realloc(array->data, (size_t)capacity * element_size);
+    if (data == nullptr) return false;
+    track_allocation((size_t)(capacity - array->capacity) * element_size);
+    array->data = data;
+    array->capacity = capacity;
+    return true;
+}
+
+void array_reserve(ObjArray* array, uint32_t capacity) {
+    if (!array_try_reserve(array, capacity)) throw std::bad_alloc();
+}
+
+// Abre espaço para mais um elemento do tipo que guarda 'value'. Um literal
+// vazio sem tipo declarado ("[]") ainda não escolheu nada e adota o do valor.
+static void array_grow_for(ObjArray* array, const SapphireValue& value) {
+    if (array->count == 0 && array->capacity == 0 && array->kind == ARRAY_VALUE) {
+        array->kind = natural_kind(value);
+    } else {
+        array_convert(array, array_widen(array->kind, value));
+    }
+    if (array->count == array->capacity) {
+        uint64_t doubled = array->capacity < 8 ? 8 : (uint64_t)array->capacity * 2;
+        array_reserve(array, (uint32_t)(doubled < UINT32_MAX ? doubled : UINT32_MAX));
+    }
+}
+
+void array_push(ObjArray* array, const SapphireValue& value) {
+    array_grow_for(array, value);
+    array->count++;
+    array_store(array, array->count - 1, value);
+}
+
+void array_append(ObjArray* array, const SapphireValue* values, uint32_t count) {
+    if ((uint64_t)array->count + count > array->capacity) {
+        array_reserve(array, array->count + count);
+    }
+    for (uint32_t i = 0; i < count; i++) array_push(array, values[i]);
+}
+
+void array_insert(ObjArray* array, uint32_t index, const SapphireValue& value) {
+    array_grow_for(array, value);
+    size_t element_size = array_element_size(array->kind);
+    char* data = static_cast<char*>(array->data);
+    std::memmove(data + (size_t)(index + 1) * element_size, data + (size_t)index * element_size,
+                 (size_t)(array->count - index) * element_size);
+    array->count++;
+    array_store(array, index, value);
+}
+
+SapphireValue array_pop(ObjArray* array) {
+    SapphireValue value = array_get(array, array->count - 1);
+    // Uma fatia ainda pode enxergar a posição liberada; nil não segura nenhum objeto.
+    if (array->kind == ARRAY_VALUE) array->values()[array->count - 1] = SapphireValue();
+    array->count--;
+    return value;
+}
+
+std::string pack_array_literal(const std::vector<SapphireValue>& elements, ArrayKind kind) {
+    std::string packed;
+    packed.reserve(elements.size() * array_element_size(kind));
+    for (const SapphireValue& element : elements) {
+        uint64_t bits;
+        switch (kind) {
+            case ARRAY_DOUBLE: {
+                double number = element.as_number();
+                std::memcpy(&bits, &number, sizeof(double));
+                break;
+            }
+            case ARRAY_INT:
+                bits = (uint64_t)static_cast<int64_t>(element.as_number());
+                break;
+            default:
+                packed.push_back(element.as_bool() ? 1 : 0);
+                continue;
+        }
+        for (int i = 0; i < 8; i++) packed.push_back((char)((bits >> (8 * i)) & 0xff));
+    }
+    return packed;
+}
+
+ObjArray* unpack_array_literal(const ObjString* packed, ArrayKind kind) {
+    size_t element_size = array_element_size(kind);
+    uint32_t count = (uint32_t)(packed->chars.size() / element_size);
+    ObjArray* array = new_array(kind, count);
+    array->count = count;
+    const unsigned char* bytes = reinterpret_cast<const unsigned char*>(packed->chars.data());
+    if (kind == ARRAY_BOOL) {
+        std::memcpy(array->data, bytes, count);
+        return array;
+    }
+    // Os dois tipos de 8 bytes são lidos do mesmo jeito; o compilador
+    // transforma o laço de bytes numa leitura só em máquinas little-endian.
+    uint64_t* words = static_cast<uint64_t*>(array->data);
+    for (uint32_t i = 0; i < count; i++) {
+        const unsigned char* at = bytes + (size_t)i * 8;
+        uint64_t bits = 0;
+        for (int b = 0; b < 8; b++) bits |= (uint64_t)at[b] << (8 * b);
+        words[i] = bits;
+    }
+    return array;
+}
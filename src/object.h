@@ -3,19 +3,39 @@
 
 #include "chunk.h"
 #include "value.h"
+#include <cmath>
 #include <string>
-#include <functional>
+#include <string_view>
+#include <memory>
 #include <vector>
 #include <unordered_map>
 
 struct ObjBoundMethod; 
+struct ObjClass;
 struct ObjFunction;
 struct ObjString;
 struct ObjClosure;
+struct BytecodeImage;
 
-// Forward declaration para o tipo de função nativa, que usa SapphireValue
-struct SapphireValue;
-using NativeFn = std::function<SapphireValue(int arg_count, SapphireValue* args)>;
+// --- Funções nativas ---
+// Uma nativa é um ponteiro de função simples: chamá-la custa uma chamada
+// indireta, sem cópia nem std::function. A VM confere a aridade declarada
+// antes da chamada, então a nativa pode ler os argumentos direto.
+// Em caso de erro a nativa retorna false com a mensagem em 'error' (ver
+// native_error) e a VM interrompe a execução, como nos outros erros de runtime.
+struct NativeCall {
+    SapphireValue* args;            // 'arg_count' valores, na pilha da VM
+    int arg_count;
+    void* userdata;                 // O ponteiro registrado com a nativa
+    SapphireValue result{};         // nil se a nativa não definir
+    const char* error = nullptr;
+};
+using NativeFn = bool (*)(NativeCall& call);
+
+static inline bool native_error(NativeCall& call, const char* message) {
+    call.error = message;
+    return false;
+}
 
 // Enum para identificar o tipo de objeto em tempo de execução
 enum ObjType {
@@ -26,65 +46,291 @@ enum ObjType {
     OBJ_FUNCTION,
     OBJ_NATIVE,
     OBJ_STRING,
+    OBJ_ARRAY,
 };
 
 // A struct base para todos os objetos gerenciados no "heap" pela VM
 struct Obj {
     ObjType type;
+    bool is_marked = false;     // Usado pelo coletor de lixo (memory.cpp)
+    bool is_young = false;      // Vive no berçário (modo geracional)
+    bool is_remembered = false; // Já está no remembered set da geração jovem
+    Obj* next = nullptr;        // Lista intrusiva de todos os objetos alocados
+};
+
+// Struct para armazenar strings de forma eficiente
+struct ObjString : Obj {
+    std::string chars;
+    uint32_t hash = 0;        // Calculado uma única vez, na criação
+    bool is_interned = false; // Única na tabela de strings: compara por ponteiro
+};
+
+// Tabelas de nomes (campos, métodos) são indexadas por strings internadas:
+// a comparação é por ponteiro e o hash já vem pronto no objeto.
+struct ObjStringHash {
+    size_t operator()(const ObjString* string) const { return string->hash; }
+};
+template <typename T>
+using StringTable = std::unordered_map<ObjString*, T, ObjStringHash>;
+
+// "Forma" (hidden class) de uma instância: a lista de campos e a posição de
+// cada um no vetor de valores. Instâncias que recebem os mesmos campos na
+// mesma ordem compartilham a mesma forma. Cada classe é dona de uma árvore de
+// formas: adicionar um campo segue (ou cria) uma transição para a forma filha.
+struct Shape {
+    ObjClass* klass = nullptr;   // Dona da árvore (mantida viva pelos inline caches)
+    Shape* parent = nullptr;
+    StringTable<uint16_t> slots; // Todos os campos desta forma -> índice
+    StringTable<std::unique_ptr<Shape>> transitions;
+
+    // Índice do campo, ou -1 se esta forma não o tiver.
+    int find(ObjString* name) const {
+        auto it = slots.find(name);
+        return it == slots.end() ? -1 : it->second;
+    }
+    // A forma com 'name' acrescentado no fim.
+    Shape* add_field(ObjString* name);
 };
 
 struct ObjClass : Obj {
     ObjString* name;
-    std::unordered_map<std::string, ObjClosure*> methods;
+    StringTable<ObjClosure*> methods;
+    Shape root_shape;                    // Forma vazia, raiz da árvore
+    Shape* initial_shape = &root_shape;  // Já com os campos declarados na classe
 };
 
 // Struct para representar uma instância de uma classe
 struct ObjInstance : Obj {
     ObjClass* klass; // A que classe esta instância pertence
-    std::unordered_map<std::string, SapphireValue> fields; 
+    Shape* shape;
+    std::vector<SapphireValue> fields; // Valores na ordem dada por 'shape'
 };
 
 struct ObjClosure : Obj {
     ObjFunction* function;
 };
 
-// Struct para armazenar strings de forma eficiente
-struct ObjString : Obj {
-    std::string chars;
-};
-
 // Struct para representar nossas funções compiladas
 struct ObjFunction : Obj {
     int arity = 0;
     Chunk chunk;
     ObjString* name = nullptr;
+    // Função ainda não materializada de uma imagem de bytecode (ver image.h).
+    // Enquanto 'image' não for nulo, o chunk está vazio.
+    BytecodeImage* image = nullptr;
+    uint32_t image_index = 0;
+};
+
+// Como os elementos de um array estão guardados. Arrays só de números ou só
+// de booleanos ficam "empacotados", sem a etiqueta de tipo de cada valor
+// (e, em ARRAY_DOUBLE, prontos para os kernels de simd.h). O primeiro
+// elemento que não couber no tipo converte o array inteiro, uma única vez:
+// ARRAY_INT vira ARRAY_DOUBLE com um número fracionário, e qualquer tipo
+// empacotado vira ARRAY_VALUE com um valor de outro tipo. Nunca há volta.
+enum ArrayKind : uint8_t {
+    ARRAY_DOUBLE,   // double
+    ARRAY_INT,      // int64_t (arrays declarados como int[])
+    ARRAY_BOOL,     // um byte por elemento
+    ARRAY_VALUE,    // SapphireValue
+    ARRAY_VIEW,     // Fatia de outro array (Array.slice): sem buffer próprio
+};
+
+// Operando de OP_BUILD_ARRAY quando a declaração não diz o tipo dos
+// elementos: o tipo é deduzido dos próprios elementos.
+#define ARRAY_INFER 0xFF
+
+// Struct que define um array. Os elementos ficam contíguos em 'data', no
+// formato dado por 'kind'; 'capacity' é quanto cabe sem realocar (o buffer
+// dobra quando enche, ver array_push).
+//
+// Uma fatia (ARRAY_VIEW) não copia nada: ela mostra os elementos
+// [offset, offset + count) de 'base', que é sempre um array com buffer
+// próprio. Como ela lê 'base' a cada acesso, continua valendo depois que
+// 'base' realoca ou muda de tipo; se 'base' encolher, a fatia encolhe junto.
+struct ObjArray : Obj {
+    ArrayKind kind = ARRAY_VALUE;
+    uint32_t count = 0;
+    uint32_t capacity = 0;
+    void* data = nullptr;
+    ObjArray* base = nullptr;   // Só em ARRAY_VIEW
+    uint32_t offset = 0;
+
+    ~ObjArray();
+
+    double* numbers() const         { return static_cast<double*>(data); }
+    int64_t* integers() const       { return static_cast<int64_t*>(data); }
+    uint8_t* flags() const          { return static_cast<uint8_t*>(data); }
+    SapphireValue* values() const   { return static_cast<SapphireValue*>(data); }
 };
 
+static inline size_t array_element_size(ArrayKind kind) {
+    switch (kind) {
+        case ARRAY_DOUBLE: return sizeof(double);
+        case ARRAY_INT:    return sizeof(int64_t);
+        case ARRAY_BOOL:   return sizeof(uint8_t);
+        case ARRAY_VALUE:  break;
+        case ARRAY_VIEW:   return 0;
+    }
+    return sizeof(SapphireValue);
+}
+
 struct ObjBoundMethod : Obj {
     SapphireValue receiver; // A instância ('this')
     ObjClosure* method;     // A closure do método
 };
 
+// Aridade de uma nativa que aceita qualquer quantidade de argumentos.
+#define NATIVE_VARIADIC -1
+
 // Struct para "embrulhar" nossas funções C++ nativas
 struct ObjNative : Obj {
-    NativeFn function;
+    NativeFn function = nullptr;
+    int arity = 0;                  // NATIVE_VARIADIC: qualquer quantidade
+    void* userdata = nullptr;
+    const char* name = "";          // Para as mensagens de erro
 };
 
 // Funções "fábrica" para criar novos objetos
 ObjBoundMethod* new_bound_method(SapphireValue receiver, ObjClosure* method);
 ObjFunction* new_function();
-ObjNative* new_native(NativeFn function);
-ObjString* new_string(const std::string& chars);
+ObjNative* new_native(NativeFn function, int arity, const char* name, void* userdata = nullptr);
+// Retorna a string internada com esse conteúdo, criando-a se ainda não existir.
+ObjString* new_string(std::string_view chars);
+// Strings temporárias criadas pela VM (ex: concatenação em OP_ADD). Nascem no
+// berçário quando o modo geracional do coletor está ligado e não são internadas.
+ObjString* new_temp_string(const std::string& chars);
 ObjClass* new_class(ObjString* name);
 ObjInstance* new_instance(ObjClass* klass);
 ObjClosure* new_closure(ObjFunction* function);
+// Array vazio do tipo dado, já com espaço para 'capacity' elementos.
+ObjArray* new_array(ArrayKind kind = ARRAY_VALUE, uint32_t capacity = 0);
+// Array com os 'count' valores de 'elements'. 'hint' é o tipo declarado
+// (ARRAY_INFER se não houver); se algum elemento não couber nele, o array
+// nasce com o tipo mais largo necessário.
+ObjArray* build_array(const SapphireValue* elements, uint32_t count, uint8_t hint);
+// Fatia [start, start + count) de 'array' (que pode ser outra fatia).
+ObjArray* new_array_view(ObjArray* array, uint32_t start, uint32_t count);
+
+// Os elementos constantes do começo de um literal de array (números ou
+// booleanos) vão para o chunk como uma única string, já empacotados
+// (little-endian), e a VM cria o array com uma cópia, sem passar cada
+// elemento pela pilha.
+std::string pack_array_literal(const std::vector<SapphireValue>& elements, ArrayKind kind);
+ObjArray* unpack_array_literal(const ObjString* packed, ArrayKind kind);
+
+// Acesso aos campos de uma instância através da sua forma.
+// instance_field retorna nullptr se o campo não existir.
+SapphireValue* instance_field(ObjInstance* instance, ObjString* name);
+// Cria o campo (com uma transição de forma) se ele ainda não existir.
+// Quem chama é responsável pela barreira de escrita do coletor.
+void instance_set_field(ObjInstance* instance, ObjString* name, const SapphireValue& value);
+// Acrescenta um campo cuja transição já é conhecida: 'new_shape' deve ser
+// a forma atual da instância mais um campo no fim.
+void instance_add_field(ObjInstance* instance, Shape* new_shape, const SapphireValue& value);
+
+// --- Acesso aos elementos de um array ---
+// Quem chama confere os limites, e é responsável pela barreira de escrita
+// do coletor (só ARRAY_VALUE guarda referências).
+
+// Um número cabe em ARRAY_INT se voltar igual depois de ida e volta por
+// int64_t (o que exclui frações, NaN, infinitos e -0).
+static inline bool number_fits_int(double number) {
+    if (!(number >= -9223372036854775808.0 && number < 9223372036854775808.0)) return false;
+    int64_t integer = static_cast<int64_t>(number);
+    return static_cast<double>(integer) == number && (integer != 0 || !std::signbit(number));
+}
+
+// Quantidade de elementos visíveis. Uma fatia perde o que 'base' não tem mais.
+static inline uint32_t array_length(const ObjArray* array) {
+    if (array->kind != ARRAY_VIEW) return array->count;
+    uint32_t available = array->base->count > array->offset ? array->base->count - array->offset : 0;
+    return array->count < available ? array->count : available;
+}
+
+SapphireValue array_view_get(const ObjArray* view, uint32_t index);
+
+static inline SapphireValue array_get(const ObjArray* array, uint32_t index) {
+    switch (array->kind) {
+        case ARRAY_DOUBLE: return array->numbers()[index];
+        case ARRAY_INT:    return int_value(array->integers()[index]);
+        case ARRAY_BOOL:   return array->flags()[index] != 0;
+        case ARRAY_VALUE:  break;
+        case ARRAY_VIEW:   return array_view_get(array, index);
+    }
+    return array->values()[index];
+}
+
+// Converte o array para um tipo mais largo, preservando os elementos.
+void array_convert(ObjArray* array, ArrayKind kind);
+// O tipo mais estreito que guarda tudo o que 'kind' guarda e também 'value'.
+ArrayKind array_widen(ArrayKind kind, const SapphireValue& value);
+// Caminho lento de array_set: o valor não cabe no tipo atual.
+void array_set_widening(ObjArray* array, uint32_t index, const SapphireValue& value);
+
+static inline void array_set(ObjArray* array, uint32_t index, const SapphireValue& value) {
+    switch (array->kind) {
+        case ARRAY_DOUBLE:
+            if (value.is_number()) {
+                array->numbers()[index] = value.as_number();
+                return;
+            }
+            break;
+        case ARRAY_INT:
+            if (value.is_int()) {
+                array->integers()[index] = value.as_int();
+                return;
+            }
+            if (value.is_number() && number_fits_int(value.as_number())) {
+                array->integers()[index] = static_cast<int64_t>(value.as_number());
+                return;
+            }
+            break;
+        case ARRAY_BOOL:
+            if (value.is_bool()) {
+                array->flags()[index] = value.as_bool();
+                return;
+            }
+            break;
+        case ARRAY_VALUE:
+            array->values()[index] = value;
+            return;
+        case ARRAY_VIEW:
+            break;
+    }
+    array_set_widening(array, index, value);
+}
+
+// array_set com a barreira de escrita, fora de linha. Usada pelos handlers
+// de OP_SET_SUBSCRIPT fora do caminho rápido de ARRAY_DOUBLE, para não
+// inchar o laço de execução da VM.
+void array_store(ObjArray* array, uint32_t index, const SapphireValue& value);
+
+// --- Crescimento (arrays com buffer próprio, nunca fatias) ---
+// Estas já fazem a barreira de escrita.
+// Garante espaço para 'capacity' elementos sem realocar. Sem memória,
+// array_try_reserve retorna false e deixa o array como estava;
+// array_reserve lança std::bad_alloc, como as outras alocações.
+bool array_try_reserve(ObjArray* array, uint32_t capacity);
+void array_reserve(ObjArray* array, uint32_t capacity);
+// Acrescenta no fim, dobrando o buffer quando ele enche (O(1) amortizado).
+// Um array vazio e sem buffer adota o tipo do primeiro valor.
+void array_push(ObjArray* array, const SapphireValue& value);
+// array_push de 'count' valores, com uma realocação só.
+void array_append(ObjArray* array, const SapphireValue* values, uint32_t count);
+// Insere em 'index' (0..count), deslocando os seguintes.
+void array_insert(ObjArray* array, uint32_t index, const SapphireValue& value);
+// Remove e retorna o último elemento (o array não pode estar vazio).
+SapphireValue array_pop(ObjArray* array);
+
+// Hash FNV-1a de 32 bits, usado por ObjString::hash.
+uint32_t hash_string(const char* chars, size_t length);
 
 // Declaração da função que imprime objetos (será implementada em object.cpp)
 void print_object(const SapphireValue& value);
 
 // Função auxiliar para verificar o tipo de um Obj* em tempo de execução
 static inline bool is_obj_type(const SapphireValue& value, ObjType type) {
-    return std::holds_alternative<Obj*>(value._value) && std::get<Obj*>(value._value)->type == type;
+    return value.is_obj() && value.as_obj()->type == type;
 }
 
-#endif //SAPPHIRE_OBJECT_H
\ No newline at end of file
+#endif //SAPPHIRE_OBJECT_H
@@ -43,10 +43,62 @@ enum OpCode : uint8_t {
     OP_LOOP,
     OP_CLOSURE,
     OP_CALL,
-    OP_BUILD_ARRAY,
+    OP_INVOKE,        // obj.metodo(args) sem criar um bound method
+    OP_BUILD_ARRAY,   // N tipo: array com os N valores do topo (tipo: ArrayKind ou ARRAY_INFER)
     OP_GET_SUBSCRIPT,
     OP_SET_SUBSCRIPT,
     OP_RETURN,
+
+    // Instruções fundidas pelo otimizador peephole (ver optimizer.h). O
+    // compilador nunca as emite diretamente.
+    OP_NOT_EQUAL,          // OP_EQUAL   + OP_NOT
+    OP_GREATER_EQUAL,      // OP_LESS    + OP_NOT
+    OP_LESS_EQUAL,         // OP_GREATER + OP_NOT
+    OP_SET_LOCAL_POP,      // OP_SET_LOCAL + OP_POP
+    // Comparação + OP_JUMP_IF_FALSE + OP_POP: desempilham os dois operandos
+    // e saltam se o resultado da comparação for falso.
+    OP_EQUAL_JUMP,
+    OP_NOT_EQUAL_JUMP,
+    OP_GREATER_JUMP,
+    OP_GREATER_EQUAL_JUMP,
+    OP_LESS_JUMP,
+    OP_LESS_EQUAL_JUMP,
+    // Superinstruções para laços numéricos sobre variáveis locais, escolhidas
+    // a partir do perfil de pares de opcodes (sapphire --op-pairs).
+    OP_ADD_LOCAL_LOCAL,        // OP_GET_LOCAL a + OP_GET_LOCAL b + OP_ADD
+    OP_INC_LOCAL_CONST,        // OP_GET_LOCAL i + OP_CONSTANT k + OP_ADD + OP_SET_LOCAL_POP i
+    OP_LESS_LOCAL_CONST_JUMP,  // OP_GET_LOCAL a + OP_CONSTANT k + OP_LESS_JUMP
+    OP_LESS_LOCAL_LOCAL_JUMP,  // OP_GET_LOCAL a + OP_GET_LOCAL b + OP_LESS_JUMP
+
+    // Versões numéricas, emitidas pelo compilador quando os dois operandos
+    // são números garantidos (ver Parser::emitted_number). Não checam tipos.
+    OP_ADD_NUM,
+    OP_SUBTRACT_NUM,
+    OP_MULTIPLY_NUM,
+    OP_DIVIDE_NUM,
+    OP_GREATER_NUM,
+    OP_LESS_NUM,
+    // Atribuição de um valor sem tipo garantido a uma local numérica: o topo
+    // precisa ser um número (erro de runtime se não for).
+    OP_CHECK_NUMBER,
+    // '/' com os dois operandos do tipo int: divisão inteira, truncada
+    // (erro de runtime com divisor zero).
+    OP_DIVIDE_INT,
+    // Instruções aceleradas ("quickening"): só aparecem no bytecode de uma
+    // função quente que subiu de nível (ver quicken_chunk em optimizer.h).
+    // Valem para globais que já estavam definidas, o que nunca se desfaz.
+    OP_GET_GLOBAL_QUICK,        // OP_GET_GLOBAL sem checar se está definida
+    OP_SET_GLOBAL_POP,          // OP_SET_GLOBAL g + OP_POP
+    OP_INC_GLOBAL_CONST,        // OP_GET_GLOBAL g + OP_CONSTANT k + OP_ADD + OP_SET_GLOBAL_POP g
+    OP_LESS_GLOBAL_CONST_JUMP,  // OP_GET_GLOBAL g + OP_CONSTANT k + OP_LESS_JUMP
+    // Membros de módulos nativos, resolvidos pelo compilador: o operando é o
+    // slot (16 bits) da nativa na NativeTable (ver vm.h).
+    OP_GET_NATIVE,              // Empilha a nativa (ex: "f = Math.sqrt")
+    OP_CALL_NATIVE,             // slot + número de argumentos: chamada direta
+    // Literais de array com começo constante ou com mais de 255 elementos.
+    OP_ARRAY_LITERAL,           // K tipo: array com os elementos empacotados na string K
+    OP_ARRAY_APPEND,            // N: acrescenta os N valores do topo ao array logo abaixo deles
+    OP_COUNT // Quantidade de opcodes (não é uma instrução)
 };
 
 #endif //SAPPHIRE_OPCODES_H
\ No newline at end of file
@@ -0,0 +1,323 @@
+#include "optimizer.h"
+#include "opcodes.h"
+#include <cstring>
+#include <initializer_list>
+#include <vector>
+
+static bool enabled = true;
+
+void set_peephole_enabled(bool value) { enabled = value; }
+bool peephole_enabled() { return enabled; }
+
+// Uma instrução decodificada. Os saltos guardam o destino como posição no
+// código original; os deslocamentos só são recalculados na hora de escrever.
+struct Instruction {
+    size_t offset;          // Posição no código original
+    uint8_t op;
+    uint8_t operands[5];
+    int length;             // Em bytes, incluindo o opcode
+    size_t target = 0;      // Saltos: destino no código original
+};
+
+static bool is_forward_jump(uint8_t op) {
+    switch (op) {
+        case OP_JUMP: case OP_JUMP_IF_FALSE:
+        case OP_EQUAL_JUMP: case OP_NOT_EQUAL_JUMP: case OP_GREATER_JUMP:
+        case OP_GREATER_EQUAL_JUMP: case OP_LESS_JUMP: case OP_LESS_EQUAL_JUMP:
+        case OP_LESS_LOCAL_CONST_JUMP: case OP_LESS_LOCAL_LOCAL_JUMP:
+        case OP_LESS_GLOBAL_CONST_JUMP:
+            return true;
+    }
+    return false;
+}
+
+static bool is_jump(uint8_t op) {
+    return op == OP_LOOP || is_forward_jump(op);
+}
+
+// As instruções numéricas (OP_*_NUM) entram nas fusões como a versão
+// genérica: as fundidas checam os tipos de qualquer forma.
+static uint8_t checked_op(uint8_t op) {
+    switch (op) {
+        case OP_ADD_NUM:      return OP_ADD;
+        case OP_SUBTRACT_NUM: return OP_SUBTRACT;
+        case OP_MULTIPLY_NUM: return OP_MULTIPLY;
+        case OP_DIVIDE_NUM:   return OP_DIVIDE;
+        case OP_GREATER_NUM:  return OP_GREATER;
+        case OP_LESS_NUM:     return OP_LESS;
+    }
+    return op;
+}
+
+// Comparação seguida de OP_NOT -> comparação complementar. OP_COUNT = nenhuma.
+static uint8_t negated_compare(uint8_t op) {
+    switch (checked_op(op)) {
+        case OP_EQUAL:   return OP_NOT_EQUAL;
+        case OP_LESS:    return OP_GREATER_EQUAL;
+        case OP_GREATER: return OP_LESS_EQUAL;
+    }
+    return OP_COUNT;
+}
+
+// Comparação seguida de OP_JUMP_IF_FALSE + OP_POP -> salto fundido.
+static uint8_t compare_jump(uint8_t op) {
+    switch (checked_op(op)) {
+        case OP_EQUAL:         return OP_EQUAL_JUMP;
+        case OP_NOT_EQUAL:     return OP_NOT_EQUAL_JUMP;
+        case OP_GREATER:       return OP_GREATER_JUMP;
+        case OP_GREATER_EQUAL: return OP_GREATER_EQUAL_JUMP;
+        case OP_LESS:          return OP_LESS_JUMP;
+        case OP_LESS_EQUAL:    return OP_LESS_EQUAL_JUMP;
+    }
+    return OP_COUNT;
+}
+
+// Decodifica o chunk e marca quais posições são destino de algum salto. Uma
+// instrução que é destino não pode ser absorvida pela anterior.
+static bool decode(const Chunk& chunk, std::vector<Instruction>& code, std::vector<uint8_t>& is_target) {
+    const size_t size = chunk.code.size();
+    is_target.assign(size + 1, 0);
+    for (size_t offset = 0; offset < size;) {
+        Instruction instruction;
+        instruction.offset = offset;
+        instruction.op = chunk.code[offset];
+        instruction.length = instruction_length(instruction.op);
+        if (instruction.length == 0 || offset + instruction.length > size) return false;
+        for (int i = 1; i < instruction.length; i++) instruction.operands[i - 1] = chunk.code[offset + i];
+
+        if (is_jump(instruction.op)) {
+            // O deslocamento é sempre o último operando (16 bits).
+            const uint8_t* operand = &instruction.operands[instruction.length - 3];
+            size_t jump = (size_t)((operand[0] << 8) | operand[1]);
+            size_t end = offset + instruction.length;
+            if (instruction.op == OP_LOOP) {
+                if (jump > end) return false;
+                instruction.target = end - jump;
+            } else {
+                instruction.target = end + jump;
+            }
+            if (instruction.target > size) return false;
+            is_target[instruction.target] = 1;
+        }
+        code.push_back(instruction);
+        offset += instruction.length;
+    }
+    return true;
+}
+
+// Se 'ops' aparece a partir de code[i], sem que as instruções a absorver
+// sejam destino de salto.
+static bool absorbable(const std::vector<Instruction>& code, const std::vector<uint8_t>& is_target,
+                       size_t i, std::initializer_list<uint8_t> ops) {
+    if (i + ops.size() > code.size()) return false;
+    size_t k = 0;
+    for (uint8_t op : ops) {
+        if (checked_op(code[i + k].op) != op || (k > 0 && is_target[code[i + k].offset])) return false;
+        k++;
+    }
+    return true;
+}
+
+// Calcula as novas posições, reescreve os saltos e grava o código no chunk.
+// 'new_offset' leva cada posição original que ainda começa uma instrução (e
+// o fim do código) à posição nova; as demais ficam -1. Se algo sair do
+// esperado, retorna false sem tocar no chunk.
+static bool encode(Chunk& chunk, const std::vector<Instruction>& code, std::vector<long>& new_offset) {
+    const size_t size = chunk.code.size();
+    new_offset.assign(size + 1, -1);
+    size_t position = 0;
+    for (const Instruction& instruction : code) {
+        new_offset[instruction.offset] = (long)position;
+        position += instruction.length;
+    }
+    new_offset[size] = (long)position;
+
+    std::vector<uint8_t> output;
+    output.reserve(position);
+    for (const Instruction& instruction : code) {
+        size_t at = output.size();
+        output.push_back(instruction.op);
+        for (int i = 1; i < instruction.length; i++) output.push_back(instruction.operands[i - 1]);
+        if (is_jump(instruction.op)) {
+            long target = new_offset[instruction.target];
+            if (target == -1) return false;
+            long end = (long)at + instruction.length;
+            long jump = instruction.op == OP_LOOP ? end - target : target - end;
+            if (jump < 0 || jump > UINT16_MAX) return false;
+            output[end - 2] = (jump >> 8) & 0xff;
+            output[end - 1] = jump & 0xff;
+        }
+    }
+
+    // Os inline caches guardam a posição da sua instrução (para as estatísticas).
+    std::vector<int> cache_offsets;
+    for (const InlineCache& cache : chunk.caches) {
+        if (cache.offset < 0 || (size_t)cache.offset > size || new_offset[cache.offset] == -1) return false;
+        cache_offsets.push_back((int)new_offset[cache.offset]);
+    }
+
+    chunk.code.resize(output.size());
+    if (!output.empty()) std::memcpy(chunk.code.writable_data(), output.data(), output.size());
+    for (size_t i = 0; i < chunk.caches.size(); i++) chunk.caches[i].offset = cache_offsets[i];
+    return true;
+}
+
+// Se algo sair do esperado (bytecode inválido, salto longo demais), o chunk
+// fica como estava: o código novo só é gravado no final.
+void optimize_chunk(Chunk& chunk) {
+    if (!enabled) return;
+    const size_t size = chunk.code.size();
+
+    // 1. Decodifica.
+    std::vector<Instruction> code;
+    std::vector<uint8_t> is_target;
+    if (!decode(chunk, code, is_target)) return;
+
+    // 2. Pares: comparação + OP_NOT, OP_SET_LOCAL + OP_POP (atribuição como statement).
+    std::vector<Instruction> fused;
+    for (size_t i = 0; i < code.size(); i++) {
+        Instruction instruction = code[i];
+        if (i + 1 < code.size() && !is_target[code[i + 1].offset]) {
+            const Instruction& next = code[i + 1];
+            if (next.op == OP_NOT && negated_compare(instruction.op) != OP_COUNT) {
+                instruction.op = negated_compare(instruction.op);
+                fused.push_back(instruction);
+                i++;
+                continue;
+            }
+            if (instruction.op == OP_SET_LOCAL && next.op == OP_POP) {
+                instruction.op = OP_SET_LOCAL_POP;
+                fused.push_back(instruction);
+                i++;
+                continue;
+            }
+        }
+        fused.push_back(instruction);
+    }
+
+    // 3. Comparação + OP_JUMP_IF_FALSE + OP_POP. O salto original chega num
+    //    OP_POP que descarta a condição; o fundido não empilha a condição,
+    //    então passa a saltar para a instrução seguinte a esse OP_POP.
+    code.clear();
+    for (size_t i = 0; i < fused.size(); i++) {
+        Instruction instruction = fused[i];
+        if (compare_jump(instruction.op) != OP_COUNT && i + 2 < fused.size() &&
+            fused[i + 1].op == OP_JUMP_IF_FALSE && fused[i + 2].op == OP_POP &&
+            !is_target[fused[i + 1].offset] && !is_target[fused[i + 2].offset] &&
+            fused[i + 1].target < size && chunk.code[fused[i + 1].target] == OP_POP) {
+            instruction.op = compare_jump(instruction.op);
+            instruction.length = 3;
+            instruction.target = fused[i + 1].target + 1;
+            code.push_back(instruction);
+            i += 2;
+            continue;
+        }
+        code.push_back(instruction);
+    }
+
+    // 4. Superinstruções para laços sobre variáveis locais (ver o perfil de
+    //    pares em debug.h). As instruções absorvidas não podem ser destino
+    //    de salto.
+    fused.clear();
+    for (size_t i = 0; i < code.size(); i++) {
+        Instruction instruction = code[i];
+        if (absorbable(code, is_target, i, {OP_GET_LOCAL, OP_CONSTANT, OP_ADD, OP_SET_LOCAL_POP}) &&
+            code[i].operands[0] == code[i + 3].operands[0]) {
+            instruction.op = OP_INC_LOCAL_CONST;
+            instruction.operands[1] = code[i + 1].operands[0];
+            instruction.length = 3;
+            i += 3;
+        } else if (absorbable(code, is_target, i, {OP_GET_LOCAL, OP_CONSTANT, OP_LESS_JUMP}) ||
+                   absorbable(code, is_target, i, {OP_GET_LOCAL, OP_GET_LOCAL, OP_LESS_JUMP})) {
+            instruction.op = code[i + 1].op == OP_CONSTANT ? OP_LESS_LOCAL_CONST_JUMP : OP_LESS_LOCAL_LOCAL_JUMP;
+            instruction.operands[1] = code[i + 1].operands[0];
+            instruction.length = 5;
+            instruction.target = code[i + 2].target;
+            i += 2;
+        } else if (absorbable(code, is_target, i, {OP_GET_LOCAL, OP_GET_LOCAL, OP_ADD})) {
+            instruction.op = OP_ADD_LOCAL_LOCAL;
+            instruction.operands[1] = code[i + 1].operands[0];
+            instruction.length = 3;
+            i += 2;
+        }
+        fused.push_back(instruction);
+    }
+    code.swap(fused);
+
+    // Posição original -> índice na lista final.
+    std::vector<int> index_at(size + 1, -1);
+    for (size_t i = 0; i < code.size(); i++) index_at[code[i].offset] = (int)i;
+
+    // 5. Encadeamento de saltos: se o destino é um OP_JUMP, vai direto ao
+    //    destino dele (só para a frente; o limite evita ciclos).
+    for (Instruction& instruction : code) {
+        if (!is_forward_jump(instruction.op)) continue;
+        for (int hops = 0; hops < 8; hops++) {
+            int index = index_at[instruction.target];
+            if (index == -1 || code[index].op != OP_JUMP || code[index].target == instruction.target) break;
+            instruction.target = code[index].target;
+        }
+    }
+
+    // 6. Novas posições e escrita. Todo destino precisa ser o início de uma
+    //    instrução que sobreviveu (ou o fim do código).
+    std::vector<long> new_offset;
+    encode(chunk, code, new_offset);
+}
+
+// Índice de 16 bits de uma instrução de global (os dois primeiros operandos).
+static uint16_t global_operand(const Instruction& instruction) {
+    return (uint16_t)((instruction.operands[0] << 8) | instruction.operands[1]);
+}
+
+bool quicken_chunk(Chunk& chunk, const std::vector<uint8_t>& defined, std::vector<size_t>& resume) {
+    std::vector<Instruction> code;
+    std::vector<uint8_t> is_target;
+    if (!decode(chunk, code, is_target)) return false;
+
+    // Os pontos de retomada se comportam como destinos de salto: continuam
+    // começando uma instrução no código novo.
+    std::vector<uint8_t> is_start(chunk.code.size() + 1, 0);
+    for (const Instruction& instruction : code) is_start[instruction.offset] = 1;
+    for (size_t offset : resume) {
+        if (offset >= chunk.code.size() || !is_start[offset]) return false;
+        is_target[offset] = 1;
+    }
+
+    auto is_defined = [&](const Instruction& instruction) {
+        uint16_t slot = global_operand(instruction);
+        return slot < defined.size() && defined[slot];
+    };
+
+    std::vector<Instruction> quick;
+    for (size_t i = 0; i < code.size(); i++) {
+        Instruction instruction = code[i];
+        if (instruction.op == OP_GET_GLOBAL && is_defined(instruction)) {
+            if (absorbable(code, is_target, i, {OP_GET_GLOBAL, OP_CONSTANT, OP_ADD, OP_SET_GLOBAL, OP_POP}) &&
+                global_operand(code[i + 3]) == global_operand(instruction)) {
+                instruction.op = OP_INC_GLOBAL_CONST;
+                instruction.operands[2] = code[i + 1].operands[0];
+                instruction.length = 4;
+                i += 4;
+            } else if (absorbable(code, is_target, i, {OP_GET_GLOBAL, OP_CONSTANT, OP_LESS_JUMP})) {
+                instruction.op = OP_LESS_GLOBAL_CONST_JUMP;
+                instruction.operands[2] = code[i + 1].operands[0];
+                instruction.length = 6;
+                instruction.target = code[i + 2].target;
+                i += 2;
+            } else {
+                instruction.op = OP_GET_GLOBAL_QUICK;
+            }
+        } else if (instruction.op == OP_SET_GLOBAL && is_defined(instruction) &&
+                   absorbable(code, is_target, i, {OP_SET_GLOBAL, OP_POP})) {
+            instruction.op = OP_SET_GLOBAL_POP;
+            i++;
+        }
+        quick.push_back(instruction);
+    }
+
+    std::vector<long> new_offset;
+    if (!encode(chunk, quick, new_offset)) return false;
+    for (size_t& offset : resume) offset = (size_t)new_offset[offset];
+    return true;
+}
\ No newline at end of file
@@ -0,0 +1,36 @@
+#ifndef SAPPHIRE_OPTIMIZER_H
+#define SAPPHIRE_OPTIMIZER_H
+
+#include "chunk.h"
+#include <vector>
+
+// --- Otimizador peephole ---
+// Roda sobre o bytecode de cada função assim que ela termina de ser
+// compilada. Troca sequências comuns por instruções fundidas e por
+// superinstruções de laços sobre locais (ver o fim de opcodes.h), encurta
+// cadeias de saltos (um salto para um OP_JUMP vai direto ao destino final)
+// e recalcula todos os deslocamentos de 16 bits, além das posições
+// guardadas nos inline caches.
+//
+// Ligado por padrão; "--no-peephole" (main.cpp) desliga.
+void set_peephole_enabled(bool enabled);
+bool peephole_enabled();
+
+void optimize_chunk(Chunk& chunk);
+
+// --- Segundo nível (tier-up) ---
+// Quando as chamadas + voltas de laço de uma função chegam a
+// TIER_UP_THRESHOLD (ver VM::count_hotness), o bytecode dela é reescrito com
+// o que só se sabe durante a execução: globais já definidas dispensam a
+// checagem e ganham as instruções aceleradas do fim de opcodes.h. É o que
+// acelera o laço do script principal, que só usa globais.
+//
+// 'resume' traz as posições em que há frames parados no meio desta função
+// (o laço que disparou a troca, chamadas recursivas esperando o retorno);
+// elas continuam começando uma instrução e voltam convertidas para o código
+// novo ("on-stack replacement"). Retorna false, sem mudar nada, se não der.
+#define TIER_UP_THRESHOLD 100
+
+bool quicken_chunk(Chunk& chunk, const std::vector<uint8_t>& defined, std::vector<size_t>& resume);
+
+#endif //SAPPHIRE_OPTIMIZER_H
\ No newline at end of file
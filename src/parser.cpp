@@ -1,10 +1,12 @@
 #include "parser.h"
 #include "opcodes.h"
 #include <iostream>
+#include <charconv>
 #include <map>
-#include <stdexcept>
 #include "object.h"
 #include "debug.h"
+#include "optimizer.h"
+#include "memory.h"
 
 static bool types_are_compatible(TokenType variable_type, TokenType value_type) {
     // Um tipo é sempre compatível com ele mesmo.
@@ -32,15 +34,22 @@ static bool types_are_compatible(TokenType variable_type, TokenType value_type)
 }
 
 // Estrutura do Parser
-Parser::Parser(Lexer& lexer, Compiler* compiler) : lexer(lexer), current_compiler(compiler) {
+Parser::Parser(Lexer& lexer, Compiler* compiler, GlobalTable* globals)
+    : lexer(lexer), current_compiler(compiler), globals(globals) {
     had_error = false;
     panic_mode = false;
     
     // Inicializa o lookahead. Preenche current e next.
     advance();
     advance();
-    
-    initialize_rules();
+}
+
+// Marca a cadeia de compiladores ativa: cada função em construção (e, através
+// dela, sua piscina de constantes) precisa sobreviver a uma coleta.
+void Parser::mark_roots() {
+    for (Compiler* compiler = current_compiler; compiler != nullptr; compiler = compiler->enclosing) {
+        mark_object(compiler->function);
+    }
 }
 
 // Funções de erro
@@ -68,7 +77,7 @@ void Parser::advance() {
     for (;;) {
         next = lexer.scan_token();
         if (next.type != TokenType::ILLEGAL) break;
-        error_at_current("Invalid character: " + next.literal);
+        error_at_current("Invalid character: " + std::string(next.literal));
     }
 }
 bool Parser::check_next(TokenType type) {
@@ -113,21 +122,156 @@ int Parser::emit_jump(uint8_t instruction) {
 }
 
 void Parser::patch_jump(int offset) {
-    int jump = current_chunk()->code.size() - offset - 1;
+    // O salto é relativo ao fim do operando de 16 bits (-2 para pular o próprio operando).
+    int jump = current_chunk()->code.size() - offset - 2;
 
     if (jump > UINT16_MAX) {
         error("Jump is too long to be encoded.");
     }
 
-    current_chunk()->code[offset] = (jump >> 8) & 0xff;
-    current_chunk()->code[offset + 1] = jump & 0xff;
+    current_chunk()->code.patch(offset, (jump >> 8) & 0xff);
+    current_chunk()->code.patch(offset + 1, jump & 0xff);
+}
+
+// --- Dobra de constantes ---
+// O parser é de uma passada só, então a dobra acontece sobre o bytecode já
+// emitido: se o código de um operando é exatamente a carga de uma constante,
+// o operador é avaliado aqui e as cargas são trocadas pelo resultado.
+
+Parser::CodeMark Parser::mark_code() {
+    Chunk* chunk = current_chunk();
+    return { chunk->code.size(), chunk->constants.size(), chunk->caches.size() };
+}
+
+// As constantes e caches criados depois da marca só são usados pelo código
+// emitido depois dela, então podem sair junto com ele.
+void Parser::discard_code(const CodeMark& mark) {
+    Chunk* chunk = current_chunk();
+    if (number_chunk == chunk && number_end > mark.code) number_chunk = nullptr;
+    chunk->code.resize(mark.code);
+    chunk->constants.resize(mark.constants);
+    chunk->caches.resize(mark.caches);
+}
+
+// Se o código entre 'from' e 'to' é só a carga de uma constante, retorna o valor.
+bool Parser::constant_value(const CodeMark& from, size_t to, SapphireValue& value) {
+    const Chunk* chunk = current_chunk();
+    if (to - from.code == 1) {
+        switch (chunk->code[from.code]) {
+            case OP_TRUE:  value = true; return true;
+            case OP_FALSE: value = false; return true;
+            case OP_NIL:   value = SapphireValue(); return true;
+        }
+        return false;
+    }
+    if (to - from.code == 2 && chunk->code[from.code] == OP_CONSTANT) {
+        value = chunk->constants[chunk->code[from.code + 1]];
+        return true;
+    }
+    return false;
+}
+
+// Um literal int usado como double (guardado num double, devolvido por uma
+// função double ou ao lado de um double numa conta) já vira a constante
+// double: o valor é o mesmo, e o código double não passa pelo caminho misto.
+// A constante é só deste OP_CONSTANT (o chunk não reaproveita constantes).
+void Parser::constant_as_double(const CodeMark& from, size_t to) {
+    Chunk* chunk = current_chunk();
+    if (to - from.code == 2 && chunk->code[from.code] == OP_CONSTANT) {
+        SapphireValue& value = chunk->constants[chunk->code[from.code + 1]];
+        if (value.is_int()) value = value.as_number();
+    }
+}
+
+void Parser::emit_value(const SapphireValue& value) {
+    if (value.is_nil()) emit_byte(OP_NIL);
+    else if (value.is_bool()) emit_byte(value.as_bool() ? OP_TRUE : OP_FALSE);
+    else emit_constant(value);
+    if (value.is_number()) note_number();
+}
+
+void Parser::note_number() {
+    number_chunk = current_chunk();
+    number_end = number_chunk->code.size();
+}
+
+// Qualquer instrução emitida depois (uma chamada, um acesso a campo...)
+// muda o fim do código, então o resultado deixa de ser garantido.
+bool Parser::emitted_number() {
+    return number_chunk == current_chunk() && number_end == number_chunk->code.size();
+}
+
+// Avalia o operador como a VM faria. Retorna false (sem mexer no código) se
+// algum operando não for constante ou se a operação daria erro em tempo de
+// execução, que continua sendo reportado pela VM. 'integer_division' é o '/'
+// entre dois int (OP_DIVIDE_INT).
+bool Parser::fold_binary(TokenType operator_type, const CodeMark& left_start, const CodeMark& right_start,
+                         bool integer_division) {
+    SapphireValue a, b;
+    if (!constant_value(left_start, right_start.code, a)) return false;
+    if (!constant_value(right_start, current_chunk()->code.size(), b)) return false;
+
+    bool numbers = a.is_number() && b.is_number();
+    SapphireValue result;
+    switch (operator_type) {
+        case TokenType::PLUS:
+            if (numbers) {
+                result = add_numbers(a, b);
+            } else if (is_obj_type(a, OBJ_STRING) && is_obj_type(b, OBJ_STRING)) {
+                // Os operandos continuam na piscina de constantes durante a alocação.
+                result = new_string(static_cast<ObjString*>(a.as_obj())->chars +
+                                    static_cast<ObjString*>(b.as_obj())->chars);
+            } else {
+                return false;
+            }
+            break;
+        case TokenType::MINUS:         if (!numbers) return false; result = subtract_numbers(a, b); break;
+        case TokenType::STAR:          if (!numbers) return false; result = multiply_numbers(a, b); break;
+        case TokenType::SLASH:
+            if (!numbers) return false;
+            if (!integer_division) {
+                result = divide_numbers(a, b);
+            } else if (b.as_number() != 0) {
+                result = divide_integers(a, b);
+            } else {
+                return false;
+            }
+            break;
+        case TokenType::EQUAL_EQUAL:   result = values_equal(a, b); break;
+        case TokenType::BANG_EQUAL:    result = !values_equal(a, b); break;
+        // Mesma sequência de instruções que binary() emitiria (>= é !(a < b)).
+        case TokenType::GREATER:       if (!numbers) return false; result = a.as_number() > b.as_number(); break;
+        case TokenType::LESS:          if (!numbers) return false; result = a.as_number() < b.as_number(); break;
+        case TokenType::GREATER_EQUAL: if (!numbers) return false; result = !(a.as_number() < b.as_number()); break;
+        case TokenType::LESS_EQUAL:    if (!numbers) return false; result = !(a.as_number() > b.as_number()); break;
+        default: return false;
+    }
+
+    discard_code(left_start);
+    emit_value(result);
+    return true;
 }
 
-uint8_t Parser::argument_list() {
+// Compila um statement; se o ramo nunca executa, ele é analisado (para que
+// os erros ainda apareçam) e o código gerado é descartado.
+void Parser::branch(bool live) {
+    CodeMark mark = mark_code();
+    statement();
+    if (!live) discard_code(mark);
+}
+
+// 'params', se conhecidos, são os tipos dos parâmetros da função chamada:
+// um literal int passado a um parâmetro double já vai como double.
+uint8_t Parser::argument_list(const std::vector<TokenType>* params) {
     uint8_t arg_count = 0;
     if (!check(TokenType::RIGHT_PAREN)) { // Não precisa mais de "parser->"
         do {
+            CodeMark argument_start = mark_code();
             expression(); // Não precisa mais de "parser->"
+            if (params != nullptr && arg_count < params->size() &&
+                ((*params)[arg_count] == TokenType::DOUBLE || (*params)[arg_count] == TokenType::FLOAT)) {
+                constant_as_double(argument_start, current_chunk()->code.size());
+            }
             if (arg_count == 255) {
                 error("You can't have more than 225 arguments!"); // Não precisa mais de "parser->"
             }
@@ -149,13 +293,15 @@ TokenType Parser::parse_precedence(Precedence precedence) {
     }
 
     bool can_assign = precedence <= PREC_ASSIGNMENT;
-    TokenType left_type = prefix_rule(can_assign);
+    CodeMark start = mark_code();
+    TokenType left_type = (this->*prefix_rule)(can_assign);
 
     while (precedence <= get_rule(current.type)->precedence) {
         advance();
         InfixParseFn infix_rule = get_rule(previous.type)->infix;
+        operand_start = start; // Lido por binary() antes de analisar o lado direito
         // PASSA O TIPO ESQUERDO para a regra infixa!
-        left_type = infix_rule(left_type, can_assign);
+        left_type = (this->*infix_rule)(left_type, can_assign);
     }
     
     if (can_assign && match(TokenType::EQUAL)) {
@@ -164,14 +310,90 @@ TokenType Parser::parse_precedence(Precedence precedence) {
 
     return left_type;
 }
-ParseRule* Parser::get_rule(TokenType type) {
-    if (rules.count(type)) return &rules[type];
-    return &rules[TokenType::ILLEGAL]; // Retorna uma regra segura
-}
 
 // Lógica de declaração de variáveis
 uint8_t Parser::identifier_constant(const Token& name) {
-    return make_constant(new_string(name.literal));
+    // Nomes são strings internadas: se o mesmo nome já está na piscina de
+    // constantes, reaproveitamos o índice em vez de criar outra entrada.
+    ObjString* string = new_string(name.literal);
+    const std::vector<SapphireValue>& constants = current_chunk()->constants;
+    for (size_t i = 0; i < constants.size(); i++) {
+        if (constants[i].is_obj() && constants[i].as_obj() == string) return (uint8_t)i;
+    }
+    return make_constant(string);
+}
+
+// Resolve um nome global para o seu slot na tabela de globais da VM.
+uint16_t Parser::global_slot(const Token& name) {
+    int slot = globals->resolve(new_string(name.literal));
+    if (slot == -1) {
+        error("Too many global variables.");
+        return 0;
+    }
+    return (uint16_t)slot;
+}
+
+// Slot de uma global que está sendo declarada. Os nomes dos módulos nativos
+// são reservados: "Math.sqrt(x)" é resolvido na compilação.
+uint16_t Parser::declare_global(const Token& name) {
+    if (is_native_module(name)) {
+        error_at(name, "'" + std::string(name.literal) + "' is a native module and cannot be redeclared.");
+    }
+    return global_slot(name);
+}
+
+bool Parser::is_native_module(const Token& name) {
+    const NativeTable& natives = globals->natives;
+    return natives.modules.find(new_string(name.literal)) != natives.modules.end();
+}
+
+// "Modulo.membro" vira o slot da nativa: uma chamada direta, sem busca de
+// propriedade em runtime, ou a própria nativa como valor.
+TokenType Parser::native_member(const Token& module) {
+    consume(TokenType::DOT, "Expect '.' after module name.");
+    consume(TokenType::IDENTIFIER, "Expect member name after '.'.");
+    Token member = previous;
+    std::string qualified = std::string(module.literal) + "." + std::string(member.literal);
+    int slot = globals->natives.find(new_string(qualified));
+    if (slot == -1) {
+        error("Native module '" + std::string(module.literal) + "' has no member '" + std::string(member.literal) + "'.");
+        return TokenType::ILLEGAL;
+    }
+
+    if (!match(TokenType::LEFT_PAREN)) {
+        emit_global(OP_GET_NATIVE, (uint16_t)slot);
+        return TokenType::ILLEGAL;
+    }
+    uint8_t arg_count = argument_list();
+    int arity = globals->natives.functions[slot]->arity;
+    if (arity != NATIVE_VARIADIC && arg_count != arity) {
+        error(qualified + "() expects " + std::to_string(arity) + (arity == 1 ? " argument" : " arguments") +
+              " but got " + std::to_string(arg_count) + ".");
+    }
+    emit_global(OP_CALL_NATIVE, (uint16_t)slot);
+    emit_byte(arg_count);
+    return TokenType::ILLEGAL;
+}
+
+void Parser::emit_global(uint8_t instruction, uint16_t slot) {
+    emit_byte(instruction);
+    emit_byte((slot >> 8) & 0xff);
+    emit_byte(slot & 0xff);
+}
+
+// Instruções de propriedade levam o nome e o índice (16 bits) do seu inline cache.
+void Parser::emit_property(uint8_t instruction, uint8_t name) {
+    Chunk* chunk = current_chunk();
+    if (chunk->caches.size() > UINT16_MAX) {
+        error("Too many property accesses in one function.");
+    }
+    uint16_t cache = (uint16_t)chunk->caches.size();
+    chunk->caches.emplace_back();
+    chunk->caches.back().offset = (int)chunk->code.size();
+
+    emit_bytes(instruction, name);
+    emit_byte((cache >> 8) & 0xff);
+    emit_byte(cache & 0xff);
 }
 
 void Parser::add_local(Token name, TokenType type) {
@@ -183,6 +405,7 @@ void Parser::add_local(Token name, TokenType type) {
     local->name = name;
     local->depth = -1; // -1 = não inicializada
     local->type = type; // <<< PRONTO! O tipo foi armazenado!
+    local->number = false;
 }
 
 int Parser::resolve_local(Compiler* compiler, const Token& name) {
@@ -218,26 +441,26 @@ void Parser::declare_variable(const Token& name, TokenType type) {
     add_local(name, type);
 }
 
-uint8_t Parser::parse_variable(const std::string& error_message, TokenType type) {
+uint16_t Parser::parse_variable(const std::string& error_message, TokenType type) {
     consume(TokenType::IDENTIFIER, error_message);
 
     // Passa o tipo para a função que declara a variável no escopo atual
     declare_variable(previous, type);
 
     if (current_compiler->scope_depth > 0) return 0;
-    return identifier_constant(previous);
+    return declare_global(previous);
 }
 void Parser::mark_initialized() {
     if (current_compiler->scope_depth == 0) return;
     current_compiler->locals[current_compiler->local_count - 1].depth = current_compiler->scope_depth;
 }
 
-void Parser::define_variable(uint8_t global) {
+void Parser::define_variable(uint16_t global) {
     if (current_compiler->scope_depth > 0) {
         mark_initialized();
         return;
     }
-    emit_bytes(OP_DEFINE_GLOBAL, global);
+    emit_global(OP_DEFINE_GLOBAL, global);
 }
 
 
@@ -270,9 +493,21 @@ void Parser::print_statement() {
 
 void Parser::if_statement() {
     consume(TokenType::LEFT_PAREN, "Esperava '(' depois de 'if'.");
+    CodeMark condition_start = mark_code();
     expression();
     consume(TokenType::RIGHT_PAREN, "Esperava ')' depois da condicao."); 
 
+    // Condição conhecida em tempo de compilação: só o ramo tomado é emitido,
+    // sem saltos nem o teste.
+    SapphireValue condition;
+    if (constant_value(condition_start, current_chunk()->code.size(), condition)) {
+        discard_code(condition_start);
+        bool taken = !is_falsey(condition);
+        branch(taken);
+        if (match(TokenType::ELSE)) branch(!taken);
+        return;
+    }
+
     int then_jump = emit_jump(OP_JUMP_IF_FALSE);
     emit_byte(OP_POP);
 
@@ -293,8 +528,8 @@ void Parser::if_statement() {
 void Parser::emit_loop(int loop_start) {
     emit_byte(OP_LOOP);
     
-    // A correção está aqui: sem o '+ 2'
-    int offset = current_chunk()->code.size() - loop_start; 
+    // +2 para pular o operando de 16 bits, que a VM já terá lido ao saltar.
+    int offset = current_chunk()->code.size() - loop_start + 2;
     
     if (offset > UINT16_MAX) {
         error("Loop too long!");
@@ -306,9 +541,20 @@ void Parser::emit_loop(int loop_start) {
 void Parser::while_statement() {
     int loop_start = current_chunk()->code.size();
     consume(TokenType::LEFT_PAREN, "Expected '(' after 'while'.");
+    CodeMark condition_start = mark_code();
     expression();
     consume(TokenType::RIGHT_PAREN, "Expected ')' after condition.");
 
+    // while (false) não gera nada; while (true) é só o corpo e o salto de volta.
+    SapphireValue condition;
+    if (constant_value(condition_start, current_chunk()->code.size(), condition)) {
+        discard_code(condition_start);
+        bool live = !is_falsey(condition);
+        branch(live);
+        if (live) emit_loop(loop_start);
+        return;
+    }
+
     int exit_jump = emit_jump(OP_JUMP_IF_FALSE);
     
     emit_byte(OP_POP); // Remove a condição para executar o corpo
@@ -352,15 +598,21 @@ void Parser::class_declaration() {
     // 1. SETUP INICIAL DA CLASSE
     consume(TokenType::IDENTIFIER, "Expect class name.");
     Token class_name = previous;
-    uint8_t name_constant = identifier_constant(class_name);
 
     // Registra o nome da classe como um tipo conhecido no escopo global.
     // Isso é crucial para que 'Ponto p = Ponto();' funcione.
-    current_compiler->global_types[class_name.literal] = TokenType::CLASS;
+    current_compiler->global_types[std::string(class_name.literal)] = TokenType::CLASS;
     declare_variable(class_name, TokenType::CLASS);
+    uint16_t global = current_compiler->scope_depth > 0 ? 0 : declare_global(class_name);
 
     // Cria o objeto da classe em tempo de compilação, que será preenchido.
-    ObjClass* klass = new_class(new_string(class_name.literal));
+    // Ele vai logo para a piscina de constantes, o que o mantém vivo para o
+    // coletor de lixo enquanto os métodos são compilados.
+    ObjString* klass_name = new_string(class_name.literal);
+    push_temp_root(klass_name);
+    ObjClass* klass = new_class(klass_name);
+    pop_temp_root();
+    uint8_t klass_constant = make_constant(klass);
 
     consume(TokenType::LEFT_BRACE, "Expect '{' before class body.");
 
@@ -400,7 +652,7 @@ void Parser::class_declaration() {
                     if (!(match(TokenType::INT) || match(TokenType::BOOL) || match(TokenType::STRING) || match(TokenType::DOUBLE) || match(TokenType::FLOAT))) {
                         error_at_current("Expect parameter type.");
                     }
-                    uint8_t param_const = parse_variable("Expect parameter name.", previous.type);
+                    uint16_t param_const = parse_variable("Expect parameter name.", previous.type);
                     define_variable(param_const);
                 } while (match(TokenType::COMMA));
             }
@@ -414,11 +666,13 @@ void Parser::class_declaration() {
             ObjFunction* function = end_compiler_scope();
             
             // Adiciona o método à classe
-            klass->methods[method_name.literal] = new_closure(function);
+            push_temp_root(function);
+            klass->methods[function->name] = new_closure(function);
+            pop_temp_root();
 
         } else {
             // Se não for 'function', é uma declaração de campo.
-            field_declaration();
+            field_declaration(klass);
         }
     }
 
@@ -426,10 +680,10 @@ void Parser::class_declaration() {
 
     // 3. FINALIZAÇÃO
     // Emite a classe (agora completa com todos os métodos) como uma constante.
-    emit_bytes(OP_CONSTANT, make_constant(klass));
+    emit_bytes(OP_CONSTANT, klass_constant);
     
     // Emite o bytecode para definir a variável da classe em tempo de execução.
-    define_variable(name_constant);
+    define_variable(global);
 }
 void Parser::statement() {
     if (match(TokenType::PRINT)) {
@@ -479,8 +733,10 @@ void Parser::declaration_statement() {
     advance(); // Consome o token do tipo (ex: 'double' ou 'Ponto').
 
     // 2. Verifica se é uma declaração de array (nova lógica).
+    bool is_array = false;
     if (match(TokenType::LEFT_BRACKET)) {
         consume(TokenType::RIGHT_BRACKET, "Expect ']' after '[' in array type specifier.");
+        is_array = true;
     }
     
     // 3. Trata nomes de classe como um tipo CLASS.
@@ -494,22 +750,47 @@ void Parser::declaration_statement() {
 
     // 5. O resto da função continua como antes.
     declare_variable(var_name, var_type);
+    bool numeric = var_type == TokenType::INT || var_type == TokenType::DOUBLE || var_type == TokenType::FLOAT;
 
     if (match(TokenType::EQUAL)) {
+        // "int[] xs = [...]": o literal já nasce empacotado no tipo declarado.
+        if (is_array && check(TokenType::LEFT_BRACKET)) {
+            switch (var_type) {
+                case TokenType::INT:    array_hint = ARRAY_INT; break;
+                case TokenType::DOUBLE:
+                case TokenType::FLOAT:  array_hint = ARRAY_DOUBLE; break;
+                case TokenType::BOOL:   array_hint = ARRAY_BOOL; break;
+                default:                break;
+            }
+        }
+        CodeMark value_start = mark_code();
         TokenType rhs_type = expression();
+        if ((var_type == TokenType::DOUBLE || var_type == TokenType::FLOAT) && !is_array) {
+            constant_as_double(value_start, current_chunk()->code.size());
+        }
         if (!types_are_compatible(var_type, rhs_type)) {
             // A verificação agora funciona para literais de array também.
             if (!(var_type == TokenType::CLASS && rhs_type == TokenType::CLASS) && !(rhs_type == TokenType::ILLEGAL)) {
                  error("Incompatible types: Cannot assign this expression to the variable.");
             }
         }
+        // Local numérica começando com um número garantido: as atribuições
+        // seguintes são checadas (variable()), então ela nunca deixa de ser número.
+        if (current_compiler->scope_depth > 0 && numeric && !is_array && emitted_number()) {
+            current_compiler->locals[current_compiler->local_count - 1].number = true;
+        }
     } else {
         emit_byte(OP_NIL);
     }
 
     consume(TokenType::SEMICOLON, "Expected ';' after variable declaration.");
 
-    define_variable(identifier_constant(var_name));
+    // O tipo de uma global numérica vale para as leituras seguintes (ex: '/'
+    // entre int). Os outros tipos continuam desconhecidos, como antes.
+    if (current_compiler->scope_depth == 0 && numeric && !is_array) {
+        current_compiler->global_types[std::string(var_name.literal)] = var_type;
+    }
+    define_variable(current_compiler->scope_depth > 0 ? 0 : declare_global(var_name));
 }
 // Funções de parsing para cada tipo de token
 TokenType Parser::grouping(bool can_assign) {
@@ -519,15 +800,30 @@ TokenType Parser::grouping(bool can_assign) {
     return type;
 }
 TokenType Parser::number(bool can_assign) {
-    try {
-        double value = std::stod(previous.literal);
-        emit_constant(value);
-    } catch (const std::out_of_range&) {
+    // from_chars lê direto da fatia do código-fonte, sem copiar o token.
+    const char* start = previous.literal.data();
+    const char* end = start + previous.literal.size();
+    // Sem ponto decimal, o literal é um int: um inteiro exato se couber na
+    // faixa de int, e um double se não couber.
+    bool integer = previous.literal.find('.') == std::string_view::npos;
+    int64_t integer_value = 0;
+    auto integer_result = std::from_chars(start, end, integer_value);
+    if (integer && integer_result.ec == std::errc() && integer_value <= INT_VALUE_MAX) {
+        emit_constant(SapphireValue::from_int(integer_value));
+        note_number();
+        return TokenType::INT;
+    }
+
+    double value = 0.0;
+    auto result = std::from_chars(start, end, value);
+    if (result.ec == std::errc::result_out_of_range) {
         error("Numeric value out of bounds.");
-        emit_constant(0.0);
+        value = 0.0;
     }
+    emit_constant(value);
+    note_number();
 
-    return TokenType::DOUBLE;
+    return integer ? TokenType::INT : TokenType::DOUBLE;
 }
 
 void Parser::function_declaration() {
@@ -539,7 +835,7 @@ void Parser::function_declaration() {
     }
     TokenType return_type = previous.type;
 
-    uint8_t global = parse_variable("Expect function name.", TokenType::FUNCTION);
+    uint16_t global = parse_variable("Expect function name.", TokenType::FUNCTION);
     mark_initialized();
     
     // CORREÇÃO: Passa o tipo de retorno que acabamos de ler para a função 'function'.
@@ -554,6 +850,7 @@ ObjFunction* Parser::end_compiler_scope() {
     emit_return(); 
     
     ObjFunction* function = current_compiler->function;
+    if (!had_error) optimize_chunk(function->chunk);
 
     // Se DEBUG_PRINT_CODE estiver ativo, imprime o bytecode da função compilada
     #ifdef DEBUG_PRINT_CODE
@@ -583,6 +880,7 @@ void Parser::function(TokenType kind, TokenType return_type) {
 
     // 4. Analisa a lista de parâmetros
     consume(TokenType::LEFT_PAREN, "Expect '(' after function name.");
+    std::vector<TokenType> param_types;
     if (!check(TokenType::RIGHT_PAREN)) {
         do {
             current_compiler->function->arity++;
@@ -596,14 +894,20 @@ void Parser::function(TokenType kind, TokenType return_type) {
                 error_at_current("Expect parameter type.");
             }
             TokenType param_type = previous.type;
+            param_types.push_back(param_type);
 
             // Consome e declara o nome do parâmetro como uma variável local
-            uint8_t param_const = parse_variable("Expect parameter name.", param_type);
+            uint16_t param_const = parse_variable("Expect parameter name.", param_type);
             define_variable(param_const);
 
         } while (match(TokenType::COMMA));
     }
     consume(TokenType::RIGHT_PAREN, "Expect ')' after parameters.");
+    // Uma função global: as chamadas seguintes, e as recursivas no corpo,
+    // conhecem os tipos dos parâmetros.
+    if (compiler.enclosing->scope_depth == 0) {
+        compiler.enclosing->function_params[current_compiler->function->name->chars] = param_types;
+    }
 
     // 5. Analisa o corpo da função
     consume(TokenType::LEFT_BRACE, "Expect '{' before function body.");
@@ -626,7 +930,12 @@ void Parser::return_statement() {
             error("A non-void function must return a value.");
             emit_return();
         } else {
+            CodeMark value_start = mark_code();
             TokenType value_type = expression();
+            TokenType return_type = current_compiler->function_return_type;
+            if (return_type == TokenType::DOUBLE || return_type == TokenType::FLOAT) {
+                constant_as_double(value_start, current_chunk()->code.size());
+            }
             if (!types_are_compatible(current_compiler->function_return_type, value_type)) {
                 error("Return value type does not match function return type.");
             }
@@ -642,7 +951,11 @@ TokenType Parser::string(bool can_assign) {
     return TokenType::STRING;
 }
 TokenType Parser::call(TokenType left_type, bool can_assign) {
-    uint8_t arg_count = argument_list();
+    // O '(' vem logo depois do nome carregado por variable(), então os
+    // parâmetros anotados lá são os desta chamada.
+    const std::vector<TokenType>* params = callee_params;
+    callee_params = nullptr;
+    uint8_t arg_count = argument_list(params);
     emit_bytes(OP_CALL, arg_count);
 
     // Se a chamada for em uma classe, é um construtor. Retorna uma instância da classe.
@@ -656,18 +969,29 @@ TokenType Parser::unary(bool can_assign) {
     TokenType operator_type = previous.type;
     
     // Analisa o operando
+    CodeMark operand = mark_code();
     TokenType operand_type = parse_precedence(PREC_UNARY);
 
-    // Emite o bytecode para a operação
-    switch (operator_type) {
-        case TokenType::MINUS: emit_byte(OP_NEGATE); break;
-        case TokenType::BANG:  emit_byte(OP_NOT); break;
-        default: break;
+    // Operando constante: o resultado é calculado aqui (-NUMERO, !VALOR).
+    SapphireValue value;
+    if (constant_value(operand, current_chunk()->code.size(), value) &&
+        (operator_type == TokenType::BANG || (operator_type == TokenType::MINUS && value.is_number()))) {
+        discard_code(operand);
+        if (operator_type == TokenType::MINUS) emit_value(negate_number(value));
+        else emit_value(is_falsey(value));
+    } else {
+        // Emite o bytecode para a operação
+        switch (operator_type) {
+            case TokenType::MINUS: emit_byte(OP_NEGATE); note_number(); break;
+            case TokenType::BANG:  emit_byte(OP_NOT); break;
+            default: break;
+        }
     }
     
-    // O tipo de uma negação numérica é número, de uma negação lógica é booleano.
+    // O tipo de uma negação numérica é número (int continua int), de uma
+    // negação lógica é booleano.
     if (operator_type == TokenType::MINUS) {
-        return TokenType::DOUBLE; // Ou o tipo do operando, se tivéssemos checagem aqui
+        return operand_type == TokenType::INT ? TokenType::INT : TokenType::DOUBLE;
     }
     return TokenType::BOOL;
 }
@@ -683,8 +1007,21 @@ static TokenType resolve_local_type(Compiler* compiler, const Token& name) {
 }
 TokenType Parser::binary(TokenType left_type, bool can_assign) {
     TokenType operator_type = previous.type;
-    ParseRule* rule = get_rule(operator_type);
+    const ParseRule* rule = get_rule(operator_type);
+    CodeMark left_start = operand_start;
+    CodeMark right_start = mark_code();
+    bool left_number = emitted_number();
     TokenType right_type = parse_precedence((Precedence)(rule->precedence + 1));
+    bool numbers = left_number && emitted_number();
+
+    // Literal int ao lado de um double: a conta é em double de qualquer forma.
+    bool left_double = left_type == TokenType::DOUBLE || left_type == TokenType::FLOAT;
+    bool right_double = right_type == TokenType::DOUBLE || right_type == TokenType::FLOAT;
+    if (left_double && right_type == TokenType::INT) {
+        constant_as_double(right_start, current_chunk()->code.size());
+    } else if (right_double && left_type == TokenType::INT) {
+        constant_as_double(left_start, right_start.code);
+    }
 
     // A lógica de verificação de erro está boa, não precisa mudar.
     if (left_type != TokenType::ILLEGAL && right_type != TokenType::ILLEGAL) {
@@ -710,19 +1047,35 @@ TokenType Parser::binary(TokenType left_type, bool can_assign) {
         }
     }
 
-    // A emissão de bytecode também está boa.
-    switch (operator_type) {
-        case TokenType::PLUS:          emit_byte(OP_ADD); break;
-        case TokenType::MINUS:         emit_byte(OP_SUBTRACT); break;
-        case TokenType::STAR:          emit_byte(OP_MULTIPLY); break;
-        case TokenType::SLASH:         emit_byte(OP_DIVIDE); break;
-        case TokenType::BANG_EQUAL:    emit_bytes(OP_EQUAL, OP_NOT); break;
-        case TokenType::EQUAL_EQUAL:   emit_byte(OP_EQUAL); break;
-        case TokenType::GREATER:       emit_byte(OP_GREATER); break;
-        case TokenType::GREATER_EQUAL: emit_bytes(OP_LESS, OP_NOT); break;
-        case TokenType::LESS:          emit_byte(OP_LESS); break;
-        case TokenType::LESS_EQUAL:    emit_bytes(OP_GREATER, OP_NOT); break;
-        default: return TokenType::ILLEGAL;
+    // Com os dois operandos constantes, o resultado já vem calculado.
+    // Com dois números garantidos, as versões OP_*_NUM dispensam a checagem
+    // de tipos na VM. '-', '*' e '/' sempre produzem um número (ou param a
+    // VM com erro); '+' só quando os dois lados são números.
+    // '/' entre dois int é a divisão inteira (OP_DIVIDE_INT), que checa os
+    // tipos e o divisor zero de qualquer forma.
+    bool integer_division = operator_type == TokenType::SLASH &&
+                            left_type == TokenType::INT && right_type == TokenType::INT;
+    if (!fold_binary(operator_type, left_start, right_start, integer_division)) {
+        uint8_t less = numbers ? OP_LESS_NUM : OP_LESS;
+        uint8_t greater = numbers ? OP_GREATER_NUM : OP_GREATER;
+        uint8_t divide = integer_division ? OP_DIVIDE_INT : numbers ? OP_DIVIDE_NUM : OP_DIVIDE;
+        switch (operator_type) {
+            case TokenType::PLUS:          emit_byte(numbers ? OP_ADD_NUM : OP_ADD); break;
+            case TokenType::MINUS:         emit_byte(numbers ? OP_SUBTRACT_NUM : OP_SUBTRACT); break;
+            case TokenType::STAR:          emit_byte(numbers ? OP_MULTIPLY_NUM : OP_MULTIPLY); break;
+            case TokenType::SLASH:         emit_byte(divide); break;
+            case TokenType::BANG_EQUAL:    emit_bytes(OP_EQUAL, OP_NOT); break;
+            case TokenType::EQUAL_EQUAL:   emit_byte(OP_EQUAL); break;
+            case TokenType::GREATER:       emit_byte(greater); break;
+            case TokenType::GREATER_EQUAL: emit_bytes(less, OP_NOT); break;
+            case TokenType::LESS:          emit_byte(less); break;
+            case TokenType::LESS_EQUAL:    emit_bytes(greater, OP_NOT); break;
+            default: return TokenType::ILLEGAL;
+        }
+        if (operator_type == TokenType::MINUS || operator_type == TokenType::STAR ||
+            operator_type == TokenType::SLASH || (operator_type == TokenType::PLUS && numbers)) {
+            note_number();
+        }
     }
 
     switch (operator_type) {
@@ -772,66 +1125,99 @@ TokenType Parser::variable(bool can_assign) {
     uint8_t get_op, set_op;
     int arg;
     TokenType var_type = TokenType::ILLEGAL;
+    bool number = false;
 
     arg = resolve_local(current_compiler, name);
     if (arg != -1) {
         get_op = OP_GET_LOCAL;
         set_op = OP_SET_LOCAL;
         var_type = resolve_local_type(current_compiler, name);
+        number = current_compiler->locals[arg].number;
+    } else if (check(TokenType::DOT) && is_native_module(name)) {
+        return native_member(name);
     } else {
-        arg = identifier_constant(name);
+        if (can_assign && check(TokenType::EQUAL) && is_native_module(name)) {
+            error("Cannot assign to native module '" + std::string(name.literal) + "'.");
+        }
+        arg = global_slot(name);
         get_op = OP_GET_GLOBAL;
         set_op = OP_SET_GLOBAL;
-        auto it = current_compiler->global_types.find(name.literal);
-        if (it != current_compiler->global_types.end()) {
-            var_type = it->second;
+        // As globais são declaradas no script: uma função enxerga os tipos
+        // registrados pelos compiladores de fora.
+        for (Compiler* compiler = current_compiler; compiler != nullptr; compiler = compiler->enclosing) {
+            auto it = compiler->global_types.find(name.literal);
+            if (it != compiler->global_types.end()) {
+                var_type = it->second;
+                break;
+            }
+            auto params = compiler->function_params.find(name.literal);
+            if (params != compiler->function_params.end()) {
+                if (check(TokenType::LEFT_PAREN)) callee_params = &params->second;
+                break;
+            }
         }
     }
 
     if (can_assign && match(TokenType::EQUAL)) {
+        CodeMark value_start = mark_code();
         TokenType assigned_type = expression();
-        if (var_type != TokenType::ILLEGAL && !types_are_compatible(var_type, assigned_type)) {
+        if (var_type == TokenType::DOUBLE || var_type == TokenType::FLOAT) {
+            constant_as_double(value_start, current_chunk()->code.size());
+        }
+        // Um valor de tipo desconhecido (ILLEGAL, ex: o retorno de uma
+        // chamada) é aceito, como na declaração.
+        if (var_type != TokenType::ILLEGAL && assigned_type != TokenType::ILLEGAL &&
+            !types_are_compatible(var_type, assigned_type)) {
             error("Incompatible types for assignment.");
         }
-        emit_bytes(set_op, (uint8_t)arg);
+        // A local continua guardando só números.
+        if (number && !emitted_number()) emit_byte(OP_CHECK_NUMBER);
+        if (set_op == OP_SET_GLOBAL) emit_global(set_op, (uint16_t)arg);
+        else emit_bytes(set_op, (uint8_t)arg);
+        if (number) note_number();
         return assigned_type;
     }
 
-    emit_bytes(get_op, (uint8_t)arg);
+    if (get_op == OP_GET_GLOBAL) emit_global(get_op, (uint16_t)arg);
+    else emit_bytes(get_op, (uint8_t)arg);
+    if (number) note_number();
     return var_type;
 }
 
-// Inicialização da tabela de regras
-void Parser::initialize_rules() {
-    rules[TokenType::LEFT_PAREN]    = { [this](bool b){ return grouping(b); },      [this](TokenType lhs_type, bool b){ return call(lhs_type, b); }, PREC_CALL };
-    rules[TokenType::DOT]           = { nullptr,                                    [this](TokenType lhs_type, bool b){ return dot(lhs_type, b); },    PREC_CALL };
-    rules[TokenType::MINUS]         = { [this](bool b){ return unary(b); },         [this](TokenType lhs_type, bool b){ return binary(lhs_type, b); }, PREC_TERM };
-    rules[TokenType::PLUS]          = { nullptr,                                    [this](TokenType lhs_type, bool b){ return binary(lhs_type, b); }, PREC_TERM };
-    rules[TokenType::SLASH]         = { nullptr,                                    [this](TokenType lhs_type, bool b){ return binary(lhs_type, b); }, PREC_FACTOR };
-    rules[TokenType::STAR]          = { nullptr,                                    [this](TokenType lhs_type, bool b){ return binary(lhs_type, b); }, PREC_FACTOR };
-    rules[TokenType::EQUAL_EQUAL]   = { nullptr,                                    [this](TokenType lhs_type, bool b){ return binary(lhs_type, b); }, PREC_EQUALITY };
-    rules[TokenType::BANG_EQUAL]    = { nullptr,                                    [this](TokenType lhs_type, bool b){ return binary(lhs_type, b); }, PREC_EQUALITY };
-    rules[TokenType::GREATER]       = { nullptr,                                    [this](TokenType lhs_type, bool b){ return binary(lhs_type, b); }, PREC_COMPARISON };
-    rules[TokenType::GREATER_EQUAL] = { nullptr,                                    [this](TokenType lhs_type, bool b){ return binary(lhs_type, b); }, PREC_COMPARISON };
-    rules[TokenType::LESS]          = { nullptr,                                    [this](TokenType lhs_type, bool b){ return binary(lhs_type, b); }, PREC_COMPARISON };
-    rules[TokenType::LESS_EQUAL]    = { nullptr,                                    [this](TokenType lhs_type, bool b){ return binary(lhs_type, b); }, PREC_COMPARISON };
-    rules[TokenType::BANG]          = { [this](bool b){ return unary(b); },         nullptr, PREC_NONE };
-    rules[TokenType::IDENTIFIER]    = { [this](bool b){ return variable(b); },      nullptr, PREC_NONE };
-    rules[TokenType::NUMBER]        = { [this](bool b){ return number(b); },         nullptr, PREC_NONE };
-    rules[TokenType::STRING_LITERAL]= { [this](bool b){ return string(b); },         nullptr, PREC_NONE };
-    rules[TokenType::FALSE]         = { [this](bool b){ return literal(b); },       nullptr, PREC_NONE };
-    rules[TokenType::TRUE]          = { [this](bool b){ return literal(b); },        nullptr, PREC_NONE };
-    rules[TokenType::NIL]           = { [this](bool b){ return literal(b); },        nullptr, PREC_NONE };
-    rules[TokenType::RIGHT_PAREN]   = { nullptr, nullptr, PREC_NONE };
-    rules[TokenType::LEFT_BRACKET]  = { [this](bool b){ return array_literal(b); }, [this](TokenType l, bool b){ return subscript(l, b); }, PREC_CALL };
-    rules[TokenType::LEFT_BRACE]    = { nullptr, nullptr, PREC_NONE };
-    rules[TokenType::RIGHT_BRACE]   = { nullptr, nullptr, PREC_NONE };
-    rules[TokenType::COMMA]         = { nullptr, nullptr, PREC_NONE };
-    rules[TokenType::EQUAL]         = { nullptr, nullptr, PREC_NONE };
-    rules[TokenType::SEMICOLON]     = { nullptr, nullptr, PREC_NONE };
-    rules[TokenType::THIS]          = { [this](bool b){ return this_expression(b); },nullptr, PREC_NONE };
+// Tabela de regras. Ela é montada por uma função constexpr, então fica pronta
+// em tempo de compilação (inicialização estática), e cada consulta é só um
+// acesso indexado. Tokens sem entrada ficam com a regra vazia.
+constexpr Parser::RuleTable Parser::make_rules() {
+    RuleTable table{};
+    auto rule = [&table](TokenType type, PrefixParseFn prefix, InfixParseFn infix, Precedence precedence) {
+        table[(size_t)type] = { prefix, infix, precedence };
+    };
+    rule(TokenType::LEFT_PAREN,     &Parser::grouping,        &Parser::call,      PREC_CALL);
+    rule(TokenType::DOT,            nullptr,                  &Parser::dot,       PREC_CALL);
+    rule(TokenType::MINUS,          &Parser::unary,           &Parser::binary,    PREC_TERM);
+    rule(TokenType::PLUS,           nullptr,                  &Parser::binary,    PREC_TERM);
+    rule(TokenType::SLASH,          nullptr,                  &Parser::binary,    PREC_FACTOR);
+    rule(TokenType::STAR,           nullptr,                  &Parser::binary,    PREC_FACTOR);
+    rule(TokenType::EQUAL_EQUAL,    nullptr,                  &Parser::binary,    PREC_EQUALITY);
+    rule(TokenType::BANG_EQUAL,     nullptr,                  &Parser::binary,    PREC_EQUALITY);
+    rule(TokenType::GREATER,        nullptr,                  &Parser::binary,    PREC_COMPARISON);
+    rule(TokenType::GREATER_EQUAL,  nullptr,                  &Parser::binary,    PREC_COMPARISON);
+    rule(TokenType::LESS,           nullptr,                  &Parser::binary,    PREC_COMPARISON);
+    rule(TokenType::LESS_EQUAL,     nullptr,                  &Parser::binary,    PREC_COMPARISON);
+    rule(TokenType::BANG,           &Parser::unary,           nullptr,            PREC_NONE);
+    rule(TokenType::IDENTIFIER,     &Parser::variable,        nullptr,            PREC_NONE);
+    rule(TokenType::NUMBER,         &Parser::number,          nullptr,            PREC_NONE);
+    rule(TokenType::STRING_LITERAL, &Parser::string,          nullptr,            PREC_NONE);
+    rule(TokenType::FALSE,          &Parser::literal,         nullptr,            PREC_NONE);
+    rule(TokenType::TRUE,           &Parser::literal,         nullptr,            PREC_NONE);
+    rule(TokenType::NIL,            &Parser::literal,         nullptr,            PREC_NONE);
+    rule(TokenType::LEFT_BRACKET,   &Parser::array_literal,   &Parser::subscript, PREC_CALL);
+    rule(TokenType::THIS,           &Parser::this_expression, nullptr,            PREC_NONE);
+    return table;
 }
 
+const Parser::RuleTable Parser::rules = Parser::make_rules();
+
 // Adicione a implementação da nova função 'dot'
 TokenType Parser::dot(TokenType left_type, bool can_assign) {
     consume(TokenType::IDENTIFIER, "Expect property name after '.'.");
@@ -840,31 +1226,109 @@ TokenType Parser::dot(TokenType left_type, bool can_assign) {
     if (can_assign && match(TokenType::EQUAL)) {
         // Atribuição: p.x = 10
         TokenType rhs_type = expression(); // Analisa o lado direito
-        emit_bytes(OP_SET_PROPERTY, name);
+        emit_property(OP_SET_PROPERTY, name);
         // O tipo de uma expressão de atribuição é o tipo do valor atribuído
         return rhs_type;
     }
+
+    if (match(TokenType::LEFT_PAREN)) {
+        // Chamada direta: p.mover(1, 2). Uma única instrução busca o método e
+        // chama, sem criar o bound method intermediário.
+        uint8_t arg_count = argument_list();
+        emit_property(OP_INVOKE, name);
+        emit_byte(arg_count);
+        return TokenType::ILLEGAL;
+    }
     
     // Leitura: print p.x
-    emit_bytes(OP_GET_PROPERTY, name);
+    emit_property(OP_GET_PROPERTY, name);
     // Em tempo de compilação, não temos como saber o tipo de uma propriedade ainda.
     return TokenType::ILLEGAL; 
 }
 TokenType Parser::array_literal(bool can_assign) {
-    uint8_t element_count = 0;
+    // A dica vale só para este literal, não para os que estiverem dentro dele.
+    uint8_t hint = array_hint;
+    array_hint = ARRAY_INFER;
+
+    // Os elementos constantes do começo (números ou booleanos) não passam pela
+    // pilha: vão empacotados numa string só, lida por OP_ARRAY_LITERAL. O resto
+    // vai para a pilha em lotes, e o primeiro lote cria o array
+    // (OP_BUILD_ARRAY) se não houver parte empacotada; os outros são
+    // acrescentados com OP_ARRAY_APPEND. O tipo final é o mesmo que
+    // build_array escolheria olhando todos os elementos.
+    std::vector<SapphireValue> packed;
+    ArrayKind packed_kind = hint != ARRAY_INFER ? static_cast<ArrayKind>(hint) : ARRAY_VALUE;
+    bool packing = true;
+    bool array_exists = false;
+    uint8_t pending = 0; // Elementos na pilha que ainda não estão no array
+    // Cada lote vira registradores em --vm=register, que tem 255 por função
+    // somando as locais e os temporários abaixo do literal. Lotes pequenos
+    // deixam espaço para eles; um OP_ARRAY_APPEND a mais por lote é barato.
+    constexpr uint8_t batch = 64;
+
+    auto emit_packed = [&]() {
+        ObjString* blob = new_string(pack_array_literal(packed, packed_kind));
+        emit_bytes(OP_ARRAY_LITERAL, make_constant(blob));
+        emit_byte(packed_kind);
+        array_exists = true;
+    };
+    auto flush = [&]() {
+        if (array_exists) {
+            emit_bytes(OP_ARRAY_APPEND, pending);
+        } else {
+            emit_bytes(OP_BUILD_ARRAY, pending);
+            emit_byte(hint);
+            array_exists = true;
+        }
+        pending = 0;
+    };
+
     if (!check(TokenType::RIGHT_BRACKET)) {
         do {
+            CodeMark element = mark_code();
             expression(); // Compila a expressão do elemento, deixando o valor na pilha
-            if (element_count == 255) {
-                error("Cannot have more than 255 elements in an array literal.");
+            if (packing) {
+                SapphireValue value;
+                if (constant_value(element, current_chunk()->code.size(), value)) {
+                    ArrayKind kind = packed.empty() && hint == ARRAY_INFER
+                                         ? (value.is_number() ? ARRAY_DOUBLE : value.is_bool() ? ARRAY_BOOL : ARRAY_VALUE)
+                                         : array_widen(packed_kind, value);
+                    if (kind != ARRAY_VALUE) {
+                        discard_code(element);
+                        packed_kind = kind;
+                        packed.push_back(value);
+                        continue;
+                    }
+                }
+                packing = false;
+                if (!packed.empty()) {
+                    // O array empacotado precisa vir antes deste elemento na
+                    // pilha: o código do elemento sai e volta depois dele (os
+                    // saltos são relativos; os caches guardam a posição).
+                    Chunk* chunk = current_chunk();
+                    std::vector<uint8_t> tail(chunk->code.data() + element.code,
+                                              chunk->code.data() + chunk->code.size());
+                    chunk->code.resize(element.code);
+                    size_t before = chunk->code.size();
+                    emit_packed();
+                    int shift = (int)(chunk->code.size() - before);
+                    for (size_t i = element.caches; i < chunk->caches.size(); i++) chunk->caches[i].offset += shift;
+                    for (uint8_t byte : tail) emit_byte(byte);
+                    number_chunk = nullptr;
+                }
             }
-            element_count++;
+            pending++;
+            if (pending == batch) flush();
         } while (match(TokenType::COMMA));
     }
 
     consume(TokenType::RIGHT_BRACKET, "Expect ']' after array elements.");
-    
-    emit_bytes(OP_BUILD_ARRAY, element_count);
+
+    if (packing && !packed.empty()) {
+        emit_packed();
+    } else if (pending > 0 || !array_exists) {
+        flush();
+    }
 
     // O tipo de um literal de array é, bem, um array.
     // Precisaremos de um tipo para isso no futuro, por enquanto ILLEGAL funciona.
@@ -905,11 +1369,17 @@ TokenType Parser::this_expression(bool can_assign) {
     // O tipo de uma expressão 'this' é a própria classe.
     return TokenType::CLASS;
 }
-void Parser::field_declaration() {
+void Parser::field_declaration(ObjClass* klass) {
     // Consome o tipo (int, double, etc. ou um nome de classe)
     advance(); 
     // Consome o nome do campo
     consume(TokenType::IDENTIFIER, "Expect field name.");
+    // O campo entra na forma inicial da classe: toda instância já nasce com
+    // ele (valendo nil) e com o layout final, sem transições no caminho comum.
+    ObjString* field_name = new_string(previous.literal);
+    if (klass->initial_shape->find(field_name) == -1) {
+        klass->initial_shape = klass->initial_shape->add_field(field_name);
+    }
     // Consome o ponto e vírgula
     consume(TokenType::SEMICOLON, "Expect ';' after field declaration.");
 }
\ No newline at end of file
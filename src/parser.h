@@ -3,29 +3,33 @@
 
 #include "lexer.h"
 #include "compiler.h"
-#include <map>
+#include <array>
 
 class Parser {
 public:
-    Parser(Lexer& lexer, Compiler* compiler);
+    Parser(Lexer& lexer, Compiler* compiler, GlobalTable* globals);
     void advance();
     void declaration();
     bool match(TokenType type);
     void emit_return();
+    void mark_roots();
     bool had_error;
 
 private:
     Lexer& lexer;
     Compiler* current_compiler;
+    GlobalTable* globals;
     Token current;
     Token previous;
     Token next;
     bool panic_mode;
-    std::map<TokenType, ParseRule> rules;
     void function(TokenType kind, TokenType return_type);
     ObjFunction* end_compiler_scope();
 
-    uint8_t argument_list(); 
+    uint8_t argument_list(const std::vector<TokenType>* params = nullptr);
+    // Parâmetros da função global que variable() acabou de carregar, se o
+    // próximo token abre a chamada dela (ver call()).
+    const std::vector<TokenType>* callee_params = nullptr;
     void error_at(const Token& token, const std::string& message);
     void error(const std::string& message);
     void error_at_current(const std::string& message);
@@ -39,9 +43,39 @@ private:
     void emit_constant(const SapphireValue& value);
     int emit_jump(uint8_t instruction);
     void patch_jump(int offset);
+
+    // --- Dobra de constantes e ramos mortos ---
+    // Uma posição no chunk atual. O código emitido depois dela pode ser
+    // descartado, junto com as constantes e os inline caches que ele criou.
+    struct CodeMark {
+        size_t code;
+        size_t constants;
+        size_t caches;
+    };
+    CodeMark operand_start{}; // Início do operando esquerdo do infixo em andamento
+    CodeMark mark_code();
+    void discard_code(const CodeMark& mark);
+    bool constant_value(const CodeMark& from, size_t to, SapphireValue& value);
+    void constant_as_double(const CodeMark& from, size_t to);
+    void emit_value(const SapphireValue& value);
+    bool fold_binary(TokenType operator_type, const CodeMark& left_start, const CodeMark& right_start,
+                     bool integer_division);
+    void branch(bool live);
+
+    // --- Números garantidos ---
+    // Posição do chunk logo depois do código de uma expressão que com certeza
+    // produz um número (literal, local numérica, resultado de '-', '*', '/').
+    // Se o código ainda termina ali, o último operando é um desses.
+    const Chunk* number_chunk = nullptr;
+    size_t number_end = 0;
+    void note_number();
+    bool emitted_number();
     TokenType parse_precedence(Precedence precedence);
-    ParseRule* get_rule(TokenType type);
-    void initialize_rules();
+    // Tabela de regras indexada por TokenType, montada em tempo de compilação.
+    using RuleTable = std::array<ParseRule, (size_t)TokenType::ILLEGAL + 1>;
+    static const RuleTable rules;
+    static constexpr RuleTable make_rules();
+    static const ParseRule* get_rule(TokenType type) { return &rules[(size_t)type]; }
     TokenType expression();
     void statement();
     void block();
@@ -64,20 +98,29 @@ private:
     void class_declaration();
     TokenType dot(TokenType left_type, bool can_assign);
     uint8_t identifier_constant(const Token& name);
+    uint16_t global_slot(const Token& name);
+    uint16_t declare_global(const Token& name);
+    bool is_native_module(const Token& name);
+    TokenType native_member(const Token& module);
+    void emit_global(uint8_t instruction, uint16_t slot);
+    void emit_property(uint8_t instruction, uint8_t name);
     void add_local(Token name, TokenType type);
     int resolve_local(Compiler* compiler, const Token& name);
     void declare_variable(const Token& name, TokenType type);
-    uint8_t parse_variable(const std::string& error_message, TokenType type);
+    uint16_t parse_variable(const std::string& error_message, TokenType type);
     void mark_initialized();
-    void define_variable(uint8_t global);
+    void define_variable(uint16_t global);
     void emit_loop(int loop_start);
     void function_declaration();
     void function(TokenType kind);
     void return_statement();
     TokenType array_literal(bool can_assign);
+    // Tipo dos elementos (ArrayKind) para o literal que inicializa uma
+    // declaração como "int[] xs = [...]"; ARRAY_INFER no resto do tempo.
+    uint8_t array_hint = ARRAY_INFER;
     TokenType subscript(TokenType left_type, bool can_assign);
     TokenType this_expression(bool can_assign);
-    void field_declaration();
+    void field_declaration(ObjClass* klass);
 };
 
 #endif //SAPPHIRE_PARSER_H
\ No newline at end of file
@@ -0,0 +1,629 @@
+#include "register.h"
+#include "chunk.h"
+#include <iostream>
+#include <vector>
+
+// Onde está, durante a tradução, o valor de uma posição da pilha simulada.
+// Invariante: um operando na posição P só referencia registradores <= P, então
+// escrever no registrador do topo nunca destrói um valor ainda pendente.
+struct Operand {
+    bool constant;  // Ainda na piscina de constantes (não carregado)
+    int index;      // Registrador, ou índice da constante
+};
+
+struct Translator {
+    ObjFunction* function;
+    const Chunk& chunk;
+    std::vector<Operand> stack;     // A pilha simulada do bytecode de pilha
+    std::vector<uint8_t> out;       // O código de registradores
+    int register_count = 0;
+    bool ok = true;
+    bool reachable = true;          // false depois de um salto incondicional ou retorno
+    long last_result = -1;          // Byte de destino da última instrução, se ela escreveu no topo
+
+    // Saltos: posições no código de pilha -> no de registradores.
+    std::vector<uint8_t> is_target;
+    std::vector<long> target_of;
+    std::vector<int> depth_at;      // Altura da pilha esperada em cada destino
+    struct Fixup { size_t at; size_t target; };
+    std::vector<Fixup> fixups;      // Saltos para a frente, corrigidos no final
+
+    explicit Translator(ObjFunction* function) : function(function), chunk(function->chunk) {}
+
+    void fail(const char* reason) {
+        if (ok) {
+            std::cerr << "Erro: a funcao '" << (function->name != nullptr ? function->name->chars.c_str() : "<script>")
+                      << "' nao pode usar o backend de registradores: " << reason << "." << std::endl;
+        }
+        ok = false;
+    }
+
+    int top() const { return (int)stack.size() - 1; }
+
+    uint8_t reg(int index) {
+        if (index > UINT8_MAX) {
+            fail("registradores demais");
+            return 0;
+        }
+        if (index + 1 > register_count) register_count = index + 1;
+        return (uint8_t)index;
+    }
+
+    void emit_op(RegisterOp op) {
+        out.push_back(op);
+        last_result = -1;
+    }
+    void emit(uint8_t byte) { out.push_back(byte); }
+    void emit_short(uint16_t value) {
+        out.push_back((value >> 8) & 0xff);
+        out.push_back(value & 0xff);
+    }
+
+    void push(Operand operand) {
+        stack.push_back(operand);
+        reg(top());
+    }
+    Operand pop() {
+        if (stack.empty()) {
+            fail("pilha vazia");
+            return {false, 0};
+        }
+        Operand operand = stack.back();
+        stack.pop_back();
+        return operand;
+    }
+
+    // Garante que o valor da posição está no próprio registrador.
+    void materialize(int position) {
+        Operand& operand = stack[position];
+        if (!operand.constant && operand.index == position) return;
+        emit_op(operand.constant ? R_LOADK : R_MOVE);
+        emit(reg(position));
+        emit((uint8_t)operand.index);
+        operand = {false, position};
+    }
+
+    // Nas fronteiras de bloco (saltos e destinos) todo valor fica no seu
+    // registrador, para que os caminhos que se encontram concordem.
+    void materialize_all() {
+        for (int i = 0; i < (int)stack.size(); i++) materialize(i);
+    }
+
+    // Operando RK para a posição: constante, ou o registrador onde o valor está.
+    uint8_t rk(int position) {
+        if (position < 0 || position > top()) {
+            fail("pilha vazia");
+            return 0;
+        }
+        Operand operand = stack[position];
+        if (operand.constant && operand.index < RK_CONSTANT) return RK_CONSTANT | operand.index;
+        if (operand.constant) {
+            materialize(position);
+            operand = stack[position];
+        }
+        if (operand.index >= RK_CONSTANT) fail("registrador alto demais para um operando RK");
+        return (uint8_t)operand.index;
+    }
+
+    // Operando que precisa ser um registrador.
+    uint8_t source(int position) {
+        if (position < 0 || position > top()) {
+            fail("pilha vazia");
+            return 0;
+        }
+        if (stack[position].constant) materialize(position);
+        return reg(stack[position].index);
+    }
+
+    // A instrução recém-emitida escreveu o resultado no registrador da posição.
+    void result(int position, long destination_byte) {
+        stack[position] = {false, position};
+        last_result = destination_byte;
+    }
+
+    // O valor de uma local, sem copiar: aponta para o mesmo registrador ou constante.
+    Operand local(int slot) {
+        if (slot > top()) {
+            fail("local fora da pilha");
+            return {false, 0};
+        }
+        Operand operand = stack[slot];
+        if (operand.constant || operand.index != slot) return operand;
+        return {false, slot};
+    }
+
+    // Escreve o topo na local 'slot' (OP_SET_LOCAL). O topo continua valendo.
+    void store_local(int slot) {
+        int position = top();
+        if (slot >= position) {
+            fail("local fora da pilha");
+            return;
+        }
+        // Quem ainda aponta para o valor antigo da local recebe uma cópia.
+        for (int i = slot + 1; i < position; i++) {
+            if (!stack[i].constant && stack[i].index == slot) materialize(i);
+        }
+        Operand value = stack[position];
+        if (last_result != -1 && !value.constant && value.index == position) {
+            // "local = a + b": a última instrução escreve direto na local.
+            out[last_result] = reg(slot);
+        } else if (value.constant || value.index != slot) {
+            emit_op(value.constant ? R_LOADK : R_MOVE);
+            emit(reg(slot));
+            emit((uint8_t)value.index);
+        }
+        last_result = -1;
+        stack[slot] = {false, slot};
+        stack[position] = {false, slot};
+    }
+
+    // Tira 'count' posições e deixa 'value' no topo, preservando a invariante.
+    void replace_top(int count, Operand value) {
+        for (int i = 0; i < count; i++) pop();
+        push(value);
+        if (!value.constant && value.index > top()) materialize(top());
+    }
+
+    void binary(RegisterOp op) {
+        int position = top() - 1;
+        if (position < 0) {
+            fail("pilha vazia");
+            return;
+        }
+        uint8_t b = rk(position + 1);
+        uint8_t a = rk(position);
+        pop();
+        emit_op(op);
+        long destination = (long)out.size();
+        emit(reg(position));
+        emit(a);
+        emit(b);
+        result(position, destination);
+    }
+
+    void unary(RegisterOp op) {
+        int position = top();
+        uint8_t a = rk(position);
+        if (!ok) return;
+        emit_op(op);
+        long destination = (long)out.size();
+        emit(reg(position));
+        emit(a);
+        result(position, destination);
+    }
+
+    // Um valor novo no topo, escrito por uma instrução com destino A.
+    void load(RegisterOp op) {
+        push({false, (int)stack.size()});
+        emit_op(op);
+        long destination = (long)out.size();
+        emit(reg(top()));
+        result(top(), destination);
+    }
+
+    void forward_jump(size_t target) {
+        if (target >= depth_at.size()) {
+            fail("salto invalido");
+            return;
+        }
+        if (depth_at[target] == -1) depth_at[target] = (int)stack.size();
+        else if (depth_at[target] != (int)stack.size()) fail("altura da pilha diferente entre caminhos");
+        fixups.push_back({out.size(), target});
+        emit_short(0);
+    }
+
+    // Comparação + salto (as instruções fundidas do otimizador).
+    void compare_jump(RegisterOp op, size_t target) {
+        int position = top() - 1;
+        if (position < 0) {
+            fail("pilha vazia");
+            return;
+        }
+        uint8_t b = rk(position + 1);
+        uint8_t a = rk(position);
+        pop();
+        pop();
+        materialize_all();
+        emit_op(op);
+        emit(a);
+        emit(b);
+        forward_jump(target);
+    }
+
+    // Materializa os argumentos de uma chamada: o chamado usa essas posições
+    // como os seus próprios registradores.
+    int call_base(int arg_count) {
+        int base = (int)stack.size() - arg_count - 1;
+        if (base < 0) {
+            fail("pilha vazia");
+            return 0;
+        }
+        for (int i = base; i < (int)stack.size(); i++) materialize(i);
+        return base;
+    }
+
+    bool run();
+};
+
+static bool is_forward_jump(uint8_t op) {
+    switch (op) {
+        case OP_JUMP: case OP_JUMP_IF_FALSE:
+        case OP_EQUAL_JUMP: case OP_NOT_EQUAL_JUMP: case OP_GREATER_JUMP:
+        case OP_GREATER_EQUAL_JUMP: case OP_LESS_JUMP: case OP_LESS_EQUAL_JUMP:
+        case OP_LESS_LOCAL_CONST_JUMP: case OP_LESS_LOCAL_LOCAL_JUMP:
+        case OP_LESS_GLOBAL_CONST_JUMP:
+            return true;
+    }
+    return false;
+}
+
+bool Translator::run() {
+    const uint8_t* code = chunk.code.data();
+    const size_t size = chunk.code.size();
+
+    // Os destinos de salto são fronteiras de bloco.
+    is_target.assign(size + 1, 0);
+    target_of.assign(size + 1, -1);
+    depth_at.assign(size + 1, -1);
+    for (size_t offset = 0; offset < size;) {
+        uint8_t op = code[offset];
+        int length = instruction_length(op);
+        if (length == 0 || offset + length > size) {
+            fail("bytecode invalido");
+            return false;
+        }
+        if (is_forward_jump(op) || op == OP_LOOP) {
+            size_t end = offset + length;
+            size_t jump = (size_t)((code[end - 2] << 8) | code[end - 1]);
+            size_t target = op == OP_LOOP ? end - jump : end + jump;
+            if (target > size) {
+                fail("salto invalido");
+                return false;
+            }
+            is_target[target] = 1;
+        }
+        offset += length;
+    }
+
+    // Slot 0 (a função ou 'this') e os parâmetros já chegam nos registradores.
+    for (int i = 0; i <= function->arity; i++) push({false, i});
+
+    for (size_t offset = 0; offset < size && ok;) {
+        uint8_t op = code[offset];
+        int length = instruction_length(op);
+        const uint8_t* operands = code + offset + 1;
+        size_t end = offset + length;
+        size_t jump_target = is_forward_jump(op) ? end + (size_t)((code[end - 2] << 8) | code[end - 1]) : 0;
+
+        if (is_target[offset]) {
+            if (reachable) materialize_all();
+            if (!reachable && depth_at[offset] != -1) {
+                // Só se chega aqui por salto: a pilha tem a altura registrada
+                // nele, com tudo nos registradores.
+                stack.clear();
+                for (int i = 0; i < depth_at[offset]; i++) push({false, i});
+            } else if (depth_at[offset] != -1 && depth_at[offset] != (int)stack.size()) {
+                fail("altura da pilha diferente entre caminhos");
+                break;
+            }
+            depth_at[offset] = (int)stack.size();
+            target_of[offset] = (long)out.size();
+            last_result = -1;
+            reachable = true;
+        }
+        // Código morto (depois de um 'return', por exemplo) não é traduzido.
+        if (!reachable) {
+            offset = end;
+            continue;
+        }
+
+        switch (op) {
+            case OP_CONSTANT: push({true, operands[0]}); break;
+            case OP_NIL:      load(R_NIL); break;
+            case OP_TRUE:     load(R_TRUE); break;
+            case OP_FALSE:    load(R_FALSE); break;
+            case OP_POP:      pop(); break;
+
+            case OP_GET_LOCAL: push(local(operands[0])); break;
+            case OP_SET_LOCAL: store_local(operands[0]); break;
+            case OP_SET_LOCAL_POP:
+                store_local(operands[0]);
+                pop();
+                break;
+
+            // As instruções aceleradas (tier-up do backend de pilha) voltam às
+            // genéricas, que também servem para globais já definidas.
+            case OP_GET_GLOBAL:
+            case OP_GET_GLOBAL_QUICK:
+                load(R_GET_GLOBAL);
+                emit(operands[0]);
+                emit(operands[1]);
+                break;
+            case OP_SET_GLOBAL:
+            case OP_SET_GLOBAL_POP:
+            case OP_DEFINE_GLOBAL: {
+                uint8_t value = rk(top());
+                emit_op(op == OP_DEFINE_GLOBAL ? R_DEFINE_GLOBAL : R_SET_GLOBAL);
+                emit(value);
+                emit(operands[0]);
+                emit(operands[1]);
+                if (op != OP_SET_GLOBAL) pop();
+                break;
+            }
+            case OP_INC_GLOBAL_CONST: {
+                load(R_GET_GLOBAL);
+                emit(operands[0]);
+                emit(operands[1]);
+                push({true, operands[2]});
+                binary(R_ADD);
+                uint8_t value = rk(top());
+                emit_op(R_SET_GLOBAL);
+                emit(value);
+                emit(operands[0]);
+                emit(operands[1]);
+                pop();
+                break;
+            }
+            case OP_LESS_GLOBAL_CONST_JUMP:
+                load(R_GET_GLOBAL);
+                emit(operands[0]);
+                emit(operands[1]);
+                push({true, operands[2]});
+                compare_jump(R_LESS_JUMP, jump_target);
+                break;
+
+            case OP_GET_PROPERTY: {
+                int position = top();
+                uint8_t object = source(position);
+                emit_op(R_GET_PROPERTY);
+                long destination = (long)out.size();
+                emit(reg(position));
+                emit(object);
+                emit(operands[0]);
+                emit(operands[1]);
+                emit(operands[2]);
+                result(position, destination);
+                break;
+            }
+            case OP_SET_PROPERTY: {
+                int position = top();
+                uint8_t value = rk(position);
+                uint8_t object = source(position - 1);
+                emit_op(R_SET_PROPERTY);
+                emit(object);
+                emit(value);
+                emit(operands[0]);
+                emit(operands[1]);
+                emit(operands[2]);
+                replace_top(2, stack[position]);
+                break;
+            }
+            case OP_GET_SUBSCRIPT: {
+                int position = top() - 1;
+                uint8_t index = rk(position + 1);
+                uint8_t array = source(position);
+                pop();
+                emit_op(R_GET_SUBSCRIPT);
+                long destination = (long)out.size();
+                emit(reg(position));
+                emit(array);
+                emit(index);
+                result(position, destination);
+                break;
+            }
+            case OP_SET_SUBSCRIPT: {
+                int position = top();
+                uint8_t value = rk(position);
+                uint8_t index = rk(position - 1);
+                uint8_t array = source(position - 2);
+                emit_op(R_SET_SUBSCRIPT);
+                emit(array);
+                emit(index);
+                emit(value);
+                replace_top(3, stack[position]);
+                break;
+            }
+
+            case OP_EQUAL:         binary(R_EQUAL); break;
+            case OP_NOT_EQUAL:     binary(R_NOT_EQUAL); break;
+            case OP_GREATER:       binary(R_GREATER); break;
+            case OP_GREATER_EQUAL: binary(R_GREATER_EQUAL); break;
+            case OP_LESS:          binary(R_LESS); break;
+            case OP_LESS_EQUAL:    binary(R_LESS_EQUAL); break;
+            case OP_ADD:           binary(R_ADD); break;
+            case OP_SUBTRACT:      binary(R_SUBTRACT); break;
+            case OP_MULTIPLY:      binary(R_MULTIPLY); break;
+            case OP_DIVIDE:        binary(R_DIVIDE); break;
+            case OP_NOT:           unary(R_NOT); break;
+            case OP_NEGATE:        unary(R_NEGATE); break;
+            case OP_ADD_NUM:       binary(R_ADD_NUM); break;
+            case OP_SUBTRACT_NUM:  binary(R_SUBTRACT_NUM); break;
+            case OP_MULTIPLY_NUM:  binary(R_MULTIPLY_NUM); break;
+            case OP_DIVIDE_NUM:    binary(R_DIVIDE_NUM); break;
+            case OP_DIVIDE_INT:    binary(R_DIVIDE_INT); break;
+            case OP_GREATER_NUM:   binary(R_GREATER_NUM); break;
+            case OP_LESS_NUM:      binary(R_LESS_NUM); break;
+            case OP_CHECK_NUMBER: {
+                uint8_t value = rk(top());
+                emit_op(R_CHECK_NUMBER);
+                emit(value);
+                break;
+            }
+
+            // Superinstruções do otimizador: voltam a ser operações sobre locais.
+            case OP_ADD_LOCAL_LOCAL:
+                push(local(operands[0]));
+                push(local(operands[1]));
+                binary(R_ADD);
+                break;
+            case OP_INC_LOCAL_CONST:
+                push(local(operands[0]));
+                push({true, operands[1]});
+                binary(R_ADD);
+                store_local(operands[0]);
+                pop();
+                break;
+
+            case OP_PRINT: {
+                uint8_t value = rk(top());
+                emit_op(R_PRINT);
+                emit(value);
+                pop();
+                break;
+            }
+
+            case OP_JUMP:
+                materialize_all();
+                emit_op(R_JUMP);
+                forward_jump(jump_target);
+                reachable = false;
+                break;
+            case OP_JUMP_IF_FALSE: {
+                materialize_all();
+                uint8_t condition = rk(top());
+                emit_op(R_JUMP_IF_FALSE);
+                emit(condition);
+                forward_jump(jump_target);
+                break;
+            }
+            case OP_LOOP: {
+                size_t target = end - (size_t)((operands[0] << 8) | operands[1]);
+                materialize_all();
+                if (target_of[target] == -1 || depth_at[target] != (int)stack.size()) {
+                    fail("laco invalido");
+                    break;
+                }
+                emit_op(R_LOOP);
+                size_t distance = out.size() + 2 - (size_t)target_of[target];
+                if (distance > UINT16_MAX) fail("laco longo demais");
+                emit_short((uint16_t)distance);
+                reachable = false;
+                break;
+            }
+            case OP_EQUAL_JUMP:         compare_jump(R_EQUAL_JUMP, jump_target); break;
+            case OP_NOT_EQUAL_JUMP:     compare_jump(R_NOT_EQUAL_JUMP, jump_target); break;
+            case OP_GREATER_JUMP:       compare_jump(R_GREATER_JUMP, jump_target); break;
+            case OP_GREATER_EQUAL_JUMP: compare_jump(R_GREATER_EQUAL_JUMP, jump_target); break;
+            case OP_LESS_JUMP:          compare_jump(R_LESS_JUMP, jump_target); break;
+            case OP_LESS_EQUAL_JUMP:    compare_jump(R_LESS_EQUAL_JUMP, jump_target); break;
+            case OP_LESS_LOCAL_CONST_JUMP:
+                push(local(operands[0]));
+                push({true, operands[1]});
+                compare_jump(R_LESS_JUMP, jump_target);
+                break;
+            case OP_LESS_LOCAL_LOCAL_JUMP:
+                push(local(operands[0]));
+                push(local(operands[1]));
+                compare_jump(R_LESS_JUMP, jump_target);
+                break;
+
+            case OP_CLOSURE:
+                load(R_CLOSURE);
+                emit(operands[0]);
+                break;
+            case OP_CALL: {
+                int base = call_base(operands[0]);
+                emit_op(R_CALL);
+                emit(reg(base));
+                emit(operands[0]);
+                replace_top(operands[0] + 1, {false, base});
+                break;
+            }
+            case OP_GET_NATIVE:
+                load(R_GET_NATIVE);
+                emit(operands[0]);
+                emit(operands[1]);
+                break;
+            case OP_CALL_NATIVE: {
+                // Sem o chamado na pilha: os argumentos ocupam a base.
+                int base = call_base(operands[2] - 1);
+                emit_op(R_CALL_NATIVE);
+                emit(reg(base));
+                emit(operands[0]);
+                emit(operands[1]);
+                emit(operands[2]);
+                replace_top(operands[2], {false, base});
+                break;
+            }
+            case OP_INVOKE: {
+                int base = call_base(operands[3]);
+                emit_op(R_INVOKE);
+                emit(reg(base));
+                emit(operands[0]);
+                emit(operands[1]);
+                emit(operands[2]);
+                emit(operands[3]);
+                replace_top(operands[3] + 1, {false, base});
+                break;
+            }
+            case OP_BUILD_ARRAY: {
+                int first = (int)stack.size() - operands[0];
+                if (first < 0) {
+                    fail("pilha vazia");
+                    break;
+                }
+                for (int i = first; i < (int)stack.size(); i++) materialize(i);
+                emit_op(R_BUILD_ARRAY);
+                emit(reg(first));
+                emit(operands[0]);
+                emit(operands[1]);
+                replace_top(operands[0], {false, first});
+                break;
+            }
+            case OP_ARRAY_LITERAL:
+                load(R_ARRAY_LITERAL);
+                emit(operands[0]);
+                emit(operands[1]);
+                break;
+            case OP_ARRAY_APPEND: {
+                // O array fica logo abaixo dos elementos.
+                int array = (int)stack.size() - operands[0] - 1;
+                if (array < 0) {
+                    fail("pilha vazia");
+                    break;
+                }
+                for (int i = array; i < (int)stack.size(); i++) materialize(i);
+                emit_op(R_ARRAY_APPEND);
+                emit(reg(array));
+                emit(operands[0]);
+                replace_top(operands[0] + 1, {false, array});
+                break;
+            }
+            case OP_RETURN: {
+                uint8_t value = rk(top());
+                emit_op(R_RETURN);
+                emit(value);
+                reachable = false;
+                break;
+            }
+
+            default:
+                fail("instrucao sem traducao");
+                break;
+        }
+        offset = end;
+    }
+    if (!ok) return false;
+
+    // Um salto pode cair logo depois da última instrução.
+    if (is_target[size]) target_of[size] = (long)out.size();
+    for (const Fixup& fixup : fixups) {
+        long target = target_of[fixup.target];
+        long distance = target - (long)(fixup.at + 2);
+        if (target == -1 || distance < 0 || distance > UINT16_MAX) {
+            fail("salto invalido");
+            return false;
+        }
+        out[fixup.at] = (distance >> 8) & 0xff;
+        out[fixup.at + 1] = distance & 0xff;
+    }
+    return true;
+}
+
+bool translate_to_registers(ObjFunction* function) {
+    Translator translator(function);
+    if (!translator.run()) return false;
+    function->chunk.register_code = std::move(translator.out);
+    function->chunk.register_count = (uint16_t)translator.register_count;
+    return true;
+}
\ No newline at end of file
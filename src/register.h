@@ -0,0 +1,114 @@
+#ifndef SAPPHIRE_REGISTER_H
+#define SAPPHIRE_REGISTER_H
+
+#include "object.h"
+#include <cstdint>
+
+// --- Backend de registradores ---
+// Alternativa à VM de pilha, escolhida na linha de comando (--vm=register).
+// O compilador continua gerando o bytecode de pilha (que segue sendo a
+// referência, e é o que vai para .spc/.spi); na primeira chamada de cada
+// função ele é traduzido para instruções de três endereços sobre
+// registradores virtuais.
+//
+// Registrador N é a posição N da pilha do frame: as variáveis locais já têm
+// posição fixa e viram registradores, e os temporários de cada expressão
+// ocupam as posições acima delas. A tradução simula a pilha e adia os
+// GET_LOCAL/CONSTANT até o uso, então "a + 1" vira um único R_ADD que lê
+// direto o registrador de 'a' e a constante.
+//
+// Operandos "RK" (1 byte): com o bit 7 ligado, índice na piscina de
+// constantes; sem ele, registrador. Por isso constantes e registradores
+// usados como RK ficam limitados a 128 (a tradução carrega constantes
+// maiores num registrador antes).
+#define RK_CONSTANT 0x80
+
+enum RegisterOp : uint8_t {
+    R_MOVE,            // A B      A = B
+    R_LOADK,           // A K      A = constante K
+    R_NIL,             // A
+    R_TRUE,            // A
+    R_FALSE,           // A
+    R_GET_GLOBAL,      // A G16
+    R_SET_GLOBAL,      // RK G16
+    R_DEFINE_GLOBAL,   // RK G16
+    R_GET_PROPERTY,    // A B nome C16     A = B.nome
+    R_SET_PROPERTY,    // A RK nome C16    A.nome = RK
+    R_GET_SUBSCRIPT,   // A B RK           A = B[RK]
+    R_SET_SUBSCRIPT,   // A RK RK          A[RK] = RK
+    R_EQUAL,           // A RK RK
+    R_NOT_EQUAL,
+    R_GREATER,
+    R_GREATER_EQUAL,
+    R_LESS,
+    R_LESS_EQUAL,
+    R_ADD,
+    R_SUBTRACT,
+    R_MULTIPLY,
+    R_DIVIDE,
+    R_NOT,             // A RK
+    R_NEGATE,          // A RK
+    R_PRINT,           // RK
+    R_JUMP,            // S16 (para a frente)
+    R_LOOP,            // S16 (para trás)
+    R_JUMP_IF_FALSE,   // RK S16
+    // Comparação e salto: saltam se o resultado for falso.
+    R_EQUAL_JUMP,      // RK RK S16
+    R_NOT_EQUAL_JUMP,
+    R_GREATER_JUMP,
+    R_GREATER_EQUAL_JUMP,
+    R_LESS_JUMP,
+    R_LESS_EQUAL_JUMP,
+    R_CLOSURE,         // A K
+    R_CALL,            // A N       chamada em A com argumentos em A+1..A+N; resultado em A
+    R_INVOKE,          // A nome C16 N
+    R_BUILD_ARRAY,     // A N K     A = [A..A+N-1], K como em OP_BUILD_ARRAY
+    R_RETURN,          // RK
+    // Operandos numéricos garantidos (OP_*_NUM): sem checagem de tipo.
+    R_ADD_NUM,         // A RK RK
+    R_SUBTRACT_NUM,
+    R_MULTIPLY_NUM,
+    R_DIVIDE_NUM,
+    R_GREATER_NUM,
+    R_LESS_NUM,
+    R_CHECK_NUMBER,    // RK
+    R_GET_NATIVE,      // A N16
+    R_CALL_NATIVE,     // A N16 C    nativa N com argumentos em A..A+C-1; resultado em A
+    R_ARRAY_LITERAL,   // A K T      A = array empacotado na constante K, do tipo T
+    R_ARRAY_APPEND,    // A N        acrescenta A+1..A+N ao array em A
+    R_DIVIDE_INT,      // A RK RK    divisão inteira (OP_DIVIDE_INT)
+    R_COUNT
+};
+
+// Tamanho em bytes de uma instrução de registradores (0 se desconhecida).
+static inline int register_instruction_length(uint8_t instruction) {
+    switch (instruction) {
+        case R_RETURN: case R_PRINT: case R_NIL: case R_TRUE: case R_FALSE: case R_CHECK_NUMBER:
+            return 2;
+        case R_MOVE: case R_LOADK: case R_NOT: case R_NEGATE: case R_JUMP: case R_LOOP:
+        case R_CLOSURE: case R_CALL: case R_ARRAY_APPEND:
+            return 3;
+        case R_GET_GLOBAL: case R_SET_GLOBAL: case R_DEFINE_GLOBAL: case R_JUMP_IF_FALSE:
+        case R_GET_SUBSCRIPT: case R_SET_SUBSCRIPT:
+        case R_EQUAL: case R_NOT_EQUAL: case R_GREATER: case R_GREATER_EQUAL:
+        case R_LESS: case R_LESS_EQUAL: case R_ADD: case R_SUBTRACT: case R_MULTIPLY: case R_DIVIDE:
+        case R_ADD_NUM: case R_SUBTRACT_NUM: case R_MULTIPLY_NUM: case R_DIVIDE_NUM:
+        case R_GREATER_NUM: case R_LESS_NUM: case R_GET_NATIVE: case R_BUILD_ARRAY:
+        case R_ARRAY_LITERAL: case R_DIVIDE_INT:
+            return 4;
+        case R_EQUAL_JUMP: case R_NOT_EQUAL_JUMP: case R_GREATER_JUMP:
+        case R_GREATER_EQUAL_JUMP: case R_LESS_JUMP: case R_LESS_EQUAL_JUMP:
+        case R_CALL_NATIVE:
+            return 5;
+        case R_GET_PROPERTY: case R_SET_PROPERTY: case R_INVOKE:
+            return 6;
+    }
+    return 0;
+}
+
+// Preenche function->chunk.register_code a partir do bytecode de pilha.
+// Retorna false (com a mensagem em std::cerr) se a função não couber nos
+// limites do formato.
+bool translate_to_registers(ObjFunction* function);
+
+#endif //SAPPHIRE_REGISTER_H
\ No newline at end of file
@@ -0,0 +1,593 @@
+#include "serializer.h"
+#include "memory.h"
+#include "vm.h"
+#include "optimizer.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+// Tags das constantes no arquivo.
+enum SpcTag : uint8_t {
+    SPC_NIL,
+    SPC_FALSE,
+    SPC_TRUE,
+    SPC_NUMBER,
+    SPC_STRING,
+    SPC_FUNCTION,
+    SPC_CLASS,
+    SPC_INT,
+};
+
+static const uint32_t NO_NAME = 0xFFFFFFFF;
+
+// --- Escrita ---
+
+static void write_u8(std::ostream& out, uint8_t value) {
+    out.put((char)value);
+}
+
+static void write_u32(std::ostream& out, uint32_t value) {
+    for (int i = 0; i < 4; i++) write_u8(out, (value >> (8 * i)) & 0xff);
+}
+
+static void write_u64(std::ostream& out, uint64_t value) {
+    for (int i = 0; i < 8; i++) write_u8(out, (value >> (8 * i)) & 0xff);
+}
+
+static void write_string(std::ostream& out, const ObjString* string) {
+    if (string == nullptr) {
+        write_u32(out, NO_NAME);
+        return;
+    }
+    write_u32(out, (uint32_t)string->chars.size());
+    out.write(string->chars.data(), string->chars.size());
+}
+
+static bool write_function(std::ostream& out, ObjFunction* function);
+
+// Os campos declarados são o caminho da forma inicial até a raiz.
+static void write_class(std::ostream& out, ObjClass* klass) {
+    write_string(out, klass->name);
+
+    std::vector<ObjString*> fields(klass->initial_shape->slots.size());
+    for (auto& entry : klass->initial_shape->slots) fields[entry.second] = entry.first;
+    write_u32(out, (uint32_t)fields.size());
+    for (ObjString* field : fields) write_string(out, field);
+
+    write_u32(out, (uint32_t)klass->methods.size());
+    for (auto& entry : klass->methods) {
+        write_string(out, entry.first);
+        write_function(out, entry.second->function);
+    }
+}
+
+static bool write_constant(std::ostream& out, const SapphireValue& value) {
+    if (value.is_nil()) {
+        write_u8(out, SPC_NIL);
+    } else if (value.is_bool()) {
+        write_u8(out, value.as_bool() ? SPC_TRUE : SPC_FALSE);
+    } else if (value.is_int()) {
+        write_u8(out, SPC_INT);
+        write_u64(out, (uint64_t)value.as_int());
+    } else if (value.is_number()) {
+        double number = value.as_number();
+        uint64_t bits;
+        std::memcpy(&bits, &number, sizeof(double));
+        write_u8(out, SPC_NUMBER);
+        write_u64(out, bits);
+    } else if (is_obj_type(value, OBJ_STRING)) {
+        write_u8(out, SPC_STRING);
+        write_string(out, static_cast<ObjString*>(value.as_obj()));
+    } else if (is_obj_type(value, OBJ_FUNCTION)) {
+        write_u8(out, SPC_FUNCTION);
+        return write_function(out, static_cast<ObjFunction*>(value.as_obj()));
+    } else if (is_obj_type(value, OBJ_CLASS)) {
+        write_u8(out, SPC_CLASS);
+        write_class(out, static_cast<ObjClass*>(value.as_obj()));
+    } else {
+        std::cerr << "Erro: Constante do tipo " << get_value_type_name(value)
+                  << " nao pode ser serializada." << std::endl;
+        return false;
+    }
+    return true;
+}
+
+static bool write_function(std::ostream& out, ObjFunction* function) {
+    write_u32(out, (uint32_t)function->arity);
+    write_string(out, function->name);
+
+    const Chunk& chunk = function->chunk;
+    write_u32(out, (uint32_t)chunk.code.size());
+    out.write(reinterpret_cast<const char*>(chunk.code.data()), chunk.code.size());
+
+    write_u32(out, (uint32_t)chunk.constants.size());
+    for (const SapphireValue& constant : chunk.constants) {
+        if (!write_constant(out, constant)) return false;
+    }
+    return true;
+}
+
+bool write_bytecode(std::ostream& out, ObjFunction* function, const GlobalTable& globals) {
+    out.write("SPHC", 4);
+    write_u32(out, SPC_VERSION);
+    write_u32(out, OP_COUNT);
+
+    write_u32(out, (uint32_t)globals.names.size());
+    for (ObjString* name : globals.names) write_string(out, name);
+    write_u32(out, (uint32_t)globals.natives.names.size());
+    for (ObjString* name : globals.natives.names) write_string(out, name);
+
+    if (!write_function(out, function)) return false;
+    return (bool)out;
+}
+
+// --- Leitura ---
+
+// Estado da leitura. Qualquer erro marca 'failed'; as funções seguintes
+// passam a ler zeros e o resultado final é descartado.
+struct Reader {
+    std::istream& in;
+    std::vector<uint16_t> global_remap; // Slot no arquivo -> slot na VM
+    std::vector<uint16_t> native_remap; // Idem, para as nativas
+    bool failed = false;
+
+    explicit Reader(std::istream& in) : in(in) {}
+
+    uint8_t u8() {
+        int c = in.get();
+        if (c == EOF) {
+            failed = true;
+            return 0;
+        }
+        return (uint8_t)c;
+    }
+
+    uint32_t u32() {
+        uint32_t value = 0;
+        for (int i = 0; i < 4; i++) value |= (uint32_t)u8() << (8 * i);
+        return value;
+    }
+
+    uint64_t u64() {
+        uint64_t value = 0;
+        for (int i = 0; i < 8; i++) value |= (uint64_t)u8() << (8 * i);
+        return value;
+    }
+
+    // Retorna false para "sem nome".
+    bool raw_string(std::string& chars) {
+        uint32_t length = u32();
+        if (failed || length == NO_NAME) return false;
+        chars.resize(length);
+        in.read(&chars[0], length);
+        if ((uint32_t)in.gcount() != length) failed = true;
+        return !failed;
+    }
+
+    ObjString* string() {
+        std::string chars;
+        if (!raw_string(chars)) return nullptr;
+        return new_string(chars);
+    }
+};
+
+static void read_function(Reader& reader, ObjFunction* function);
+
+// Troca o operando de 16 bits em 'at' pelo slot correspondente na VM.
+static bool remap_slot(Chunk& chunk, size_t at, const std::vector<uint16_t>& remap) {
+    uint16_t slot = (uint16_t)((chunk.code[at] << 8) | chunk.code[at + 1]);
+    if (slot >= remap.size()) return false;
+    slot = remap[slot];
+    chunk.code.patch(at, (slot >> 8) & 0xff);
+    chunk.code.patch(at + 1, slot & 0xff);
+    return true;
+}
+
+bool link_chunk(Chunk& chunk, const std::vector<uint16_t>* global_remap, const std::vector<uint16_t>* native_remap) {
+    size_t offset = 0;
+    while (offset < chunk.code.size()) {
+        uint8_t instruction = chunk.code[offset];
+        int length = instruction_length(instruction);
+        if (length == 0 || offset + length > chunk.code.size()) return false;
+
+        switch (instruction) {
+            case OP_GET_GLOBAL:
+            case OP_SET_GLOBAL:
+            case OP_DEFINE_GLOBAL: {
+                if (global_remap != nullptr && !remap_slot(chunk, offset + 1, *global_remap)) return false;
+                break;
+            }
+            case OP_GET_NATIVE:
+            case OP_CALL_NATIVE: {
+                if (native_remap != nullptr && !remap_slot(chunk, offset + 1, *native_remap)) return false;
+                break;
+            }
+            case OP_GET_PROPERTY:
+            case OP_SET_PROPERTY:
+            case OP_INVOKE: {
+                uint16_t cache = (uint16_t)((chunk.code[offset + 2] << 8) | chunk.code[offset + 3]);
+                if (cache >= chunk.caches.size()) chunk.caches.resize(cache + 1);
+                chunk.caches[cache].offset = (int)offset;
+                break;
+            }
+            default:
+                break;
+        }
+        offset += length;
+    }
+    return true;
+}
+
+// --- Verificação ---
+
+// Quantos valores a instrução tira da pilha e quantos coloca. As que saem do
+// bloco (OP_JUMP, OP_LOOP, OP_RETURN) são tratadas em verify_code.
+struct StackEffect {
+    int pops;
+    int pushes;
+};
+
+static StackEffect stack_effect(const uint8_t* at) {
+    switch (at[0]) {
+        case OP_CONSTANT: case OP_NIL: case OP_TRUE: case OP_FALSE:
+        case OP_GET_LOCAL: case OP_GET_GLOBAL: case OP_GET_GLOBAL_QUICK: case OP_GET_NATIVE:
+        case OP_CLOSURE: case OP_ADD_LOCAL_LOCAL: case OP_ARRAY_LITERAL:
+            return {0, 1};
+        case OP_POP: case OP_SET_LOCAL_POP: case OP_DEFINE_GLOBAL: case OP_SET_GLOBAL_POP:
+        case OP_PRINT: case OP_RETURN:
+            return {1, 0};
+        case OP_SET_LOCAL: case OP_SET_GLOBAL: case OP_GET_PROPERTY:
+        case OP_NOT: case OP_NEGATE: case OP_CHECK_NUMBER: case OP_JUMP_IF_FALSE:
+            return {1, 1};
+        case OP_SET_PROPERTY: case OP_GET_SUBSCRIPT:
+        case OP_EQUAL: case OP_NOT_EQUAL: case OP_GREATER: case OP_GREATER_EQUAL:
+        case OP_LESS: case OP_LESS_EQUAL:
+        case OP_ADD: case OP_SUBTRACT: case OP_MULTIPLY: case OP_DIVIDE:
+        case OP_ADD_NUM: case OP_SUBTRACT_NUM: case OP_MULTIPLY_NUM: case OP_DIVIDE_NUM:
+        case OP_GREATER_NUM: case OP_LESS_NUM: case OP_DIVIDE_INT:
+            return {2, 1};
+        case OP_SET_SUBSCRIPT:
+            return {3, 1};
+        case OP_EQUAL_JUMP: case OP_NOT_EQUAL_JUMP: case OP_GREATER_JUMP:
+        case OP_GREATER_EQUAL_JUMP: case OP_LESS_JUMP: case OP_LESS_EQUAL_JUMP:
+            return {2, 0};
+        case OP_CALL:        return {at[1] + 1, 1};
+        case OP_INVOKE:      return {at[4] + 1, 1};
+        case OP_CALL_NATIVE: return {at[3], 1};
+        case OP_BUILD_ARRAY: return {at[1], 1};
+        case OP_ARRAY_APPEND: return {at[1], 0};
+    }
+    return {0, 0};
+}
+
+// Operandos que não dependem da pilha: índices e tipos de constantes, e os
+// tipos de array. O compilador só empacota arrays de double, int e bool.
+static bool valid_operands(const uint8_t* at, const std::vector<ConstantKind>& constants) {
+    auto constant = [&](uint8_t index) { return index < constants.size(); };
+    auto constant_of = [&](uint8_t index, ConstantKind kind) { return constant(index) && constants[index] == kind; };
+    switch (at[0]) {
+        case OP_CONSTANT:
+            return constant(at[1]);
+        case OP_CLOSURE:
+            return constant_of(at[1], CONSTANT_FUNCTION);
+        case OP_GET_PROPERTY: case OP_SET_PROPERTY: case OP_INVOKE:
+            return constant_of(at[1], CONSTANT_STRING);
+        case OP_ARRAY_LITERAL:
+            return constant_of(at[1], CONSTANT_STRING) &&
+                   (at[2] == ARRAY_DOUBLE || at[2] == ARRAY_INT || at[2] == ARRAY_BOOL);
+        case OP_BUILD_ARRAY:
+            return at[2] == ARRAY_INFER || at[2] == ARRAY_DOUBLE || at[2] == ARRAY_INT ||
+                   at[2] == ARRAY_BOOL || at[2] == ARRAY_VALUE;
+        case OP_INC_LOCAL_CONST: case OP_LESS_LOCAL_CONST_JUMP:
+            return constant(at[2]);
+        // As instruções aceleradas só surgem em execução (quicken_chunk) e
+        // supõem a global já definida; OP_CLASS não tem handler na VM.
+        case OP_GET_GLOBAL_QUICK: case OP_SET_GLOBAL_POP:
+        case OP_INC_GLOBAL_CONST: case OP_LESS_GLOBAL_CONST_JUMP:
+        case OP_CLASS:
+            return false;
+    }
+    return true;
+}
+
+static bool is_forward_jump(uint8_t op) {
+    switch (op) {
+        case OP_JUMP: case OP_JUMP_IF_FALSE:
+        case OP_EQUAL_JUMP: case OP_NOT_EQUAL_JUMP: case OP_GREATER_JUMP:
+        case OP_GREATER_EQUAL_JUMP: case OP_LESS_JUMP: case OP_LESS_EQUAL_JUMP:
+        case OP_LESS_LOCAL_CONST_JUMP: case OP_LESS_LOCAL_LOCAL_JUMP:
+        case OP_LESS_GLOBAL_CONST_JUMP:
+            return true;
+    }
+    return false;
+}
+
+// O que a verificação sabe de cada posição da pilha. OP_ARRAY_APPEND
+// converte o valor abaixo dos elementos em array sem checar, então ele
+// precisa ter vindo de OP_BUILD_ARRAY ou de OP_ARRAY_LITERAL.
+enum SlotKind : uint8_t { SLOT_ANY, SLOT_ARRAY };
+
+bool verify_code(const uint8_t* code, size_t length, int arity, const std::vector<ConstantKind>& constants) {
+    if (arity < 0 || arity > 255 || length == 0) return false;
+
+    // 1. Decodifica: onde começam as instruções e quais são destino de OP_LOOP.
+    std::vector<uint8_t> starts(length, 0), loop_target(length, 0);
+    for (size_t offset = 0; offset < length;) {
+        const uint8_t* at = code + offset;
+        int size = instruction_length(at[0]);
+        if (size == 0 || offset + size > length || !valid_operands(at, constants)) return false;
+        starts[offset] = 1;
+        size_t end = offset + size;
+        if (at[0] == OP_LOOP) {
+            size_t jump = (size_t)((code[end - 2] << 8) | code[end - 1]);
+            if (jump > end || !starts[end - jump]) return false;
+            loop_target[end - jump] = 1;
+        }
+        offset = end;
+    }
+
+    // 2. Percorre em ordem, simulando a pilha do frame. Todo salto para a
+    //    frente é visto antes do destino; os de OP_LOOP conferem o estado
+    //    guardado na primeira passagem pelo destino.
+    std::vector<std::vector<uint8_t>> saved(length);
+    std::vector<uint8_t> has_saved(length, 0);
+    std::vector<uint8_t> stack(arity + 1, SLOT_ANY);
+    bool reachable = true;
+    auto join = [&](size_t target) {
+        if (!has_saved[target]) {
+            saved[target] = stack;
+            has_saved[target] = 1;
+            return true;
+        }
+        std::vector<uint8_t>& state = saved[target];
+        if (state.size() != stack.size()) return false;
+        for (size_t i = 0; i < state.size(); i++) state[i] = std::min(state[i], stack[i]);
+        return true;
+    };
+
+    for (size_t offset = 0; offset < length;) {
+        const uint8_t* at = code + offset;
+        size_t end = offset + instruction_length(at[0]);
+
+        if (has_saved[offset] || (loop_target[offset] && reachable)) {
+            if (reachable && !join(offset)) return false;
+            stack = saved[offset];
+            reachable = true;
+        }
+        if (!reachable) { // Código morto
+            offset = end;
+            continue;
+        }
+
+        size_t depth = stack.size();
+        switch (at[0]) {
+            case OP_GET_LOCAL: case OP_INC_LOCAL_CONST: case OP_LESS_LOCAL_CONST_JUMP:
+                if (at[1] >= depth) return false;
+                break;
+            case OP_ADD_LOCAL_LOCAL: case OP_LESS_LOCAL_LOCAL_JUMP:
+                if (at[1] >= depth || at[2] >= depth) return false;
+                break;
+            case OP_SET_LOCAL: case OP_SET_LOCAL_POP:
+                if ((size_t)at[1] + 1 >= depth) return false;
+                break;
+            case OP_ARRAY_APPEND:
+                if (depth <= at[1] || stack[depth - 1 - at[1]] != SLOT_ARRAY) return false;
+                break;
+        }
+        if (at[0] == OP_SET_LOCAL || at[0] == OP_SET_LOCAL_POP || at[0] == OP_INC_LOCAL_CONST) {
+            stack[at[1]] = SLOT_ANY;
+        }
+
+        StackEffect effect = stack_effect(at);
+        if ((size_t)effect.pops > depth) return false;
+        stack.resize(depth - effect.pops);
+        uint8_t pushed = at[0] == OP_BUILD_ARRAY || at[0] == OP_ARRAY_LITERAL ? SLOT_ARRAY : SLOT_ANY;
+        stack.resize(stack.size() + effect.pushes, pushed);
+
+        if (is_forward_jump(at[0])) {
+            size_t target = end + (size_t)((code[end - 2] << 8) | code[end - 1]);
+            if (target >= length || !starts[target] || !join(target)) return false;
+        } else if (at[0] == OP_LOOP) {
+            size_t target = end - (size_t)((code[end - 2] << 8) | code[end - 1]);
+            const std::vector<uint8_t>& state = saved[target];
+            if (!has_saved[target] || state.size() != stack.size()) return false;
+            for (size_t i = 0; i < state.size(); i++) {
+                if (state[i] > stack[i]) return false;
+            }
+        }
+        if (at[0] == OP_JUMP || at[0] == OP_LOOP || at[0] == OP_RETURN) reachable = false;
+        offset = end;
+    }
+    // Cair do fim do código leria além dele.
+    return !reachable;
+}
+
+// Cada objeto criado aqui fica alcançável (pela piscina de constantes da
+// função que está sendo lida, ou pela forma/métodos da classe) antes da
+// próxima alocação, porque qualquer alocação pode disparar uma coleta.
+static void read_class(Reader& reader, Chunk& chunk) {
+    ObjString* name = reader.string();
+    if (name == nullptr) {
+        reader.failed = true;
+        return;
+    }
+    push_temp_root(name);
+    ObjClass* klass = new_class(name);
+    pop_temp_root();
+    chunk.constants.push_back(klass);
+
+    uint32_t field_count = reader.u32();
+    for (uint32_t i = 0; i < field_count && !reader.failed; i++) {
+        ObjString* field = reader.string();
+        if (field == nullptr) {
+            reader.failed = true;
+            return;
+        }
+        klass->initial_shape = klass->initial_shape->add_field(field);
+    }
+
+    uint32_t method_count = reader.u32();
+    for (uint32_t i = 0; i < method_count && !reader.failed; i++) {
+        ObjString* method_name = reader.string();
+        if (method_name == nullptr) {
+            reader.failed = true;
+            return;
+        }
+        push_temp_root(method_name);
+        ObjFunction* method = new_function();
+        push_temp_root(method);
+        read_function(reader, method);
+        klass->methods[method_name] = new_closure(method);
+        pop_temp_root();
+        pop_temp_root();
+    }
+}
+
+static void read_constant(Reader& reader, Chunk& chunk) {
+    switch (reader.u8()) {
+        case SPC_NIL:   chunk.constants.push_back(SapphireValue()); break;
+        case SPC_FALSE: chunk.constants.push_back(false); break;
+        case SPC_TRUE:  chunk.constants.push_back(true); break;
+        case SPC_NUMBER: {
+            uint64_t bits = reader.u64();
+            double number;
+            std::memcpy(&number, &bits, sizeof(double));
+            chunk.constants.push_back(number);
+            break;
+        }
+        // Fora da faixa de int (arquivo adulterado), vira double.
+        case SPC_INT: chunk.constants.push_back(int_value((int64_t)reader.u64())); break;
+        case SPC_STRING: {
+            ObjString* string = reader.string();
+            if (string == nullptr) reader.failed = true;
+            else chunk.constants.push_back(string);
+            break;
+        }
+        case SPC_FUNCTION: {
+            ObjFunction* nested = new_function();
+            chunk.constants.push_back(nested);
+            read_function(reader, nested);
+            break;
+        }
+        case SPC_CLASS:
+            read_class(reader, chunk);
+            break;
+        default:
+            reader.failed = true;
+            break;
+    }
+}
+
+static void read_function(Reader& reader, ObjFunction* function) {
+    function->arity = (int)reader.u32();
+    function->name = reader.string();
+
+    uint32_t code_length = reader.u32();
+    if (reader.failed) return;
+    function->chunk.code.resize(code_length);
+    reader.in.read(reinterpret_cast<char*>(function->chunk.code.writable_data()), code_length);
+    if ((uint32_t)reader.in.gcount() != code_length) {
+        reader.failed = true;
+        return;
+    }
+
+    uint32_t constant_count = reader.u32();
+    for (uint32_t i = 0; i < constant_count && !reader.failed; i++) {
+        read_constant(reader, function->chunk);
+    }
+
+    if (reader.failed) return;
+
+    std::vector<ConstantKind> kinds;
+    for (const SapphireValue& constant : function->chunk.constants) {
+        kinds.push_back(is_obj_type(constant, OBJ_STRING)     ? CONSTANT_STRING
+                        : is_obj_type(constant, OBJ_FUNCTION) ? CONSTANT_FUNCTION
+                                                              : CONSTANT_OTHER);
+    }
+    const Chunk& chunk = function->chunk;
+    if (!verify_code(chunk.code.data(), chunk.code.size(), function->arity, kinds) ||
+        !link_chunk(function->chunk, &reader.global_remap, &reader.native_remap)) {
+        reader.failed = true;
+    }
+}
+
+ObjFunction* read_bytecode(std::istream& in, GlobalTable& globals) {
+    Reader reader(in);
+
+    char magic[4];
+    in.read(magic, 4);
+    if (in.gcount() != 4 || std::memcmp(magic, "SPHC", 4) != 0) {
+        std::cerr << "Erro: Arquivo de bytecode invalido." << std::endl;
+        return nullptr;
+    }
+    uint32_t version = reader.u32();
+    uint32_t opcode_count = reader.u32();
+    if (version != SPC_VERSION || opcode_count != OP_COUNT) {
+        std::cerr << "Erro: Bytecode gerado por outra versao da Sapphire." << std::endl;
+        return nullptr;
+    }
+
+    uint32_t global_count = reader.u32();
+    for (uint32_t i = 0; i < global_count && !reader.failed; i++) {
+        ObjString* name = reader.string();
+        if (name == nullptr) {
+            reader.failed = true;
+            break;
+        }
+        int slot = globals.resolve(name);
+        if (slot == -1) {
+            reader.failed = true;
+            break;
+        }
+        reader.global_remap.push_back((uint16_t)slot);
+    }
+
+    // Uma nativa que esta VM não registrou não tem como ser chamada.
+    uint32_t native_count = reader.u32();
+    for (uint32_t i = 0; i < native_count && !reader.failed; i++) {
+        ObjString* name = reader.string();
+        if (name == nullptr) {
+            reader.failed = true;
+            break;
+        }
+        int slot = globals.natives.find(name);
+        if (slot == -1) {
+            std::cerr << "Erro: Funcao nativa '" << name->chars << "' nao registrada nesta VM." << std::endl;
+            return nullptr;
+        }
+        reader.native_remap.push_back((uint16_t)slot);
+    }
+
+    ObjFunction* function = nullptr;
+    if (!reader.failed) {
+        function = new_function();
+        push_temp_root(function);
+        read_function(reader, function);
+        pop_temp_root();
+    }
+
+    if (reader.failed) {
+        std::cerr << "Erro: Arquivo de bytecode corrompido." << std::endl;
+        return nullptr;
+    }
+    return function;
+}
+
+std::string bytecode_cache_key(const std::string& source) {
+    // FNV-1a de 64 bits sobre o código-fonte, misturado com a versão do formato.
+    uint64_t hash = 14695981039346656037ull;
+    auto mix = [&hash](uint8_t byte) {
+        hash ^= byte;
+        hash *= 1099511628211ull;
+    };
+    for (char c : source) mix((uint8_t)c);
+    for (int i = 0; i < 4; i++) mix((SPC_VERSION >> (8 * i)) & 0xff);
+    mix((uint8_t)OP_COUNT);
+    mix(peephole_enabled()); // --no-peephole gera outro bytecode
+
+    char key[17];
+    snprintf(key, sizeof(key), "%016llx", (unsigned long long)hash);
+    return key;
+}
\ No newline at end of file
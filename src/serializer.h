@@ -0,0 +1,64 @@
+#ifndef SAPPHIRE_SERIALIZER_H
+#define SAPPHIRE_SERIALIZER_H
+
+#include "object.h"
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <vector>
+
+struct GlobalTable;
+
+// --- Formato binário de bytecode (.spc) ---
+// Um arquivo .spc guarda o script principal já compilado e tudo o que ele
+// alcança pela piscina de constantes: funções aninhadas, classes (com os
+// campos declarados e os métodos) e strings. Os slots de globais e de nativas
+// usados no bytecode são remapeados na carga, pelos nomes, para as tabelas da
+// VM atual.
+//
+// Layout (inteiros little-endian):
+//   "SPHC" u32 versão, u32 número de opcodes
+//   u32 n, n x string          -> nomes das globais, na ordem dos slots
+//   u32 n, n x string          -> nomes qualificados das nativas ("Math.sqrt")
+//   função                     -> o script principal
+// função: u32 aridade, string nome (comprimento 0xFFFFFFFF = sem nome),
+//         u32 n, n bytes de código, u32 n, n x constante
+// constante: u8 tag, seguido do conteúdo (ver SpcTag)
+// classe: string nome, u32 n, n x string (campos), u32 n, n x (string, função)
+//
+// Mude SPC_VERSION sempre que o significado do bytecode mudar.
+#define SPC_VERSION 5
+
+// Escreve 'function' no formato .spc. Não aloca objetos.
+bool write_bytecode(std::ostream& out, ObjFunction* function, const GlobalTable& globals);
+
+// Lê um .spc e retorna o script principal, ou nullptr (com a mensagem em
+// std::cerr) se o arquivo for inválido ou de outra versão.
+ObjFunction* read_bytecode(std::istream& in, GlobalTable& globals);
+
+// Prepara um chunk lido de disco: cria os inline caches (vazios) de cada
+// instrução de propriedade e troca os slots de globais e de nativas do
+// arquivo pelos da VM (cada tabela nula fica como está). Retorna false se o
+// bytecode for inválido.
+bool link_chunk(Chunk& chunk, const std::vector<uint16_t>* global_remap, const std::vector<uint16_t>* native_remap);
+
+// O que verify_code precisa saber de cada constante da função.
+enum ConstantKind : uint8_t {
+    CONSTANT_OTHER,    // nil, booleano, número ou classe
+    CONSTANT_STRING,
+    CONSTANT_FUNCTION,
+};
+
+// Confere o bytecode de uma função lida de disco (.spc ou .spi), que a VM
+// executa sem checar: os operandos de constante existem e têm o tipo que a
+// instrução espera, as locais estão dentro da pilha do frame, a pilha nunca
+// fica negativa e tem a mesma altura em todos os caminhos, e todo salto cai
+// no início de uma instrução. Os slots de globais e de nativas ficam com
+// link_chunk e com a validação da imagem.
+bool verify_code(const uint8_t* code, size_t length, int arity, const std::vector<ConstantKind>& constants);
+
+// Chave do cache de compilação: hash do código-fonte e da versão do formato.
+std::string bytecode_cache_key(const std::string& source);
+
+#endif //SAPPHIRE_SERIALIZER_H
\ No newline at end of file
@@ -0,0 +1,273 @@
+#include "simd.h"
+#include <cstdlib>
+#include <string>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define SIMD_X86
+#include <immintrin.h>
+#endif
+
+// --- Versão escalar ---
+// A referência: as versões vetoriais reproduzem estes passos, lane a lane.
+
+static inline double lane_min(double accumulator, double x) { return accumulator < x ? accumulator : x; } // = minpd
+static inline double lane_max(double accumulator, double x) { return accumulator > x ? accumulator : x; } // = maxpd
+
+// Combina os acumuladores: (0+1)+(2+3), (4+5)+(6+7), e então as duas metades.
+static double combine_sum(const double* lanes) {
+    return ((lanes[0] + lanes[1]) + (lanes[2] + lanes[3])) + ((lanes[4] + lanes[5]) + (lanes[6] + lanes[7]));
+}
+
+template <double (*Op)(double, double)>
+static double combine(const double* lanes) {
+    double result = lanes[0];
+    for (int i = 1; i < SIMD_LANES; i++) result = Op(result, lanes[i]);
+    return result;
+}
+
+// Os elementos que sobram depois dos blocos completos vão para as lanes na
+// mesma posição que teriam num bloco.
+static double scalar_sum(const double* x, size_t count) {
+    double lanes[SIMD_LANES] = {};
+    for (size_t i = 0; i < count; i++) lanes[i % SIMD_LANES] += x[i];
+    return combine_sum(lanes);
+}
+
+static double scalar_dot(const double* x, const double* y, size_t count) {
+    double lanes[SIMD_LANES] = {};
+    for (size_t i = 0; i < count; i++) lanes[i % SIMD_LANES] += x[i] * y[i];
+    return combine_sum(lanes);
+}
+
+template <double (*Op)(double, double)>
+static double scalar_extreme(const double* x, size_t count) {
+    double lanes[SIMD_LANES];
+    for (double& lane : lanes) lane = x[0];
+    for (size_t i = 0; i < count; i++) lanes[i % SIMD_LANES] = Op(lanes[i % SIMD_LANES], x[i]);
+    return combine<Op>(lanes);
+}
+
+static void scalar_add(const double* x, const double* y, double* out, size_t count) {
+    for (size_t i = 0; i < count; i++) out[i] = x[i] + y[i];
+}
+
+static void scalar_add_scalar(const double* x, double k, double* out, size_t count) {
+    for (size_t i = 0; i < count; i++) out[i] = x[i] + k;
+}
+
+static void scalar_scale(const double* x, double k, double* out, size_t count) {
+    for (size_t i = 0; i < count; i++) out[i] = x[i] * k;
+}
+
+#ifdef SIMD_X86
+
+// --- SSE2: quatro registradores de 2 lanes ---
+
+static double sse2_sum(const double* x, size_t count) {
+    __m128d a0 = _mm_setzero_pd(), a1 = a0, a2 = a0, a3 = a0;
+    size_t i = 0;
+    for (; i + SIMD_LANES <= count; i += SIMD_LANES) {
+        a0 = _mm_add_pd(a0, _mm_loadu_pd(x + i));
+        a1 = _mm_add_pd(a1, _mm_loadu_pd(x + i + 2));
+        a2 = _mm_add_pd(a2, _mm_loadu_pd(x + i + 4));
+        a3 = _mm_add_pd(a3, _mm_loadu_pd(x + i + 6));
+    }
+    double lanes[SIMD_LANES];
+    _mm_storeu_pd(lanes, a0);
+    _mm_storeu_pd(lanes + 2, a1);
+    _mm_storeu_pd(lanes + 4, a2);
+    _mm_storeu_pd(lanes + 6, a3);
+    for (size_t j = 0; i < count; i++, j++) lanes[j] += x[i];
+    return combine_sum(lanes);
+}
+
+static double sse2_dot(const double* x, const double* y, size_t count) {
+    __m128d a0 = _mm_setzero_pd(), a1 = a0, a2 = a0, a3 = a0;
+    size_t i = 0;
+    for (; i + SIMD_LANES <= count; i += SIMD_LANES) {
+        a0 = _mm_add_pd(a0, _mm_mul_pd(_mm_loadu_pd(x + i), _mm_loadu_pd(y + i)));
+        a1 = _mm_add_pd(a1, _mm_mul_pd(_mm_loadu_pd(x + i + 2), _mm_loadu_pd(y + i + 2)));
+        a2 = _mm_add_pd(a2, _mm_mul_pd(_mm_loadu_pd(x + i + 4), _mm_loadu_pd(y + i + 4)));
+        a3 = _mm_add_pd(a3, _mm_mul_pd(_mm_loadu_pd(x + i + 6), _mm_loadu_pd(y + i + 6)));
+    }
+    double lanes[SIMD_LANES];
+    _mm_storeu_pd(lanes, a0);
+    _mm_storeu_pd(lanes + 2, a1);
+    _mm_storeu_pd(lanes + 4, a2);
+    _mm_storeu_pd(lanes + 6, a3);
+    for (size_t j = 0; i < count; i++, j++) lanes[j] += x[i] * y[i];
+    return combine_sum(lanes);
+}
+
+template <double (*Op)(double, double), __m128d (*Vector)(__m128d, __m128d)>
+static double sse2_extreme(const double* x, size_t count) {
+    __m128d a0 = _mm_set1_pd(x[0]), a1 = a0, a2 = a0, a3 = a0;
+    size_t i = 0;
+    for (; i + SIMD_LANES <= count; i += SIMD_LANES) {
+        a0 = Vector(a0, _mm_loadu_pd(x + i));
+        a1 = Vector(a1, _mm_loadu_pd(x + i + 2));
+        a2 = Vector(a2, _mm_loadu_pd(x + i + 4));
+        a3 = Vector(a3, _mm_loadu_pd(x + i + 6));
+    }
+    double lanes[SIMD_LANES];
+    _mm_storeu_pd(lanes, a0);
+    _mm_storeu_pd(lanes + 2, a1);
+    _mm_storeu_pd(lanes + 4, a2);
+    _mm_storeu_pd(lanes + 6, a3);
+    for (size_t j = 0; i < count; i++, j++) lanes[j] = Op(lanes[j], x[i]);
+    return combine<Op>(lanes);
+}
+
+static __m128d sse2_min_pd(__m128d a, __m128d b) { return _mm_min_pd(a, b); }
+static __m128d sse2_max_pd(__m128d a, __m128d b) { return _mm_max_pd(a, b); }
+
+static void sse2_add(const double* x, const double* y, double* out, size_t count) {
+    size_t i = 0;
+    for (; i + 2 <= count; i += 2) _mm_storeu_pd(out + i, _mm_add_pd(_mm_loadu_pd(x + i), _mm_loadu_pd(y + i)));
+    for (; i < count; i++) out[i] = x[i] + y[i];
+}
+
+static void sse2_add_scalar(const double* x, double k, double* out, size_t count) {
+    __m128d vk = _mm_set1_pd(k);
+    size_t i = 0;
+    for (; i + 2 <= count; i += 2) _mm_storeu_pd(out + i, _mm_add_pd(_mm_loadu_pd(x + i), vk));
+    for (; i < count; i++) out[i] = x[i] + k;
+}
+
+static void sse2_scale(const double* x, double k, double* out, size_t count) {
+    __m128d vk = _mm_set1_pd(k);
+    size_t i = 0;
+    for (; i + 2 <= count; i += 2) _mm_storeu_pd(out + i, _mm_mul_pd(_mm_loadu_pd(x + i), vk));
+    for (; i < count; i++) out[i] = x[i] * k;
+}
+
+// --- AVX2: dois registradores de 4 lanes ---
+// Sem FMA: multiplicar e somar separados arredonda como as outras versões.
+
+#define AVX2 __attribute__((target("avx2")))
+
+AVX2 static double avx2_sum(const double* x, size_t count) {
+    __m256d a0 = _mm256_setzero_pd(), a1 = a0;
+    size_t i = 0;
+    for (; i + SIMD_LANES <= count; i += SIMD_LANES) {
+        a0 = _mm256_add_pd(a0, _mm256_loadu_pd(x + i));
+        a1 = _mm256_add_pd(a1, _mm256_loadu_pd(x + i + 4));
+    }
+    double lanes[SIMD_LANES];
+    _mm256_storeu_pd(lanes, a0);
+    _mm256_storeu_pd(lanes + 4, a1);
+    for (size_t j = 0; i < count; i++, j++) lanes[j] += x[i];
+    return combine_sum(lanes);
+}
+
+AVX2 static double avx2_dot(const double* x, const double* y, size_t count) {
+    __m256d a0 = _mm256_setzero_pd(), a1 = a0;
+    size_t i = 0;
+    for (; i + SIMD_LANES <= count; i += SIMD_LANES) {
+        a0 = _mm256_add_pd(a0, _mm256_mul_pd(_mm256_loadu_pd(x + i), _mm256_loadu_pd(y + i)));
+        a1 = _mm256_add_pd(a1, _mm256_mul_pd(_mm256_loadu_pd(x + i + 4), _mm256_loadu_pd(y + i + 4)));
+    }
+    double lanes[SIMD_LANES];
+    _mm256_storeu_pd(lanes, a0);
+    _mm256_storeu_pd(lanes + 4, a1);
+    for (size_t j = 0; i < count; i++, j++) lanes[j] += x[i] * y[i];
+    return combine_sum(lanes);
+}
+
+AVX2 static double avx2_min(const double* x, size_t count) {
+    __m256d a0 = _mm256_set1_pd(x[0]), a1 = a0;
+    size_t i = 0;
+    for (; i + SIMD_LANES <= count; i += SIMD_LANES) {
+        a0 = _mm256_min_pd(a0, _mm256_loadu_pd(x + i));
+        a1 = _mm256_min_pd(a1, _mm256_loadu_pd(x + i + 4));
+    }
+    double lanes[SIMD_LANES];
+    _mm256_storeu_pd(lanes, a0);
+    _mm256_storeu_pd(lanes + 4, a1);
+    for (size_t j = 0; i < count; i++, j++) lanes[j] = lane_min(lanes[j], x[i]);
+    return combine<lane_min>(lanes);
+}
+
+AVX2 static double avx2_max(const double* x, size_t count) {
+    __m256d a0 = _mm256_set1_pd(x[0]), a1 = a0;
+    size_t i = 0;
+    for (; i + SIMD_LANES <= count; i += SIMD_LANES) {
+        a0 = _mm256_max_pd(a0, _mm256_loadu_pd(x + i));
+        a1 = _mm256_max_pd(a1, _mm256_loadu_pd(x + i + 4));
+    }
+    double lanes[SIMD_LANES];
+    _mm256_storeu_pd(lanes, a0);
+    _mm256_storeu_pd(lanes + 4, a1);
+    for (size_t j = 0; i < count; i++, j++) lanes[j] = lane_max(lanes[j], x[i]);
+    return combine<lane_max>(lanes);
+}
+
+AVX2 static void avx2_add(const double* x, const double* y, double* out, size_t count) {
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) _mm256_storeu_pd(out + i, _mm256_add_pd(_mm256_loadu_pd(x + i), _mm256_loadu_pd(y + i)));
+    for (; i < count; i++) out[i] = x[i] + y[i];
+}
+
+AVX2 static void avx2_add_scalar(const double* x, double k, double* out, size_t count) {
+    __m256d vk = _mm256_set1_pd(k);
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) _mm256_storeu_pd(out + i, _mm256_add_pd(_mm256_loadu_pd(x + i), vk));
+    for (; i < count; i++) out[i] = x[i] + k;
+}
+
+AVX2 static void avx2_scale(const double* x, double k, double* out, size_t count) {
+    __m256d vk = _mm256_set1_pd(k);
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) _mm256_storeu_pd(out + i, _mm256_mul_pd(_mm256_loadu_pd(x + i), vk));
+    for (; i < count; i++) out[i] = x[i] * k;
+}
+
+#undef AVX2
+
+#endif // SIMD_X86
+
+// --- Escolha da versão ---
+
+struct Kernels {
+    const char* name;
+    double (*sum)(const double*, size_t);
+    double (*dot)(const double*, const double*, size_t);
+    double (*min)(const double*, size_t);
+    double (*max)(const double*, size_t);
+    void (*add)(const double*, const double*, double*, size_t);
+    void (*add_scalar)(const double*, double, double*, size_t);
+    void (*scale)(const double*, double, double*, size_t);
+};
+
+static Kernels select_kernels() {
+    const char* forced = std::getenv("SAPPHIRE_SIMD");
+    std::string level = forced != nullptr ? forced : "";
+    Kernels scalar = {"scalar", scalar_sum, scalar_dot,
+                      scalar_extreme<lane_min>, scalar_extreme<lane_max>,
+                      scalar_add, scalar_add_scalar, scalar_scale};
+    if (level == "scalar") return scalar;
+#ifdef SIMD_X86
+    if (level != "sse2" && __builtin_cpu_supports("avx2")) {
+        return {"avx2", avx2_sum, avx2_dot, avx2_min, avx2_max, avx2_add, avx2_add_scalar, avx2_scale};
+    }
+    return {"sse2", sse2_sum, sse2_dot,
+            sse2_extreme<lane_min, sse2_min_pd>, sse2_extreme<lane_max, sse2_max_pd>,
+            sse2_add, sse2_add_scalar, sse2_scale};
+#else
+    return scalar;
+#endif
+}
+
+static const Kernels& kernels() {
+    static const Kernels selected = select_kernels();
+    return selected;
+}
+
+double simd_sum(const double* x, size_t count) { return kernels().sum(x, count); }
+double simd_dot(const double* x, const double* y, size_t count) { return kernels().dot(x, y, count); }
+double simd_min(const double* x, size_t count) { return kernels().min(x, count); }
+double simd_max(const double* x, size_t count) { return kernels().max(x, count); }
+void simd_add(const double* x, const double* y, double* out, size_t count) { kernels().add(x, y, out, count); }
+void simd_add_scalar(const double* x, double k, double* out, size_t count) { kernels().add_scalar(x, k, out, count); }
+void simd_scale(const double* x, double k, double* out, size_t count) { kernels().scale(x, k, out, count); }
+const char* simd_level() { return kernels().name; }
\ No newline at end of file
@@ -0,0 +1,33 @@
+#ifndef SAPPHIRE_SIMD_H
+#define SAPPHIRE_SIMD_H
+
+#include <cstddef>
+
+// --- Kernels vetoriais sobre doubles contíguos ---
+// Usados pelas operações de array inteiro da biblioteca padrão (Array.sum,
+// Array.dot...). Em x86-64 há uma versão AVX2, escolhida na primeira
+// chamada se a CPU tiver, e uma SSE2 (sempre presente em x86-64); nas outras
+// arquiteturas, só a versão escalar.
+//
+// As reduções usam SIMD_LANES acumuladores independentes, combinados sempre
+// na mesma ordem, e as três versões fazem exatamente as mesmas operações:
+// o resultado (inclusive o arredondamento) não depende da CPU.
+#define SIMD_LANES 8
+
+double simd_sum(const double* x, size_t count);
+double simd_dot(const double* x, const double* y, size_t count);
+// Com NaN entre os elementos o resultado não é especificado. 'count' > 0.
+double simd_min(const double* x, size_t count);
+double simd_max(const double* x, size_t count);
+
+// out[i] = x[i] + y[i]; out[i] = x[i] + k; out[i] = x[i] * k.
+// 'out' pode ser o próprio 'x'.
+void simd_add(const double* x, const double* y, double* out, size_t count);
+void simd_add_scalar(const double* x, double k, double* out, size_t count);
+void simd_scale(const double* x, double k, double* out, size_t count);
+
+// Nome da versão em uso ("avx2", "sse2" ou "scalar"). A variável de ambiente
+// SAPPHIRE_SIMD=scalar|sse2 força uma versão mais simples.
+const char* simd_level();
+
+#endif //SAPPHIRE_SIMD_H
\ No newline at end of file
@@ -1,7 +1,7 @@
 #ifndef SAPPHIRE_TOKENS_H
 #define SAPPHIRE_TOKENS_H
 
-#include <string>
+#include <string_view>
 
 enum class TokenType {
     // Operadores
@@ -36,9 +36,11 @@ enum class TokenType {
     END_OF_FILE, ILLEGAL
 };
 
+// O texto do token é uma fatia do código-fonte (ver Lexer), ou a mensagem
+// de um token ILLEGAL.
 struct Token {
     TokenType type;
-    std::string literal;
+    std::string_view literal;
     int line;
 };
 
@@ -1,26 +1,57 @@
 #include "value.h"
 #include "object.h" // Necessário para print_object
 #include <iostream>
-#include <variant>
 #include <cmath>
 
 // Implementação da função que faltava
 bool is_falsey(const SapphireValue& value) {
     // Um valor é "falsey" se ele for nil ou o booleano false.
     // Qualquer outro valor (0, strings vazias, etc.) é "truthy".
-    return std::holds_alternative<std::monostate>(value._value) ||
-           (std::holds_alternative<bool>(value._value) && !std::get<bool>(value._value));
+    return value.is_nil() || (value.is_bool() && !value.as_bool());
+}
+
+// Strings internadas são únicas, então ponteiros diferentes já bastam para
+// dizer que são diferentes. Só as temporárias precisam comparar o conteúdo.
+static bool strings_equal(const ObjString* a, const ObjString* b) {
+    if (a == b) return true;
+    if (a->is_interned && b->is_interned) return false;
+    return a->hash == b->hash && a->chars == b->chars;
+}
+
+bool values_equal(const SapphireValue& a, const SapphireValue& b) {
+    if (is_obj_type(a, OBJ_STRING) && is_obj_type(b, OBJ_STRING)) {
+        return strings_equal(static_cast<ObjString*>(a.as_obj()), static_cast<ObjString*>(b.as_obj()));
+    }
+#ifdef NAN_BOXING
+    // Números são comparados como double (assim NaN != NaN, como no IEEE 754,
+    // e o int 3 é igual ao double 3.0: os dois cabem exatos num double).
+    // Para o resto, os bits já identificam o valor (ou o ponteiro) de forma única.
+    if (a.is_number() && b.is_number()) return a.as_number() == b.as_number();
+    return a.bits == b.bits;
+#else
+    if (a.is_number() && b.is_number()) return a.as_number() == b.as_number();
+    if (a.type != b.type) return false;
+    switch (a.type) {
+        case VAL_NIL:    return true;
+        case VAL_BOOL:   return a.as_bool() == b.as_bool();
+        case VAL_NUMBER:
+        case VAL_INT:    return false; // Já tratados acima
+        case VAL_OBJ:    return a.as_obj() == b.as_obj();
+    }
+    return false;
+#endif
 }
 
 const char* get_value_type_name(const SapphireValue& value) {
-    if (std::holds_alternative<std::monostate>(value._value)) return "nil";
-    if (std::holds_alternative<bool>(value._value)) return "boolean";
-    if (std::holds_alternative<double>(value._value)) return "number";
-    if (std::holds_alternative<Obj*>(value._value)) {
-        switch (std::get<Obj*>(value._value)->type) {
+    if (value.is_nil()) return "nil";
+    if (value.is_bool()) return "boolean";
+    if (value.is_number()) return "number";
+    if (value.is_obj()) {
+        switch (value.as_obj()->type) {
             case OBJ_STRING: return "string";
             case OBJ_FUNCTION: return "function";
             case OBJ_NATIVE: return "native function";
+            case OBJ_ARRAY: return "array";
             default: return "object";
         }
     }
@@ -28,34 +59,23 @@ const char* get_value_type_name(const SapphireValue& value) {
 }
 // Implementação da função que faltava
 void print_value(const SapphireValue& value) {
-    std::visit([&value](auto&& arg) {
-        using T = std::decay_t<decltype(arg)>;
-        if constexpr (std::is_same_v<T, std::monostate>) {
-            std::cout << "nil";
-        } else if constexpr (std::is_same_v<T, bool>) {
-            std::cout << (arg ? "true" : "false");
-        } else if constexpr (std::is_same_v<T, double>) {
-            // Para garantir que números inteiros não sejam impressos com ".0"
-            double int_part;
-            if (modf(arg, &int_part) == 0.0) {
-                std::cout << static_cast<long long>(arg);
-            } else {
-                std::cout << arg;
-            }
-        } else if constexpr (std::is_same_v<T, Obj*>) {
-            // Deixa a função print_object (de object.cpp) cuidar disso
-            print_object(value);
-        } else if constexpr (std::is_same_v<T, std::shared_ptr<SapphireArray>>) {
-            // Lógica para imprimir arrays
-            auto array_obj = std::get<std::shared_ptr<SapphireArray>>(value._value);
-            std::cout << "[";
-            for (size_t i = 0; i < array_obj->elements.size(); ++i) {
-                print_value(array_obj->elements[i]);
-                if (i < array_obj->elements.size() - 1) {
-                    std::cout << ", ";
-                }
-            }
-            std::cout << "]";
+    if (value.is_nil()) {
+        std::cout << "nil";
+    } else if (value.is_bool()) {
+        std::cout << (value.as_bool() ? "true" : "false");
+    } else if (value.is_int()) {
+        std::cout << value.as_int();
+    } else if (value.is_number()) {
+        // Para garantir que números inteiros não sejam impressos com ".0"
+        double number = value.as_number();
+        double int_part;
+        if (modf(number, &int_part) == 0.0) {
+            std::cout << static_cast<long long>(number);
+        } else {
+            std::cout << number;
         }
-    }, value._value);
-}
\ No newline at end of file
+    } else if (value.is_obj()) {
+        // Deixa a função print_object (de object.cpp) cuidar disso
+        print_object(value);
+    }
+}
@@ -1,48 +1,245 @@
 #ifndef SAPPHIRE_VALUE_H
 #define SAPPHIRE_VALUE_H
 
+#include <cmath>
+#include <cstdint>
+#include <cstring>
 #include <string>
-#include <variant>
-#include <iostream>
-#include <memory>
-#include <vector>
 
-// Declarações antecipadas para que os tipos se conheçam sem criar ciclos.
+// Declaração antecipada para que os tipos se conheçam sem criar ciclos.
+// Arrays, strings, funções etc. são todos objetos no heap (Obj).
 struct Obj;
-struct SapphireArray;
-struct SapphireValue;
-
-// O tipo de variant interno que guarda os dados.
-using VariantValue = std::variant<
-    std::monostate, 
-    bool, 
-    double, 
-    Obj*, // Ponteiro para qualquer tipo de objeto (string, função, etc.)
-    std::shared_ptr<SapphireArray> 
->;
-
-// A nossa struct de valor principal.
+
+#ifdef NAN_BOXING
+
+// --- Representação NaN-boxed (8 bytes) ---
+// Um double "quiet NaN" tem 51 bits de payload que o hardware nunca usa.
+// Guardamos nil/true/false, inteiros e ponteiros de objeto dentro desses bits:
+//   - números:  qualquer double que não tenha todos os bits de QNAN ligados;
+//   - singletons: QNAN | tag (1 = nil, 2 = false, 3 = true);
+//   - inteiros: QNAN | INT_TAG | inteiro de 48 bits em complemento de dois;
+//   - objetos:  SIGN_BIT | QNAN | ponteiro (48 bits em x86-64/ARM64).
+static constexpr uint64_t SIGN_BIT = 0x8000000000000000ULL;
+static constexpr uint64_t QNAN     = 0x7ffc000000000000ULL;
+static constexpr uint64_t INT_TAG  = 0x0002000000000000ULL;
+static constexpr uint64_t INT_MASK = SIGN_BIT | QNAN | INT_TAG;
+static constexpr uint64_t INT_PAYLOAD = 0x0000ffffffffffffULL;
+
+static constexpr uint64_t TAG_NIL   = 1;
+static constexpr uint64_t TAG_FALSE = 2;
+static constexpr uint64_t TAG_TRUE  = 3;
+
 struct SapphireValue {
-    VariantValue _value;
+    uint64_t bits;
 
     // Construtores para facilitar a criação de valores.
-    SapphireValue() : _value(std::monostate{}) {}
-    SapphireValue(std::monostate v) : _value(v) {}
-    SapphireValue(bool v) : _value(v) {}
-    SapphireValue(double v) : _value(v) {}
-    SapphireValue(Obj* v) : _value(v) {}
-    SapphireValue(std::shared_ptr<SapphireArray> v) : _value(v) {}
+    SapphireValue() : bits(QNAN | TAG_NIL) {}
+    SapphireValue(bool v) : bits(QNAN | (v ? TAG_TRUE : TAG_FALSE)) {}
+    SapphireValue(double v) { std::memcpy(&bits, &v, sizeof(double)); }
+    SapphireValue(Obj* v) : bits(SIGN_BIT | QNAN | (uint64_t)(uintptr_t)v) {}
+    // 'v' precisa estar entre INT_VALUE_MIN e INT_VALUE_MAX (ver int_value).
+    static SapphireValue from_int(int64_t v) {
+        SapphireValue value;
+        value.bits = QNAN | INT_TAG | ((uint64_t)v & INT_PAYLOAD);
+        return value;
+    }
+
+    bool is_nil() const    { return bits == (QNAN | TAG_NIL); }
+    bool is_bool() const   { return (bits | 1) == (QNAN | TAG_TRUE); }
+    // Inteiros também são números: quem só quer um double usa as_number().
+    // Um double não tem todos os bits de QNAN, e nem nil/bool nem um
+    // ponteiro de objeto têm INT_TAG: um teste só separa os dois casos.
+    bool is_number() const { return (bits & (QNAN | INT_TAG)) != QNAN; }
+    bool is_int() const    { return (bits & INT_MASK) == (QNAN | INT_TAG); }
+    bool is_double() const { return (bits & QNAN) != QNAN; }
+    // Os dois são inteiros, com um desvio só.
+    static bool both_ints(const SapphireValue& a, const SapphireValue& b) {
+        return (((a.bits & INT_MASK) ^ (QNAN | INT_TAG)) | ((b.bits & INT_MASK) ^ (QNAN | INT_TAG))) == 0;
+    }
+    bool is_obj() const    { return (bits & (QNAN | SIGN_BIT)) == (QNAN | SIGN_BIT); }
+
+    bool as_bool() const   { return bits == (QNAN | TAG_TRUE); }
+    // Os 16 bits de cima voltam a ser o sinal do inteiro.
+    int64_t as_int() const { return (int64_t)(bits << 16) >> 16; }
+    double as_number() const {
+        if (is_int()) return (double)as_int();
+        return as_double();
+    }
+    // Só para um valor que já se sabe double (is_double()).
+    double as_double() const {
+        double number;
+        std::memcpy(&number, &bits, sizeof(double));
+        return number;
+    }
+    Obj* as_obj() const    { return (Obj*)(uintptr_t)(bits & ~(SIGN_BIT | QNAN)); }
 };
 
-// A struct que define um array.
-// Agora ela pode usar SapphireValue porque o tipo já é conhecido.
-struct SapphireArray {
-    std::vector<SapphireValue> elements;
+static_assert(sizeof(SapphireValue) == 8, "NaN-boxed SapphireValue must be 8 bytes");
+
+#else
+
+// --- Representação portável: union com tag (16 bytes) ---
+enum ValueType {
+    VAL_NIL,
+    VAL_BOOL,
+    VAL_NUMBER,
+    VAL_INT,
+    VAL_OBJ,
+};
+
+struct SapphireValue {
+    ValueType type;
+    union {
+        bool boolean;
+        double number;
+        int64_t integer;
+        Obj* obj;
+    } as;
+
+    // Construtores para facilitar a criação de valores.
+    SapphireValue() : type(VAL_NIL) { as.number = 0; }
+    SapphireValue(bool v) : type(VAL_BOOL) { as.number = 0; as.boolean = v; }
+    SapphireValue(double v) : type(VAL_NUMBER) { as.number = v; }
+    SapphireValue(Obj* v) : type(VAL_OBJ) { as.obj = v; }
+    // 'v' precisa estar entre INT_VALUE_MIN e INT_VALUE_MAX (ver int_value).
+    static SapphireValue from_int(int64_t v) {
+        SapphireValue value;
+        value.type = VAL_INT;
+        value.as.integer = v;
+        return value;
+    }
+
+    bool is_nil() const    { return type == VAL_NIL; }
+    bool is_bool() const   { return type == VAL_BOOL; }
+    // Inteiros também são números: quem só quer um double usa as_number().
+    bool is_number() const { return type == VAL_NUMBER || type == VAL_INT; }
+    bool is_int() const    { return type == VAL_INT; }
+    bool is_double() const { return type == VAL_NUMBER; }
+    static bool both_ints(const SapphireValue& a, const SapphireValue& b) {
+        return a.type == VAL_INT && b.type == VAL_INT;
+    }
+    bool is_obj() const    { return type == VAL_OBJ; }
+
+    bool as_bool() const     { return as.boolean; }
+    int64_t as_int() const   { return as.integer; }
+    double as_number() const { return type == VAL_INT ? (double)as.integer : as.number; }
+    double as_double() const { return as.number; }
+    Obj* as_obj() const      { return as.obj; }
 };
 
+#endif // NAN_BOXING
+
+// --- Inteiros ---
+// Valores int são inteiros de 48 bits com sinal, o que cabe no payload do
+// NaN-boxing; a build com tag usa a mesma faixa para dar os mesmos
+// resultados. Toda conta entre dois inteiros é exata, e a que sai da faixa
+// vira double (exato até 2^53), como o resto dos números.
+static constexpr int64_t INT_VALUE_MIN = -(INT64_C(1) << 47);
+static constexpr int64_t INT_VALUE_MAX = (INT64_C(1) << 47) - 1;
+
+// Cabe na faixa se os 16 bits de cima são só a extensão do sinal.
+static inline bool fits_int(int64_t v) {
+    return ((int64_t)((uint64_t)v << 16) >> 16) == v;
+}
+
+static inline SapphireValue int_value(int64_t v) {
+    if (fits_int(v)) return SapphireValue::from_int(v);
+    return SapphireValue((double)v);
+}
+
+// Soma, subtração e produto de dois inteiros. Com um fator deslocado 16 bits
+// para a esquerda, o estouro da conta em 64 bits é exatamente a saída da
+// faixa de int, e o processador já o detecta; o resultado volta com >> 16.
+static inline SapphireValue add_ints(int64_t a, int64_t b) {
+#if defined(__GNUC__) || defined(__clang__)
+    int64_t sum;
+    if (!__builtin_add_overflow((int64_t)((uint64_t)a << 16), (int64_t)((uint64_t)b << 16), &sum)) {
+        return SapphireValue::from_int(sum >> 16);
+    }
+#endif
+    return int_value(a + b);
+}
+
+static inline SapphireValue subtract_ints(int64_t a, int64_t b) {
+#if defined(__GNUC__) || defined(__clang__)
+    int64_t difference;
+    if (!__builtin_sub_overflow((int64_t)((uint64_t)a << 16), (int64_t)((uint64_t)b << 16), &difference)) {
+        return SapphireValue::from_int(difference >> 16);
+    }
+#endif
+    return int_value(a - b);
+}
+
+static inline SapphireValue multiply_ints(int64_t a, int64_t b) {
+#if defined(__GNUC__) || defined(__clang__)
+    int64_t product;
+    if (!__builtin_mul_overflow((int64_t)((uint64_t)a << 16), b, &product)) {
+        return SapphireValue::from_int(product >> 16);
+    }
+#else
+    // Dois fatores de 48 bits podem passar de 64 bits: o produto em double
+    // diz antes se a multiplicação inteira é segura.
+    double estimate = (double)a * (double)b;
+    if (estimate > -4.6e18 && estimate < 4.6e18) return int_value(a * b);
+#endif
+    return SapphireValue((double)a * (double)b);
+}
+
+// Os dois são números. Os testes seguem a ordem das contas abaixo (dois
+// doubles, dois inteiros), para o compilador seguir direto para a conta.
+static inline bool both_numbers(const SapphireValue& a, const SapphireValue& b) {
+    return (a.is_double() && b.is_double()) || SapphireValue::both_ints(a, b) ||
+           (a.is_number() && b.is_number());
+}
+
+// Aritmética usada pelas duas VMs e pelo compilador (dobra de constantes):
+// inteiro com inteiro dá inteiro; com algum double, a conta é em double.
+// Dois doubles vêm primeiro, sem conversão, e depois dois inteiros.
+static inline SapphireValue add_numbers(const SapphireValue& a, const SapphireValue& b) {
+    if (a.is_double() && b.is_double()) return SapphireValue(a.as_double() + b.as_double());
+    if (SapphireValue::both_ints(a, b)) return add_ints(a.as_int(), b.as_int());
+    return SapphireValue(a.as_number() + b.as_number());
+}
+
+static inline SapphireValue subtract_numbers(const SapphireValue& a, const SapphireValue& b) {
+    if (a.is_double() && b.is_double()) return SapphireValue(a.as_double() - b.as_double());
+    if (SapphireValue::both_ints(a, b)) return subtract_ints(a.as_int(), b.as_int());
+    return SapphireValue(a.as_number() - b.as_number());
+}
+
+static inline SapphireValue multiply_numbers(const SapphireValue& a, const SapphireValue& b) {
+    if (a.is_double() && b.is_double()) return SapphireValue(a.as_double() * b.as_double());
+    if (SapphireValue::both_ints(a, b)) return multiply_ints(a.as_int(), b.as_int());
+    return SapphireValue(a.as_number() * b.as_number());
+}
+
+// '/' genérico: sempre em double (7 / 2 é 3.5 fora de contexto int).
+static inline SapphireValue divide_numbers(const SapphireValue& a, const SapphireValue& b) {
+    if (a.is_double() && b.is_double()) return SapphireValue(a.as_double() / b.as_double());
+    return SapphireValue(a.as_number() / b.as_number());
+}
+
+// '/' entre dois operandos do tipo int: trunca em direção a zero, como em C.
+// Um operando pode ser double (um int que saiu da faixa, o retorno de uma
+// nativa); aí o quociente em double é truncado. Quem chama trata o divisor 0.
+static inline SapphireValue divide_integers(const SapphireValue& a, const SapphireValue& b) {
+    if (SapphireValue::both_ints(a, b)) return int_value(a.as_int() / b.as_int());
+    double quotient = std::trunc(a.as_number() / b.as_number());
+    if (quotient >= (double)INT_VALUE_MIN && quotient <= (double)INT_VALUE_MAX) {
+        return SapphireValue::from_int((int64_t)quotient);
+    }
+    return SapphireValue(quotient);
+}
+
+static inline SapphireValue negate_number(const SapphireValue& a) {
+    if (a.is_int()) return int_value(-a.as_int());
+    return SapphireValue(-a.as_double());
+}
+
 // Declarações das nossas funções auxiliares.
 void print_value(const SapphireValue& value);
 bool is_falsey(const SapphireValue& value);
+bool values_equal(const SapphireValue& a, const SapphireValue& b);
 const char* get_value_type_name(const SapphireValue& value);
 
-#endif //SAPPHIRE_VALUE_H
\ No newline at end of file
+#endif //SAPPHIRE_VALUE_H
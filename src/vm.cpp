@@ -1,81 +1,162 @@
 #include "vm.h"
 #include "compiler.h"
+#include "serializer.h"
+#include "image.h"
+#include "register.h"
+#include "jit.h"
+#include "optimizer.h"
 #include "object.h"
 #include "debug.h"
 #include "value.h"
 #include <iostream>
-#include <chrono>
 #include <vector>
-#include <cmath>
 
-// --- Função Nativa ---
-static const auto clock_start_time = std::chrono::high_resolution_clock::now();
-static SapphireValue clock_native(int arg_count, SapphireValue* args) {
-    if (arg_count != 0) return {}; 
-    auto now = std::chrono::high_resolution_clock::now();
-    std::chrono::duration<double> diff = now - clock_start_time;
-    return diff.count();
-}
+// --- Construtor e Funções da VM ---
+VM::VM() {
+    frame_count = 0;
+    stack_top = stack;
+    set_gc_vm(this);
+    
+    // --- Funções Nativas Globais ---
+    define_native("clock", native_clock, 0);
 
+    // --- Biblioteca padrão (native.h) ---
+    for (size_t i = 0; i < standard_module_count; i++) register_module(standard_modules[i]);
+}
 
+VM::~VM() {
+    free_objects();
+    // Depois dos objetos: chunks materializados apontam para as imagens.
+    for (BytecodeImage* image : images) close_image(image);
+}
 
-//FUNÇÃO NATIVA PARA LEITURA
-static SapphireValue io_readline_native(int arg_count, SapphireValue* args) {
-    // 1. Verifica se a função foi chamada com o número correto de argumentos (zero)
-    if (arg_count != 0) {
-        // No futuro, podemos implementar um sistema de erro mais robusto aqui
-        std::cerr << "Runtime Error: IO.readLine() expects 0 arguments." << std::endl;
-        return {}; // Retorna nil em caso de erro
+void VM::mark_roots(bool include_globals) {
+    for (SapphireValue* slot = stack; slot < stack_top; slot++) {
+        mark_value(*slot);
+    }
+    for (int i = 0; i < frame_count; i++) {
+        mark_object(frames[i].function);
+    }
+    if (include_globals) {
+        for (SapphireValue& value : globals.values) {
+            mark_value(value);
+        }
     }
+    // Os nomes só mudam durante a compilação, fora de qualquer barreira.
+    for (ObjString* name : globals.names) {
+        mark_object(name);
+    }
+    // Idem para os módulos nativos, que só mudam no registro.
+    const NativeTable& natives = globals.natives;
+    for (size_t i = 0; i < natives.functions.size(); i++) {
+        mark_object(natives.names[i]);
+        mark_object(natives.functions[i]);
+    }
+    for (auto& module : natives.modules) {
+        mark_object(module.first);
+        mark_object(module.second);
+    }
+}
 
-    // 2. Lê uma linha inteira do terminal
-    std::string line;
-    std::getline(std::cin, line);
+void VM::forward_roots(bool include_globals) {
+    for (SapphireValue* slot = stack; slot < stack_top; slot++) {
+        forward_value(*slot);
+    }
+    if (include_globals) {
+        for (SapphireValue& value : globals.values) {
+            forward_value(value);
+        }
+    }
+}
 
-    // 3. Cria um objeto de string da Sapphire e o retorna
-    return new_string(line);
+void VM::define_native(const char* name, NativeFn function, int arity, void* userdata) {
+    ObjString* name_string = new_string(name);
+    push_temp_root(name_string);
+    globals.define(name_string, new_native(function, arity, name, userdata));
+    pop_temp_root();
 }
-static SapphireValue native_math_sqrt(int arg_count, SapphireValue* args) {
-    if (arg_count != 1) {
-        std::cerr << "Runtime Error: sqrt() expects 1 argument." << std::endl;
-        return {}; 
+
+bool VM::register_module(const NativeModule& module, void* userdata) {
+    // O módulo também é uma global comum (uma instância com as nativas nos
+    // campos), para os usos que o compilador não resolve: "print Math;",
+    // guardar o módulo numa variável e chamar por ela.
+    ObjString* module_name = new_string(module.name);
+    push_temp_root(module_name);
+    ObjInstance* object;
+    auto existing = globals.natives.modules.find(module_name);
+    if (existing != globals.natives.modules.end()) {
+        object = existing->second;
+    } else {
+        ObjClass* klass = new_class(module_name);
+        push_temp_root(klass);
+        object = new_instance(klass);
+        globals.natives.modules[module_name] = object;
+        globals.define(module_name, object);
+        pop_temp_root();
     }
-    if (!std::holds_alternative<double>(args[0]._value)) {
-        std::cerr << "Runtime Error: Argument for sqrt() must be a number." << std::endl;
-        return {};
+    pop_temp_root();
+
+    std::string prefix = std::string(module.name) + ".";
+    for (size_t i = 0; i < module.count; i++) {
+        const NativeEntry& entry = module.entries[i];
+        // O nome qualificado é internado (nunca se move), então a nativa
+        // pode usá-lo nas mensagens de erro.
+        ObjString* qualified = new_string(prefix + entry.name);
+        push_temp_root(qualified);
+        ObjNative* native = new_native(entry.function, entry.arity, qualified->chars.c_str(), userdata);
+        int slot = globals.natives.add(qualified, native);
+        pop_temp_root();
+        if (slot == -1) return false;
+
+        ObjString* member = new_string(entry.name);
+        push_temp_root(member);
+        instance_set_field(object, member, native);
+        pop_temp_root();
     }
-    double number = std::get<double>(args[0]._value);
-    return sqrt(number);
+    return true;
 }
 
-// --- Construtor e Funções da VM ---
-VM::VM() {
-    frame_count = 0;
-    stack_top = stack;
-    
-    // --- Funções Nativas Globais ---
-    define_native("clock", clock_native);
+// --- Tabela de Nativas ---
+int NativeTable::find(ObjString* name) const {
+    auto it = slots.find(name);
+    return it != slots.end() ? it->second : -1;
+}
 
-    // --- Biblioteca Nativa de IO ---
-    // 1. Criamos um objeto de classe genérico para nossa biblioteca.
-    ObjClass* io_class = new_class(new_string("IO")); 
-    // 2. Criamos uma instância que será nosso objeto 'IO'.
-    ObjInstance* io_object = new_instance(io_class);
+int NativeTable::add(ObjString* name, ObjNative* native) {
+    auto it = slots.find(name);
+    if (it != slots.end()) {
+        // Registrar de novo um membro troca a nativa, mantendo o slot.
+        functions[it->second] = native;
+        return it->second;
+    }
+    if (functions.size() > UINT16_MAX) return -1;
+    uint16_t slot = (uint16_t)functions.size();
+    slots[name] = slot;
+    names.push_back(name);
+    functions.push_back(native);
+    return slot;
+}
 
-    // 3. Adicionamos nossas funções nativas como campos neste objeto.
-    //    O valor do campo é um objeto de função nativa.
-    io_object->fields["readLine"] = new_native(io_readline_native);
-    
-    // 4. Finalmente, registramos o objeto 'io_object' como uma variável global chamada "IO".
-    globals["IO"] = io_object;
+// --- Tabela de Globais ---
+int GlobalTable::resolve(ObjString* name) {
+    auto it = slots.find(name);
+    if (it != slots.end()) return it->second;
 
-    ObjClass* math_class = new_class(new_string("Math"));
-    ObjInstance* math_object = new_instance(math_class);
-    math_object->fields["sqrt"] = new_native(native_math_sqrt);
-    globals["Math"] = math_object;
+    // Os slots são operandos de 16 bits nas instruções.
+    if (values.size() > UINT16_MAX) return -1;
+    uint16_t slot = (uint16_t)values.size();
+    slots[name] = slot;
+    names.push_back(name);
+    values.emplace_back();
+    defined.push_back(0);
+    return slot;
 }
-void VM::define_native(const std::string& name, NativeFn function) {
-    globals[name] = new_native(function);
+
+void GlobalTable::define(ObjString* name, const SapphireValue& value) {
+    int slot = resolve(name);
+    if (slot == -1) return;
+    values[slot] = value;
+    defined[slot] = 1;
 }
 
 void VM::push(const SapphireValue& value) {
@@ -117,16 +198,90 @@ bool VM::call(ObjFunction* function, int arg_count) {
         return false;
     }
 
+    // Funções vindas de uma imagem só ganham constantes e caches aqui.
+    if (function->image != nullptr) materialize_function(function);
+    if (backend == BACKEND_STACK) count_hotness(function);
+
+
+    SapphireValue* slots = stack_top - arg_count - 1;
+    if (backend == BACKEND_REGISTER) {
+        // Traduzida na primeira chamada. Os registradores que os argumentos
+        // não ocupam começam nil, para o coletor nunca ver lixo na pilha.
+        Chunk& chunk = function->chunk;
+        if (chunk.register_code.empty()) {
+            if (!translate_to_registers(function)) return false;
+#ifdef DEBUG_PRINT_CODE
+            disassemble_register_code(chunk, function->name != nullptr ? function->name->chars : "Script Principal");
+#endif
+        }
+        SapphireValue* end = slots + chunk.register_count;
+        if (end > stack + STACK_MAX - 2) {
+            std::cerr << "Erro de Runtime: Estouro da pilha de chamadas (stack overflow)." << std::endl;
+            return false;
+        }
+        while (stack_top < end) *stack_top++ = SapphireValue();
+    }
+
     CallFrame* frame = &frames[frame_count++];
     frame->function = function;
-    frame->ip = &function->chunk.code[0];
-    frame->slots = stack_top - arg_count - 1;
+    frame->ip = backend == BACKEND_REGISTER ? function->chunk.register_code.data() : function->chunk.code.data();
+    frame->slots = slots;
     return true;
 }
 
+static_assert(TIER_UP_THRESHOLD < JIT_HOT_THRESHOLD, "o JIT compila o bytecode ja acelerado");
+
+void VM::count_hotness(ObjFunction* function) {
+    Chunk& chunk = function->chunk;
+    // Cada nível é tentado uma única vez; depois do último o contador para.
+    if (chunk.hotness > JIT_HOT_THRESHOLD) return;
+    chunk.hotness++;
+    if (chunk.hotness == TIER_UP_THRESHOLD && tiering_enabled) tier_up(function);
+    if (chunk.hotness == JIT_HOT_THRESHOLD && jit_enabled) chunk.jit = jit_compile(chunk);
+}
+
+void VM::tier_up(ObjFunction* function) {
+    // Todos os frames da função têm o ip salvo: o do topo pelo OP_LOOP, os
+    // demais por estarem esperando o retorno de uma chamada.
+    Chunk& chunk = function->chunk;
+    std::vector<size_t> resume;
+    for (int i = 0; i < frame_count; i++) {
+        if (frames[i].function == function) resume.push_back((size_t)(frames[i].ip - chunk.code.data()));
+    }
+    if (!quicken_chunk(chunk, globals.defined, resume)) return;
+
+    size_t next = 0;
+    for (int i = 0; i < frame_count; i++) {
+        if (frames[i].function == function) frames[i].ip = chunk.code.data() + resume[next++];
+    }
+    // Código nativo do bytecode antigo não serve mais.
+    if (chunk.jit != nullptr) {
+        free_jit_code(chunk.jit);
+        chunk.jit = jit_compile(chunk);
+    }
+#ifdef DEBUG_PRINT_CODE
+    std::string name = function->name != nullptr ? function->name->chars : "Script Principal";
+    disassemble_chunk(chunk, name + " (acelerado)");
+#endif
+}
+
+void VM::run_jit(CallFrame* frame) {
+    Chunk& chunk = frame->function->chunk;
+    JitFrame native;
+    native.slots = frame->slots;
+    native.stack_top = stack_top;
+    native.constants = chunk.constants.data();
+    native.globals = globals.values.data();
+    native.defined = globals.defined.data();
+    uint32_t offset = jit_execute(chunk.jit, &native, (uint32_t)(frame->ip - chunk.code.data()));
+    stack_top = native.stack_top;
+    frame->ip = chunk.code.data() + offset;
+}
+
+
 bool VM::call_value(SapphireValue callee, int arg_count) {
-    if (std::holds_alternative<Obj*>(callee._value)) {
-        Obj* obj = std::get<Obj*>(callee._value);
+    if (callee.is_obj()) {
+        Obj* obj = callee.as_obj();
         switch (obj->type) {
             case OBJ_CLASS: {
                 ObjClass* klass = static_cast<ObjClass*>(obj);
@@ -140,10 +295,20 @@ bool VM::call_value(SapphireValue callee, int arg_count) {
                 return call(static_cast<ObjClosure*>(obj)->function, arg_count);
             
             case OBJ_NATIVE: {
-                NativeFn native = static_cast<ObjNative*>(obj)->function;
-                SapphireValue result = native(arg_count, stack_top - arg_count);
+                ObjNative* native = static_cast<ObjNative*>(obj);
+                if (arg_count != native->arity && native->arity != NATIVE_VARIADIC) {
+                    std::cerr << "Runtime Error: " << native->name << "() expects " << native->arity
+                              << (native->arity == 1 ? " argument" : " arguments")
+                              << " but got " << arg_count << "." << std::endl;
+                    return false;
+                }
+                NativeCall call{stack_top - arg_count, arg_count, native->userdata};
+                if (!native->function(call)) {
+                    std::cerr << "Runtime Error: " << call.error << std::endl;
+                    return false;
+                }
                 stack_top -= arg_count + 1;
-                push(result);
+                push(call.result);
                 return true;
             }
             case OBJ_BOUND_METHOD: {
@@ -163,313 +328,1445 @@ bool VM::call_value(SapphireValue callee, int arg_count) {
     return false;
 }
 
-// --- MACRO PARA OPERAÇÕES BINÁRIAS ---
-#define BINARY_OP(value_type, op) \
-    do { \
-        if (!std::holds_alternative<double>(peek(0)._value) || !std::holds_alternative<double>(peek(1)._value)) { \
-            std::cerr << "Runtime Error : Operators must be numbers. " \
-                      << "Received " << get_value_type_name(peek(1)) \
-                      << " and " << get_value_type_name(peek(0)) \
-                      << "." << std::endl; \
-            return false; \
-        } \
-        double b = std::get<double>(pop()._value); \
-        double a = std::get<double>(pop()._value); \
-        push(value_type(a op b)); \
-    } while (false)
-
-
-// --- O CORAÇÃO DA VM: O LOOP DE EXECUÇÃO ---
-bool VM::run() {
-    CallFrame* frame = &frames[frame_count - 1];
+// --- Inline caches de propriedade ---
 
-    for (;;) {
-
-        #ifdef DEBUG_TRACE_EXECUTION
-            debug_print_stack(this);
-            disassemble_instruction(frame->function->chunk, (int)(frame->ip - &frame->function->chunk.code[0]));
-        #endif
-
-        uint8_t instruction = *frame->ip++;
-        switch (instruction) {
-            case OP_CONSTANT:      push(frame->function->chunk.constants[*frame->ip++]); break;
-            case OP_NIL:           push({}); break;
-            case OP_TRUE:          push(true); break;
-            case OP_FALSE:         push(false); break;
-            case OP_POP:           pop(); break;
-            
-            case OP_GET_LOCAL:     push(frame->slots[*frame->ip++]); break;
-            case OP_SET_LOCAL:     frame->slots[*frame->ip++] = peek(0); break;
-
-            case OP_GET_GLOBAL: {
-    ObjString* name = static_cast<ObjString*>(std::get<Obj*>(frame->function->chunk.constants[*frame->ip++]._value));
-    auto it = globals.find(name->chars);
-    if (it == globals.end()) {
-        std::cerr << "Runtime Error: Undefined global variable '" << name->chars << "'." << std::endl;
-        return false;
+static inline const CacheEntry* cache_lookup(const InlineCache* cache, const Shape* shape) {
+    for (int i = 0; i < cache->count; i++) {
+        if (cache->entries[i].shape == shape) return &cache->entries[i];
     }
-    push(it->second);
-    break;
+    return nullptr;
 }
-            case OP_DEFINE_GLOBAL: {
-    ObjString* name = static_cast<ObjString*>(std::get<Obj*>(frame->function->chunk.constants[*frame->ip++]._value));
-    globals[name->chars] = peek(0);
-    pop();
-    break;
+
+// Guarda o resultado de uma busca lenta. 'function' é a dona do cache: a
+// barreira mantém viva a classe da forma durante uma marcação incremental.
+static void cache_insert(InlineCache* cache, ObjFunction* function, const CacheEntry& entry) {
+    if (cache->state == CACHE_MEGAMORPHIC) return;
+    if (cache->count == CACHE_ENTRIES_MAX) {
+        // Formas demais passando por aqui: desistimos de cachear este ponto.
+        cache->state = CACHE_MEGAMORPHIC;
+        cache->count = 0;
+        return;
+    }
+    write_barrier(function, SapphireValue(entry.shape->klass));
+    cache->entries[cache->count++] = entry;
+    cache->state = cache->count == 1 ? CACHE_MONOMORPHIC : CACHE_POLYMORPHIC;
 }
-            case OP_GET_PROPERTY: {
-    if (!is_obj_type(peek(0), OBJ_INSTANCE)) {
-        std::cerr << "Runtime Error: Only instances have properties." << std::endl;
-        return false;
+
+// Leitura de 'instance.name'. 'receiver' é a própria instância, já na pilha
+// (ou num registrador), para continuar alcançável se o bound method alocar.
+static inline SapphireValue get_property(ObjInstance* instance, const SapphireValue& receiver, ObjString* name,
+                                         InlineCache* cache, ObjFunction* owner) {
+    // 0. Caminho rápido: a forma da instância já passou por aqui.
+    const CacheEntry* entry = cache_lookup(cache, instance->shape);
+    if (entry != nullptr) {
+        cache->hits++;
+        if (entry->method == nullptr) return instance->fields[entry->index];
+        return new_bound_method(receiver, entry->method);
     }
-    ObjInstance* instance = static_cast<ObjInstance*>(std::get<Obj*>(peek(0)._value));
-    ObjString* name = static_cast<ObjString*>(std::get<Obj*>(frame->function->chunk.constants[*frame->ip++]._value));
+    cache->misses++;
 
     // 1. Procura por um campo na instância.
-    auto it_field = instance->fields.find(name->chars);
-    if (it_field != instance->fields.end()) {
-        pop(); // Remove a instância
-        push(it_field->second); // Coloca o valor do campo na pilha
-        break;
+    int index = instance->shape->find(name);
+    if (index != -1) {
+        CacheEntry field_entry;
+        field_entry.shape = instance->shape;
+        field_entry.index = (uint16_t)index;
+        cache_insert(cache, owner, field_entry);
+        return instance->fields[index];
     }
 
     // 2. Se não encontrou um campo, procura por um método na classe.
-    auto it_method = instance->klass->methods.find(name->chars);
+    auto it_method = instance->klass->methods.find(name);
     if (it_method != instance->klass->methods.end()) {
         ObjClosure* method = it_method->second;
-        ObjBoundMethod* bound = new_bound_method(peek(0), method);
-        pop(); // Remove a instância
-        push(bound); // Coloca o bound method, pronto para ser chamado.
-        break;
+        CacheEntry method_entry;
+        method_entry.shape = instance->shape;
+        method_entry.method = method;
+        cache_insert(cache, owner, method_entry);
+        return new_bound_method(receiver, method); // Pronto para ser chamado.
     }
 
     // 3. Se não encontrou nem campo nem método, a propriedade é indefinida.
     //    Retornamos 'nil' em vez de gerar um erro fatal.
-    pop(); // Remove a instância da pilha
-    push({}); // Empurra um valor nil (SapphireValue{} é nil)
-    
-    break;
+    return SapphireValue();
 }
-case OP_SET_PROPERTY: {
-    if (std::get_if<Obj*>(&peek(1)._value) == nullptr || std::get<Obj*>(peek(1)._value)->type != OBJ_INSTANCE) {
-        std::cerr << "Runtime Error: Only instances have fields." << std::endl;
-        return false;
+
+// Escrita de 'instance.name = value'.
+static inline void set_property(ObjInstance* instance, ObjString* name, InlineCache* cache,
+                                ObjFunction* owner, const SapphireValue& value) {
+    write_barrier(instance, value);
+
+    const CacheEntry* entry = cache_lookup(cache, instance->shape);
+    if (entry != nullptr) {
+        cache->hits++;
+        if (entry->new_shape == nullptr) {
+            instance->fields[entry->index] = value;
+        } else {
+            instance_add_field(instance, entry->new_shape, value);
+        }
+        return;
     }
-    ObjInstance* instance = static_cast<ObjInstance*>(std::get<Obj*>(peek(1)._value));
-    ObjString* name = static_cast<ObjString*>(std::get<Obj*>(frame->function->chunk.constants[*frame->ip++]._value));
-    
-    // Atribui usando a string, não o ponteiro
-    instance->fields[name->chars] = peek(0); 
-
-    SapphireValue value = pop();
-    pop();
-    push(value);
-    break;
-}
-            case OP_SET_GLOBAL: { 
-    ObjString* name = static_cast<ObjString*>(std::get<Obj*>(frame->function->chunk.constants[*frame->ip++]._value));
-    auto it = globals.find(name->chars);
-    if (it == globals.end()) {
-         std::cerr << "Runtime Error: Undefined global variable for assignment '" << name->chars << "'." << std::endl;
-        return false;
+    cache->misses++;
+    // Se o campo ainda não existe, a instância muda de forma.
+    CacheEntry field_entry;
+    field_entry.shape = instance->shape;
+    int index = instance->shape->find(name);
+    if (index != -1) {
+        field_entry.index = (uint16_t)index;
+        instance->fields[index] = value;
+    } else {
+        field_entry.new_shape = instance->shape->add_field(name);
+        field_entry.index = (uint16_t)instance->fields.size();
+        instance_add_field(instance, field_entry.new_shape, value);
     }
-    it->second = peek(0);
-    break;
+    cache_insert(cache, owner, field_entry);
 }
-            case OP_CLOSURE: { 
-    ObjFunction* function = static_cast<ObjFunction*>(std::get<Obj*>(frame->function->chunk.constants[*frame->ip++]._value));
-    ObjClosure* closure = new_closure(function);
-    push(closure);
-    break;
-} 
-            
-            case OP_EQUAL:   { SapphireValue b = pop(); SapphireValue a = pop(); push(a._value == b._value); break; }
-            case OP_GREATER:  BINARY_OP(bool, >); break;
-            case OP_LESS:     BINARY_OP(bool, <); break;
-            
-            case OP_ADD: {
-    // Verifica se os dois operandos no topo da pilha são strings
-    if (is_obj_type(peek(0), OBJ_STRING) && is_obj_type(peek(1), OBJ_STRING)) {
-        // 1. Faz o pop dos valores e os armazena em ponteiros.
-        ObjString* b = static_cast<ObjString*>(std::get<Obj*>(pop()._value));
-        ObjString* a = static_cast<ObjString*>(std::get<Obj*>(pop()._value));
-        
-        // 2.cria um novo objeto de string.
-        push(new_string(a->chars + b->chars));
-
-    } else if (std::holds_alternative<double>(peek(0)._value) && std::holds_alternative<double>(peek(1)._value)) {
-        // A lógica para números permanece a mesma
-        double b = std::get<double>(pop()._value);
-        double a = std::get<double>(pop()._value);
-        push(a + b);
+
+// Busca de 'instance.name(...)' para OP_INVOKE, na mesma ordem de
+// OP_GET_PROPERTY: campo, depois método. Retorna nullptr se não existir.
+static inline const CacheEntry* find_invoke(ObjInstance* instance, ObjString* name, InlineCache* cache,
+                                            ObjFunction* owner, CacheEntry& resolved) {
+    const CacheEntry* entry = cache_lookup(cache, instance->shape);
+    if (entry != nullptr) {
+        cache->hits++;
+        return entry;
+    }
+    cache->misses++;
+    resolved.shape = instance->shape;
+    int index = instance->shape->find(name);
+    if (index != -1) {
+        resolved.index = (uint16_t)index;
     } else {
+        auto it_method = instance->klass->methods.find(name);
+        if (it_method == instance->klass->methods.end()) return nullptr;
+        resolved.method = it_method->second;
+    }
+    cache_insert(cache, owner, resolved);
+    return &resolved;
+}
+
+bool VM::concatenate() {
+    if (!is_obj_type(peek(0), OBJ_STRING) || !is_obj_type(peek(1), OBJ_STRING)) {
         // Se os tipos não corresponderem, gera um erro.
         std::cerr << "Runtime Error: Operands for '+' must be two numbers or two strings." << std::endl;
         return false;
     }
-    break;
+    // 1. Lê os operandos sem removê-los, para que continuem alcançáveis
+    //    pelo coletor caso a alocação abaixo dispare uma coleta.
+    ObjString* b = static_cast<ObjString*>(peek(0).as_obj());
+    ObjString* a = static_cast<ObjString*>(peek(1).as_obj());
+
+    // 2. Cria um novo objeto de string.
+    ObjString* result = new_temp_string(a->chars + b->chars);
+    stack_top -= 2;
+    push(result);
+    return true;
 }
-            case OP_SUBTRACT: BINARY_OP(double, -); break;
-            case OP_MULTIPLY: BINARY_OP(double, *); break;
-            case OP_DIVIDE:   BINARY_OP(double, /); break;
-            
-            case OP_NOT:      push(is_falsey(pop())); break;
-            case OP_NEGATE:
-                if (!std::holds_alternative<double>(peek(0)._value)) {
+
+// --- MACROS DO LAÇO DE EXECUÇÃO ---
+// O laço guarda ip, slots e a piscina de constantes do frame atual em
+// variáveis locais (que o compilador mantém em registradores), em vez de
+// reler tudo através de 'frame->' a cada instrução. Antes de qualquer coisa
+// que possa trocar de frame, o ip é salvo de volta com SAVE_FRAME().
+#define READ_BYTE()     (*ip++)
+#define READ_SHORT()    (ip += 2, (uint16_t)((ip[-2] << 8) | ip[-1]))
+#define READ_CONSTANT() (constants[READ_BYTE()])
+#define READ_STRING()   static_cast<ObjString*>(READ_CONSTANT().as_obj())
+
+#define PUSH(value)     (*stack_top++ = (value))
+#define POP()           (*--stack_top)
+#define PEEK(distance)  (stack_top[-1 - (distance)])
+
+#define SAVE_FRAME()    (frame->ip = ip)
+#define LOAD_FRAME() \
+    do { \
+        frame = &frames[frame_count - 1]; \
+        ip = frame->ip; \
+        slots = frame->slots; \
+        constants = frame->function->chunk.constants.data(); \
+        caches = frame->function->chunk.caches.data(); \
+    } while (false)
+
+#define CHECK_NUMBER_OPERANDS() \
+    do { \
+        if (!both_numbers(PEEK(1), PEEK(0))) { \
+            std::cerr << "Runtime Error : Operators must be numbers. " \
+                      << "Received " << get_value_type_name(PEEK(1)) \
+                      << " and " << get_value_type_name(PEEK(0)) \
+                      << "." << std::endl; \
+            return false; \
+        } \
+    } while (false)
+
+// Roda 'statement' com 'a' e 'b' valendo os números 'left' e 'right': dois
+// doubles vão direto, e dois inteiros se comparam como int64_t, sem a
+// conversão para double.
+#define WITH_NUMBERS(left, right, statement) \
+    do { \
+        if ((left).is_double() && (right).is_double()) { \
+            double a = (left).as_double(); \
+            double b = (right).as_double(); \
+            statement; \
+        } else if (SapphireValue::both_ints((left), (right))) { \
+            int64_t a = (left).as_int(); \
+            int64_t b = (right).as_int(); \
+            statement; \
+        } else { \
+            double a = (left).as_number(); \
+            double b = (right).as_number(); \
+            statement; \
+        } \
+    } while (false)
+
+#define BINARY_OP(value_type, op) \
+    do { \
+        CHECK_NUMBER_OPERANDS(); \
+        SapphireValue right = POP(); \
+        SapphireValue left = POP(); \
+        WITH_NUMBERS(left, right, PUSH(value_type(a op b))); \
+    } while (false)
+
+// '-', '*' e '/': 'function' é uma das contas de value.h, que mantém o
+// resultado inteiro quando os dois operandos são inteiros.
+#define ARITHMETIC_OP(function) \
+    do { \
+        CHECK_NUMBER_OPERANDS(); \
+        SapphireValue b = POP(); \
+        PEEK(0) = function(PEEK(0), b); \
+    } while (false)
+
+// Operandos que o compilador garante serem números (OP_*_NUM): sem checagem.
+#define NUMBER_OP(value_type, op) \
+    do { \
+        SapphireValue right = POP(); \
+        SapphireValue left = PEEK(0); \
+        WITH_NUMBERS(left, right, PEEK(0) = value_type(a op b)); \
+    } while (false)
+
+#define NUMBER_ARITHMETIC_OP(function) \
+    do { \
+        SapphireValue b = POP(); \
+        PEEK(0) = function(PEEK(0), b); \
+    } while (false)
+
+// Comparações fundidas (optimizer.h). 'test' usa os operandos 'a' e 'b' e
+// reproduz exatamente a sequência original (ex: >= é !(a < b), por causa de NaN).
+#define COMPARE_OP(test) \
+    do { \
+        CHECK_NUMBER_OPERANDS(); \
+        SapphireValue right = POP(); \
+        SapphireValue left = POP(); \
+        WITH_NUMBERS(left, right, PUSH(test)); \
+    } while (false)
+
+// Comparação + OP_JUMP_IF_FALSE + OP_POP: os operandos saem da pilha e o
+// booleano intermediário nem chega a ser empilhado.
+#define COMPARE_JUMP(test) \
+    do { \
+        CHECK_NUMBER_OPERANDS(); \
+        SapphireValue right = POP(); \
+        SapphireValue left = POP(); \
+        uint16_t offset = READ_SHORT(); \
+        WITH_NUMBERS(left, right, if (!(test)) ip += offset); \
+    } while (false)
+
+#define EQUAL_JUMP(test) \
+    do { \
+        SapphireValue b = POP(); \
+        SapphireValue a = POP(); \
+        uint16_t offset = READ_SHORT(); \
+        if (!(test)) ip += offset; \
+    } while (false)
+
+// Com --jit, continua no código nativo do frame atual, se ele já tiver sido
+// compilado (jit.h). Usado nos pontos em que o interpretador chega a um frame
+// quente: saltos para trás, entrada numa função e retorno para ela.
+#ifdef BASELINE_JIT
+#define JIT_ENTER() \
+    do { \
+        if (frame->function->chunk.jit != nullptr) { \
+            SAVE_FRAME(); \
+            run_jit(frame); \
+            ip = frame->ip; \
+        } \
+    } while (false)
+#else
+#define JIT_ENTER() do { } while (false)
+#endif
+
+#ifdef DEBUG_TRACE_EXECUTION
+#define TRACE_INSTRUCTION() \
+    do { \
+        debug_print_stack(this); \
+        disassemble_instruction(frame->function->chunk, (int)(ip - frame->function->chunk.code.data())); \
+    } while (false)
+#else
+#define TRACE_INSTRUCTION() do { } while (false)
+#endif
+
+// Contagem de pares de instruções consecutivas (debug.h), para escolher
+// quais sequências valem uma superinstrução.
+#ifdef PROFILE_OPCODES
+#define PROFILE_INSTRUCTION() \
+    do { \
+        opcode_pair_counts[previous_instruction][*ip]++; \
+        previous_instruction = *ip; \
+    } while (false)
+#else
+#define PROFILE_INSTRUCTION() do { } while (false)
+#endif
+
+// --- DESPACHO ---
+// Com COMPUTED_GOTO (GCC/Clang), cada instrução salta diretamente para a
+// próxima através de uma tabela de rótulos ("direct threading"): há um salto
+// indireto por opcode, que o preditor de desvios aprende separadamente.
+// Sem ele, usamos o 'switch' portável dentro de um laço.
+#ifdef COMPUTED_GOTO
+#define INSTRUCTION(op)      label_##op
+#define UNKNOWN_INSTRUCTION  label_unknown
+#define DISPATCH() \
+    do { \
+        TRACE_INSTRUCTION(); \
+        PROFILE_INSTRUCTION(); \
+        goto *dispatch_table[*ip++]; \
+    } while (false)
+#else
+#define INSTRUCTION(op)      case op
+#define UNKNOWN_INSTRUCTION  default
+#define DISPATCH()           continue
+#endif
+
+
+// --- O CORAÇÃO DA VM: O LOOP DE EXECUÇÃO ---
+bool VM::run() {
+    CallFrame* frame;
+    const uint8_t* ip;
+    SapphireValue* slots;
+    SapphireValue* constants;
+    InlineCache* caches;
+    LOAD_FRAME();
+#ifdef PROFILE_OPCODES
+    // O script começa como uma chamada (ver interpret()).
+    uint8_t previous_instruction = OP_CALL;
+#endif
+
+#ifdef COMPUTED_GOTO
+    // A tabela é preenchida uma única vez. Posições sem instrução caem no
+    // rótulo de opcode desconhecido.
+    static void* dispatch_table[256];
+    static bool dispatch_table_ready = false;
+    if (!dispatch_table_ready) {
+        for (void*& target : dispatch_table) target = &&label_unknown;
+        dispatch_table[OP_CONSTANT]      = &&label_OP_CONSTANT;
+        dispatch_table[OP_NIL]           = &&label_OP_NIL;
+        dispatch_table[OP_TRUE]          = &&label_OP_TRUE;
+        dispatch_table[OP_FALSE]         = &&label_OP_FALSE;
+        dispatch_table[OP_POP]           = &&label_OP_POP;
+        dispatch_table[OP_GET_LOCAL]     = &&label_OP_GET_LOCAL;
+        dispatch_table[OP_SET_LOCAL]     = &&label_OP_SET_LOCAL;
+        dispatch_table[OP_GET_GLOBAL]    = &&label_OP_GET_GLOBAL;
+        dispatch_table[OP_GET_PROPERTY]  = &&label_OP_GET_PROPERTY;
+        dispatch_table[OP_SET_PROPERTY]  = &&label_OP_SET_PROPERTY;
+        dispatch_table[OP_DEFINE_GLOBAL] = &&label_OP_DEFINE_GLOBAL;
+        dispatch_table[OP_SET_GLOBAL]    = &&label_OP_SET_GLOBAL;
+        dispatch_table[OP_EQUAL]         = &&label_OP_EQUAL;
+        dispatch_table[OP_GREATER]       = &&label_OP_GREATER;
+        dispatch_table[OP_LESS]          = &&label_OP_LESS;
+        dispatch_table[OP_NOT]           = &&label_OP_NOT;
+        dispatch_table[OP_ADD]           = &&label_OP_ADD;
+        dispatch_table[OP_SUBTRACT]      = &&label_OP_SUBTRACT;
+        dispatch_table[OP_MULTIPLY]      = &&label_OP_MULTIPLY;
+        dispatch_table[OP_DIVIDE]        = &&label_OP_DIVIDE;
+        dispatch_table[OP_NEGATE]        = &&label_OP_NEGATE;
+        dispatch_table[OP_PRINT]         = &&label_OP_PRINT;
+        dispatch_table[OP_JUMP]          = &&label_OP_JUMP;
+        dispatch_table[OP_JUMP_IF_FALSE] = &&label_OP_JUMP_IF_FALSE;
+        dispatch_table[OP_LOOP]          = &&label_OP_LOOP;
+        dispatch_table[OP_CLOSURE]       = &&label_OP_CLOSURE;
+        dispatch_table[OP_CALL]          = &&label_OP_CALL;
+        dispatch_table[OP_INVOKE]        = &&label_OP_INVOKE;
+        dispatch_table[OP_BUILD_ARRAY]   = &&label_OP_BUILD_ARRAY;
+        dispatch_table[OP_GET_SUBSCRIPT] = &&label_OP_GET_SUBSCRIPT;
+        dispatch_table[OP_SET_SUBSCRIPT] = &&label_OP_SET_SUBSCRIPT;
+        dispatch_table[OP_RETURN]        = &&label_OP_RETURN;
+        dispatch_table[OP_NOT_EQUAL]     = &&label_OP_NOT_EQUAL;
+        dispatch_table[OP_GREATER_EQUAL] = &&label_OP_GREATER_EQUAL;
+        dispatch_table[OP_LESS_EQUAL]    = &&label_OP_LESS_EQUAL;
+        dispatch_table[OP_SET_LOCAL_POP] = &&label_OP_SET_LOCAL_POP;
+        dispatch_table[OP_EQUAL_JUMP]         = &&label_OP_EQUAL_JUMP;
+        dispatch_table[OP_NOT_EQUAL_JUMP]     = &&label_OP_NOT_EQUAL_JUMP;
+        dispatch_table[OP_GREATER_JUMP]       = &&label_OP_GREATER_JUMP;
+        dispatch_table[OP_GREATER_EQUAL_JUMP] = &&label_OP_GREATER_EQUAL_JUMP;
+        dispatch_table[OP_LESS_JUMP]          = &&label_OP_LESS_JUMP;
+        dispatch_table[OP_LESS_EQUAL_JUMP]    = &&label_OP_LESS_EQUAL_JUMP;
+        dispatch_table[OP_ADD_LOCAL_LOCAL]       = &&label_OP_ADD_LOCAL_LOCAL;
+        dispatch_table[OP_INC_LOCAL_CONST]       = &&label_OP_INC_LOCAL_CONST;
+        dispatch_table[OP_LESS_LOCAL_CONST_JUMP] = &&label_OP_LESS_LOCAL_CONST_JUMP;
+        dispatch_table[OP_LESS_LOCAL_LOCAL_JUMP] = &&label_OP_LESS_LOCAL_LOCAL_JUMP;
+        dispatch_table[OP_ADD_NUM]      = &&label_OP_ADD_NUM;
+        dispatch_table[OP_SUBTRACT_NUM] = &&label_OP_SUBTRACT_NUM;
+        dispatch_table[OP_MULTIPLY_NUM] = &&label_OP_MULTIPLY_NUM;
+        dispatch_table[OP_DIVIDE_NUM]   = &&label_OP_DIVIDE_NUM;
+        dispatch_table[OP_GREATER_NUM]  = &&label_OP_GREATER_NUM;
+        dispatch_table[OP_LESS_NUM]     = &&label_OP_LESS_NUM;
+        dispatch_table[OP_CHECK_NUMBER] = &&label_OP_CHECK_NUMBER;
+        dispatch_table[OP_DIVIDE_INT]   = &&label_OP_DIVIDE_INT;
+        dispatch_table[OP_GET_GLOBAL_QUICK]       = &&label_OP_GET_GLOBAL_QUICK;
+        dispatch_table[OP_SET_GLOBAL_POP]         = &&label_OP_SET_GLOBAL_POP;
+        dispatch_table[OP_INC_GLOBAL_CONST]       = &&label_OP_INC_GLOBAL_CONST;
+        dispatch_table[OP_LESS_GLOBAL_CONST_JUMP] = &&label_OP_LESS_GLOBAL_CONST_JUMP;
+        dispatch_table[OP_GET_NATIVE]             = &&label_OP_GET_NATIVE;
+        dispatch_table[OP_CALL_NATIVE]            = &&label_OP_CALL_NATIVE;
+        dispatch_table[OP_ARRAY_LITERAL]          = &&label_OP_ARRAY_LITERAL;
+        dispatch_table[OP_ARRAY_APPEND]           = &&label_OP_ARRAY_APPEND;
+        dispatch_table_ready = true;
+    }
+
+    // O 'for' externo só existe para espelhar a estrutura do 'switch':
+    // com computed goto cada instrução salta diretamente para a próxima.
+    DISPATCH();
+    for (;;) {
+        {
+#else
+    for (;;) {
+        TRACE_INSTRUCTION();
+        PROFILE_INSTRUCTION();
+        switch (READ_BYTE()) {
+#endif
+            INSTRUCTION(OP_CONSTANT): PUSH(READ_CONSTANT()); DISPATCH();
+            INSTRUCTION(OP_NIL):      PUSH(SapphireValue()); DISPATCH();
+            INSTRUCTION(OP_TRUE):     PUSH(true); DISPATCH();
+            INSTRUCTION(OP_FALSE):    PUSH(false); DISPATCH();
+            INSTRUCTION(OP_POP):      stack_top--; DISPATCH();
+
+            INSTRUCTION(OP_GET_LOCAL): PUSH(slots[READ_BYTE()]); DISPATCH();
+            INSTRUCTION(OP_SET_LOCAL): slots[READ_BYTE()] = PEEK(0); DISPATCH();
+            INSTRUCTION(OP_SET_LOCAL_POP): {
+                uint8_t slot = READ_BYTE();
+                slots[slot] = POP();
+                DISPATCH();
+            }
+
+            // O operando das instruções de globais é o slot (16 bits) na GlobalTable.
+            INSTRUCTION(OP_GET_GLOBAL): {
+                uint16_t slot = READ_SHORT();
+                if (!globals.defined[slot]) {
+                    std::cerr << "Runtime Error: Undefined global variable '" << globals.names[slot]->chars << "'." << std::endl;
+                    return false;
+                }
+                PUSH(globals.values[slot]);
+                DISPATCH();
+            }
+            INSTRUCTION(OP_DEFINE_GLOBAL): {
+                uint16_t slot = READ_SHORT();
+                global_write_barrier(PEEK(0));
+                globals.values[slot] = PEEK(0);
+                globals.defined[slot] = 1;
+                stack_top--;
+                DISPATCH();
+            }
+            INSTRUCTION(OP_GET_PROPERTY): {
+                if (!is_obj_type(PEEK(0), OBJ_INSTANCE)) {
+                    std::cerr << "Runtime Error: Only instances have properties." << std::endl;
+                    return false;
+                }
+                ObjInstance* instance = static_cast<ObjInstance*>(PEEK(0).as_obj());
+                ObjString* name = READ_STRING();
+                InlineCache* cache = &caches[READ_SHORT()];
+                // Troca a instância pelo valor do campo (ou pelo bound method).
+                PEEK(0) = get_property(instance, PEEK(0), name, cache, frame->function);
+                DISPATCH();
+            }
+            INSTRUCTION(OP_SET_PROPERTY): {
+                if (!is_obj_type(PEEK(1), OBJ_INSTANCE)) {
+                    std::cerr << "Runtime Error: Only instances have fields." << std::endl;
+                    return false;
+                }
+                ObjInstance* instance = static_cast<ObjInstance*>(PEEK(1).as_obj());
+                ObjString* name = READ_STRING();
+                InlineCache* cache = &caches[READ_SHORT()];
+                set_property(instance, name, cache, frame->function, PEEK(0));
+
+                // O valor atribuído fica no lugar da instância.
+                SapphireValue value = POP();
+                PEEK(0) = value;
+                DISPATCH();
+            }
+            INSTRUCTION(OP_SET_GLOBAL): {
+                uint16_t slot = READ_SHORT();
+                if (!globals.defined[slot]) {
+                    std::cerr << "Runtime Error: Undefined global variable for assignment '" << globals.names[slot]->chars << "'." << std::endl;
+                    return false;
+                }
+                global_write_barrier(PEEK(0));
+                globals.values[slot] = PEEK(0);
+                DISPATCH();
+            }
+            INSTRUCTION(OP_CLOSURE): {
+                ObjFunction* function = static_cast<ObjFunction*>(READ_CONSTANT().as_obj());
+                ObjClosure* closure = new_closure(function);
+                PUSH(closure);
+                DISPATCH();
+            }
+
+            INSTRUCTION(OP_EQUAL): {
+                SapphireValue b = POP();
+                SapphireValue a = POP();
+                PUSH(values_equal(a, b));
+                DISPATCH();
+            }
+            INSTRUCTION(OP_GREATER): BINARY_OP(bool, >); DISPATCH();
+            INSTRUCTION(OP_LESS):    BINARY_OP(bool, <); DISPATCH();
+            INSTRUCTION(OP_NOT_EQUAL): {
+                SapphireValue b = POP();
+                SapphireValue a = POP();
+                PUSH(!values_equal(a, b));
+                DISPATCH();
+            }
+            INSTRUCTION(OP_GREATER_EQUAL): COMPARE_OP(!(a < b)); DISPATCH();
+            INSTRUCTION(OP_LESS_EQUAL):    COMPARE_OP(!(a > b)); DISPATCH();
+
+            INSTRUCTION(OP_ADD): {
+                // O caso numérico vem primeiro: é de longe o mais comum.
+                if (both_numbers(PEEK(1), PEEK(0))) {
+                    SapphireValue b = POP();
+                    PEEK(0) = add_numbers(PEEK(0), b);
+                } else if (!concatenate()) {
+                    return false;
+                }
+                DISPATCH();
+            }
+            // Superinstruções (optimizer.cpp). Fora do caso numérico, empilham
+            // os operandos e seguem o mesmo caminho de OP_ADD.
+            INSTRUCTION(OP_ADD_LOCAL_LOCAL): {
+                const SapphireValue& a = slots[READ_BYTE()];
+                const SapphireValue& b = slots[READ_BYTE()];
+                if (both_numbers(a, b)) {
+                    PUSH(add_numbers(a, b));
+                } else {
+                    PUSH(a);
+                    PUSH(b);
+                    if (!concatenate()) return false;
+                }
+                DISPATCH();
+            }
+            INSTRUCTION(OP_INC_LOCAL_CONST): {
+                SapphireValue& local = slots[READ_BYTE()];
+                const SapphireValue& constant = READ_CONSTANT();
+                if (both_numbers(local, constant)) {
+                    local = add_numbers(local, constant);
+                } else {
+                    PUSH(local);
+                    PUSH(constant);
+                    if (!concatenate()) return false;
+                    local = POP();
+                }
+                DISPATCH();
+            }
+            INSTRUCTION(OP_LESS_LOCAL_CONST_JUMP): {
+                const SapphireValue& left = slots[READ_BYTE()];
+                const SapphireValue& right = READ_CONSTANT();
+                uint16_t offset = READ_SHORT();
+                if (!both_numbers(left, right)) {
+                    PUSH(left);
+                    PUSH(right);
+                    CHECK_NUMBER_OPERANDS();
+                }
+                WITH_NUMBERS(left, right, if (!(a < b)) ip += offset);
+                DISPATCH();
+            }
+            INSTRUCTION(OP_LESS_LOCAL_LOCAL_JUMP): {
+                const SapphireValue& left = slots[READ_BYTE()];
+                const SapphireValue& right = slots[READ_BYTE()];
+                uint16_t offset = READ_SHORT();
+                if (!both_numbers(left, right)) {
+                    PUSH(left);
+                    PUSH(right);
+                    CHECK_NUMBER_OPERANDS();
+                }
+                WITH_NUMBERS(left, right, if (!(a < b)) ip += offset);
+                DISPATCH();
+            }
+            // Instruções aceleradas (quicken_chunk): a global já está definida.
+            INSTRUCTION(OP_GET_GLOBAL_QUICK):
+                PUSH(globals.values[READ_SHORT()]);
+                DISPATCH();
+            INSTRUCTION(OP_SET_GLOBAL_POP): {
+                uint16_t slot = READ_SHORT();
+                global_write_barrier(PEEK(0));
+                globals.values[slot] = POP();
+                DISPATCH();
+            }
+            INSTRUCTION(OP_INC_GLOBAL_CONST): {
+                SapphireValue& global = globals.values[READ_SHORT()];
+                const SapphireValue& constant = READ_CONSTANT();
+                if (both_numbers(global, constant)) {
+                    global = add_numbers(global, constant);
+                } else {
+                    PUSH(global);
+                    PUSH(constant);
+                    if (!concatenate()) return false;
+                    global_write_barrier(PEEK(0));
+                    global = POP();
+                }
+                DISPATCH();
+            }
+            INSTRUCTION(OP_LESS_GLOBAL_CONST_JUMP): {
+                const SapphireValue& left = globals.values[READ_SHORT()];
+                const SapphireValue& right = READ_CONSTANT();
+                uint16_t offset = READ_SHORT();
+                if (!both_numbers(left, right)) {
+                    PUSH(left);
+                    PUSH(right);
+                    CHECK_NUMBER_OPERANDS();
+                }
+                WITH_NUMBERS(left, right, if (!(a < b)) ip += offset);
+                DISPATCH();
+            }
+            INSTRUCTION(OP_SUBTRACT): ARITHMETIC_OP(subtract_numbers); DISPATCH();
+            INSTRUCTION(OP_MULTIPLY): ARITHMETIC_OP(multiply_numbers); DISPATCH();
+            INSTRUCTION(OP_DIVIDE):   ARITHMETIC_OP(divide_numbers); DISPATCH();
+            INSTRUCTION(OP_DIVIDE_INT): {
+                CHECK_NUMBER_OPERANDS();
+                SapphireValue b = POP();
+                if (b.as_number() == 0) {
+                    std::cerr << "Runtime Error: Integer division by zero." << std::endl;
+                    return false;
+                }
+                PEEK(0) = divide_integers(PEEK(0), b);
+                DISPATCH();
+            }
+
+            INSTRUCTION(OP_ADD_NUM):      NUMBER_ARITHMETIC_OP(add_numbers); DISPATCH();
+            INSTRUCTION(OP_SUBTRACT_NUM): NUMBER_ARITHMETIC_OP(subtract_numbers); DISPATCH();
+            INSTRUCTION(OP_MULTIPLY_NUM): NUMBER_ARITHMETIC_OP(multiply_numbers); DISPATCH();
+            INSTRUCTION(OP_DIVIDE_NUM):   NUMBER_ARITHMETIC_OP(divide_numbers); DISPATCH();
+            INSTRUCTION(OP_GREATER_NUM):  NUMBER_OP(bool, >); DISPATCH();
+            INSTRUCTION(OP_LESS_NUM):     NUMBER_OP(bool, <); DISPATCH();
+            INSTRUCTION(OP_CHECK_NUMBER):
+                if (!PEEK(0).is_number()) {
+                    std::cerr << "Runtime Error: A numeric variable can't hold a "
+                              << get_value_type_name(PEEK(0)) << "." << std::endl;
+                    return false;
+                }
+                DISPATCH();
+
+            INSTRUCTION(OP_NOT): PEEK(0) = is_falsey(PEEK(0)); DISPATCH();
+            INSTRUCTION(OP_NEGATE):
+                if (!PEEK(0).is_number()) {
                     std::cerr << "Erro de Runtime: Operando para '-' deve ser um numero." << std::endl;
                     return false;
                 }
-                push(-std::get<double>(pop()._value));
-                break;
+                PEEK(0) = negate_number(PEEK(0));
+                DISPATCH();
 
-            case OP_PRINT: {
-                print_value(pop());
+            INSTRUCTION(OP_PRINT): {
+                print_value(POP());
                 std::cout << std::endl;
-                break;
+                DISPATCH();
             }
 
-            case OP_JUMP: {
-                uint16_t offset = (frame->ip[0] << 8) | frame->ip[1];
-                frame->ip += offset;
-                break;
+            // Os saltos são relativos ao fim do operando de 16 bits.
+            INSTRUCTION(OP_JUMP): {
+                uint16_t offset = READ_SHORT();
+                ip += offset;
+                DISPATCH();
+            }
+            INSTRUCTION(OP_JUMP_IF_FALSE): {
+                uint16_t offset = READ_SHORT();
+                if (is_falsey(PEEK(0))) ip += offset;
+                DISPATCH();
             }
-            case OP_JUMP_IF_FALSE: {
-                uint16_t offset = (frame->ip[0] << 8) | frame->ip[1];
-                frame->ip += 2;
-                if (is_falsey(peek(0))) {
-                    frame->ip += offset;
+            INSTRUCTION(OP_LOOP): {
+                uint16_t offset = READ_SHORT();
+                ip -= offset;
+                // Um laço quente sobe a função de nível no meio da execução:
+                // tier_up reposiciona o ip salvo no código novo.
+                if (frame->function->chunk.hotness <= JIT_HOT_THRESHOLD) {
+                    SAVE_FRAME();
+                    count_hotness(frame->function);
+                    ip = frame->ip;
                 }
-                break;
+                JIT_ENTER();
+                DISPATCH();
             }
-            case OP_LOOP: {
-                uint16_t offset = (frame->ip[0] << 8) | frame->ip[1];
-                frame->ip -= offset;
-                break;
+            INSTRUCTION(OP_EQUAL_JUMP):         EQUAL_JUMP(values_equal(a, b)); DISPATCH();
+            INSTRUCTION(OP_NOT_EQUAL_JUMP):     EQUAL_JUMP(!values_equal(a, b)); DISPATCH();
+            INSTRUCTION(OP_GREATER_JUMP):       COMPARE_JUMP(a > b); DISPATCH();
+            INSTRUCTION(OP_GREATER_EQUAL_JUMP): COMPARE_JUMP(!(a < b)); DISPATCH();
+            INSTRUCTION(OP_LESS_JUMP):          COMPARE_JUMP(a < b); DISPATCH();
+            INSTRUCTION(OP_LESS_EQUAL_JUMP):    COMPARE_JUMP(!(a > b)); DISPATCH();
+            INSTRUCTION(OP_CALL): {
+                int arg_count = READ_BYTE();
+                SAVE_FRAME();
+                if (!call_value(PEEK(arg_count), arg_count)) {
+                    return false;
+                }
+                LOAD_FRAME();
+                JIT_ENTER();
+                DISPATCH();
             }
-            case OP_CALL: {
-                int arg_count = *frame->ip++;
-                if (!call_value(peek(arg_count), arg_count)) {
+            // Membro de módulo nativo: o slot foi resolvido na compilação e a
+            // aridade já conferida, então a nativa lê os argumentos da pilha.
+            INSTRUCTION(OP_GET_NATIVE): PUSH(globals.natives.functions[READ_SHORT()]); DISPATCH();
+            INSTRUCTION(OP_CALL_NATIVE): {
+                ObjNative* native = globals.natives.functions[READ_SHORT()];
+                int arg_count = READ_BYTE();
+                NativeCall call{stack_top - arg_count, arg_count, native->userdata};
+                if (!native->function(call)) {
+                    std::cerr << "Runtime Error: " << call.error << std::endl;
                     return false;
                 }
-                frame = &frames[frame_count - 1];
-                break;
+                stack_top -= arg_count;
+                PUSH(call.result);
+                DISPATCH();
             }
-            case OP_RETURN: {
-                SapphireValue result = pop();
+            INSTRUCTION(OP_INVOKE): {
+                ObjString* name = READ_STRING();
+                InlineCache* cache = &caches[READ_SHORT()];
+                int arg_count = READ_BYTE();
+                SAVE_FRAME();
+
+                if (!is_obj_type(PEEK(arg_count), OBJ_INSTANCE)) {
+                    std::cerr << "Runtime Error: Only instances have methods." << std::endl;
+                    return false;
+                }
+                ObjInstance* instance = static_cast<ObjInstance*>(PEEK(arg_count).as_obj());
+
+                CacheEntry resolved;
+                const CacheEntry* entry = find_invoke(instance, name, cache, frame->function, resolved);
+                if (entry == nullptr) {
+                    std::cerr << "Runtime Error: Undefined property '" << name->chars << "'." << std::endl;
+                    return false;
+                }
+
+                if (entry->method != nullptr) {
+                    // A instância já está onde o método espera o 'this' (slot 0).
+                    if (!call(entry->method->function, arg_count)) return false;
+                } else {
+                    // Um campo que guarda algo chamável (ex: IO.readLine).
+                    SapphireValue callee = instance->fields[entry->index];
+                    PEEK(arg_count) = callee;
+                    if (!call_value(callee, arg_count)) return false;
+                }
+                LOAD_FRAME();
+                JIT_ENTER();
+                DISPATCH();
+            }
+            INSTRUCTION(OP_RETURN): {
+                SapphireValue result = POP();
                 frame_count--;
                 if (frame_count == 0) {
-                    pop();
+                    stack_top--; // Remove a função do script principal
                     return true;
                 }
                 stack_top = frame->slots;
-                push(result);
-                frame = &frames[frame_count - 1];
-                break;
+                PUSH(result);
+                LOAD_FRAME();
+                JIT_ENTER();
+                DISPATCH();
             }
-            case OP_BUILD_ARRAY: {
-                // 1. O operando é a quantidade de elementos no array.
-                uint8_t element_count = *frame->ip++;
+            INSTRUCTION(OP_BUILD_ARRAY): {
+                // 1. Os operandos são a quantidade de elementos no array e o
+                //    tipo declarado deles (ARRAY_INFER se não houver).
+                uint8_t element_count = READ_BYTE();
+                uint8_t hint = READ_BYTE();
 
-                // 2. Cria o nosso objeto de array.
-                auto array_obj = std::make_shared<SapphireArray>();
+                // 2. Cria o array com os 'element_count' elementos do topo da pilha.
+                // Eles continuam na pilha (e alcançáveis) durante a alocação.
+                ObjArray* array_obj = build_array(stack_top - element_count, element_count, hint);
 
-                // 3. Pega os 'element_count' elementos do topo da pilha e os adiciona ao array.
-                // Usamos peek para não bagunçar a pilha antes da hora.
-                for (int i = 0; i < element_count; i++) {
-                    array_obj->elements.push_back(peek(element_count - 1 - i));
-                }
-
-                // 4. Agora, remove os elementos originais da pilha.
-                for (int i = 0; i < element_count; i++) {
-                    pop();
-                }
-                
-                // 5. Coloca o novo objeto de array na pilha.
-                push(array_obj);
-                break;
+                // 3. Agora, remove os elementos originais da pilha
+                //    e coloca o novo objeto de array no lugar deles.
+                stack_top -= element_count;
+                PUSH(array_obj);
+                DISPATCH();
+            }
+            INSTRUCTION(OP_ARRAY_LITERAL): {
+                ObjString* packed = READ_STRING();
+                ArrayKind kind = static_cast<ArrayKind>(READ_BYTE());
+                PUSH(unpack_array_literal(packed, kind));
+                DISPATCH();
+            }
+            INSTRUCTION(OP_ARRAY_APPEND): {
+                uint8_t element_count = READ_BYTE();
+                ObjArray* array_obj = static_cast<ObjArray*>(PEEK(element_count).as_obj());
+                array_append(array_obj, stack_top - element_count, element_count);
+                stack_top -= element_count;
+                DISPATCH();
             }
-            case OP_GET_SUBSCRIPT: {
+            INSTRUCTION(OP_GET_SUBSCRIPT): {
                 // O índice está no topo da pilha, e o array logo abaixo.
-                SapphireValue index_val = pop();
-                SapphireValue array_val = pop();
+                SapphireValue index_val = POP();
+                SapphireValue array_val = POP();
 
                 // 1. Verifica se estamos mesmo tentando acessar um array.
-                if (!std::holds_alternative<std::shared_ptr<SapphireArray>>(array_val._value)) {
+                if (!is_obj_type(array_val, OBJ_ARRAY)) {
                     std::cerr << "Runtime Error: Subscript target must be an array." << std::endl;
                     return false;
                 }
-                auto array_obj = std::get<std::shared_ptr<SapphireArray>>(array_val._value);
-                
+                ObjArray* array_obj = static_cast<ObjArray*>(array_val.as_obj());
+
                 // 2. Verifica se o índice é um número.
-                if (!std::holds_alternative<double>(index_val._value)) {
+                if (!index_val.is_number()) {
                     std::cerr << "Runtime Error: Array index must be a number." << std::endl;
                     return false;
                 }
-                double index_double = std::get<double>(index_val._value);
+                double index_double = index_val.as_number();
                 int index = static_cast<int>(index_double);
-                
+
                 // 3. Verifica se o índice está dentro dos limites do array (bounds checking).
-                if (index < 0 || index >= array_obj->elements.size()) {
+                if (index < 0 || index >= (int)array_length(array_obj)) {
                     std::cerr << "Runtime Error: Array index out of bounds." << std::endl;
                     return false;
                 }
-                
+
                 // 4. Se tudo estiver certo, pega o elemento e o coloca na pilha.
-                push(array_obj->elements[index]);
-                break;
+                //    Arrays de números, o caso comum nos laços, são lidos direto;
+                //    os outros tipos passam por array_get.
+                if (array_obj->kind == ARRAY_DOUBLE) {
+                    PUSH(array_obj->numbers()[index]);
+                } else {
+                    PUSH(array_get(array_obj, index));
+                }
+                DISPATCH();
             }
-            case OP_SET_SUBSCRIPT: {
+            INSTRUCTION(OP_SET_SUBSCRIPT): {
                 // A ordem na pilha (do topo para baixo) é: valor, índice, array.
-                SapphireValue value = pop();
-                SapphireValue index_val = pop();
-                SapphireValue array_val = pop();
+                SapphireValue value = POP();
+                SapphireValue index_val = POP();
+                SapphireValue array_val = POP();
 
                 // Verifica se o alvo é mesmo um array.
-                if (!std::holds_alternative<std::shared_ptr<SapphireArray>>(array_val._value)) {
+                if (!is_obj_type(array_val, OBJ_ARRAY)) {
                     std::cerr << "Runtime Error: Subscript target must be an array." << std::endl;
                     return false;
                 }
-                auto array_obj = std::get<std::shared_ptr<SapphireArray>>(array_val._value);
-                
+                ObjArray* array_obj = static_cast<ObjArray*>(array_val.as_obj());
+
                 // Verifica se o índice é um número.
-                if (!std::holds_alternative<double>(index_val._value)) {
+                if (!index_val.is_number()) {
                     std::cerr << "Runtime Error: Array index must be a number." << std::endl;
                     return false;
                 }
-                int index = static_cast<int>(std::get<double>(index_val._value));
-                
+                int index = static_cast<int>(index_val.as_number());
+
                 // Verifica se o índice está dentro dos limites (bounds checking).
-                if (index < 0 || index >= array_obj->elements.size()) {
+                if (index < 0 || index >= (int)array_length(array_obj)) {
                     std::cerr << "Runtime Error: Array index out of bounds for assignment." << std::endl;
                     return false;
                 }
-                
-                // Se tudo estiver certo, atualiza o valor no array.
-                array_obj->elements[index] = value;
+
+                // Se tudo estiver certo, atualiza o valor no array. Um valor
+                // que não cabe no tipo do array o converte (ver array_set).
+                if (array_obj->kind == ARRAY_DOUBLE && value.is_number()) {
+                    array_obj->numbers()[index] = value.as_number();
+                } else {
+                    array_store(array_obj, index, value);
+                }
 
                 // Colocamos o valor atribuído de volta na pilha, pois a atribuição
                 // em si é uma expressão que tem um valor.
-                push(value); 
-                break;
+                PUSH(value);
+                DISPATCH();
+            }
+            UNKNOWN_INSTRUCTION:
+                std::cerr << "Erro de Runtime: Opcode desconhecido " << (int)ip[-1] << std::endl;
+                return false;
+        }
+    }
+}
+
+// --- O LAÇO DO BACKEND DE REGISTRADORES (register.h) ---
+// Os registradores são os slots do frame: o frame ocupa 'register_count'
+// posições da pilha e stack_top fica no fim delas, para o coletor.
+static inline const SapphireValue& register_operand(uint8_t operand, const SapphireValue* slots,
+                                                    const SapphireValue* constants) {
+    return operand & RK_CONSTANT ? constants[operand & ~RK_CONSTANT] : slots[operand];
+}
+#define RK(operand) register_operand((operand), slots, constants)
+
+#define CHECK_NUMBERS(a, b) \
+    do { \
+        if (!both_numbers((a), (b))) { \
+            std::cerr << "Runtime Error : Operators must be numbers. " \
+                      << "Received " << get_value_type_name(a) \
+                      << " and " << get_value_type_name(b) \
+                      << "." << std::endl; \
+            return false; \
+        } \
+    } while (false)
+
+// A B C: A = B op C, com B e C operandos RK numéricos.
+#define REGISTER_BINARY(test) \
+    do { \
+        uint8_t destination = READ_BYTE(); \
+        const SapphireValue& left = RK(READ_BYTE()); \
+        const SapphireValue& right = RK(READ_BYTE()); \
+        CHECK_NUMBERS(left, right); \
+        WITH_NUMBERS(left, right, slots[destination] = (test)); \
+    } while (false)
+
+#define REGISTER_NUMBER(test) \
+    do { \
+        uint8_t destination = READ_BYTE(); \
+        const SapphireValue& left = RK(READ_BYTE()); \
+        const SapphireValue& right = RK(READ_BYTE()); \
+        WITH_NUMBERS(left, right, slots[destination] = (test)); \
+    } while (false)
+
+// Como REGISTER_BINARY, com uma das contas de value.h (ver ARITHMETIC_OP).
+#define REGISTER_ARITHMETIC(function) \
+    do { \
+        uint8_t destination = READ_BYTE(); \
+        const SapphireValue& left = RK(READ_BYTE()); \
+        const SapphireValue& right = RK(READ_BYTE()); \
+        CHECK_NUMBERS(left, right); \
+        slots[destination] = function(left, right); \
+    } while (false)
+
+#define REGISTER_NUMBER_ARITHMETIC(function) \
+    do { \
+        uint8_t destination = READ_BYTE(); \
+        const SapphireValue& left = RK(READ_BYTE()); \
+        const SapphireValue& right = RK(READ_BYTE()); \
+        slots[destination] = function(left, right); \
+    } while (false)
+
+#define REGISTER_COMPARE_JUMP(test) \
+    do { \
+        const SapphireValue& left = RK(READ_BYTE()); \
+        const SapphireValue& right = RK(READ_BYTE()); \
+        uint16_t offset = READ_SHORT(); \
+        CHECK_NUMBERS(left, right); \
+        WITH_NUMBERS(left, right, if (!(test)) ip += offset); \
+    } while (false)
+
+#define REGISTER_EQUAL_JUMP(test) \
+    do { \
+        const SapphireValue& a = RK(READ_BYTE()); \
+        const SapphireValue& b = RK(READ_BYTE()); \
+        uint16_t offset = READ_SHORT(); \
+        if (!(test)) ip += offset; \
+    } while (false)
+
+// Depois de uma chamada que não criou frame (nativa, classe) ou de um
+// retorno: os registradores do frame acima de 'from' podem ter ficado fora
+// das raízes durante a chamada, então voltam a ser nil.
+#define RESTORE_REGISTERS(from) \
+    do { \
+        SapphireValue* end = slots + frame->function->chunk.register_count; \
+        for (SapphireValue* slot = (from); slot < end; slot++) *slot = SapphireValue(); \
+        stack_top = end; \
+    } while (false)
+
+#undef TRACE_INSTRUCTION
+#ifdef DEBUG_TRACE_EXECUTION
+#define TRACE_INSTRUCTION() \
+    do { \
+        debug_print_stack(this); \
+        disassemble_register_instruction(frame->function->chunk, \
+                                         (int)(ip - frame->function->chunk.register_code.data())); \
+    } while (false)
+#else
+#define TRACE_INSTRUCTION() do { } while (false)
+#endif
+// O perfil de pares (--op-pairs) é do bytecode de pilha.
+#undef PROFILE_INSTRUCTION
+#define PROFILE_INSTRUCTION() do { } while (false)
+
+bool VM::run_registers() {
+    CallFrame* frame;
+    const uint8_t* ip;
+    SapphireValue* slots;
+    SapphireValue* constants;
+    InlineCache* caches;
+    LOAD_FRAME();
+
+#ifdef COMPUTED_GOTO
+    static void* dispatch_table[256];
+    static bool dispatch_table_ready = false;
+    if (!dispatch_table_ready) {
+        for (void*& target : dispatch_table) target = &&label_unknown;
+        dispatch_table[R_MOVE]               = &&label_R_MOVE;
+        dispatch_table[R_LOADK]              = &&label_R_LOADK;
+        dispatch_table[R_NIL]                = &&label_R_NIL;
+        dispatch_table[R_TRUE]               = &&label_R_TRUE;
+        dispatch_table[R_FALSE]              = &&label_R_FALSE;
+        dispatch_table[R_GET_GLOBAL]         = &&label_R_GET_GLOBAL;
+        dispatch_table[R_SET_GLOBAL]         = &&label_R_SET_GLOBAL;
+        dispatch_table[R_DEFINE_GLOBAL]      = &&label_R_DEFINE_GLOBAL;
+        dispatch_table[R_GET_PROPERTY]       = &&label_R_GET_PROPERTY;
+        dispatch_table[R_SET_PROPERTY]       = &&label_R_SET_PROPERTY;
+        dispatch_table[R_GET_SUBSCRIPT]      = &&label_R_GET_SUBSCRIPT;
+        dispatch_table[R_SET_SUBSCRIPT]      = &&label_R_SET_SUBSCRIPT;
+        dispatch_table[R_EQUAL]              = &&label_R_EQUAL;
+        dispatch_table[R_NOT_EQUAL]          = &&label_R_NOT_EQUAL;
+        dispatch_table[R_GREATER]            = &&label_R_GREATER;
+        dispatch_table[R_GREATER_EQUAL]      = &&label_R_GREATER_EQUAL;
+        dispatch_table[R_LESS]               = &&label_R_LESS;
+        dispatch_table[R_LESS_EQUAL]         = &&label_R_LESS_EQUAL;
+        dispatch_table[R_ADD]                = &&label_R_ADD;
+        dispatch_table[R_SUBTRACT]           = &&label_R_SUBTRACT;
+        dispatch_table[R_MULTIPLY]           = &&label_R_MULTIPLY;
+        dispatch_table[R_DIVIDE]             = &&label_R_DIVIDE;
+        dispatch_table[R_NOT]                = &&label_R_NOT;
+        dispatch_table[R_NEGATE]             = &&label_R_NEGATE;
+        dispatch_table[R_PRINT]              = &&label_R_PRINT;
+        dispatch_table[R_JUMP]               = &&label_R_JUMP;
+        dispatch_table[R_LOOP]               = &&label_R_LOOP;
+        dispatch_table[R_JUMP_IF_FALSE]      = &&label_R_JUMP_IF_FALSE;
+        dispatch_table[R_EQUAL_JUMP]         = &&label_R_EQUAL_JUMP;
+        dispatch_table[R_NOT_EQUAL_JUMP]     = &&label_R_NOT_EQUAL_JUMP;
+        dispatch_table[R_GREATER_JUMP]       = &&label_R_GREATER_JUMP;
+        dispatch_table[R_GREATER_EQUAL_JUMP] = &&label_R_GREATER_EQUAL_JUMP;
+        dispatch_table[R_LESS_JUMP]          = &&label_R_LESS_JUMP;
+        dispatch_table[R_LESS_EQUAL_JUMP]    = &&label_R_LESS_EQUAL_JUMP;
+        dispatch_table[R_CLOSURE]            = &&label_R_CLOSURE;
+        dispatch_table[R_CALL]               = &&label_R_CALL;
+        dispatch_table[R_INVOKE]             = &&label_R_INVOKE;
+        dispatch_table[R_BUILD_ARRAY]        = &&label_R_BUILD_ARRAY;
+        dispatch_table[R_RETURN]             = &&label_R_RETURN;
+        dispatch_table[R_ADD_NUM]            = &&label_R_ADD_NUM;
+        dispatch_table[R_SUBTRACT_NUM]       = &&label_R_SUBTRACT_NUM;
+        dispatch_table[R_MULTIPLY_NUM]       = &&label_R_MULTIPLY_NUM;
+        dispatch_table[R_DIVIDE_NUM]         = &&label_R_DIVIDE_NUM;
+        dispatch_table[R_GREATER_NUM]        = &&label_R_GREATER_NUM;
+        dispatch_table[R_LESS_NUM]           = &&label_R_LESS_NUM;
+        dispatch_table[R_CHECK_NUMBER]       = &&label_R_CHECK_NUMBER;
+        dispatch_table[R_GET_NATIVE]         = &&label_R_GET_NATIVE;
+        dispatch_table[R_CALL_NATIVE]        = &&label_R_CALL_NATIVE;
+        dispatch_table[R_ARRAY_LITERAL]      = &&label_R_ARRAY_LITERAL;
+        dispatch_table[R_ARRAY_APPEND]       = &&label_R_ARRAY_APPEND;
+        dispatch_table[R_DIVIDE_INT]         = &&label_R_DIVIDE_INT;
+        dispatch_table_ready = true;
+    }
+
+    DISPATCH();
+    for (;;) {
+        {
+#else
+    for (;;) {
+        TRACE_INSTRUCTION();
+        switch (READ_BYTE()) {
+#endif
+            INSTRUCTION(R_MOVE): {
+                uint8_t destination = READ_BYTE();
+                slots[destination] = slots[READ_BYTE()];
+                DISPATCH();
+            }
+            INSTRUCTION(R_LOADK): {
+                uint8_t destination = READ_BYTE();
+                slots[destination] = READ_CONSTANT();
+                DISPATCH();
             }
-             default:
-                std::cerr << "Erro de Runtime: Opcode desconhecido " << (int)instruction << std::endl;
+            INSTRUCTION(R_NIL):   slots[READ_BYTE()] = SapphireValue(); DISPATCH();
+            INSTRUCTION(R_TRUE):  slots[READ_BYTE()] = true; DISPATCH();
+            INSTRUCTION(R_FALSE): slots[READ_BYTE()] = false; DISPATCH();
+
+            INSTRUCTION(R_GET_GLOBAL): {
+                uint8_t destination = READ_BYTE();
+                uint16_t slot = READ_SHORT();
+                if (!globals.defined[slot]) {
+                    std::cerr << "Runtime Error: Undefined global variable '" << globals.names[slot]->chars << "'." << std::endl;
+                    return false;
+                }
+                slots[destination] = globals.values[slot];
+                DISPATCH();
+            }
+            INSTRUCTION(R_SET_GLOBAL): {
+                const SapphireValue& value = RK(READ_BYTE());
+                uint16_t slot = READ_SHORT();
+                if (!globals.defined[slot]) {
+                    std::cerr << "Runtime Error: Undefined global variable for assignment '" << globals.names[slot]->chars << "'." << std::endl;
+                    return false;
+                }
+                global_write_barrier(value);
+                globals.values[slot] = value;
+                DISPATCH();
+            }
+            INSTRUCTION(R_DEFINE_GLOBAL): {
+                const SapphireValue& value = RK(READ_BYTE());
+                uint16_t slot = READ_SHORT();
+                global_write_barrier(value);
+                globals.values[slot] = value;
+                globals.defined[slot] = 1;
+                DISPATCH();
+            }
+
+            INSTRUCTION(R_GET_PROPERTY): {
+                uint8_t destination = READ_BYTE();
+                const SapphireValue& object = slots[READ_BYTE()];
+                if (!is_obj_type(object, OBJ_INSTANCE)) {
+                    std::cerr << "Runtime Error: Only instances have properties." << std::endl;
+                    return false;
+                }
+                ObjString* name = READ_STRING();
+                InlineCache* cache = &caches[READ_SHORT()];
+                SapphireValue value = get_property(static_cast<ObjInstance*>(object.as_obj()), object, name, cache, frame->function);
+                slots[destination] = value;
+                DISPATCH();
+            }
+            INSTRUCTION(R_SET_PROPERTY): {
+                const SapphireValue& object = slots[READ_BYTE()];
+                const SapphireValue& value = RK(READ_BYTE());
+                if (!is_obj_type(object, OBJ_INSTANCE)) {
+                    std::cerr << "Runtime Error: Only instances have fields." << std::endl;
+                    return false;
+                }
+                ObjString* name = READ_STRING();
+                InlineCache* cache = &caches[READ_SHORT()];
+                set_property(static_cast<ObjInstance*>(object.as_obj()), name, cache, frame->function, value);
+                DISPATCH();
+            }
+            INSTRUCTION(R_GET_SUBSCRIPT): {
+                uint8_t destination = READ_BYTE();
+                const SapphireValue& array_val = slots[READ_BYTE()];
+                const SapphireValue& index_val = RK(READ_BYTE());
+                if (!is_obj_type(array_val, OBJ_ARRAY)) {
+                    std::cerr << "Runtime Error: Subscript target must be an array." << std::endl;
+                    return false;
+                }
+                ObjArray* array_obj = static_cast<ObjArray*>(array_val.as_obj());
+                if (!index_val.is_number()) {
+                    std::cerr << "Runtime Error: Array index must be a number." << std::endl;
+                    return false;
+                }
+                int index = static_cast<int>(index_val.as_number());
+                if (index < 0 || index >= (int)array_length(array_obj)) {
+                    std::cerr << "Runtime Error: Array index out of bounds." << std::endl;
+                    return false;
+                }
+                if (array_obj->kind == ARRAY_DOUBLE) {
+                    slots[destination] = array_obj->numbers()[index];
+                } else {
+                    slots[destination] = array_get(array_obj, index);
+                }
+                DISPATCH();
+            }
+            INSTRUCTION(R_SET_SUBSCRIPT): {
+                const SapphireValue& array_val = slots[READ_BYTE()];
+                const SapphireValue& index_val = RK(READ_BYTE());
+                const SapphireValue& value = RK(READ_BYTE());
+                if (!is_obj_type(array_val, OBJ_ARRAY)) {
+                    std::cerr << "Runtime Error: Subscript target must be an array." << std::endl;
+                    return false;
+                }
+                ObjArray* array_obj = static_cast<ObjArray*>(array_val.as_obj());
+                if (!index_val.is_number()) {
+                    std::cerr << "Runtime Error: Array index must be a number." << std::endl;
+                    return false;
+                }
+                int index = static_cast<int>(index_val.as_number());
+                if (index < 0 || index >= (int)array_length(array_obj)) {
+                    std::cerr << "Runtime Error: Array index out of bounds for assignment." << std::endl;
+                    return false;
+                }
+                if (array_obj->kind == ARRAY_DOUBLE && value.is_number()) {
+                    array_obj->numbers()[index] = value.as_number();
+                } else {
+                    array_store(array_obj, index, value);
+                }
+                DISPATCH();
+            }
+
+            INSTRUCTION(R_EQUAL): {
+                uint8_t destination = READ_BYTE();
+                const SapphireValue& a = RK(READ_BYTE());
+                const SapphireValue& b = RK(READ_BYTE());
+                bool equal = values_equal(a, b);
+                slots[destination] = equal;
+                DISPATCH();
+            }
+            INSTRUCTION(R_NOT_EQUAL): {
+                uint8_t destination = READ_BYTE();
+                const SapphireValue& a = RK(READ_BYTE());
+                const SapphireValue& b = RK(READ_BYTE());
+                bool equal = values_equal(a, b);
+                slots[destination] = !equal;
+                DISPATCH();
+            }
+            INSTRUCTION(R_GREATER):       REGISTER_BINARY(a > b); DISPATCH();
+            INSTRUCTION(R_GREATER_EQUAL): REGISTER_BINARY(!(a < b)); DISPATCH();
+            INSTRUCTION(R_LESS):          REGISTER_BINARY(a < b); DISPATCH();
+            INSTRUCTION(R_LESS_EQUAL):    REGISTER_BINARY(!(a > b)); DISPATCH();
+            INSTRUCTION(R_ADD): {
+                uint8_t destination = READ_BYTE();
+                const SapphireValue& left = RK(READ_BYTE());
+                const SapphireValue& right = RK(READ_BYTE());
+                if (both_numbers(left, right)) {
+                    slots[destination] = add_numbers(left, right);
+                } else {
+                    // Strings: o mesmo caminho de OP_ADD, com os operandos
+                    // empilhados logo acima dos registradores do frame.
+                    PUSH(left);
+                    PUSH(right);
+                    if (!concatenate()) return false;
+                    slots[destination] = POP();
+                }
+                DISPATCH();
+            }
+            INSTRUCTION(R_SUBTRACT): REGISTER_ARITHMETIC(subtract_numbers); DISPATCH();
+            INSTRUCTION(R_MULTIPLY): REGISTER_ARITHMETIC(multiply_numbers); DISPATCH();
+            INSTRUCTION(R_DIVIDE):   REGISTER_ARITHMETIC(divide_numbers); DISPATCH();
+            INSTRUCTION(R_DIVIDE_INT): {
+                uint8_t destination = READ_BYTE();
+                const SapphireValue& left = RK(READ_BYTE());
+                const SapphireValue& right = RK(READ_BYTE());
+                CHECK_NUMBERS(left, right);
+                if (right.as_number() == 0) {
+                    std::cerr << "Runtime Error: Integer division by zero." << std::endl;
+                    return false;
+                }
+                slots[destination] = divide_integers(left, right);
+                DISPATCH();
+            }
+            INSTRUCTION(R_ADD_NUM):      REGISTER_NUMBER_ARITHMETIC(add_numbers); DISPATCH();
+            INSTRUCTION(R_SUBTRACT_NUM): REGISTER_NUMBER_ARITHMETIC(subtract_numbers); DISPATCH();
+            INSTRUCTION(R_MULTIPLY_NUM): REGISTER_NUMBER_ARITHMETIC(multiply_numbers); DISPATCH();
+            INSTRUCTION(R_DIVIDE_NUM):   REGISTER_NUMBER_ARITHMETIC(divide_numbers); DISPATCH();
+            INSTRUCTION(R_GREATER_NUM):  REGISTER_NUMBER(a > b); DISPATCH();
+            INSTRUCTION(R_LESS_NUM):     REGISTER_NUMBER(a < b); DISPATCH();
+            INSTRUCTION(R_CHECK_NUMBER): {
+                const SapphireValue& value = RK(READ_BYTE());
+                if (!value.is_number()) {
+                    std::cerr << "Runtime Error: A numeric variable can't hold a "
+                              << get_value_type_name(value) << "." << std::endl;
+                    return false;
+                }
+                DISPATCH();
+            }
+            INSTRUCTION(R_NOT): {
+                uint8_t destination = READ_BYTE();
+                bool falsey = is_falsey(RK(READ_BYTE()));
+                slots[destination] = falsey;
+                DISPATCH();
+            }
+            INSTRUCTION(R_NEGATE): {
+                uint8_t destination = READ_BYTE();
+                const SapphireValue& value = RK(READ_BYTE());
+                if (!value.is_number()) {
+                    std::cerr << "Erro de Runtime: Operando para '-' deve ser um numero." << std::endl;
+                    return false;
+                }
+                slots[destination] = negate_number(value);
+                DISPATCH();
+            }
+            INSTRUCTION(R_PRINT): {
+                print_value(RK(READ_BYTE()));
+                std::cout << std::endl;
+                DISPATCH();
+            }
+
+            INSTRUCTION(R_JUMP): {
+                uint16_t offset = READ_SHORT();
+                ip += offset;
+                DISPATCH();
+            }
+            INSTRUCTION(R_LOOP): {
+                uint16_t offset = READ_SHORT();
+                ip -= offset;
+                DISPATCH();
+            }
+            INSTRUCTION(R_JUMP_IF_FALSE): {
+                const SapphireValue& condition = RK(READ_BYTE());
+                uint16_t offset = READ_SHORT();
+                if (is_falsey(condition)) ip += offset;
+                DISPATCH();
+            }
+            INSTRUCTION(R_EQUAL_JUMP):         REGISTER_EQUAL_JUMP(values_equal(a, b)); DISPATCH();
+            INSTRUCTION(R_NOT_EQUAL_JUMP):     REGISTER_EQUAL_JUMP(!values_equal(a, b)); DISPATCH();
+            INSTRUCTION(R_GREATER_JUMP):       REGISTER_COMPARE_JUMP(a > b); DISPATCH();
+            INSTRUCTION(R_GREATER_EQUAL_JUMP): REGISTER_COMPARE_JUMP(!(a < b)); DISPATCH();
+            INSTRUCTION(R_LESS_JUMP):          REGISTER_COMPARE_JUMP(a < b); DISPATCH();
+            INSTRUCTION(R_LESS_EQUAL_JUMP):    REGISTER_COMPARE_JUMP(!(a > b)); DISPATCH();
+
+            INSTRUCTION(R_CLOSURE): {
+                uint8_t destination = READ_BYTE();
+                ObjFunction* function = static_cast<ObjFunction*>(READ_CONSTANT().as_obj());
+                ObjClosure* closure = new_closure(function);
+                slots[destination] = closure;
+                DISPATCH();
+            }
+            // A chamada usa as posições A.. como base do novo frame, igual à
+            // VM de pilha: call()/call_value() leem o chamado e os argumentos
+            // logo abaixo de stack_top.
+            INSTRUCTION(R_CALL): {
+                SapphireValue* base = slots + READ_BYTE();
+                int arg_count = READ_BYTE();
+                int frames_before = frame_count;
+                stack_top = base + arg_count + 1;
+                SAVE_FRAME();
+                if (!call_value(*base, arg_count)) return false;
+                if (frame_count == frames_before) RESTORE_REGISTERS(base + arg_count + 1);
+                LOAD_FRAME();
+                DISPATCH();
+            }
+            INSTRUCTION(R_GET_NATIVE): {
+                uint8_t destination = READ_BYTE();
+                slots[destination] = globals.natives.functions[READ_SHORT()];
+                DISPATCH();
+            }
+            // Os argumentos já estão em registradores do frame (abaixo de
+            // stack_top), então a nativa os lê no lugar.
+            INSTRUCTION(R_CALL_NATIVE): {
+                SapphireValue* base = slots + READ_BYTE();
+                ObjNative* native = globals.natives.functions[READ_SHORT()];
+                int arg_count = READ_BYTE();
+                NativeCall call{base, arg_count, native->userdata};
+                if (!native->function(call)) {
+                    std::cerr << "Runtime Error: " << call.error << std::endl;
+                    return false;
+                }
+                *base = call.result;
+                DISPATCH();
+            }
+            INSTRUCTION(R_INVOKE): {
+                SapphireValue* base = slots + READ_BYTE();
+                ObjString* name = READ_STRING();
+                InlineCache* cache = &caches[READ_SHORT()];
+                int arg_count = READ_BYTE();
+                if (!is_obj_type(*base, OBJ_INSTANCE)) {
+                    std::cerr << "Runtime Error: Only instances have methods." << std::endl;
+                    return false;
+                }
+                ObjInstance* instance = static_cast<ObjInstance*>(base->as_obj());
+                CacheEntry resolved;
+                const CacheEntry* entry = find_invoke(instance, name, cache, frame->function, resolved);
+                if (entry == nullptr) {
+                    std::cerr << "Runtime Error: Undefined property '" << name->chars << "'." << std::endl;
+                    return false;
+                }
+
+                int frames_before = frame_count;
+                stack_top = base + arg_count + 1;
+                SAVE_FRAME();
+                if (entry->method != nullptr) {
+                    if (!call(entry->method->function, arg_count)) return false;
+                } else {
+                    SapphireValue callee = instance->fields[entry->index];
+                    *base = callee;
+                    if (!call_value(callee, arg_count)) return false;
+                }
+                if (frame_count == frames_before) RESTORE_REGISTERS(base + arg_count + 1);
+                LOAD_FRAME();
+                DISPATCH();
+            }
+            INSTRUCTION(R_BUILD_ARRAY): {
+                uint8_t first = READ_BYTE();
+                uint8_t element_count = READ_BYTE();
+                uint8_t hint = READ_BYTE();
+                ObjArray* array_obj = build_array(&slots[first], element_count, hint);
+                slots[first] = array_obj;
+                DISPATCH();
+            }
+            INSTRUCTION(R_ARRAY_LITERAL): {
+                uint8_t destination = READ_BYTE();
+                ObjString* packed = READ_STRING();
+                ArrayKind kind = static_cast<ArrayKind>(READ_BYTE());
+                slots[destination] = unpack_array_literal(packed, kind);
+                DISPATCH();
+            }
+            INSTRUCTION(R_ARRAY_APPEND): {
+                uint8_t first = READ_BYTE();
+                uint8_t element_count = READ_BYTE();
+                array_append(static_cast<ObjArray*>(slots[first].as_obj()), &slots[first + 1], element_count);
+                DISPATCH();
+            }
+            INSTRUCTION(R_RETURN): {
+                SapphireValue result = RK(READ_BYTE());
+                SapphireValue* base = frame->slots;
+                SapphireValue* callee_end = stack_top;
+                frame_count--;
+                if (frame_count == 0) {
+                    stack_top = base; // Remove a função do script principal
+                    return true;
+                }
+                *base = result; // O registrador A da instrução de chamada
+                LOAD_FRAME();
+                RESTORE_REGISTERS(callee_end > base + 1 ? callee_end : base + 1);
+                DISPATCH();
+            }
+            UNKNOWN_INSTRUCTION:
+                std::cerr << "Erro de Runtime: Opcode desconhecido " << (int)ip[-1] << std::endl;
                 return false;
         }
     }
 }
 
+#undef RK
+#undef CHECK_NUMBERS
+#undef REGISTER_BINARY
+#undef REGISTER_NUMBER
+#undef REGISTER_ARITHMETIC
+#undef REGISTER_NUMBER_ARITHMETIC
+#undef REGISTER_COMPARE_JUMP
+#undef REGISTER_EQUAL_JUMP
+#undef RESTORE_REGISTERS
+#undef READ_BYTE
+#undef READ_SHORT
+#undef READ_CONSTANT
+#undef READ_STRING
+#undef PUSH
+#undef POP
+#undef PEEK
+#undef SAVE_FRAME
+#undef LOAD_FRAME
+#undef CHECK_NUMBER_OPERANDS
+#undef WITH_NUMBERS
+#undef BINARY_OP
+#undef ARITHMETIC_OP
+#undef NUMBER_OP
+#undef NUMBER_ARITHMETIC_OP
+#undef COMPARE_OP
+#undef COMPARE_JUMP
+#undef EQUAL_JUMP
+#undef JIT_ENTER
+#undef TRACE_INSTRUCTION
+#undef PROFILE_INSTRUCTION
+#undef INSTRUCTION
+#undef UNKNOWN_INSTRUCTION
+#undef DISPATCH
+
+
+ObjFunction* VM::compile(const std::string& source) {
+    return ::compile(source, globals);
+}
+
+bool VM::save_bytecode(std::ostream& out, ObjFunction* function) const {
+    return write_bytecode(out, function, globals);
+}
+
+ObjFunction* VM::load_bytecode(std::istream& in) {
+    return read_bytecode(in, globals);
+}
+
+bool VM::save_image(std::ostream& out, ObjFunction* function) const {
+    return write_image(out, function, globals);
+}
+
+ObjFunction* VM::load_image(const std::string& path) {
+    BytecodeImage* image = open_image(path);
+    if (image == nullptr) return nullptr;
+    images.push_back(image);
+    return ::load_image(image, globals);
+}
 
 bool VM::interpret(const std::string& source) {
     ObjFunction* function = compile(source);
     if (function == nullptr) return false;
+    return interpret(function);
+}
 
+bool VM::interpret(ObjFunction* function) {
     push(function);
-    call(function, 0);
+    if (!call(function, 0)) return false;
 
     #ifdef DEBUG_PRINT_CODE
         disassemble_chunk(function->chunk, "Script Principal");
     #endif
 
-    return run();
-}
\ No newline at end of file
+    bool ok = backend == BACKEND_REGISTER ? run_registers() : run();
+    if (print_cache_stats) ::print_cache_stats(function);
+    return ok;
+}
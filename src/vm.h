@@ -4,8 +4,13 @@
 #include "chunk.h"
 #include "value.h"
 #include "object.h" // Incluído para ObjFunction
+#include "memory.h"
+#include "native.h"
 #include <unordered_map>
 #include <string>
+#include <istream>
+#include <ostream>
+#include <vector>
 
 #define FRAMES_MAX 64
 #define STACK_MAX (FRAMES_MAX * 256)
@@ -13,14 +18,87 @@
 // Representa um único quadro de chamada na pilha de chamadas da VM.
 struct CallFrame {
     ObjFunction* function;
-    uint8_t* ip;        // Instruction Pointer
+    const uint8_t* ip;  // Instruction Pointer
     SapphireValue* slots; // Ponteiro para o slot da VM onde o quadro começa
 };
 
+// Membros dos módulos nativos registrados (ver native.h), em slots fixos.
+// O compilador resolve "Modulo.membro" para o slot, e OP_CALL_NATIVE indexa
+// 'functions' direto. Como nas globais, os arquivos de bytecode guardam os
+// nomes qualificados e remapeiam os slots na carga.
+struct NativeTable {
+    StringTable<uint16_t> slots;        // "Math.sqrt" (internado) -> slot
+    std::vector<ObjString*> names;      // Slot -> nome qualificado
+    std::vector<ObjNative*> functions;  // Slot -> nativa
+    StringTable<ObjInstance*> modules;  // Nome do módulo -> objeto global dele
+
+    // Retorna o slot do nome qualificado, ou -1 se não houver.
+    int find(ObjString* name) const;
+    // Retorna o slot do novo membro, ou -1 se a tabela estiver cheia.
+    int add(ObjString* name, ObjNative* native);
+};
+
+// Tabela de variáveis globais compartilhada entre o compilador e a VM.
+// O compilador resolve cada nome para um índice fixo (slot) na primeira vez
+// que o encontra, e as instruções de globais indexam 'values' diretamente,
+// sem calcular hash de strings em tempo de execução. Como a tabela vive na
+// VM, um nome usado antes de ser definido (ex: numa linha anterior do REPL)
+// recebe o mesmo slot que a sua definição posterior usará.
+struct GlobalTable {
+    StringTable<uint16_t> slots;     // Nome (internado) -> slot
+    std::vector<ObjString*> names;   // Slot -> nome (para mensagens de erro)
+    std::vector<SapphireValue> values;
+    std::vector<uint8_t> defined;    // 0 enquanto OP_DEFINE_GLOBAL não rodar
+    NativeTable natives;             // Também resolvidas pelo compilador
+
+    // Retorna o slot do nome, criando um novo (ainda indefinido) se preciso.
+    // Retorna -1 se a tabela estiver cheia.
+    int resolve(ObjString* name);
+    // Caminho por nome, para quem não passou pelo compilador (ex: nativas).
+    void define(ObjString* name, const SapphireValue& value);
+};
+
+// Laço de execução usado pela VM (escolhido na partida, antes de rodar código).
+enum VMBackend {
+    BACKEND_STACK,     // Bytecode de pilha (a referência)
+    BACKEND_REGISTER,  // Tradução para registradores (register.h)
+};
+
 class VM {
 public:
     VM();
+    ~VM();
     bool interpret(const std::string& source);
+    // Executa um script já compilado (ex: carregado de um arquivo .spc).
+    bool interpret(ObjFunction* function);
+
+    // Compila sem executar. Os nomes globais ficam resolvidos na tabela desta VM.
+    ObjFunction* compile(const std::string& source);
+    // Bytecode em disco (ver serializer.h).
+    bool save_bytecode(std::ostream& out, ObjFunction* function) const;
+    ObjFunction* load_bytecode(std::istream& in);
+    // Imagens mapeadas em memória (ver image.h). A imagem fica aberta até a
+    // VM ser destruída, porque as funções são materializadas sob demanda.
+    bool save_image(std::ostream& out, ObjFunction* function) const;
+    ObjFunction* load_image(const std::string& path);
+
+    // Marca as raízes da VM (pilha, frames e globais) para o coletor de lixo.
+    void mark_roots(bool include_globals);
+    // Atualiza as raízes que apontam para objetos promovidos do berçário.
+    void forward_roots(bool include_globals);
+    const GCStats& gc_stats() const { return ::gc_stats(); }
+    double gc_pause_percentile(double percentile) const { return ::gc_pause_percentile(percentile); }
+    // Imprime as estatísticas dos inline caches ao fim de cada interpret().
+    void set_print_cache_stats(bool enabled) { print_cache_stats = enabled; }
+    void set_backend(VMBackend value) { backend = value; }
+    // Acelera o bytecode das funções quentes do backend de pilha (optimizer.h).
+    void set_tiering(bool enabled) { tiering_enabled = enabled; }
+    // Compila para código nativo as funções quentes do backend de pilha (jit.h).
+    void set_jit(bool enabled) { jit_enabled = enabled; }
+    // Registra um módulo nativo (ver native.h). Precisa acontecer antes de
+    // compilar o código que usa o módulo. Registrar de novo um módulo
+    // existente acrescenta membros a ele. Retorna false se a tabela encher.
+    bool register_module(const NativeModule& module, void* userdata = nullptr);
 
 private:
     CallFrame frames[FRAMES_MAX];
@@ -30,17 +108,35 @@ private:
     SapphireValue stack[STACK_MAX];
     SapphireValue* stack_top;
 
-    std::unordered_map<std::string, SapphireValue> globals;
+    GlobalTable globals;
+    std::vector<BytecodeImage*> images;
+    bool print_cache_stats = false;
+    VMBackend backend = BACKEND_STACK;
+    bool tiering_enabled = true;
+    bool jit_enabled = false;
 
     bool run();
+    bool run_registers();
+    // Conta uma chamada ou volta de laço e sobe a função de nível ao ficar quente.
+    void count_hotness(ObjFunction* function);
+    // Troca o bytecode pelo acelerado e move os frames da função para ele.
+    void tier_up(ObjFunction* function);
+    // Roda o código nativo do frame a partir de frame->ip e atualiza
+    // frame->ip e stack_top para onde o interpretador deve continuar.
+    void run_jit(CallFrame* frame);
     void push(const SapphireValue& value);
     SapphireValue pop();
     SapphireValue& peek(int distance);
 
+    // OP_ADD quando os operandos no topo da pilha não são dois números:
+    // concatena duas strings ou reporta o erro.
+    bool concatenate();
+
     bool call(ObjFunction* function, int arg_count);
     bool call_value(SapphireValue callee, int arg_count);
 
-    void define_native(const std::string& name, NativeFn function);
+    // 'name' precisa viver tanto quanto a VM (normalmente um literal).
+    void define_native(const char* name, NativeFn function, int arity, void* userdata = nullptr);
 };
 
 #endif //SAPPHIRE_VM_H
\ No newline at end of file
@@ -0,0 +1,88 @@
+#!/usr/bin/env bash
+# Testes de regressão do Sapphire.
+#
+# Uso: tests/run.sh [binario] [filtro]
+#   binario  padrão: build/sapphire
+#   filtro   só os testes cujo nome contém o texto (ex: "array")
+#
+# Cada tests/NOME.sp roda em todos os modos e a saída (stdout e stderr) é
+# comparada com tests/NOME.out:
+#   pilha, registr.  as duas VMs (--vm=register)
+#   jit              --jit, se a build tiver o JIT
+#   sem-peephole     --no-peephole
+#   gc               coletor geracional e incremental, com fatias pequenas
+#   cache            --cache duas vezes: compila e grava, depois lê o .spc
+#   spc, spi         --compile para bytecode e para imagem, e roda o arquivo
+# As listagens de DEBUG_PRINT_CODE/DEBUG_PRINT_LEXER e a faixa do início
+# são descartadas antes da comparação. Sai com 1 se algum modo divergir.
+
+set -u
+
+BIN=${1:-build/sapphire}
+FILTER=${2:-}
+DIR=$(cd "$(dirname "$0")" && pwd)
+
+if [ ! -x "$BIN" ]; then
+    echo "Binario nao encontrado: $BIN" >&2
+    exit 1
+fi
+
+TMP=$(mktemp -d)
+trap 'rm -rf "$TMP"' EXIT
+export SAPPHIRE_CACHE_DIR=$TMP/cache
+
+MODES="pilha registr. sem-peephole gc cache spc spi"
+if "$BIN" --jit "$DIR/loop.sp" >/dev/null 2>&1; then
+    MODES="pilha registr. jit sem-peephole gc cache spc spi"
+fi
+
+# Saída do programa, sem as listagens de depuração.
+clean() {
+    grep -a -v -E '^[0-9]{4} |^== |^--- DEBUG|^start index|^current index|^Calculated length|^Substring value|^-----------|^>>>>>>'
+}
+
+# Roda o teste $1 no modo $2.
+run_mode() {
+    local script=$1 mode=$2 name
+    name=$(basename "$script" .sp)
+    case "$mode" in
+        pilha)        "$BIN" --no-cache "$script" ;;
+        registr.)     "$BIN" --no-cache --vm=register "$script" ;;
+        jit)          "$BIN" --no-cache --jit "$script" ;;
+        sem-peephole) "$BIN" --no-cache --no-peephole "$script" ;;
+        gc)           "$BIN" --no-cache --gc-generational --gc-incremental --gc-slice=16 "$script" ;;
+        cache)
+            "$BIN" --cache "$script" >/dev/null 2>&1
+            "$BIN" --cache "$script"
+            ;;
+        spc|spi)
+            "$BIN" --compile "$TMP/$name.$mode" "$script" >/dev/null 2>&1
+            "$BIN" "$TMP/$name.$mode"
+            ;;
+    esac 2>&1 | clean
+}
+
+failed=0
+total=0
+for script in "$DIR"/*.sp; do
+    name=$(basename "$script" .sp)
+    case "$name" in *"$FILTER"*) ;; *) continue ;; esac
+    total=$((total + 1))
+    bad=""
+    for mode in $MODES; do
+        if ! run_mode "$script" "$mode" | diff --strip-trailing-cr -u "$DIR/$name.out" - >"$TMP/diff" 2>&1; then
+            bad="$bad $mode"
+            sed 's/^/    /' "$TMP/diff" | head -20
+        fi
+    done
+    if [ -n "$bad" ]; then
+        echo "FALHOU $name:$bad"
+        failed=$((failed + 1))
+    else
+        echo "ok     $name"
+    fi
+done
+
+echo
+echo "$((total - failed))/$total testes passaram ($MODES)"
+[ "$failed" -eq 0 ]